@@ -0,0 +1,22 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class IlluviumSimCore : ModuleRules
+{
+	public IlluviumSimCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		// Rules only, no Engine: the simulation has to run without a world, actors or rendering
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject" });
+
+		// Benchmark result export
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json" });
+
+		PublicIncludePaths.AddRange(new string[]
+		{
+			"IlluviumSimCore/Public/"
+		});
+	}
+}
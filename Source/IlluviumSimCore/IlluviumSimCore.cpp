@@ -0,0 +1,22 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "IlluviumSimCore.h"
+#include "Benchmark/AllocationCounter.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Modules/ModuleManager.h"
+
+class FIlluviumSimCoreModule : public FDefaultModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		// Runs before the engine loop, so a game or editor can still wrap GMalloc here
+		if (FParse::Param(FCommandLine::Get(), TEXT("CountAllocations")))
+		{
+			FAllocationCounter::Install();
+		}
+	}
+};
+
+IMPLEMENT_MODULE( FIlluviumSimCoreModule, IlluviumSimCore );
@@ -0,0 +1,195 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BattleTypes.h"
+
+namespace
+{
+	// Single cell moves in the order FGridAStar expands neighbours
+	const FGridCoordinate UnitMoveOffsets[4] {
+		{+1,0},
+		{0,+1},
+		{-1,0},
+		{0,-1}
+	};
+
+	// Multi-cell moves span at most 8 cells along each axis
+	constexpr int32 MaxMoveOffset = 8;
+
+	// Largest grid a step may claim to run on
+	constexpr uint32 MaxGridExtent = 1 << 15;
+
+	// Most moving units a step can carry, far above any battle the simulation runs. Rejecting larger counts up
+	// front, and growing the arrays only as elements decode, bounds what a malformed packet makes the reader do
+	constexpr uint32 MaxNetUnits = 1 << 16;
+
+	FORCEINLINE uint32 ZigZag(int32 Value)
+	{
+		return (static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31);
+	}
+
+	FORCEINLINE int32 UnZigZag(uint32 Value)
+	{
+		return static_cast<int32>(Value >> 1) ^ -static_cast<int32>(Value & 1);
+	}
+
+	FORCEINLINE bool SerializeFlag(FArchive& Ar, bool bFlag)
+	{
+		uint8 Bit = bFlag ? 1 : 0;
+		Ar.SerializeBits(&Bit, 1);
+		return Bit != 0;
+	}
+
+	FORCEINLINE void SerializeBounded(FArchive& Ar, uint32& Value, uint32 ValueMax)
+	{
+		// A single possible value needs no bits, and bit writers refuse a maximum below 2
+		if (ValueMax > 1)
+		{
+			Ar.SerializeInt(Value, ValueMax);
+		}
+		else
+		{
+			Value = 0;
+		}
+	}
+
+	FORCEINLINE void SerializeSigned(FArchive& Ar, int32& Value)
+	{
+		uint32 Encoded = ZigZag(Value);
+		Ar.SerializeIntPacked(Encoded);
+		Value = UnZigZag(Encoded);
+	}
+}
+
+bool FStepDelta::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = true;
+
+	uint32 NumMoves = Moves.Num();
+	uint32 NumEvents = Events.Num();
+	uint32 GridX = GridSize.X;
+	uint32 GridY = GridSize.Y;
+	Ar.SerializeIntPacked(NumMoves);
+	Ar.SerializeIntPacked(NumEvents);
+	Ar.SerializeIntPacked(GridX);
+	Ar.SerializeIntPacked(GridY);
+	Ar << StateHash;
+
+	// Every unit moves at most once and takes part in at most three events per step. The grid is checked first so
+	// its cell count cannot overflow
+	const bool bGridValid = GridX <= MaxGridExtent && GridY <= MaxGridExtent;
+	const uint32 MaxUnits = bGridValid ? FMath::Min(GridX * GridY, MaxNetUnits) : 0;
+	if (Ar.IsError() || !bGridValid || NumMoves > MaxUnits || NumEvents > 3 * MaxUnits)
+	{
+		Ar.SetError();
+		bOutSuccess = false;
+		return false;
+	}
+
+	if (Ar.IsLoading())
+	{
+		GridSize = FIntPoint(GridX, GridY);
+
+		// Added as they decode rather than sized from the counts, so a packet claiming more than it carries stops
+		// at its last bit instead of allocating what it claims
+		Moves.Reset();
+		Events.Reset();
+	}
+
+	// Moves are committed in unit order, so ids only grow within a step
+	int32 PreviousMoverId = 0;
+	for (uint32 MoveIndex = 0; MoveIndex < NumMoves && !Ar.IsError(); ++MoveIndex)
+	{
+		FSimMove& Move = Ar.IsLoading() ? Moves.AddDefaulted_GetRef() : Moves[MoveIndex];
+
+		uint32 IdDelta = Move.ActorId - PreviousMoverId;
+		Ar.SerializeIntPacked(IdDelta);
+		Move.ActorId = PreviousMoverId + IdDelta;
+		PreviousMoverId = Move.ActorId;
+
+		uint32 FromX = Move.From.X;
+		uint32 FromY = Move.From.Y;
+		SerializeBounded(Ar, FromX, GridX);
+		SerializeBounded(Ar, FromY, GridY);
+		Move.From = FGridCoordinate(FromX, FromY);
+
+		int32 UnitMoveIndex = INDEX_NONE;
+		if (Ar.IsSaving())
+		{
+			const FGridCoordinate Offset(Move.To.X - Move.From.X, Move.To.Y - Move.From.Y);
+			UnitMoveIndex = UE_ARRAY_COUNT(UnitMoveOffsets) - 1;
+			while (UnitMoveIndex >= 0 && !(UnitMoveOffsets[UnitMoveIndex] == Offset))
+			{
+				--UnitMoveIndex;
+			}
+		}
+
+		if (SerializeFlag(Ar, UnitMoveIndex != INDEX_NONE))
+		{
+			uint32 Direction = UnitMoveIndex;
+			Ar.SerializeInt(Direction, UE_ARRAY_COUNT(UnitMoveOffsets));
+			const FGridCoordinate& Offset = UnitMoveOffsets[Direction];
+			Move.To = FGridCoordinate(Move.From.X + Offset.X, Move.From.Y + Offset.Y);
+		}
+		else
+		{
+			uint32 OffsetX = 0;
+			uint32 OffsetY = 0;
+			if (Ar.IsSaving())
+			{
+				OffsetX = Move.To.X - Move.From.X + MaxMoveOffset;
+				OffsetY = Move.To.Y - Move.From.Y + MaxMoveOffset;
+				bOutSuccess &= OffsetX <= 2 * MaxMoveOffset && OffsetY <= 2 * MaxMoveOffset;
+			}
+			Ar.SerializeInt(OffsetX, 2 * MaxMoveOffset + 1);
+			Ar.SerializeInt(OffsetY, 2 * MaxMoveOffset + 1);
+			Move.To = FGridCoordinate(Move.From.X + OffsetX - MaxMoveOffset, Move.From.Y + OffsetY - MaxMoveOffset);
+		}
+	}
+
+	// Attackers act in unit order. A Hit carries its Attack's pair swapped and a Die its Hit's pair, so both are
+	// predicted from the event before them
+	int32 PreviousActorId = 0;
+	for (uint32 EventIndex = 0; EventIndex < NumEvents && !Ar.IsError(); ++EventIndex)
+	{
+		FSimEvent& Event = Ar.IsLoading() ? Events.AddDefaulted_GetRef() : Events[EventIndex];
+		const FSimEvent* PreviousEvent = EventIndex > 0 ? &Events[EventIndex - 1] : nullptr;
+
+		uint32 EventType = static_cast<uint32>(Event.EventType);
+		Ar.SerializeInt(EventType, static_cast<uint32>(EEventType::Die) + 1);
+		Event.EventType = static_cast<EEventType>(EventType);
+
+		FSimEvent Predicted;
+		if (PreviousEvent)
+		{
+			const bool bSwapped = PreviousEvent->EventType == EEventType::Attack;
+			Predicted.ActorId = bSwapped ? PreviousEvent->OtherId : PreviousEvent->ActorId;
+			Predicted.OtherId = bSwapped ? PreviousEvent->ActorId : PreviousEvent->OtherId;
+		}
+
+		const bool bMatchesPrediction = Ar.IsSaving() && PreviousEvent &&
+			Event.ActorId == Predicted.ActorId && Event.OtherId == Predicted.OtherId;
+		if (PreviousEvent && SerializeFlag(Ar, bMatchesPrediction))
+		{
+			Event.ActorId = Predicted.ActorId;
+			Event.OtherId = Predicted.OtherId;
+		}
+		else
+		{
+			int32 ActorDelta = Event.ActorId - PreviousActorId;
+			SerializeSigned(Ar, ActorDelta);
+			Event.ActorId = PreviousActorId + ActorDelta;
+			PreviousActorId = Event.ActorId;
+
+			int32 OtherDelta = Event.OtherId - Event.ActorId;
+			SerializeSigned(Ar, OtherDelta);
+			Event.OtherId = Event.ActorId + OtherDelta;
+		}
+	}
+
+	if (Ar.IsError())
+	{
+		bOutSuccess = false;
+	}
+	return true;
+}
@@ -0,0 +1,119 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Benchmark/AllocationCounter.h"
+
+#include <atomic>
+
+#include "CoreGlobals.h"
+#include "HAL/MemoryBase.h"
+
+namespace
+{
+	std::atomic<uint64> GNumAllocations { 0 };
+	std::atomic<uint64> GAllocatedBytes { 0 };
+	std::atomic<bool> GIsInstalled { false };
+	thread_local uint64 GNumAllocationsOnThread = 0;
+
+#if GRIDBATTLE_WITH_ALLOCATION_COUNTER
+	class FCountingMallocProxy final : public FMalloc
+	{
+	public:
+		explicit FCountingMallocProxy(FMalloc* InInnerMalloc)
+			: InnerMalloc(InInnerMalloc)
+		{
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Record(Count);
+			return InnerMalloc->Malloc(Count, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Record(Count);
+			return InnerMalloc->TryMalloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			Record(Count);
+			return InnerMalloc->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			Record(Count);
+			return InnerMalloc->TryRealloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { InnerMalloc->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return InnerMalloc->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return InnerMalloc->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { InnerMalloc->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { InnerMalloc->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { InnerMalloc->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { InnerMalloc->InitializeStatsMetadata(); }
+		virtual void UpdateStats() override { InnerMalloc->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { InnerMalloc->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { InnerMalloc->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return InnerMalloc->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return InnerMalloc->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return TEXT("CountingMallocProxy"); }
+
+	private:
+		static FORCEINLINE void Record(SIZE_T Count)
+		{
+			// Realloc to zero is a free
+			if (Count == 0) return;
+			GNumAllocations.fetch_add(1, std::memory_order_relaxed);
+			GAllocatedBytes.fetch_add(Count, std::memory_order_relaxed);
+			++GNumAllocationsOnThread;
+		}
+
+		FMalloc* InnerMalloc;
+	};
+#endif
+}
+
+bool FAllocationCounter::Install()
+{
+#if GRIDBATTLE_WITH_ALLOCATION_COUNTER
+	if (GIsInstalled.load()) return true;
+
+	if (GIsRunning && !IsRunningCommandlet())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Allocation counter not installed: GMalloc can only be wrapped at startup, run with -CountAllocations"));
+		return false;
+	}
+
+	GIsInstalled.store(true);
+
+	// Every call is forwarded, so blocks allocated before the swap are still freed by the allocator that owns them
+	GMalloc = new FCountingMallocProxy(GMalloc);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool FAllocationCounter::IsInstalled()
+{
+	return GIsInstalled.load();
+}
+
+uint64 FAllocationCounter::GetNumAllocations()
+{
+	return GNumAllocations.load(std::memory_order_relaxed);
+}
+
+uint64 FAllocationCounter::GetAllocatedBytes()
+{
+	return GAllocatedBytes.load(std::memory_order_relaxed);
+}
+
+uint64 FAllocationCounter::GetNumAllocationsOnCurrentThread()
+{
+	return GNumAllocationsOnThread;
+}
@@ -0,0 +1,478 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Benchmark/GridPerfSuite.h"
+
+#include "Benchmark/AllocationCounter.h"
+#include "Navigation/GridAStar.h"
+#include "Navigation/GridHierarchy.h"
+#include "Navigation/GridOccupancy.h"
+#include "Navigation/GridRegionLabels.h"
+#include "Policies/PrettyJsonPrintPolicy.h"
+#include "Serialization/JsonWriter.h"
+#include "Simulation/BattleSimulation.h"
+#include "Templates/Function.h"
+
+namespace
+{
+	/** Allocation totals between construction and Finish(), zero when the counter is not installed. */
+	struct FAllocationScope
+	{
+		uint64 StartAllocations = FAllocationCounter::GetNumAllocations();
+		uint64 StartBytes = FAllocationCounter::GetAllocatedBytes();
+
+		void Finish(int32 Calls, FGridPerfResult& OutResult) const
+		{
+			if (!FAllocationCounter::IsInstalled() || Calls <= 0) return;
+			OutResult.AllocationsPerCall = double(FAllocationCounter::GetNumAllocations() - StartAllocations) / Calls;
+			OutResult.BytesPerCall = double(FAllocationCounter::GetAllocatedBytes() - StartBytes) / Calls;
+		}
+	};
+
+	double CyclesToMs(uint64 Cycles)
+	{
+		return FPlatformTime::GetSecondsPerCycle64() * Cycles * 1000.0;
+	}
+
+	FGridCoordinate MakeRandomFreeCell(FRandomStream& RandomStream, const FGridOccupancy& Obstacles,
+	                                   int32 MinX, int32 MaxX, int32 GridHeight)
+	{
+		FGridCoordinate Cell;
+		do
+		{
+			Cell.X = RandomStream.RandRange(MinX, MaxX);
+			Cell.Y = RandomStream.RandRange(0, GridHeight - 1);
+		}
+		while (Obstacles.IsSet(Cell));
+		return Cell;
+	}
+
+	/**
+	 * Times Search over every endpoint pair. Search returns whether it found a path, writes it to Path and sets the
+	 * nodes it expanded. The length of each path found, 0 for none, goes to OutPathCells if given, and each that
+	 * differs from ExpectedPathCells counts as a path mismatch.
+	 */
+	void RunFindPathQueries(const FString& Scenario, const FIntPoint& GridSize,
+	                        const TArray<TPair<FGridCoordinate, FGridCoordinate>>& Endpoints, FPathRequest& PathRequest,
+	                        TFunctionRef<bool(const FPathRequest&, int32&)> Search, const TArray<FGridCoordinate>& Path,
+	                        TArray<FGridPerfResult>& OutResults, TArray<int32>* OutPathCells = nullptr,
+	                        const TArray<int32>* ExpectedPathCells = nullptr)
+	{
+		int32 NodesExpanded = 0;
+
+		// Grows the context to the grid once, like a long running simulation would have
+		PathRequest.Start = Endpoints[0].Key;
+		PathRequest.Goal = Endpoints[0].Value;
+		Search(PathRequest, NodesExpanded);
+
+		FGridPerfResult& Result = OutResults.AddDefaulted_GetRef();
+		Result.Suite = TEXT("FindPath");
+		Result.Scenario = Scenario;
+		Result.GridSize = GridSize.X;
+		Result.Calls = Endpoints.Num();
+
+		TArray<double> TimesMs;
+		TArray<double> NodesExpandedSamples;
+		TimesMs.Reserve(Endpoints.Num());
+		NodesExpandedSamples.Reserve(Endpoints.Num());
+
+		if (OutPathCells)
+		{
+			OutPathCells->Reset(Endpoints.Num());
+		}
+
+		const FAllocationScope Allocations;
+		for (int32 QueryIndex = 0; QueryIndex < Endpoints.Num(); ++QueryIndex)
+		{
+			PathRequest.Start = Endpoints[QueryIndex].Key;
+			PathRequest.Goal = Endpoints[QueryIndex].Value;
+
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			const bool bFound = Search(PathRequest, NodesExpanded);
+			const uint64 EndCycles = FPlatformTime::Cycles64();
+
+			TimesMs.Add(CyclesToMs(EndCycles - StartCycles));
+			NodesExpandedSamples.Add(NodesExpanded);
+			Result.Successes += bFound ? 1 : 0;
+
+			const int32 PathCells = bFound ? Path.Num() : 0;
+			if (OutPathCells)
+			{
+				OutPathCells->Add(PathCells);
+			}
+			if (ExpectedPathCells && (*ExpectedPathCells)[QueryIndex] != PathCells)
+			{
+				UE_LOG(LogTemp, Error, TEXT("FindPath %s grid=%d from (%d,%d) to (%d,%d): %d path cells, expected %d"),
+				       *Scenario, GridSize.X, PathRequest.Start.X, PathRequest.Start.Y, PathRequest.Goal.X, PathRequest.Goal.Y,
+				       PathCells, (*ExpectedPathCells)[QueryIndex]);
+				++Result.PathMismatches;
+			}
+		}
+		Allocations.Finish(Result.Calls, Result);
+
+		Result.TimeMs = FGridPerfStats::FromSamples(TimesMs);
+		Result.NodesExpanded = FGridPerfStats::FromSamples(NodesExpandedSamples);
+		FGridPerfSuite::LogResult(Result);
+	}
+
+	void RunFindPathScenario(const FString& Scenario, const FGridOccupancy& Obstacles, bool bAcrossMiddle,
+	                         const FGridPerfSuiteSettings& Settings, TArray<FGridPerfResult>& OutResults)
+	{
+		const FIntPoint GridSize = Obstacles.GetGridSize();
+		FRandomStream RandomStream(Settings.Seed);
+
+		// Endpoints are drawn up front so the timed loop only runs searches
+		TArray<TPair<FGridCoordinate, FGridCoordinate>> Endpoints;
+		for (int32 QueryIndex = 0; QueryIndex < Settings.PathQueries; ++QueryIndex)
+		{
+			const int32 HalfX = GridSize.X / 2;
+			const FGridCoordinate Start = MakeRandomFreeCell(RandomStream, Obstacles, 0, bAcrossMiddle ? HalfX - 1 : GridSize.X - 1, GridSize.Y);
+			const FGridCoordinate Goal = MakeRandomFreeCell(RandomStream, Obstacles, bAcrossMiddle ? HalfX + 1 : 0, GridSize.X - 1, GridSize.Y);
+			Endpoints.Emplace(Start, Goal);
+		}
+
+		FPathRequest PathRequest;
+		PathRequest.GridSize = GridSize;
+		PathRequest.Occupancy = &Obstacles;
+
+		FGridAStarContext Context;
+		TArray<FGridCoordinate> Path;
+		TArray<int32> AStarPathCells;
+
+		RunFindPathQueries(Scenario, GridSize, Endpoints, PathRequest,
+			[&](const FPathRequest& Request, int32& OutNodesExpanded)
+			{
+				const bool bFound = FGridAStar::FindPath(Request, Path, Context);
+				OutNodesExpanded = Context.LastNodesExpanded;
+				return bFound;
+			}, Path, OutResults, &AStarPathCells);
+
+		if (Settings.bJumpPointSearch)
+		{
+			// Jump point paths may take other cells than A*'s but must be just as short
+			PathRequest.SearchMode = EGridSearchMode::JumpPoint;
+			RunFindPathQueries(Scenario + TEXT("/JPS"), GridSize, Endpoints, PathRequest,
+				[&](const FPathRequest& Request, int32& OutNodesExpanded)
+				{
+					const bool bFound = FGridAStar::FindPath(Request, Path, Context);
+					OutNodesExpanded = Context.LastNodesExpanded;
+					return bFound;
+				}, Path, OutResults, nullptr, &AStarPathCells);
+			PathRequest.SearchMode = EGridSearchMode::AStar;
+		}
+
+		if (Settings.bRegionLabels)
+		{
+			const double LabelStart = FPlatformTime::Seconds();
+			FGridRegionLabels Regions;
+			Regions.Build(Obstacles);
+			UE_LOG(LogTemp, Display, TEXT("FGridRegionLabels %s grid=%d: %d regions labelled in %.2fms"),
+			       *Scenario, GridSize.X, Regions.GetNumRegions(), (FPlatformTime::Seconds() - LabelStart) * 1000.0);
+
+			PathRequest.Regions = &Regions;
+			RunFindPathQueries(Scenario + TEXT("/Regions"), GridSize, Endpoints, PathRequest,
+				[&](const FPathRequest& Request, int32& OutNodesExpanded)
+				{
+					const bool bFound = FGridAStar::FindPath(Request, Path, Context);
+					OutNodesExpanded = Context.LastNodesExpanded;
+					return bFound;
+				}, Path, OutResults);
+			PathRequest.Regions = nullptr;
+		}
+
+		if (Settings.ExpansionBudget > 0)
+		{
+			PathRequest.MaxExpansions = Settings.ExpansionBudget;
+			PathRequest.bAllowPartialPath = true;
+			RunFindPathQueries(Scenario + TEXT("/Budget"), GridSize, Endpoints, PathRequest,
+				[&](const FPathRequest& Request, int32& OutNodesExpanded)
+				{
+					FGridAStar::FindPath(Request, Path, Context);
+					OutNodesExpanded = Context.LastNodesExpanded;
+					return Context.LastResult == EGridSearchResult::Found;
+				}, Path, OutResults);
+			PathRequest.MaxExpansions = MAX_int32;
+			PathRequest.bAllowPartialPath = false;
+		}
+
+		if (!Settings.bHierarchical) return;
+
+		// The obstacles are static here, the hierarchy takes them instead of the request
+		const double BuildStart = FPlatformTime::Seconds();
+		FGridHierarchy Hierarchy;
+		Hierarchy.Build(Obstacles, Settings.HierarchyClusterSize);
+		UE_LOG(LogTemp, Display, TEXT("FGridHierarchy %s grid=%d: %d entrances built in %.2fms"),
+		       *Scenario, GridSize.X, Hierarchy.GetNumEntrances(), (FPlatformTime::Seconds() - BuildStart) * 1000.0);
+
+		PathRequest.Occupancy = nullptr;
+		FGridHierarchyContext HierarchyContext;
+		for (const int32 MaxRefinedCells : { MAX_int32, 1 })
+		{
+			PathRequest.MaxRefinedCells = MaxRefinedCells;
+			RunFindPathQueries(Scenario + (MaxRefinedCells == 1 ? TEXT("/HPA-Lazy") : TEXT("/HPA")), GridSize, Endpoints, PathRequest,
+				[&](const FPathRequest& Request, int32& OutNodesExpanded)
+				{
+					const bool bFound = Hierarchy.FindPath(Request, Path, HierarchyContext);
+					OutNodesExpanded = HierarchyContext.LastNodesExpanded;
+					return bFound;
+				}, Path, OutResults);
+		}
+	}
+
+	const TCHAR* GetPlannerName(EMovementPlanner Planner)
+	{
+		switch (Planner)
+		{
+		case EMovementPlanner::FlowField:    return TEXT("FlowField");
+		case EMovementPlanner::Hierarchical: return TEXT("Hierarchical");
+		default:                             return TEXT("AStar");
+		}
+	}
+
+	void WriteStats(TJsonWriter<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>& Writer, const TCHAR* Name, const FGridPerfStats& Stats)
+	{
+		Writer.WriteObjectStart(Name);
+		Writer.WriteValue(TEXT("median"), Stats.Median);
+		Writer.WriteValue(TEXT("p99"), Stats.P99);
+		Writer.WriteValue(TEXT("mean"), Stats.Mean);
+		Writer.WriteValue(TEXT("max"), Stats.Max);
+		Writer.WriteObjectEnd();
+	}
+}
+
+FGridPerfStats FGridPerfStats::FromSamples(TArray<double>& Samples)
+{
+	FGridPerfStats Stats;
+	if (Samples.IsEmpty()) return Stats;
+
+	Samples.Sort();
+	const int32 NumSamples = Samples.Num();
+
+	double Sum = 0.0;
+	for (const double Sample : Samples)
+	{
+		Sum += Sample;
+	}
+
+	Stats.Median = Samples[NumSamples / 2];
+	Stats.P99 = Samples[FMath::Clamp(FMath::CeilToInt(NumSamples * 0.99) - 1, 0, NumSamples - 1)];
+	Stats.Mean = Sum / NumSamples;
+	Stats.Max = Samples.Last();
+	return Stats;
+}
+
+void FGridPerfSuite::Run(const FGridPerfSuiteSettings& Settings, TArray<FGridPerfResult>& OutResults)
+{
+	RunFindPath(Settings, OutResults);
+	RunStep(Settings, OutResults);
+}
+
+int32 FGridPerfSuite::CountPathMismatches(const TArray<FGridPerfResult>& Results)
+{
+	int32 NumMismatches = 0;
+	for (const FGridPerfResult& Result : Results)
+	{
+		NumMismatches += Result.PathMismatches;
+	}
+	return NumMismatches;
+}
+
+void FGridPerfSuite::RunFindPath(const FGridPerfSuiteSettings& Settings, TArray<FGridPerfResult>& OutResults)
+{
+	if (Settings.PathQueries <= 0) return;
+
+	FGridOccupancy Obstacles;
+	for (const int32 GridSize : Settings.GridSizes)
+	{
+		if (GridSize < 3) continue;
+
+		for (const float Density : Settings.ObstacleDensities)
+		{
+			Obstacles.Init(FIntPoint(GridSize, GridSize));
+
+			FRandomStream RandomStream(Settings.Seed + GridSize);
+			for (int32 Y = 0; Y < GridSize; ++Y)
+			{
+				for (int32 X = 0; X < GridSize; ++X)
+				{
+					if (RandomStream.FRand() < Density) Obstacles.Set(FGridCoordinate(X, Y));
+				}
+			}
+
+			RunFindPathScenario(FString::Printf(TEXT("Random%.2f"), Density), Obstacles, false, Settings, OutResults);
+		}
+
+		if (Settings.bWallWithGap)
+		{
+			Obstacles.Init(FIntPoint(GridSize, GridSize));
+			for (int32 Y = 0; Y < GridSize; ++Y)
+			{
+				if (Y == GridSize / 2) continue;
+				Obstacles.Set(FGridCoordinate(GridSize / 2, Y));
+			}
+
+			RunFindPathScenario(TEXT("WallWithGap"), Obstacles, true, Settings, OutResults);
+		}
+
+		if (Settings.bSealedWall)
+		{
+			Obstacles.Init(FIntPoint(GridSize, GridSize));
+			for (int32 Y = 0; Y < GridSize; ++Y)
+			{
+				Obstacles.Set(FGridCoordinate(GridSize / 2, Y));
+			}
+
+			RunFindPathScenario(TEXT("SealedWall"), Obstacles, true, Settings, OutResults);
+		}
+	}
+}
+
+void FGridPerfSuite::RunStep(const FGridPerfSuiteSettings& Settings, TArray<FGridPerfResult>& OutResults)
+{
+	if (Settings.StepsPerRun <= 0) return;
+
+	for (const int32 GridSize : Settings.GridSizes)
+	{
+		for (const int32 UnitCount : Settings.UnitCounts)
+		{
+			// Spawning draws random free cells, keep at least half the grid empty
+			if (UnitCount < 2 || UnitCount > GridSize * GridSize / 2) continue;
+
+			for (const EMovementPlanner Planner : Settings.Planners)
+			{
+				struct FStepVariant
+				{
+					const TCHAR* Suffix;
+					bool bCachePaths;
+					bool bExpansionBudget;
+					bool bSchedulePaths;
+				};
+				const FStepVariant Variants[] = {
+					{ TEXT(""), false, false, false },
+					{ TEXT("/Cached"), true, false, false },
+					{ TEXT("/Budget"), false, true, false },
+					{ TEXT("/Scheduled"), false, false, true }
+				};
+
+				for (const FStepVariant& Variant : Variants)
+				{
+					const bool bCachePaths = Variant.bCachePaths;
+					if ((bCachePaths || Variant.bExpansionBudget || Variant.bSchedulePaths) && Planner != EMovementPlanner::AStar) continue;
+					if (bCachePaths && !Settings.bCachedPaths) continue;
+					if (Variant.bExpansionBudget && Settings.ExpansionBudget <= 0) continue;
+					if (Variant.bSchedulePaths && Settings.PathBudgetPerStep <= 0) continue;
+
+					FSimConfig Config;
+					Config.GridSize = FIntPoint(GridSize, GridSize);
+					Config.UnitsPerTeam = UnitCount / 2;
+					Config.MovementPlanner = Planner;
+					Config.bParallelPlanning = Settings.bParallelPlanning;
+					Config.bCachePaths = bCachePaths;
+					Config.MaxPathExpansions = Variant.bExpansionBudget ? Settings.ExpansionBudget : 0;
+					Config.bSchedulePaths = Variant.bSchedulePaths;
+					Config.PathBudgetPerStep = Settings.PathBudgetPerStep;
+
+					FBattleSimulation Simulation(Config);
+					Simulation.Reset(Settings.Seed);
+
+					FGridPerfResult& Result = OutResults.AddDefaulted_GetRef();
+					Result.Suite = TEXT("Step");
+					Result.Scenario = GetPlannerName(Planner);
+					Result.Scenario += Variant.Suffix;
+					Result.GridSize = GridSize;
+					Result.Units = Config.UnitsPerTeam * 2;
+
+					TArray<double> TimesMs;
+					FStepDelta StepDelta;
+
+					const FAllocationScope Allocations;
+					while (Simulation.GetStepCount() < Settings.StepsPerRun && !Simulation.IsBattleOver())
+					{
+						const uint64 StartCycles = FPlatformTime::Cycles64();
+						Simulation.Step(StepDelta);
+						const uint64 EndCycles = FPlatformTime::Cycles64();
+
+						TimesMs.Add(CyclesToMs(EndCycles - StartCycles));
+						Result.Successes += StepDelta.Moves.Num() + StepDelta.Events.Num();
+					}
+					Result.Calls = TimesMs.Num();
+					Allocations.Finish(Result.Calls, Result);
+
+					Result.TimeMs = FGridPerfStats::FromSamples(TimesMs);
+					LogResult(Result);
+
+					if (bCachePaths)
+					{
+						const FPathCacheStats& CacheStats = Simulation.GetPathCacheStats();
+						UE_LOG(LogTemp, Display, TEXT("Path cache grid=%d units=%d: hits=%lld repairs=%lld replans=%lld"),
+						       GridSize, Result.Units, CacheStats.Hits, CacheStats.Repairs, CacheStats.Replans);
+					}
+					if (Variant.bSchedulePaths)
+					{
+						const FPathSchedulerStats& ScheduleStats = Simulation.GetPathSchedulerStats();
+						UE_LOG(LogTemp, Display, TEXT("Path scheduler grid=%d units=%d: requests=%lld coalesced=%lld searches=%lld latency mean %.2f max %d steps, peak queue %d"),
+						       GridSize, Result.Units, ScheduleStats.Requests, ScheduleStats.Coalesced, ScheduleStats.Searches,
+						       ScheduleStats.GetMeanLatencyFrames(), ScheduleStats.MaxLatencyFrames, ScheduleStats.PeakQueueDepth);
+					}
+				}
+			}
+		}
+	}
+}
+
+FString FGridPerfSuite::ToJson(const FGridPerfSuiteSettings& Settings, const TArray<FGridPerfResult>& Results)
+{
+	FString Json;
+	const TSharedRef<TJsonWriter<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>> Writer =
+		TJsonWriterFactory<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>::Create(&Json);
+
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("seed"), Settings.Seed);
+	Writer->WriteValue(TEXT("parallelPlanning"), Settings.bParallelPlanning);
+	Writer->WriteValue(TEXT("allocationsCounted"), FAllocationCounter::IsInstalled());
+	Writer->WriteValue(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+
+	Writer->WriteArrayStart(TEXT("results"));
+	for (const FGridPerfResult& Result : Results)
+	{
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("suite"), Result.Suite);
+		Writer->WriteValue(TEXT("scenario"), Result.Scenario);
+		Writer->WriteValue(TEXT("gridSize"), Result.GridSize);
+		Writer->WriteValue(TEXT("units"), Result.Units);
+		Writer->WriteValue(TEXT("calls"), Result.Calls);
+		WriteStats(*Writer, TEXT("timeMs"), Result.TimeMs);
+		if (Result.Suite == TEXT("FindPath"))
+		{
+			WriteStats(*Writer, TEXT("nodesExpanded"), Result.NodesExpanded);
+		}
+		Writer->WriteValue(TEXT("successes"), Result.Successes);
+		if (Result.Suite == TEXT("FindPath"))
+		{
+			Writer->WriteValue(TEXT("pathMismatches"), Result.PathMismatches);
+		}
+		Writer->WriteValue(TEXT("bytesPerCall"), Result.BytesPerCall);
+		Writer->WriteValue(TEXT("allocationsPerCall"), Result.AllocationsPerCall);
+		Writer->WriteObjectEnd();
+	}
+	Writer->WriteArrayEnd();
+
+	Writer->WriteObjectEnd();
+	Writer->Close();
+	return Json;
+}
+
+void FGridPerfSuite::LogResult(const FGridPerfResult& Result)
+{
+	FString NodesText = Result.Suite == TEXT("FindPath")
+		? FString::Printf(TEXT(" nodes(median=%.0f p99=%.0f)"), Result.NodesExpanded.Median, Result.NodesExpanded.P99)
+		: FString();
+	if (Result.PathMismatches > 0)
+	{
+		NodesText += FString::Printf(TEXT(" path mismatches=%d"), Result.PathMismatches);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("%s %s grid=%d units=%d calls=%d median=%.4fms p99=%.4fms%s bytes/call=%.1f allocs/call=%.2f"),
+	       *Result.Suite, *Result.Scenario, Result.GridSize, Result.Units, Result.Calls,
+	       Result.TimeMs.Median, Result.TimeMs.P99, *NodesText, Result.BytesPerCall, Result.AllocationsPerCall);
+}
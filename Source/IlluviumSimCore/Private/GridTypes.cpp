@@ -1,4 +1,4 @@
 ﻿// Fill out your copyright notice in the Description page of Project Settings.
 
 
-#include "IlluviumTT/Public/GridTypes.h"
+#include "IlluviumSimCore/Public/GridTypes.h"
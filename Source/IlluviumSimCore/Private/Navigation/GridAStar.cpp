@@ -0,0 +1,703 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridAStar.h"
+
+#include "GridBattleStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("FindPath"), STAT_GridBattle_FindPath, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("FindPath (Jump Point)"), STAT_GridBattle_FindPathJumpPoint, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("A* Searches"), STAT_GridBattle_PathSearches, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("A* Nodes Expanded"), STAT_GridBattle_NodesExpanded, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("A* Path Cells"), STAT_GridBattle_PathCells, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("A* Walled Off Requests"), STAT_GridBattle_WalledOffRequests, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("A* Out Of Budget"), STAT_GridBattle_SearchesOutOfBudget, STATGROUP_GridBattle);
+
+namespace
+{
+    const FGridCoordinate NeighbourOffsets[4] {
+        {+1,0},
+        {0,+1},
+        {-1,0},
+        {0,-1}
+    };
+    
+    // Rows a jump point search scans vertically before it stops and leaves the rest to a new jump point. Keeps every
+    // step of a horizontal run from reading whole columns on open maps
+    constexpr int32 MaxVerticalJumpRows = 16;
+
+    FORCEINLINE bool InBounds(const FGridCoordinate& C, const FIntPoint& S)
+    {
+        return C.X >= 0 && C.X < S.X && C.Y >= 0 && C.Y < S.Y;
+    }
+
+    /** The request's search box clamped to its grid. */
+    FORCEINLINE void GetSearchBounds(const FPathRequest& PathRequest, FGridCoordinate& OutMin, FGridCoordinate& OutMax)
+    {
+        OutMin = FGridCoordinate(FMath::Max(PathRequest.SearchMin.X, 0), FMath::Max(PathRequest.SearchMin.Y, 0));
+        OutMax = FGridCoordinate(FMath::Min(PathRequest.SearchMax.X, PathRequest.GridSize.X - 1),
+                                 FMath::Min(PathRequest.SearchMax.Y, PathRequest.GridSize.Y - 1));
+    }
+
+    /** Expansion and time budget of one FindPath or ResumePath call. */
+    struct FSearchBudget
+    {
+        explicit FSearchBudget(const FPathRequest& PathRequest)
+            : MaxExpansions(FMath::Max(PathRequest.MaxExpansions, 1))
+            , Deadline(PathRequest.MaxSearchSeconds > 0.0 ? FPlatformTime::Seconds() + PathRequest.MaxSearchSeconds : 0.0)
+        {
+        }
+
+        /**
+         * Counts a pop off the open list, checking the clock every 64. Pops rather than expansions, as searches that
+         * improved many open cells drain long runs of stale entries.
+         */
+        FORCEINLINE bool CountPopAndCheckTime()
+        {
+            return Deadline > 0.0 && (++NumPops & 63) == 0 && FPlatformTime::Seconds() >= Deadline;
+        }
+
+        int32 MaxExpansions;
+        double Deadline;
+        int32 NumPops = 0;
+    };
+
+    /** Replaces OutPath with the cells from the search's start to EndIndex, following parents cell by cell. */
+    void WriteParentPath(const FGridAStarContext& Context, int32 GridWidth, int32 EndIndex, TArray<FGridCoordinate>& OutPath)
+    {
+        int32 PathLength = 0;
+        for (int32 CellIndex = EndIndex; CellIndex != INDEX_NONE; CellIndex = Context.ParentIndex[CellIndex])
+        {
+            ++PathLength;
+        }
+
+        OutPath.SetNumUninitialized(PathLength);
+
+        int32 WriteIndex = PathLength - 1;
+        for (int32 CellIndex = EndIndex; CellIndex != INDEX_NONE; CellIndex = Context.ParentIndex[CellIndex])
+        {
+            OutPath[WriteIndex--] = FGridCoordinate(CellIndex % GridWidth, CellIndex / GridWidth);
+        }
+    }
+
+    /**
+     * Like WriteParentPath for jump points, filling in the runs between them: straight, or horizontal from the parent
+     * and then vertical where a run's vertical scan hit MaxVerticalJumpRows.
+     */
+    void WriteJumpPointPath(const FGridAStarContext& Context, int32 GridWidth, int32 EndIndex, TArray<FGridCoordinate>& OutPath)
+    {
+        const int32 PathLength = Context.CostFromStart[EndIndex] + 1;
+        OutPath.SetNumUninitialized(PathLength);
+
+        int32 WriteIndex = PathLength - 1;
+        OutPath[WriteIndex--] = FGridCoordinate(EndIndex % GridWidth, EndIndex / GridWidth);
+        for (int32 CellIndex = EndIndex; Context.ParentIndex[CellIndex] != INDEX_NONE; CellIndex = Context.ParentIndex[CellIndex])
+        {
+            const int32 ParentCellIndex = Context.ParentIndex[CellIndex];
+            const FGridCoordinate Parent(ParentCellIndex % GridWidth, ParentCellIndex / GridWidth);
+            FGridCoordinate Cell(CellIndex % GridWidth, CellIndex / GridWidth);
+            const int32 StepX = FMath::Sign(Parent.X - Cell.X);
+            const int32 StepY = FMath::Sign(Parent.Y - Cell.Y);
+            while (!(Cell == Parent))
+            {
+                Cell = Cell.Y != Parent.Y ? FGridCoordinate(Cell.X, Cell.Y + StepY) : FGridCoordinate(Cell.X + StepX, Cell.Y);
+                OutPath[WriteIndex--] = Cell;
+            }
+        }
+        checkSlow(WriteIndex == -1);
+    }
+}
+
+void FGridAStarContext::BeginSearch(const FIntPoint& GridSize)
+{
+    const int32 NumCells = GridSize.X * GridSize.Y;
+    if (VisitedGeneration.Num() < NumCells)
+    {
+        CostFromStart.SetNumUninitialized(NumCells);
+        ParentIndex.SetNumUninitialized(NumCells);
+        OpenInsertionOrder.SetNumUninitialized(NumCells);
+        VisitedGeneration.SetNumZeroed(NumCells);
+        ClosedGeneration.SetNumZeroed(NumCells);
+    }
+
+    ++Generation;
+    if (Generation == 0)
+    {
+        // Stamps wrapped around, old stamps could alias the new generation
+        FMemory::Memzero(VisitedGeneration.GetData(), VisitedGeneration.Num() * sizeof(uint32));
+        FMemory::Memzero(ClosedGeneration.GetData(), ClosedGeneration.Num() * sizeof(uint32));
+        Generation = 1;
+    }
+
+    OpenHeap.Reset();
+    LastNodesExpanded = 0;
+    LastExpandedMin = FGridCoordinate(MAX_int32, MAX_int32);
+    LastExpandedMax = FGridCoordinate(MIN_int32, MIN_int32);
+}
+
+bool FGridAStarContext::CanResume(const FPathRequest& Request) const
+{
+    FGridCoordinate SearchMin, SearchMax;
+    GetSearchBounds(Request, SearchMin, SearchMax);
+    return LastResult == EGridSearchResult::OutOfBudget &&
+           PendingStart == Request.Start && PendingGoal == Request.Goal && PendingGridSize == Request.GridSize &&
+           PendingSearchMin == SearchMin && PendingSearchMax == SearchMax && PendingSearchMode == Request.SearchMode;
+}
+
+void FGridAStarContext::BeginPending(const FPathRequest& Request, int32 StartIndex)
+{
+    PendingStart = Request.Start;
+    PendingGoal = Request.Goal;
+    PendingGridSize = Request.GridSize;
+    GetSearchBounds(Request, PendingSearchMin, PendingSearchMax);
+    PendingSearchMode = Request.SearchMode;
+    BestCellIndex = StartIndex;
+    BestRemainingCost = Manhattan(Request.Start, Request.Goal);
+}
+
+FGridAStarContext& FGridAStar::GetThreadContext()
+{
+    static thread_local FGridAStarContext ThreadContext;
+    return ThreadContext;
+}
+
+bool FGridAStar::FindPath(const FPathRequest& PathRequest, TArray<FGridCoordinate>& OutPath)
+{
+    return FindPath(PathRequest, OutPath, GetThreadContext());
+}
+
+bool FGridAStar::FindPath(const FPathRequest& PathRequest, TArray<FGridCoordinate>& OutPath, FGridAStarContext& Context)
+{
+    if (PathRequest.IsWalledOff())
+    {
+        INC_DWORD_STAT(STAT_GridBattle_WalledOffRequests);
+        OutPath.Reset();
+        Context.LastNodesExpanded = 0;
+        Context.LastExpandedMin = FGridCoordinate(MAX_int32, MAX_int32);
+        Context.LastExpandedMax = FGridCoordinate(MIN_int32, MIN_int32);
+        Context.LastResult = EGridSearchResult::NoPath;
+        return false;
+    }
+
+    if (PathRequest.SearchMode == EGridSearchMode::JumpPoint)
+    {
+        return FindJumpPointPath(PathRequest, OutPath, Context, false);
+    }
+    return FindAStarPath(PathRequest, OutPath, Context, false);
+}
+
+bool FGridAStar::ResumePath(const FPathRequest& PathRequest, TArray<FGridCoordinate>& OutPath, FGridAStarContext& Context)
+{
+    if (!Context.CanResume(PathRequest))
+    {
+        return FindPath(PathRequest, OutPath, Context);
+    }
+
+    if (PathRequest.SearchMode == EGridSearchMode::JumpPoint)
+    {
+        return FindJumpPointPath(PathRequest, OutPath, Context, true);
+    }
+    return FindAStarPath(PathRequest, OutPath, Context, true);
+}
+
+bool FGridAStar::FindAStarPath(const FPathRequest& PathRequest, TArray<FGridCoordinate>& OutPath,
+                               FGridAStarContext& Context, bool bResume)
+{
+    GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_FindPath);
+    INC_DWORD_STAT(STAT_GridBattle_PathSearches);
+
+	OutPath.Reset();
+    Context.LastResult = EGridSearchResult::NoPath;
+
+    FGridCoordinate SearchMin, SearchMax;
+    GetSearchBounds(PathRequest, SearchMin, SearchMax);
+
+    auto IsWithinSearchBounds = [&](const FGridCoordinate& Coordinate) -> bool
+    {
+        return Coordinate.X >= SearchMin.X && Coordinate.X <= SearchMax.X &&
+               Coordinate.Y >= SearchMin.Y && Coordinate.Y <= SearchMax.Y;
+    };
+
+    if (!IsWithinSearchBounds(PathRequest.Start) ||
+        !IsWithinSearchBounds(PathRequest.Goal))
+    {
+        return false;
+    }
+
+    if (PathRequest.Start == PathRequest.Goal)
+    {
+        OutPath.Add(PathRequest.Goal);
+        Context.LastResult = EGridSearchResult::Found;
+        return true;
+    }
+
+    const int32 GridWidth = PathRequest.GridSize.X;
+
+    auto EstimateRemainingCost = [&](const FGridCoordinate& From) -> int32
+    {
+        return Manhattan(From, PathRequest.Goal);
+    };
+
+    auto ToCellIndex = [GridWidth](const FGridCoordinate& Coordinate) -> int32
+    {
+        return Coordinate.Y * GridWidth + Coordinate.X;
+    };
+
+    auto IsBlocked = [&](const FGridCoordinate& Coordinate) -> bool
+    {
+        return !(Coordinate == PathRequest.Goal) && PathRequest.IsBlocked(Coordinate);
+    };
+
+    FSearchBudget Budget(PathRequest);
+    int32 InsertionCounter = 0;
+
+    if (bResume)
+    {
+        // The open list and per-cell state are as the last call left them, only the counters start over
+        Context.LastNodesExpanded = 0;
+        InsertionCounter = Context.NextInsertionOrder;
+    }
+    else
+    {
+        Context.BeginSearch(PathRequest.GridSize);
+
+        const FSearchNode StartNode{
+            PathRequest.Start,
+            0,
+            EstimateRemainingCost(PathRequest.Start),
+            { INT32_MIN, INT32_MIN },
+            InsertionCounter++
+        };
+
+        const int32 StartIndex = ToCellIndex(PathRequest.Start);
+        Context.VisitedGeneration[StartIndex] = Context.Generation;
+        Context.CostFromStart[StartIndex] = 0;
+        Context.ParentIndex[StartIndex] = INDEX_NONE;
+        Context.OpenInsertionOrder[StartIndex] = StartNode.InsertionOrderForTies;
+        Context.OpenHeap.HeapPush(StartNode);
+        Context.BeginPending(PathRequest, StartIndex);
+    }
+
+    bool bOutOfBudget = false;
+    FSearchNode CurrentNode;
+    while (!Context.OpenHeap.IsEmpty())
+    {
+        Context.OpenHeap.HeapPop(CurrentNode, EAllowShrinking::No);
+
+        const int32 CurrentIndex = ToCellIndex(CurrentNode.Coordinate);
+        const bool bOutOfTime = Budget.CountPopAndCheckTime();
+
+        // A cell is re-pushed whenever a better path to it is found, only its latest entry is live
+        if (Context.IsClosed(CurrentIndex) ||
+            Context.OpenInsertionOrder[CurrentIndex] != CurrentNode.InsertionOrderForTies)
+        {
+            if (bOutOfTime)
+            {
+                bOutOfBudget = true;
+                break;
+            }
+            continue;
+        }
+
+        if (bOutOfTime || Context.LastNodesExpanded >= Budget.MaxExpansions)
+        {
+            // Still the live entry for its cell, a resumed search pops it first
+            Context.OpenHeap.HeapPush(CurrentNode);
+            bOutOfBudget = true;
+            break;
+        }
+
+        ++Context.LastNodesExpanded;
+        Context.LastExpandedMin.X = FMath::Min(Context.LastExpandedMin.X, CurrentNode.Coordinate.X);
+        Context.LastExpandedMin.Y = FMath::Min(Context.LastExpandedMin.Y, CurrentNode.Coordinate.Y);
+        Context.LastExpandedMax.X = FMath::Max(Context.LastExpandedMax.X, CurrentNode.Coordinate.X);
+        Context.LastExpandedMax.Y = FMath::Max(Context.LastExpandedMax.Y, CurrentNode.Coordinate.Y);
+
+        if (CurrentNode.Coordinate == PathRequest.Goal)
+        {
+            WriteParentPath(Context, GridWidth, CurrentIndex, OutPath);
+            Context.LastResult = EGridSearchResult::Found;
+
+            INC_DWORD_STAT_BY(STAT_GridBattle_NodesExpanded, Context.LastNodesExpanded);
+            INC_DWORD_STAT_BY(STAT_GridBattle_PathCells, OutPath.Num());
+            return true;
+        }
+
+        const int32 RemainingCost = EstimateRemainingCost(CurrentNode.Coordinate);
+        if (RemainingCost < Context.BestRemainingCost)
+        {
+            Context.BestRemainingCost = RemainingCost;
+            Context.BestCellIndex = CurrentIndex;
+        }
+
+        Context.ClosedGeneration[CurrentIndex] = Context.Generation;
+
+        for (const FGridCoordinate& Offset : NeighbourOffsets)
+        {
+            const FGridCoordinate NeighborCoordinate{
+                CurrentNode.Coordinate.X + Offset.X,
+                CurrentNode.Coordinate.Y + Offset.Y
+            };
+
+            if (!IsWithinSearchBounds(NeighborCoordinate))
+                continue;
+
+            if (IsBlocked(NeighborCoordinate))
+                continue;
+
+            const int32 NeighborIndex = ToCellIndex(NeighborCoordinate);
+
+            if (Context.IsClosed(NeighborIndex))
+                continue;
+
+            const int32 TentativeCostFromStart  = CurrentNode.CostFromStart + 1;
+            const int32 TentativeEstimatedTotal = TentativeCostFromStart + EstimateRemainingCost(NeighborCoordinate);
+
+            const bool bHasExisting = Context.IsVisited(NeighborIndex);
+            const int32 ExistingCostFromStart = bHasExisting ? Context.CostFromStart[NeighborIndex] : 0;
+            const int32 ExistingEstimatedTotal = ExistingCostFromStart + EstimateRemainingCost(NeighborCoordinate);
+
+            const bool IsBetterPath =
+                (!bHasExisting) ||
+                (TentativeCostFromStart <  ExistingCostFromStart) ||
+                (TentativeCostFromStart == ExistingCostFromStart &&
+                 TentativeEstimatedTotal  <  ExistingEstimatedTotal);
+
+            if (IsBetterPath)
+            {
+                const FSearchNode UpdatedNeighborNode {
+                NeighborCoordinate,
+                TentativeCostFromStart,
+                TentativeEstimatedTotal,
+                CurrentNode.Coordinate,
+                InsertionCounter++
+                };
+
+                Context.VisitedGeneration[NeighborIndex] = Context.Generation;
+                Context.CostFromStart[NeighborIndex] = TentativeCostFromStart;
+                Context.ParentIndex[NeighborIndex] = CurrentIndex;
+                Context.OpenInsertionOrder[NeighborIndex] = UpdatedNeighborNode.InsertionOrderForTies;
+                Context.OpenHeap.HeapPush(UpdatedNeighborNode);
+            }
+        }
+    }
+
+    INC_DWORD_STAT_BY(STAT_GridBattle_NodesExpanded, Context.LastNodesExpanded);
+    if (!bOutOfBudget)
+        return false;
+
+    INC_DWORD_STAT(STAT_GridBattle_SearchesOutOfBudget);
+    Context.LastResult = EGridSearchResult::OutOfBudget;
+    Context.NextInsertionOrder = InsertionCounter;
+    if (!PathRequest.bAllowPartialPath)
+        return false;
+
+    WriteParentPath(Context, GridWidth, Context.BestCellIndex, OutPath);
+    INC_DWORD_STAT_BY(STAT_GridBattle_PathCells, OutPath.Num());
+    return true;
+}
+
+bool FGridAStar::FindJumpPointPath(const FPathRequest& PathRequest, TArray<FGridCoordinate>& OutPath,
+                                   FGridAStarContext& Context, bool bResume)
+{
+    GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_FindPathJumpPoint);
+    INC_DWORD_STAT(STAT_GridBattle_PathSearches);
+
+    OutPath.Reset();
+    Context.LastResult = EGridSearchResult::NoPath;
+
+    FGridCoordinate SearchMin, SearchMax;
+    GetSearchBounds(PathRequest, SearchMin, SearchMax);
+
+    const FGridCoordinate& Start = PathRequest.Start;
+    const FGridCoordinate& Goal = PathRequest.Goal;
+
+    auto IsOpen = [&](int32 X, int32 Y) -> bool
+    {
+        if (X < SearchMin.X || X > SearchMax.X || Y < SearchMin.Y || Y > SearchMax.Y)
+            return false;
+
+        const FGridCoordinate Coordinate(X, Y);
+        return Coordinate == Goal || !PathRequest.IsBlocked(Coordinate);
+    };
+
+    if (Start.X < SearchMin.X || Start.X > SearchMax.X || Start.Y < SearchMin.Y || Start.Y > SearchMax.Y ||
+        Goal.X < SearchMin.X || Goal.X > SearchMax.X || Goal.Y < SearchMin.Y || Goal.Y > SearchMax.Y)
+    {
+        return false;
+    }
+
+    if (Start == Goal)
+    {
+        OutPath.Add(Goal);
+        Context.LastResult = EGridSearchResult::Found;
+        return true;
+    }
+
+    const int32 GridWidth = PathRequest.GridSize.X;
+
+    auto ToCellIndex = [GridWidth](int32 X, int32 Y) -> int32
+    {
+        return Y * GridWidth + X;
+    };
+
+    if (bResume)
+    {
+        Context.LastNodesExpanded = 0;
+    }
+    else
+    {
+        Context.BeginSearch(PathRequest.GridSize);
+    }
+
+    // Every cell a jump tests lies on the line it scanned or right beside it
+    FGridCoordinate ScannedMin = Start;
+    FGridCoordinate ScannedMax = Start;
+    auto MarkScanned = [&](int32 X, int32 Y)
+    {
+        ScannedMin.X = FMath::Min(ScannedMin.X, X);
+        ScannedMin.Y = FMath::Min(ScannedMin.Y, Y);
+        ScannedMax.X = FMath::Max(ScannedMax.X, X);
+        ScannedMax.Y = FMath::Max(ScannedMax.Y, Y);
+    };
+
+    int32 InsertionCounter = bResume ? Context.NextInsertionOrder : 0;
+
+    auto AddJumpPoint = [&](const FSearchNode& FromNode, int32 FromIndex, int32 X, int32 Y)
+    {
+        const FGridCoordinate JumpPoint(X, Y);
+        const int32 JumpIndex = ToCellIndex(X, Y);
+        if (Context.IsClosed(JumpIndex))
+            return;
+
+        const int32 TentativeCostFromStart = FromNode.CostFromStart + Manhattan(FromNode.Coordinate, JumpPoint);
+        if (Context.IsVisited(JumpIndex) && Context.CostFromStart[JumpIndex] <= TentativeCostFromStart)
+            return;
+
+        const FSearchNode JumpNode{
+            JumpPoint,
+            TentativeCostFromStart,
+            TentativeCostFromStart + Manhattan(JumpPoint, Goal),
+            FromNode.Coordinate,
+            InsertionCounter++
+        };
+
+        Context.VisitedGeneration[JumpIndex] = Context.Generation;
+        Context.CostFromStart[JumpIndex] = TentativeCostFromStart;
+        Context.ParentIndex[JumpIndex] = FromIndex;
+        Context.OpenInsertionOrder[JumpIndex] = JumpNode.InsertionOrderForTies;
+        Context.OpenHeap.HeapPush(JumpNode);
+    };
+
+    enum class EJump : uint8
+    {
+        Blocked,
+        /** Reached the goal or a row where the run may turn. */
+        Found,
+        /** Scanned MaxVerticalJumpRows rows without either. The run carries on from the last of them. */
+        RowLimit
+    };
+
+    // Shortest paths are searched in their canonical form: horizontal moves first, and a vertical run only turns
+    // back to horizontal where an obstacle had kept it from doing so one row earlier. A vertical jump stops there.
+    auto JumpVertical = [&](int32 X, int32 Y, int32 DirectionY, int32& OutY) -> EJump
+    {
+        // Side cells of the row before, carried over so every row tests three cells
+        bool bPreviousLeftOpen = IsOpen(X - 1, Y);
+        bool bPreviousRightOpen = IsOpen(X + 1, Y);
+        for (int32 Row = 1; ; ++Row)
+        {
+            Y += DirectionY;
+            if (!IsOpen(X, Y))
+            {
+                MarkScanned(X, Y);
+                return EJump::Blocked;
+            }
+
+            const bool bLeftOpen = IsOpen(X - 1, Y);
+            const bool bRightOpen = IsOpen(X + 1, Y);
+            if ((X == Goal.X && Y == Goal.Y) ||
+                (bLeftOpen && !bPreviousLeftOpen) ||
+                (bRightOpen && !bPreviousRightOpen))
+            {
+                MarkScanned(X, Y);
+                OutY = Y;
+                return EJump::Found;
+            }
+
+            if (Row == MaxVerticalJumpRows)
+            {
+                MarkScanned(X, Y);
+                OutY = Y;
+                return EJump::RowLimit;
+            }
+
+            bPreviousLeftOpen = bLeftOpen;
+            bPreviousRightOpen = bRightOpen;
+        }
+    };
+
+    // A horizontal run may turn vertical anywhere, so it stops wherever a vertical jump finds something. Where a
+    // vertical scan only hits the row limit, the turn is added as a jump point at its last row and the run goes on
+    auto JumpHorizontal = [&](const FSearchNode& FromNode, int32 FromIndex, int32 X, int32 Y, int32 DirectionX, int32& OutX) -> bool
+    {
+        int32 UpY, DownY;
+        for (;;)
+        {
+            X += DirectionX;
+            if (!IsOpen(X, Y))
+            {
+                MarkScanned(X, Y);
+                return false;
+            }
+
+            const EJump Up = JumpVertical(X, Y, +1, UpY);
+            const EJump Down = JumpVertical(X, Y, -1, DownY);
+            if ((X == Goal.X && Y == Goal.Y) || Up == EJump::Found || Down == EJump::Found)
+            {
+                MarkScanned(X, Y);
+                OutX = X;
+                return true;
+            }
+
+            if (Up == EJump::RowLimit)
+                AddJumpPoint(FromNode, FromIndex, X, UpY);
+            if (Down == EJump::RowLimit)
+                AddJumpPoint(FromNode, FromIndex, X, DownY);
+        }
+    };
+
+    if (!bResume)
+    {
+        const FSearchNode StartNode{
+            Start,
+            0,
+            Manhattan(Start, Goal),
+            { INT32_MIN, INT32_MIN },
+            InsertionCounter++
+        };
+
+        const int32 StartIndex = ToCellIndex(Start.X, Start.Y);
+        Context.VisitedGeneration[StartIndex] = Context.Generation;
+        Context.CostFromStart[StartIndex] = 0;
+        Context.ParentIndex[StartIndex] = INDEX_NONE;
+        Context.OpenInsertionOrder[StartIndex] = StartNode.InsertionOrderForTies;
+        Context.OpenHeap.HeapPush(StartNode);
+        Context.BeginPending(PathRequest, StartIndex);
+    }
+
+    FSearchBudget Budget(PathRequest);
+    bool bFound = false;
+    bool bOutOfBudget = false;
+    FSearchNode CurrentNode;
+    while (!Context.OpenHeap.IsEmpty())
+    {
+        Context.OpenHeap.HeapPop(CurrentNode, EAllowShrinking::No);
+
+        const int32 X = CurrentNode.Coordinate.X;
+        const int32 Y = CurrentNode.Coordinate.Y;
+        const int32 CurrentIndex = ToCellIndex(X, Y);
+        const bool bOutOfTime = Budget.CountPopAndCheckTime();
+
+        if (Context.IsClosed(CurrentIndex) ||
+            Context.OpenInsertionOrder[CurrentIndex] != CurrentNode.InsertionOrderForTies)
+        {
+            if (bOutOfTime)
+            {
+                bOutOfBudget = true;
+                break;
+            }
+            continue;
+        }
+
+        if (bOutOfTime || Context.LastNodesExpanded >= Budget.MaxExpansions)
+        {
+            Context.OpenHeap.HeapPush(CurrentNode);
+            bOutOfBudget = true;
+            break;
+        }
+
+        ++Context.LastNodesExpanded;
+        Context.LastExpandedMin.X = FMath::Min(Context.LastExpandedMin.X, X);
+        Context.LastExpandedMin.Y = FMath::Min(Context.LastExpandedMin.Y, Y);
+        Context.LastExpandedMax.X = FMath::Max(Context.LastExpandedMax.X, X);
+        Context.LastExpandedMax.Y = FMath::Max(Context.LastExpandedMax.Y, Y);
+
+        if (CurrentNode.Coordinate == Goal)
+        {
+            bFound = true;
+            break;
+        }
+
+        const int32 RemainingCost = Manhattan(CurrentNode.Coordinate, Goal);
+        if (RemainingCost < Context.BestRemainingCost)
+        {
+            Context.BestRemainingCost = RemainingCost;
+            Context.BestCellIndex = CurrentIndex;
+        }
+
+        Context.ClosedGeneration[CurrentIndex] = Context.Generation;
+
+        // Jump points are reached along a straight run from their parent, or one that turned vertical at the row limit
+        const int32 ParentCellIndex = Context.ParentIndex[CurrentIndex];
+        const int32 DirectionX = ParentCellIndex == INDEX_NONE ? 0 : FMath::Sign(X - ParentCellIndex % GridWidth);
+        const int32 DirectionY = ParentCellIndex == INDEX_NONE ? 0 : FMath::Sign(Y - ParentCellIndex / GridWidth);
+
+        int32 JumpX, JumpY;
+        if (DirectionY == 0)
+        {
+            for (const int32 StepX : { +1, -1 })
+            {
+                if (StepX != -DirectionX && JumpHorizontal(CurrentNode, CurrentIndex, X, Y, StepX, JumpX))
+                    AddJumpPoint(CurrentNode, CurrentIndex, JumpX, Y);
+            }
+            for (const int32 StepY : { +1, -1 })
+            {
+                if (JumpVertical(X, Y, StepY, JumpY) != EJump::Blocked)
+                    AddJumpPoint(CurrentNode, CurrentIndex, X, JumpY);
+            }
+        }
+        else
+        {
+            if (JumpVertical(X, Y, DirectionY, JumpY) != EJump::Blocked)
+                AddJumpPoint(CurrentNode, CurrentIndex, X, JumpY);
+
+            for (const int32 StepX : { +1, -1 })
+            {
+                if (IsOpen(X + StepX, Y) && !IsOpen(X + StepX, Y - DirectionY) &&
+                    JumpHorizontal(CurrentNode, CurrentIndex, X, Y, StepX, JumpX))
+                    AddJumpPoint(CurrentNode, CurrentIndex, JumpX, Y);
+            }
+        }
+    }
+
+    Context.LastExpandedMin.X = FMath::Min(Context.LastExpandedMin.X, ScannedMin.X);
+    Context.LastExpandedMin.Y = FMath::Min(Context.LastExpandedMin.Y, ScannedMin.Y);
+    Context.LastExpandedMax.X = FMath::Max(Context.LastExpandedMax.X, ScannedMax.X);
+    Context.LastExpandedMax.Y = FMath::Max(Context.LastExpandedMax.Y, ScannedMax.Y);
+    INC_DWORD_STAT_BY(STAT_GridBattle_NodesExpanded, Context.LastNodesExpanded);
+
+    int32 EndIndex = ToCellIndex(Goal.X, Goal.Y);
+    if (bOutOfBudget)
+    {
+        INC_DWORD_STAT(STAT_GridBattle_SearchesOutOfBudget);
+        Context.LastResult = EGridSearchResult::OutOfBudget;
+        Context.NextInsertionOrder = InsertionCounter;
+        if (!PathRequest.bAllowPartialPath)
+            return false;
+
+        EndIndex = Context.BestCellIndex;
+    }
+    else if (bFound)
+    {
+        Context.LastResult = EGridSearchResult::Found;
+    }
+    else
+    {
+        return false;
+    }
+
+    WriteJumpPointPath(Context, GridWidth, EndIndex, OutPath);
+    INC_DWORD_STAT_BY(STAT_GridBattle_PathCells, OutPath.Num());
+    return true;
+}
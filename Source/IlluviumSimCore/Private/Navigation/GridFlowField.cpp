@@ -0,0 +1,98 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridFlowField.h"
+
+#include "IlluviumSimCore/Public/Navigation/GridAStar.h"
+
+namespace
+{
+	// Same order as FGridAStar so ties resolve the same way
+	const FGridCoordinate NeighbourOffsets[4] {
+		{+1,0},
+		{0,+1},
+		{-1,0},
+		{0,-1}
+	};
+}
+
+void FGridFlowField::Build(const FGridOccupancy& Occupancy, TArrayView<const FGridCoordinate> Sources,
+                           const FGridOccupancy* StaticObstacles)
+{
+	GridSize = Occupancy.GetGridSize();
+
+	const int32 NumCells = GridSize.X * GridSize.Y;
+	Distances.SetNumUninitialized(NumCells, EAllowShrinking::No);
+	for (int32& Distance : Distances)
+	{
+		Distance = Unreachable;
+	}
+
+	Frontier.Reset();
+	for (const FGridCoordinate& Source : Sources)
+	{
+		const int32 SourceIndex = Source.Y * GridSize.X + Source.X;
+		if (Distances[SourceIndex] == 0) continue;
+
+		Distances[SourceIndex] = 0;
+		Frontier.Add(SourceIndex);
+	}
+
+	for (int32 FrontierHead = 0; FrontierHead < Frontier.Num(); ++FrontierHead)
+	{
+		const int32 CellIndex = Frontier[FrontierHead];
+		const FGridCoordinate Cell(CellIndex % GridSize.X, CellIndex / GridSize.X);
+		const int32 NextDistance = Distances[CellIndex] + 1;
+
+		for (const FGridCoordinate& Offset : NeighbourOffsets)
+		{
+			const FGridCoordinate Neighbor(Cell.X + Offset.X, Cell.Y + Offset.Y);
+			if (!IsWithinGridBounds(Neighbor, GridSize)) continue;
+
+			const int32 NeighborIndex = Neighbor.Y * GridSize.X + Neighbor.X;
+			if (Distances[NeighborIndex] != Unreachable) continue;
+			if (Occupancy.IsSet(Neighbor)) continue;
+			if (StaticObstacles && StaticObstacles->IsSet(Neighbor)) continue;
+
+			Distances[NeighborIndex] = NextDistance;
+			Frontier.Add(NeighborIndex);
+		}
+	}
+}
+
+bool FGridFlowField::FindNextCell(const FGridCoordinate& Start, int32 MaxSteps, const FGridOccupancy& LiveOccupancy,
+                                  FGridCoordinate& OutCell) const
+{
+	FGridCoordinate Current = Start;
+	int32 StepsTaken = 0;
+
+	while (StepsTaken < MaxSteps)
+	{
+		// The start cell itself is occupied by the walker and has no distance, so compare neighbours only
+		int32 BestDistance = StepsTaken == 0 ? Unreachable : GetDistance(Current);
+		FGridCoordinate BestNeighbor = Current;
+
+		for (const FGridCoordinate& Offset : NeighbourOffsets)
+		{
+			const FGridCoordinate Neighbor(Current.X + Offset.X, Current.Y + Offset.Y);
+			if (!IsWithinGridBounds(Neighbor, GridSize)) continue;
+
+			const int32 NeighborDistance = GetDistance(Neighbor);
+			if (NeighborDistance < BestDistance)
+			{
+				BestDistance = NeighborDistance;
+				BestNeighbor = Neighbor;
+			}
+		}
+
+		if (BestNeighbor == Current) break;
+		if (BestDistance == 0) break; // next cell is a source, stay adjacent
+		if (LiveOccupancy.IsSet(BestNeighbor)) break;
+
+		Current = BestNeighbor;
+		++StepsTaken;
+	}
+
+	OutCell = Current;
+	return StepsTaken > 0;
+}
@@ -0,0 +1,630 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridHierarchy.h"
+
+#include "GridBattleStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("FindPath (Hierarchical)"), STAT_GridBattle_FindPathHierarchical, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("Rebuild Clusters"), STAT_GridBattle_RebuildClusters, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("HPA* Abstract Nodes Expanded"), STAT_GridBattle_AbstractNodesExpanded, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("HPA* Clusters Rebuilt"), STAT_GridBattle_ClustersRebuilt, STATGROUP_GridBattle);
+
+namespace
+{
+	constexpr int32 SlotsPerCluster = 4 * FGridHierarchy::MaxClusterSize;
+	static_assert(SlotsPerCluster <= 64, "Cluster slots must fit the 64 bit slot mask");
+
+	// Open border runs up to this long get a single entrance in the middle, longer ones one at each end
+	constexpr int32 MaxSingleEntranceRun = 5;
+
+	constexpr int32 Unreachable = MAX_int32;
+
+	// Monotone routes between entrances are often equally long, an estimate inflated by 1/16 stops the search from
+	// expanding all of them. Abstract paths stay within that factor of the shortest.
+	FORCEINLINE int32 EstimateRemainingCost(const FGridCoordinate& From, const FGridCoordinate& Goal)
+	{
+		const int32 Distance = Manhattan(From, Goal);
+		return Distance + Distance / 16;
+	}
+
+	FORCEINLINE void GrowBox(FGridCoordinate& Min, FGridCoordinate& Max, const FGridCoordinate& BoxMin,
+	                         const FGridCoordinate& BoxMax)
+	{
+		Min.X = FMath::Min(Min.X, BoxMin.X);
+		Min.Y = FMath::Min(Min.Y, BoxMin.Y);
+		Max.X = FMath::Max(Max.X, BoxMax.X);
+		Max.Y = FMath::Max(Max.Y, BoxMax.Y);
+	}
+}
+
+void FGridHierarchyContext::BeginSearch(int32 NumNodes)
+{
+	if (VisitedGeneration.Num() < NumNodes)
+	{
+		CostFromStart.SetNumUninitialized(NumNodes);
+		ParentNode.SetNumUninitialized(NumNodes);
+		OpenInsertionOrder.SetNumUninitialized(NumNodes);
+		VisitedGeneration.SetNumZeroed(NumNodes);
+		ClosedGeneration.SetNumZeroed(NumNodes);
+	}
+
+	++Generation;
+	if (Generation == 0)
+	{
+		// Stamps wrapped around, old stamps could alias the new generation
+		FMemory::Memzero(VisitedGeneration.GetData(), VisitedGeneration.Num() * sizeof(uint32));
+		FMemory::Memzero(ClosedGeneration.GetData(), ClosedGeneration.Num() * sizeof(uint32));
+		Generation = 1;
+	}
+
+	OpenHeap.Reset();
+}
+
+void FGridHierarchy::Init(const FIntPoint& InGridSize, int32 InClusterSize)
+{
+	Obstacles.Init(InGridSize);
+	ClusterSize = FMath::Clamp(InClusterSize, MinClusterSize, MaxClusterSize);
+	BuildAllClusters();
+}
+
+void FGridHierarchy::Build(const FGridOccupancy& InObstacles, int32 InClusterSize)
+{
+	Obstacles.CopyFrom(InObstacles);
+	ClusterSize = FMath::Clamp(InClusterSize, MinClusterSize, MaxClusterSize);
+	BuildAllClusters();
+}
+
+void FGridHierarchy::SetObstacle(const FGridCoordinate& Cell, bool bBlocked)
+{
+	if (Obstacles.IsSet(Cell) == bBlocked) return;
+
+	if (bBlocked)
+	{
+		Obstacles.Set(Cell);
+	}
+	else
+	{
+		Obstacles.Clear(Cell);
+	}
+
+	const int32 ClusterIndex = GetClusterIndex(Cell);
+	if (!Clusters[ClusterIndex].bDirty)
+	{
+		Clusters[ClusterIndex].bDirty = true;
+		DirtyClusters.Add(ClusterIndex);
+	}
+}
+
+int32 FGridHierarchy::RebuildDirtyClusters()
+{
+	if (DirtyClusters.IsEmpty()) return 0;
+
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_RebuildClusters);
+
+	// An edit moves entrances on all four borders, which changes the entrance sets of the neighbours too
+	const int32 NumEdited = DirtyClusters.Num();
+	for (int32 DirtyIndex = 0; DirtyIndex < NumEdited; ++DirtyIndex)
+	{
+		const int32 ClusterIndex = DirtyClusters[DirtyIndex];
+		for (int32 Side = 0; Side < NumSides; ++Side)
+		{
+			BuildBorder(ClusterIndex, static_cast<EClusterSide>(Side));
+
+			const int32 NeighbourIndex = GetNeighbourCluster(ClusterIndex, static_cast<EClusterSide>(Side));
+			if (NeighbourIndex != INDEX_NONE && !Clusters[NeighbourIndex].bDirty)
+			{
+				Clusters[NeighbourIndex].bDirty = true;
+				DirtyClusters.Add(NeighbourIndex);
+			}
+		}
+	}
+
+	FGridHierarchyContext& Scratch = GetThreadContext();
+	for (const int32 ClusterIndex : DirtyClusters)
+	{
+		BuildClusterDistances(ClusterIndex, Scratch);
+		Clusters[ClusterIndex].bDirty = false;
+	}
+
+	NumberNodes();
+
+	const int32 NumRebuilt = DirtyClusters.Num();
+	INC_DWORD_STAT_BY(STAT_GridBattle_ClustersRebuilt, NumRebuilt);
+	DirtyClusters.Reset();
+	return NumRebuilt;
+}
+
+FGridCoordinate FGridHierarchy::GetSlotCell(const FCluster& Cluster, int32 Slot) const
+{
+	const int32 Offset = Slot % MaxClusterSize;
+	switch (static_cast<EClusterSide>(Slot / MaxClusterSize))
+	{
+	case SideMinX: return FGridCoordinate(Cluster.Min.X, Cluster.Min.Y + Offset);
+	case SideMaxX: return FGridCoordinate(Cluster.Max.X, Cluster.Min.Y + Offset);
+	case SideMinY: return FGridCoordinate(Cluster.Min.X + Offset, Cluster.Min.Y);
+	default:       return FGridCoordinate(Cluster.Min.X + Offset, Cluster.Max.Y);
+	}
+}
+
+int32 FGridHierarchy::GetNeighbourCluster(int32 ClusterIndex, EClusterSide Side) const
+{
+	const int32 ClusterX = ClusterIndex % NumClusters.X;
+	const int32 ClusterY = ClusterIndex / NumClusters.X;
+	switch (Side)
+	{
+	case SideMinX: return ClusterX > 0 ? ClusterIndex - 1 : INDEX_NONE;
+	case SideMaxX: return ClusterX + 1 < NumClusters.X ? ClusterIndex + 1 : INDEX_NONE;
+	case SideMinY: return ClusterY > 0 ? ClusterIndex - NumClusters.X : INDEX_NONE;
+	default:       return ClusterY + 1 < NumClusters.Y ? ClusterIndex + NumClusters.X : INDEX_NONE;
+	}
+}
+
+void FGridHierarchy::BuildAllClusters()
+{
+	const FIntPoint& GridSize = Obstacles.GetGridSize();
+	NumClusters = FIntPoint(FMath::DivideAndRoundUp(GridSize.X, ClusterSize), FMath::DivideAndRoundUp(GridSize.Y, ClusterSize));
+
+	Clusters.Reset();
+	Clusters.SetNum(NumClusters.X * NumClusters.Y);
+	DirtyClusters.Reset();
+
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ++ClusterIndex)
+	{
+		FCluster& Cluster = Clusters[ClusterIndex];
+		Cluster.Min = FGridCoordinate((ClusterIndex % NumClusters.X) * ClusterSize, (ClusterIndex / NumClusters.X) * ClusterSize);
+		Cluster.Max = FGridCoordinate(FMath::Min(Cluster.Min.X + ClusterSize, GridSize.X) - 1,
+		                              FMath::Min(Cluster.Min.Y + ClusterSize, GridSize.Y) - 1);
+	}
+
+	// Every border is shared, building the positive sides covers each one once
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ++ClusterIndex)
+	{
+		BuildBorder(ClusterIndex, SideMaxX);
+		BuildBorder(ClusterIndex, SideMaxY);
+	}
+
+	FGridHierarchyContext Scratch;
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ++ClusterIndex)
+	{
+		BuildClusterDistances(ClusterIndex, Scratch);
+	}
+
+	NumberNodes();
+}
+
+void FGridHierarchy::NumberNodes()
+{
+	int32 NumNodes = 0;
+	for (FCluster& Cluster : Clusters)
+	{
+		Cluster.FirstNode = NumNodes;
+		NumNodes += Cluster.Slots.Num();
+	}
+
+	NodeClusters.SetNumUninitialized(NumNodes, EAllowShrinking::No);
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ++ClusterIndex)
+	{
+		const FCluster& Cluster = Clusters[ClusterIndex];
+		for (int32 SlotIndex = 0; SlotIndex < Cluster.Slots.Num(); ++SlotIndex)
+		{
+			NodeClusters[Cluster.FirstNode + SlotIndex] = ClusterIndex;
+		}
+	}
+}
+
+void FGridHierarchy::BuildBorder(int32 ClusterIndex, EClusterSide Side)
+{
+	const int32 NeighbourIndex = GetNeighbourCluster(ClusterIndex, Side);
+	if (NeighbourIndex == INDEX_NONE) return;
+
+	FCluster& Cluster = Clusters[ClusterIndex];
+	FCluster& Neighbour = Clusters[NeighbourIndex];
+
+	// Opposite sides differ in their lowest bit
+	const int32 NeighbourSide = Side ^ 1;
+	const uint64 SideMask = (1ull << MaxClusterSize) - 1;
+	Cluster.SlotMask &= ~(SideMask << (Side * MaxClusterSize));
+	Neighbour.SlotMask &= ~(SideMask << (NeighbourSide * MaxClusterSize));
+
+	const bool bAlongY = Side == SideMinX || Side == SideMaxX;
+	const int32 BorderLength = bAlongY ? Cluster.Max.Y - Cluster.Min.Y + 1 : Cluster.Max.X - Cluster.Min.X + 1;
+
+	auto AddEntrance = [&](int32 Offset)
+	{
+		Cluster.SlotMask |= 1ull << (Side * MaxClusterSize + Offset);
+		Neighbour.SlotMask |= 1ull << (NeighbourSide * MaxClusterSize + Offset);
+	};
+
+	int32 RunStart = INDEX_NONE;
+	for (int32 Offset = 0; Offset <= BorderLength; ++Offset)
+	{
+		const bool bOpen = Offset < BorderLength &&
+			!Obstacles.IsSet(GetSlotCell(Cluster, Side * MaxClusterSize + Offset)) &&
+			!Obstacles.IsSet(GetSlotCell(Neighbour, NeighbourSide * MaxClusterSize + Offset));
+
+		if (bOpen && RunStart == INDEX_NONE)
+		{
+			RunStart = Offset;
+		}
+		else if (!bOpen && RunStart != INDEX_NONE)
+		{
+			const int32 RunEnd = Offset - 1;
+			if (RunEnd - RunStart + 1 <= MaxSingleEntranceRun)
+			{
+				AddEntrance((RunStart + RunEnd) / 2);
+			}
+			else
+			{
+				AddEntrance(RunStart);
+				AddEntrance(RunEnd);
+			}
+			RunStart = INDEX_NONE;
+		}
+	}
+}
+
+void FGridHierarchy::BuildClusterDistances(int32 ClusterIndex, FGridHierarchyContext& Scratch)
+{
+	FCluster& Cluster = Clusters[ClusterIndex];
+
+	Cluster.Slots.Reset();
+	for (uint64 Remaining = Cluster.SlotMask; Remaining != 0; Remaining &= Remaining - 1)
+	{
+		Cluster.Slots.Add(FMath::CountTrailingZeros64(Remaining));
+	}
+
+	const int32 NumSlots = Cluster.Slots.Num();
+	const int32 ClusterWidth = Cluster.Max.X - Cluster.Min.X + 1;
+	Cluster.Distances.SetNumUninitialized(NumSlots * NumSlots);
+
+	LoadClusterObstacles(Cluster, Scratch);
+
+	for (int32 From = 0; From < NumSlots; ++From)
+	{
+		SearchCluster(Cluster, GetSlotCell(Cluster, Cluster.Slots[From]), Scratch);
+		for (int32 To = 0; To < NumSlots; ++To)
+		{
+			const FGridCoordinate ToCell = GetSlotCell(Cluster, Cluster.Slots[To]);
+			Cluster.Distances[From * NumSlots + To] =
+				Scratch.ClusterDistances[(ToCell.Y - Cluster.Min.Y) * ClusterWidth + ToCell.X - Cluster.Min.X];
+		}
+	}
+}
+
+void FGridHierarchy::LoadClusterObstacles(const FCluster& Cluster, FGridHierarchyContext& Scratch) const
+{
+	const int32 ClusterWidth = Cluster.Max.X - Cluster.Min.X + 1;
+	const int32 ClusterHeight = Cluster.Max.Y - Cluster.Min.Y + 1;
+
+	Scratch.ClusterBlocked.SetNumUninitialized(ClusterWidth * ClusterHeight, EAllowShrinking::No);
+	for (int32 LocalY = 0; LocalY < ClusterHeight; ++LocalY)
+	{
+		for (int32 LocalX = 0; LocalX < ClusterWidth; ++LocalX)
+		{
+			Scratch.ClusterBlocked[LocalY * ClusterWidth + LocalX] =
+				Obstacles.IsSet(FGridCoordinate(Cluster.Min.X + LocalX, Cluster.Min.Y + LocalY));
+		}
+	}
+}
+
+void FGridHierarchy::SearchCluster(const FCluster& Cluster, const FGridCoordinate& Source, FGridHierarchyContext& Scratch) const
+{
+	const int32 ClusterWidth = Cluster.Max.X - Cluster.Min.X + 1;
+	const int32 ClusterHeight = Cluster.Max.Y - Cluster.Min.Y + 1;
+
+	Scratch.ClusterDistances.SetNumUninitialized(ClusterWidth * ClusterHeight, EAllowShrinking::No);
+	for (int32 CellIndex = 0; CellIndex < Scratch.ClusterDistances.Num(); ++CellIndex)
+	{
+		Scratch.ClusterDistances[CellIndex] = Scratch.ClusterBlocked[CellIndex] ? -1 : Unreachable;
+	}
+
+	const int32 SourceIndex = (Source.Y - Cluster.Min.Y) * ClusterWidth + Source.X - Cluster.Min.X;
+	Scratch.ClusterDistances[SourceIndex] = 0;
+	Scratch.ClusterFrontier.Reset();
+	Scratch.ClusterFrontier.Add(SourceIndex);
+
+	for (int32 FrontierIndex = 0; FrontierIndex < Scratch.ClusterFrontier.Num(); ++FrontierIndex)
+	{
+		const int32 CellIndex = Scratch.ClusterFrontier[FrontierIndex];
+		const int32 LocalX = CellIndex % ClusterWidth;
+		const int32 LocalY = CellIndex / ClusterWidth;
+		const int32 NextDistance = Scratch.ClusterDistances[CellIndex] + 1;
+
+		auto Visit = [&](int32 NeighbourX, int32 NeighbourY)
+		{
+			// Blocked cells hold -1, so this skips them as well as cells already reached
+			const int32 NeighbourIndex = NeighbourY * ClusterWidth + NeighbourX;
+			if (Scratch.ClusterDistances[NeighbourIndex] != Unreachable) return;
+
+			Scratch.ClusterDistances[NeighbourIndex] = NextDistance;
+			Scratch.ClusterFrontier.Add(NeighbourIndex);
+		};
+
+		if (LocalX + 1 < ClusterWidth) Visit(LocalX + 1, LocalY);
+		if (LocalY + 1 < ClusterHeight) Visit(LocalX, LocalY + 1);
+		if (LocalX > 0) Visit(LocalX - 1, LocalY);
+		if (LocalY > 0) Visit(LocalX, LocalY - 1);
+	}
+}
+
+FGridHierarchyContext& FGridHierarchy::GetThreadContext()
+{
+	static thread_local FGridHierarchyContext ThreadContext;
+	return ThreadContext;
+}
+
+bool FGridHierarchy::FindPath(const FPathRequest& Request, TArray<FGridCoordinate>& OutPath) const
+{
+	return FindPath(Request, OutPath, GetThreadContext());
+}
+
+bool FGridHierarchy::FindPath(const FPathRequest& Request, TArray<FGridCoordinate>& OutPath, FGridHierarchyContext& Context) const
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_FindPathHierarchical);
+
+	OutPath.Reset();
+	Context.LastNodesExpanded = 0;
+	Context.LastReadMin = FGridCoordinate(MAX_int32, MAX_int32);
+	Context.LastReadMax = FGridCoordinate(MIN_int32, MIN_int32);
+
+	checkSlow(!HasDirtyClusters());
+	if (!IsBuilt() || Request.GridSize != GetGridSize() ||
+		!IsWithinGridBounds(Request.Start, Request.GridSize) ||
+		!IsWithinGridBounds(Request.Goal, Request.GridSize))
+	{
+		return false;
+	}
+
+	if (Request.Start == Request.Goal)
+	{
+		OutPath.Add(Request.Goal);
+		return true;
+	}
+
+	if (Obstacles.IsSet(Request.Goal) || Request.IsWalledOff()) return false;
+
+	// Nearby goals are cheaper to reach with one bounded search than through the entrances
+	if (Manhattan(Request.Start, Request.Goal) <= ClusterSize)
+	{
+		const FGridCoordinate SearchMin(FMath::Min(Request.Start.X, Request.Goal.X) - ClusterSize,
+		                                FMath::Min(Request.Start.Y, Request.Goal.Y) - ClusterSize);
+		const FGridCoordinate SearchMax(FMath::Max(Request.Start.X, Request.Goal.X) + ClusterSize,
+		                                FMath::Max(Request.Start.Y, Request.Goal.Y) + ClusterSize);
+
+		OutPath.Add(Request.Start);
+		if (RefineSegment(Request, Request.Start, Request.Goal, SearchMin, SearchMax, OutPath, Context))
+		{
+			return true;
+		}
+		OutPath.Reset();
+	}
+
+	if (!FindWaypoints(Request, Context)) return false;
+
+	// Refine lazily: only as far as the caller is going to walk before asking again
+	OutPath.Add(Request.Start);
+	for (const FGridCoordinate& Waypoint : Context.Waypoints)
+	{
+		if (OutPath.Num() > Request.MaxRefinedCells) break;
+
+		const FGridCoordinate From = OutPath.Last();
+		const FCluster& FromCluster = Clusters[GetClusterIndex(From)];
+		const FCluster& ToCluster = Clusters[GetClusterIndex(Waypoint)];
+		FGridCoordinate SearchMin = FromCluster.Min;
+		FGridCoordinate SearchMax = FromCluster.Max;
+		GrowBox(SearchMin, SearchMax, ToCluster.Min, ToCluster.Max);
+
+		// An entrance held by a unit can only be walked up to, the final goal is always entered
+		const bool bIsGoal = Waypoint == Request.Goal;
+		const bool bWaypointBlocked = !bIsGoal && Request.IsBlocked(Waypoint);
+		GrowBox(Context.LastReadMin, Context.LastReadMax, Waypoint, Waypoint);
+
+		bool bRefined = RefineSegment(Request, From, Waypoint, SearchMin, SearchMax, OutPath, Context);
+		if (!bRefined)
+		{
+			// Units walled off the clusters, give the detour one more cluster of room on every side
+			SearchMin = FGridCoordinate(SearchMin.X - ClusterSize, SearchMin.Y - ClusterSize);
+			SearchMax = FGridCoordinate(SearchMax.X + ClusterSize, SearchMax.Y + ClusterSize);
+			bRefined = RefineSegment(Request, From, Waypoint, SearchMin, SearchMax, OutPath, Context);
+		}
+
+		if (!bRefined) break;
+		if (bWaypointBlocked)
+		{
+			OutPath.Pop(EAllowShrinking::No);
+			break;
+		}
+	}
+
+	if (OutPath.Num() < 2)
+	{
+		OutPath.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool FGridHierarchy::FindWaypoints(const FPathRequest& Request, FGridHierarchyContext& Context) const
+{
+	const int32 StartClusterIndex = GetClusterIndex(Request.Start);
+	const int32 GoalClusterIndex = GetClusterIndex(Request.Goal);
+	const FCluster& StartCluster = Clusters[StartClusterIndex];
+	const FCluster& GoalCluster = Clusters[GoalClusterIndex];
+
+	auto ToLocalIndex = [](const FCluster& Cluster, const FGridCoordinate& Cell)
+	{
+		return (Cell.Y - Cluster.Min.Y) * (Cluster.Max.X - Cluster.Min.X + 1) + Cell.X - Cluster.Min.X;
+	};
+
+	// Start and Goal join the graph through static paths inside their own clusters
+	LoadClusterObstacles(StartCluster, Context);
+	SearchCluster(StartCluster, Request.Start, Context);
+	Context.StartDistances.Reset();
+	for (const int32 Slot : StartCluster.Slots)
+	{
+		Context.StartDistances.Add(Context.ClusterDistances[ToLocalIndex(StartCluster, GetSlotCell(StartCluster, Slot))]);
+	}
+	const int32 DirectDistance = StartClusterIndex == GoalClusterIndex
+		? Context.ClusterDistances[ToLocalIndex(StartCluster, Request.Goal)]
+		: Unreachable;
+
+	LoadClusterObstacles(GoalCluster, Context);
+	SearchCluster(GoalCluster, Request.Goal, Context);
+	Context.GoalDistances.Reset();
+	for (const int32 Slot : GoalCluster.Slots)
+	{
+		Context.GoalDistances.Add(Context.ClusterDistances[ToLocalIndex(GoalCluster, GetSlotCell(GoalCluster, Slot))]);
+	}
+
+	const int32 NumNodes = NodeClusters.Num();
+	const int32 StartNode = NumNodes;
+	const int32 GoalNode = NumNodes + 1;
+	Context.BeginSearch(NumNodes + 2);
+
+	int32 InsertionCounter = 0;
+	auto Relax = [&](int32 NodeIndex, const FGridCoordinate& Cell, int32 CostFromStart, int32 ParentIndex)
+	{
+		if (Context.IsClosed(NodeIndex)) return;
+		if (Context.IsVisited(NodeIndex) && Context.CostFromStart[NodeIndex] <= CostFromStart) return;
+
+		const FGridHierarchyContext::FOpenNode OpenNode{
+			NodeIndex,
+			CostFromStart,
+			CostFromStart + EstimateRemainingCost(Cell, Request.Goal),
+			InsertionCounter++
+		};
+
+		Context.VisitedGeneration[NodeIndex] = Context.Generation;
+		Context.CostFromStart[NodeIndex] = CostFromStart;
+		Context.ParentNode[NodeIndex] = ParentIndex;
+		Context.OpenInsertionOrder[NodeIndex] = OpenNode.InsertionOrderForTies;
+		Context.OpenHeap.HeapPush(OpenNode);
+	};
+
+	Relax(StartNode, Request.Start, 0, INDEX_NONE);
+
+	bool bFound = false;
+	FGridHierarchyContext::FOpenNode CurrentNode;
+	while (!Context.OpenHeap.IsEmpty())
+	{
+		Context.OpenHeap.HeapPop(CurrentNode, EAllowShrinking::No);
+
+		const int32 NodeIndex = CurrentNode.NodeIndex;
+		if (Context.IsClosed(NodeIndex) || Context.OpenInsertionOrder[NodeIndex] != CurrentNode.InsertionOrderForTies)
+		{
+			continue;
+		}
+
+		++Context.LastNodesExpanded;
+		if (NodeIndex == GoalNode)
+		{
+			bFound = true;
+			break;
+		}
+
+		Context.ClosedGeneration[NodeIndex] = Context.Generation;
+
+		if (NodeIndex == StartNode)
+		{
+			for (int32 SlotIndex = 0; SlotIndex < StartCluster.Slots.Num(); ++SlotIndex)
+			{
+				const int32 Distance = Context.StartDistances[SlotIndex];
+				if (Distance == Unreachable) continue;
+
+				Relax(StartCluster.FirstNode + SlotIndex, GetSlotCell(StartCluster, StartCluster.Slots[SlotIndex]), Distance, NodeIndex);
+			}
+			if (DirectDistance != Unreachable)
+			{
+				Relax(GoalNode, Request.Goal, DirectDistance, NodeIndex);
+			}
+			continue;
+		}
+
+		const int32 ClusterIndex = NodeClusters[NodeIndex];
+		const FCluster& Cluster = Clusters[ClusterIndex];
+		const int32 NumSlots = Cluster.Slots.Num();
+		const int32 SlotIndex = NodeIndex - Cluster.FirstNode;
+		const int32 Slot = Cluster.Slots[SlotIndex];
+
+		// Across the border, the entrance on the other side sits in the mirrored slot
+		const EClusterSide Side = static_cast<EClusterSide>(Slot / MaxClusterSize);
+		const FCluster& Neighbour = Clusters[GetNeighbourCluster(ClusterIndex, Side)];
+		const int32 NeighbourSlot = (Side ^ 1) * MaxClusterSize + Slot % MaxClusterSize;
+		Relax(Neighbour.FirstNode + FMath::CountBits(Neighbour.SlotMask & ((1ull << NeighbourSlot) - 1)),
+		      GetSlotCell(Neighbour, NeighbourSlot), CurrentNode.CostFromStart + 1, NodeIndex);
+
+		for (int32 OtherIndex = 0; OtherIndex < NumSlots; ++OtherIndex)
+		{
+			const int32 Distance = Cluster.Distances[SlotIndex * NumSlots + OtherIndex];
+			if (OtherIndex == SlotIndex || Distance == Unreachable) continue;
+
+			Relax(Cluster.FirstNode + OtherIndex, GetSlotCell(Cluster, Cluster.Slots[OtherIndex]),
+			      CurrentNode.CostFromStart + Distance, NodeIndex);
+		}
+
+		if (ClusterIndex == GoalClusterIndex && Context.GoalDistances[SlotIndex] != Unreachable)
+		{
+			Relax(GoalNode, Request.Goal, CurrentNode.CostFromStart + Context.GoalDistances[SlotIndex], NodeIndex);
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_GridBattle_AbstractNodesExpanded, Context.LastNodesExpanded);
+	if (!bFound) return false;
+
+	Context.AbstractPath.Reset();
+	for (int32 NodeIndex = Context.ParentNode[GoalNode]; NodeIndex != StartNode; NodeIndex = Context.ParentNode[NodeIndex])
+	{
+		Context.AbstractPath.Add(NodeIndex);
+	}
+
+	// Walking from border crossing to border crossing lets each refinement cut the corners inside a cluster
+	Context.Waypoints.Reset();
+	for (int32 PathIndex = Context.AbstractPath.Num() - 1; PathIndex > 0; --PathIndex)
+	{
+		const int32 ExitCluster = NodeClusters[Context.AbstractPath[PathIndex]];
+		const int32 EntryNode = Context.AbstractPath[PathIndex - 1];
+		const int32 EntryCluster = NodeClusters[EntryNode];
+		if (ExitCluster != EntryCluster)
+		{
+			const FCluster& Cluster = Clusters[EntryCluster];
+			Context.Waypoints.Add(GetSlotCell(Cluster, Cluster.Slots[EntryNode - Cluster.FirstNode]));
+		}
+	}
+	Context.Waypoints.Add(Request.Goal);
+	return true;
+}
+
+bool FGridHierarchy::RefineSegment(const FPathRequest& Request, const FGridCoordinate& From, const FGridCoordinate& To,
+                                   const FGridCoordinate& SearchMin, const FGridCoordinate& SearchMax,
+                                   TArray<FGridCoordinate>& OutPath, FGridHierarchyContext& Context) const
+{
+	FPathRequest LocalRequest = Request;
+	LocalRequest.Start = From;
+	LocalRequest.Goal = To;
+	LocalRequest.StaticObstacles = &Obstacles;
+	LocalRequest.SearchMin = SearchMin;
+	LocalRequest.SearchMax = SearchMax;
+	// Refinement stays inside a few clusters, the budget is meant for flat searches over the whole grid
+	LocalRequest.MaxExpansions = MAX_int32;
+	LocalRequest.MaxSearchSeconds = 0.0;
+	LocalRequest.bAllowPartialPath = false;
+
+	const bool bFound = FGridAStar::FindPath(LocalRequest, Context.Segment, Context.LocalContext);
+
+	const FGridAStarContext& LocalContext = Context.LocalContext;
+	Context.LastNodesExpanded += LocalContext.LastNodesExpanded;
+	if (LocalContext.LastNodesExpanded > 0)
+	{
+		GrowBox(Context.LastReadMin, Context.LastReadMax,
+		        FGridCoordinate(LocalContext.LastExpandedMin.X - 1, LocalContext.LastExpandedMin.Y - 1),
+		        FGridCoordinate(LocalContext.LastExpandedMax.X + 1, LocalContext.LastExpandedMax.Y + 1));
+	}
+
+	if (!bFound) return false;
+
+	// The segment starts on the last cell already in the path
+	checkSlow(OutPath.Num() > 0 && OutPath.Last() == Context.Segment[0]);
+	OutPath.Append(Context.Segment.GetData() + 1, Context.Segment.Num() - 1);
+	return true;
+}
@@ -0,0 +1,37 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridOccupancy.h"
+
+void FGridOccupancy::Init(const FIntPoint& InGridSize)
+{
+	GridSize = InGridSize;
+	Words.SetNumUninitialized(FMath::DivideAndRoundUp(GridSize.X * GridSize.Y, 64));
+	ClearAll();
+}
+
+void FGridOccupancy::CopyFrom(const FGridOccupancy& Other)
+{
+	GridSize = Other.GridSize;
+	Words.SetNumUninitialized(Other.Words.Num(), EAllowShrinking::No);
+	FMemory::Memcpy(Words.GetData(), Other.Words.GetData(), Words.Num() * sizeof(uint64));
+}
+
+void FGridOccupancy::InitFromWords(const FIntPoint& InGridSize, TArrayView<const uint64> InWords)
+{
+	Init(InGridSize);
+	const int32 NumWords = FMath::Min(Words.Num(), InWords.Num());
+	FMemory::Memcpy(Words.GetData(), InWords.GetData(), NumWords * sizeof(uint64));
+
+	// Bits past the last cell stay clear
+	const int32 NumCells = GridSize.X * GridSize.Y;
+	if (NumWords == Words.Num() && (NumCells & 63) != 0)
+	{
+		Words.Last() &= (1ull << (NumCells & 63)) - 1;
+	}
+}
+
+void FGridOccupancy::ClearAll()
+{
+	FMemory::Memzero(Words.GetData(), Words.Num() * sizeof(uint64));
+}
@@ -0,0 +1,283 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridPathCache.h"
+
+#include "GridBattleStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("FindPath (Cached)"), STAT_GridBattle_FindCachedPath, STATGROUP_GridBattle);
+
+namespace
+{
+	FORCEINLINE void ExtendBox(FGridCoordinate& Min, FGridCoordinate& Max, const FGridCoordinate& Cell)
+	{
+		Min.X = FMath::Min(Min.X, Cell.X);
+		Min.Y = FMath::Min(Min.Y, Cell.Y);
+		Max.X = FMath::Max(Max.X, Cell.X);
+		Max.Y = FMath::Max(Max.Y, Cell.Y);
+	}
+
+	/** Adds the cells the last search on Context expanded or scanned. */
+	void ExtendBoxBySearch(FGridCoordinate& Min, FGridCoordinate& Max, const FGridAStarContext& Context)
+	{
+		if (Context.LastExpandedMin.X > Context.LastExpandedMax.X) return;
+		ExtendBox(Min, Max, Context.LastExpandedMin);
+		ExtendBox(Min, Max, Context.LastExpandedMax);
+	}
+
+	FORCEINLINE bool IsInsideBox(const FGridCoordinate& Cell, const FGridCoordinate& Min, const FGridCoordinate& Max)
+	{
+		return Cell.X >= Min.X && Cell.X <= Max.X && Cell.Y >= Min.Y && Cell.Y <= Max.Y;
+	}
+
+	/**
+	 * Searches From to To inside the box between them. Any path that leaves the box is longer than their Manhattan
+	 * distance, so this finds one of Manhattan length if there is any.
+	 * @return true if OutSegment holds a path of Manhattan length.
+	 */
+	bool FindManhattanSegment(const FPathRequest& Request, const FGridCoordinate& From, const FGridCoordinate& To,
+	                          TArray<FGridCoordinate>& OutSegment, FGridAStarContext& Context,
+	                          FGridCoordinate& InOutReadMin, FGridCoordinate& InOutReadMax)
+	{
+		FPathRequest SegmentRequest = Request;
+		SegmentRequest.Start = From;
+		SegmentRequest.Goal = To;
+		SegmentRequest.SearchMin.X = FMath::Max(Request.SearchMin.X, FMath::Min(From.X, To.X));
+		SegmentRequest.SearchMin.Y = FMath::Max(Request.SearchMin.Y, FMath::Min(From.Y, To.Y));
+		SegmentRequest.SearchMax.X = FMath::Min(Request.SearchMax.X, FMath::Max(From.X, To.X));
+		SegmentRequest.SearchMax.Y = FMath::Min(Request.SearchMax.Y, FMath::Max(From.Y, To.Y));
+		SegmentRequest.bAllowPartialPath = false;
+
+		const bool bFound = FGridAStar::FindPath(SegmentRequest, OutSegment, Context);
+		ExtendBoxBySearch(InOutReadMin, InOutReadMax, Context);
+		return bFound && OutSegment.Num() - 1 == Manhattan(From, To);
+	}
+}
+
+void FCachedGridPath::Assign(const TArray<FGridCoordinate>& Cells)
+{
+	if (Cells.IsEmpty() || Cells.Num() - 1 != Manhattan(Cells[0], Cells.Last()))
+	{
+		Reset();
+		return;
+	}
+
+	Start = Cells[0];
+	DirectionX = Cells.Last().X < Start.X ? -1 : 1;
+	DirectionY = Cells.Last().Y < Start.Y ? -1 : 1;
+	NumSteps = Cells.Num() - 1;
+	bIsSet = true;
+
+	StepBits.Reset();
+	StepBits.SetNumZeroed(FMath::DivideAndRoundUp(NumSteps, 64));
+	for (int32 StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+	{
+		if (Cells[StepIndex + 1].X != Cells[StepIndex].X)
+		{
+			StepBits[StepIndex >> 6] |= 1ull << (StepIndex & 63);
+		}
+	}
+}
+
+void FCachedGridPath::Reset()
+{
+	bIsSet = false;
+	NumSteps = 0;
+	StepBits.Reset();
+}
+
+void FCachedGridPath::Empty()
+{
+	Reset();
+	StepBits.Empty();
+}
+
+void FCachedGridPath::Decode(TArray<FGridCoordinate>& OutCells) const
+{
+	OutCells.SetNumUninitialized(NumSteps + 1, EAllowShrinking::No);
+
+	FGridCoordinate Cell = Start;
+	OutCells[0] = Cell;
+	for (int32 StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+	{
+		if (StepBits[StepIndex >> 6] & (1ull << (StepIndex & 63)))
+		{
+			Cell.X += DirectionX;
+		}
+		else
+		{
+			Cell.Y += DirectionY;
+		}
+		OutCells[StepIndex + 1] = Cell;
+	}
+}
+
+void FCachedGridPath::Write(TArray<uint8>& Out) const
+{
+	auto WriteBytes = [&Out](const void* Source, int32 NumBytes)
+	{
+		const int32 Offset = Out.AddUninitialized(NumBytes);
+		FMemory::Memcpy(Out.GetData() + Offset, Source, NumBytes);
+	};
+
+	const int32 StoredSteps = bIsSet ? NumSteps : INDEX_NONE;
+	WriteBytes(&StoredSteps, sizeof(StoredSteps));
+	if (!bIsSet) return;
+
+	WriteBytes(&Start, sizeof(Start));
+	WriteBytes(&DirectionX, sizeof(DirectionX));
+	WriteBytes(&DirectionY, sizeof(DirectionY));
+	WriteBytes(StepBits.GetData(), StepBits.Num() * StepBits.GetTypeSize());
+}
+
+const uint8* FCachedGridPath::Read(const uint8* Data)
+{
+	auto ReadBytes = [&Data](void* Destination, int32 NumBytes)
+	{
+		FMemory::Memcpy(Destination, Data, NumBytes);
+		Data += NumBytes;
+	};
+
+	int32 StoredSteps;
+	ReadBytes(&StoredSteps, sizeof(StoredSteps));
+	if (StoredSteps == INDEX_NONE)
+	{
+		Reset();
+		return Data;
+	}
+
+	bIsSet = true;
+	NumSteps = StoredSteps;
+	ReadBytes(&Start, sizeof(Start));
+	ReadBytes(&DirectionX, sizeof(DirectionX));
+	ReadBytes(&DirectionY, sizeof(DirectionY));
+	StepBits.SetNumUninitialized(FMath::DivideAndRoundUp(NumSteps, 64), EAllowShrinking::No);
+	ReadBytes(StepBits.GetData(), StepBits.Num() * StepBits.GetTypeSize());
+	return Data;
+}
+
+EPathCacheResult FGridPathCache::FindPath(const FCachedGridPath& Cached, int32 MaxWalkedCells, const FPathRequest& Request,
+                                          TArray<FGridCoordinate>& OutPath, FCachedGridPath& OutCached,
+                                          FGridAStarContext& Context, FGridCoordinate& OutReadMin,
+                                          FGridCoordinate& OutReadMax)
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_FindCachedPath);
+	checkSlow(&Cached != &OutCached);
+
+	const FGridCoordinate& Start = Request.Start;
+	const FGridCoordinate& Goal = Request.Goal;
+
+	OutReadMin = Start;
+	OutReadMax = Start;
+
+	const FGridCoordinate SearchMin(FMath::Max(Request.SearchMin.X, 0), FMath::Max(Request.SearchMin.Y, 0));
+	const FGridCoordinate SearchMax(FMath::Min(Request.SearchMax.X, Request.GridSize.X - 1),
+	                                FMath::Min(Request.SearchMax.Y, Request.GridSize.Y - 1));
+
+	auto IsFree = [&](const FGridCoordinate& Cell)
+	{
+		return IsInsideBox(Cell, SearchMin, SearchMax) && !Request.IsBlocked(Cell);
+	};
+
+	static thread_local TArray<FGridCoordinate> Segment;
+	bool bRepaired = false;
+
+	auto UpdateCachedPath = [&]() -> bool
+	{
+		Cached.Decode(OutPath);
+
+		// Start walked some way along the path since it was stored
+		int32 NumWalkedCells = INDEX_NONE;
+		for (int32 Index = 0; Index < FMath::Min(MaxWalkedCells + 1, OutPath.Num()); ++Index)
+		{
+			if (OutPath[Index] == Start)
+			{
+				NumWalkedCells = Index;
+				break;
+			}
+		}
+		if (NumWalkedCells == INDEX_NONE) return false;
+		OutPath.RemoveAt(0, NumWalkedCells, EAllowShrinking::No);
+
+		if (!(OutPath.Last() == Goal))
+		{
+			// The path only ever heads one way along each axis, so the cells it keeps inside the box between Start
+			// and Goal all lie on some Manhattan-length path to Goal
+			const FGridCoordinate GoalBoxMin(FMath::Min(Start.X, Goal.X), FMath::Min(Start.Y, Goal.Y));
+			const FGridCoordinate GoalBoxMax(FMath::Max(Start.X, Goal.X), FMath::Max(Start.Y, Goal.Y));
+
+			int32 NumKept = 1;
+			while (NumKept < OutPath.Num() && !(OutPath[NumKept - 1] == Goal) &&
+			       IsInsideBox(OutPath[NumKept], GoalBoxMin, GoalBoxMax))
+			{
+				++NumKept;
+			}
+			OutPath.SetNum(NumKept, EAllowShrinking::No);
+
+			if (!(OutPath.Last() == Goal))
+			{
+				if (!FindManhattanSegment(Request, OutPath.Last(), Goal, Segment, Context, OutReadMin, OutReadMax))
+					return false;
+
+				OutPath.Append(Segment.GetData() + 1, Segment.Num() - 1);
+			}
+			bRepaired = true;
+		}
+
+		// Splice around every run of cells blocked since, keeping the path's length
+		const int32 GoalIndex = OutPath.Num() - 1;
+		for (int32 Index = 1; Index < GoalIndex; ++Index)
+		{
+			ExtendBox(OutReadMin, OutReadMax, OutPath[Index]);
+			if (IsFree(OutPath[Index])) continue;
+
+			int32 RunEnd = Index + 1;
+			while (RunEnd < GoalIndex && !IsFree(OutPath[RunEnd]))
+			{
+				ExtendBox(OutReadMin, OutReadMax, OutPath[RunEnd]);
+				++RunEnd;
+			}
+
+			if (!FindManhattanSegment(Request, OutPath[Index - 1], OutPath[RunEnd], Segment, Context, OutReadMin, OutReadMax))
+				return false;
+
+			checkSlow(Segment.Num() == RunEnd - Index + 2);
+			FMemory::Memcpy(&OutPath[Index - 1], Segment.GetData(), Segment.Num() * sizeof(FGridCoordinate));
+			bRepaired = true;
+			Index = RunEnd;
+		}
+		ExtendBox(OutReadMin, OutReadMax, Goal);
+		return true;
+	};
+
+	EPathCacheResult Result;
+	if (Cached.IsSet() && UpdateCachedPath())
+	{
+		Result = bRepaired ? EPathCacheResult::Repaired : EPathCacheResult::Hit;
+	}
+	else if (FGridAStar::FindPath(Request, OutPath, Context))
+	{
+		ExtendBoxBySearch(OutReadMin, OutReadMax, Context);
+		Result = Context.LastResult == EGridSearchResult::OutOfBudget ? EPathCacheResult::Partial : EPathCacheResult::Replanned;
+	}
+	else
+	{
+		ExtendBoxBySearch(OutReadMin, OutReadMax, Context);
+		OutPath.Reset();
+		Result = EPathCacheResult::NoPath;
+	}
+
+	if (Result == EPathCacheResult::Partial)
+	{
+		OutCached.Reset();
+	}
+	else
+	{
+		OutCached.Assign(OutPath);
+	}
+
+	// Searches test the blocked state of cells next to the ones they expand
+	OutReadMin = FGridCoordinate(OutReadMin.X - 1, OutReadMin.Y - 1);
+	OutReadMax = FGridCoordinate(OutReadMax.X + 1, OutReadMax.Y + 1);
+	return Result;
+}
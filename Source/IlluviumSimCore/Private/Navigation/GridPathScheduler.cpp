@@ -0,0 +1,288 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridPathScheduler.h"
+
+#include "GridBattleStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Serve Path Queue"), STAT_GridBattle_ServePathQueue, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Requests"), STAT_GridBattle_PathRequests, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Requests Coalesced"), STAT_GridBattle_PathRequestsCoalesced, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduled Searches"), STAT_GridBattle_ScheduledSearches, STATGROUP_GridBattle);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Path Queue Depth"), STAT_GridBattle_PathQueueDepth, STATGROUP_GridBattle);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Path Request Max Latency"), STAT_GridBattle_PathRequestMaxLatency, STATGROUP_GridBattle);
+
+namespace
+{
+	void WriteBytes(TArray<uint8>& Out, const void* Source, int32 NumBytes)
+	{
+		const int32 Offset = Out.AddUninitialized(NumBytes);
+		FMemory::Memcpy(Out.GetData() + Offset, Source, NumBytes);
+	}
+
+	void ReadBytes(const uint8*& Data, void* Destination, int32 NumBytes)
+	{
+		FMemory::Memcpy(Destination, Data, NumBytes);
+		Data += NumBytes;
+	}
+}
+
+void FGridPathScheduler::Reset(int32 InGridWidth)
+{
+	GridWidth = InGridWidth;
+	Entries.Reset();
+	FreeEntries.Reset();
+	EntryByPair.Reset();
+	EntryByRequester.Reset();
+	Heap.Reset();
+	Frame = 0;
+	NextSequence = 0;
+	Stats = FPathSchedulerStats();
+}
+
+uint64 FGridPathScheduler::MakePairKey(const FGridCoordinate& Start, const FGridCoordinate& Goal) const
+{
+	const uint32 StartIndex = uint32(Start.Y * GridWidth + Start.X);
+	const uint32 GoalIndex = uint32(Goal.Y * GridWidth + Goal.X);
+	return (uint64(StartIndex) << 32) | uint64(GoalIndex);
+}
+
+int32 FGridPathScheduler::AddEntry(const FGridCoordinate& Start, const FGridCoordinate& Goal, int32 EnqueueFrame)
+{
+	const int32 EntryIndex = FreeEntries.IsEmpty() ? Entries.AddDefaulted() : FreeEntries.Pop(EAllowShrinking::No);
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.Start = Start;
+	Entry.Goal = Goal;
+	Entry.Sequence = NextSequence++;
+	Entry.EnqueueFrame = EnqueueFrame;
+	Entry.Requesters.Reset();
+	EntryByPair.Add(MakePairKey(Start, Goal), EntryIndex);
+	return EntryIndex;
+}
+
+void FGridPathScheduler::FreeEntry(int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	EntryByPair.Remove(MakePairKey(Entry.Start, Entry.Goal));
+	Entry.Requesters.Reset();
+	++Entry.Version;
+	FreeEntries.Add(EntryIndex);
+}
+
+void FGridPathScheduler::PushEntry(int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	++Entry.Version;
+	Heap.HeapPush({Entry.Key, Entry.Sequence, EntryIndex, Entry.Version});
+}
+
+int32 FGridPathScheduler::RemoveRequester(int32 RequesterId, int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	const int32 EnqueueFrame = Entry.EnqueueFrame;
+	Entry.Requesters.RemoveSingle(RequesterId);
+	EntryByRequester.Remove(RequesterId);
+	if (Entry.Requesters.IsEmpty())
+	{
+		FreeEntry(EntryIndex);
+	}
+	return EnqueueFrame;
+}
+
+void FGridPathScheduler::Enqueue(int32 RequesterId, const FGridCoordinate& Start, const FGridCoordinate& Goal, int32 Priority)
+{
+	++Stats.Requests;
+	INC_DWORD_STAT(STAT_GridBattle_PathRequests);
+
+	int32 EnqueueFrame = Frame;
+	if (const int32* QueuedIndex = EntryByRequester.Find(RequesterId))
+	{
+		const FEntry& Queued = Entries[*QueuedIndex];
+		if (Queued.Start == Start && Queued.Goal == Goal)
+		{
+			++Stats.Coalesced;
+			INC_DWORD_STAT(STAT_GridBattle_PathRequestsCoalesced);
+			return;
+		}
+		EnqueueFrame = RemoveRequester(RequesterId, *QueuedIndex);
+	}
+
+	const int64 Key = Priority + int64(AgingPerFrame) * EnqueueFrame;
+	int32 EntryIndex;
+	if (const int32* SharedIndex = EntryByPair.Find(MakePairKey(Start, Goal)))
+	{
+		++Stats.Coalesced;
+		INC_DWORD_STAT(STAT_GridBattle_PathRequestsCoalesced);
+
+		EntryIndex = *SharedIndex;
+		FEntry& Entry = Entries[EntryIndex];
+		Entry.EnqueueFrame = FMath::Min(Entry.EnqueueFrame, EnqueueFrame);
+		if (Key < Entry.Key)
+		{
+			Entry.Key = Key;
+			PushEntry(EntryIndex);
+		}
+	}
+	else
+	{
+		EntryIndex = AddEntry(Start, Goal, EnqueueFrame);
+		Entries[EntryIndex].Key = Key;
+		PushEntry(EntryIndex);
+	}
+
+	Entries[EntryIndex].Requesters.Add(RequesterId);
+	EntryByRequester.Add(RequesterId, EntryIndex);
+}
+
+void FGridPathScheduler::Cancel(int32 RequesterId)
+{
+	if (const int32* QueuedIndex = EntryByRequester.Find(RequesterId))
+	{
+		RemoveRequester(RequesterId, *QueuedIndex);
+	}
+}
+
+void FGridPathScheduler::Serve(const FPathRequest& Base, int32 MaxExpansions, double MaxSeconds,
+                               TFunctionRef<void(int32 RequesterId, EGridSearchResult Result, const TArray<FGridCoordinate>& Path)> OnServed)
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_ServePathQueue);
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	FPathRequest Request = Base;
+	Request.bAllowPartialPath = true;
+
+	int32 MaxLatencyThisFrame = 0;
+	int32 ExpansionsLeft = MaxExpansions;
+	while (ExpansionsLeft > 0 && !Heap.IsEmpty())
+	{
+		double SecondsLeft = 0.0;
+		if (MaxSeconds > 0.0)
+		{
+			SecondsLeft = MaxSeconds - (FPlatformTime::Seconds() - StartSeconds);
+			if (SecondsLeft <= 0.0) break;
+		}
+
+		FQueued Top;
+		Heap.HeapPop(Top, EAllowShrinking::No);
+		if (Entries[Top.EntryIndex].Version != Top.Version) continue;
+
+		const FEntry& Entry = Entries[Top.EntryIndex];
+		Request.Start = Entry.Start;
+		Request.Goal = Entry.Goal;
+		Request.PassableOverrides.Reset();
+		Request.PassableOverrides.Add(Entry.Start);
+		Request.MaxExpansions = ExpansionsLeft;
+		Request.MaxSearchSeconds = SecondsLeft;
+
+		if (!FGridAStar::FindPath(Request, Path, SearchContext))
+		{
+			Path.Reset();
+		}
+		ExpansionsLeft -= SearchContext.LastNodesExpanded;
+
+		++Stats.Searches;
+		INC_DWORD_STAT(STAT_GridBattle_ScheduledSearches);
+		Stats.NodesExpanded += SearchContext.LastNodesExpanded;
+		if (SearchContext.LastResult == EGridSearchResult::OutOfBudget) ++Stats.PartialSearches;
+
+		const int32 Latency = Frame - Entry.EnqueueFrame;
+		MaxLatencyThisFrame = FMath::Max(MaxLatencyThisFrame, Latency);
+		Stats.MaxLatencyFrames = FMath::Max(Stats.MaxLatencyFrames, Latency);
+		for (const int32 RequesterId : Entry.Requesters)
+		{
+			EntryByRequester.Remove(RequesterId);
+			OnServed(RequesterId, SearchContext.LastResult, Path);
+			++Stats.RequestersServed;
+			Stats.TotalLatencyFrames += Latency;
+		}
+		FreeEntry(Top.EntryIndex);
+	}
+
+	++Frame;
+	CompactHeap();
+
+	Stats.QueueDepth = GetQueueDepth();
+	Stats.PeakQueueDepth = FMath::Max(Stats.PeakQueueDepth, Stats.QueueDepth);
+	Stats.LastServeMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+	SET_DWORD_STAT(STAT_GridBattle_PathQueueDepth, Stats.QueueDepth);
+	SET_DWORD_STAT(STAT_GridBattle_PathRequestMaxLatency, MaxLatencyThisFrame);
+}
+
+void FGridPathScheduler::CompactHeap()
+{
+	if (Heap.Num() <= 2 * GetQueueDepth() + 64) return;
+
+	Heap.Reset();
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+	{
+		const FEntry& Entry = Entries[EntryIndex];
+		if (!Entry.Requesters.IsEmpty())
+		{
+			Heap.Add({Entry.Key, Entry.Sequence, EntryIndex, Entry.Version});
+		}
+	}
+	Heap.Heapify();
+}
+
+void FGridPathScheduler::Write(TArray<uint8>& Out) const
+{
+	const int32 NumEntries = GetQueueDepth();
+	WriteBytes(Out, &Frame, sizeof(Frame));
+	WriteBytes(Out, &NextSequence, sizeof(NextSequence));
+	WriteBytes(Out, &NumEntries, sizeof(NumEntries));
+
+	for (const FEntry& Entry : Entries)
+	{
+		if (Entry.Requesters.IsEmpty()) continue;
+
+		const int32 NumRequesters = Entry.Requesters.Num();
+		WriteBytes(Out, &Entry.Start, sizeof(Entry.Start));
+		WriteBytes(Out, &Entry.Goal, sizeof(Entry.Goal));
+		WriteBytes(Out, &Entry.Key, sizeof(Entry.Key));
+		WriteBytes(Out, &Entry.Sequence, sizeof(Entry.Sequence));
+		WriteBytes(Out, &Entry.EnqueueFrame, sizeof(Entry.EnqueueFrame));
+		WriteBytes(Out, &NumRequesters, sizeof(NumRequesters));
+		WriteBytes(Out, Entry.Requesters.GetData(), NumRequesters * sizeof(int32));
+	}
+}
+
+const uint8* FGridPathScheduler::Read(const uint8* Data)
+{
+	Entries.Reset();
+	FreeEntries.Reset();
+	EntryByPair.Reset();
+	EntryByRequester.Reset();
+	Heap.Reset();
+
+	int32 NumEntries = 0;
+	ReadBytes(Data, &Frame, sizeof(Frame));
+	ReadBytes(Data, &NextSequence, sizeof(NextSequence));
+	ReadBytes(Data, &NumEntries, sizeof(NumEntries));
+
+	Entries.SetNum(NumEntries);
+	for (int32 EntryIndex = 0; EntryIndex < NumEntries; ++EntryIndex)
+	{
+		FEntry& Entry = Entries[EntryIndex];
+		int32 NumRequesters = 0;
+		ReadBytes(Data, &Entry.Start, sizeof(Entry.Start));
+		ReadBytes(Data, &Entry.Goal, sizeof(Entry.Goal));
+		ReadBytes(Data, &Entry.Key, sizeof(Entry.Key));
+		ReadBytes(Data, &Entry.Sequence, sizeof(Entry.Sequence));
+		ReadBytes(Data, &Entry.EnqueueFrame, sizeof(Entry.EnqueueFrame));
+		ReadBytes(Data, &NumRequesters, sizeof(NumRequesters));
+		Entry.Requesters.SetNum(NumRequesters);
+		ReadBytes(Data, Entry.Requesters.GetData(), NumRequesters * sizeof(int32));
+
+		EntryByPair.Add(MakePairKey(Entry.Start, Entry.Goal), EntryIndex);
+		for (const int32 RequesterId : Entry.Requesters)
+		{
+			EntryByRequester.Add(RequesterId, EntryIndex);
+		}
+		Heap.Add({Entry.Key, Entry.Sequence, EntryIndex, Entry.Version});
+	}
+	Heap.Heapify();
+
+	Stats.QueueDepth = NumEntries;
+	return Data;
+}
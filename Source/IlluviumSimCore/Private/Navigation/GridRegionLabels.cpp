@@ -0,0 +1,337 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridRegionLabels.h"
+
+#include "GridBattleStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Label Regions"), STAT_GridBattle_LabelRegions, STATGROUP_GridBattle);
+
+namespace
+{
+	const FGridCoordinate NeighbourOffsets[4] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+	// The eight cells around a cell in order, each sharing a side with the next. Odd entries share one with the cell
+	const FGridCoordinate RingOffsets[8] = { { -1, -1 }, { 0, -1 }, { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 } };
+
+	FORCEINLINE FGridCoordinate Offset(const FGridCoordinate& Cell, const FGridCoordinate& Delta)
+	{
+		return FGridCoordinate(Cell.X + Delta.X, Cell.Y + Delta.Y);
+	}
+}
+
+void FGridRegionLabels::Init(const FIntPoint& InGridSize)
+{
+	Obstacles.Init(InGridSize);
+
+	const int32 NumCells = InGridSize.X * InGridSize.Y;
+	Labels.Init(0, NumCells);
+	RegionSizes.Reset();
+	FreeRegions.Reset();
+	NumRegions = 0;
+	NumOpenCells = NumCells;
+	LastCellsRelabelled = 0;
+
+	if (NumCells > 0)
+	{
+		RegionSizes[AllocateRegion()] = NumCells;
+	}
+}
+
+void FGridRegionLabels::Build(const FGridOccupancy& InObstacles)
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_LabelRegions);
+
+	Obstacles.CopyFrom(InObstacles);
+
+	const FIntPoint& GridSize = GetGridSize();
+	Labels.Init(INDEX_NONE, GridSize.X * GridSize.Y);
+	RegionSizes.Reset();
+	FreeRegions.Reset();
+	NumRegions = 0;
+	NumOpenCells = 0;
+	LastCellsRelabelled = 0;
+
+	for (int32 Y = 0; Y < GridSize.Y; ++Y)
+	{
+		for (int32 X = 0; X < GridSize.X; ++X)
+		{
+			const FGridCoordinate Cell(X, Y);
+			if (Obstacles.IsSet(Cell) || GetRegion(Cell) != INDEX_NONE) continue;
+
+			const int32 Region = AllocateRegion();
+			RegionSizes[Region] = FloodFill(Cell, Region);
+			NumOpenCells += RegionSizes[Region];
+		}
+	}
+}
+
+void FGridRegionLabels::SetObstacle(const FGridCoordinate& Cell, bool bBlocked)
+{
+	LastCellsRelabelled = 0;
+	if (!IsWithinGrid(Cell) || Obstacles.IsSet(Cell) == bBlocked) return;
+
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_LabelRegions);
+
+	const int32 CellIndex = Cell.Y * GetGridSize().X + Cell.X;
+	if (!bBlocked)
+	{
+		Obstacles.Clear(Cell);
+		++NumOpenCells;
+
+		// The largest region next to the cell absorbs the others, which only touch each other through it
+		int32 Largest = INDEX_NONE;
+		for (const FGridCoordinate& Delta : NeighbourOffsets)
+		{
+			const FGridCoordinate Neighbour = Offset(Cell, Delta);
+			if (!IsOpen(Neighbour)) continue;
+
+			const int32 Region = GetRegion(Neighbour);
+			if (Largest == INDEX_NONE || RegionSizes[Region] > RegionSizes[Largest]) Largest = Region;
+		}
+		if (Largest == INDEX_NONE)
+		{
+			Largest = AllocateRegion();
+		}
+
+		Labels[CellIndex] = Largest;
+		++RegionSizes[Largest];
+
+		for (const FGridCoordinate& Delta : NeighbourOffsets)
+		{
+			const FGridCoordinate Neighbour = Offset(Cell, Delta);
+			if (!IsOpen(Neighbour)) continue;
+
+			const int32 Region = GetRegion(Neighbour);
+			if (Region == Largest) continue;
+
+			const int32 NumMoved = FloodFill(Neighbour, Largest);
+			RegionSizes[Largest] += NumMoved;
+			LastCellsRelabelled += NumMoved;
+			FreeRegion(Region);
+		}
+		return;
+	}
+
+	Obstacles.Set(Cell);
+	--NumOpenCells;
+
+	const int32 Region = Labels[CellIndex];
+	Labels[CellIndex] = INDEX_NONE;
+	if (--RegionSizes[Region] == 0)
+	{
+		FreeRegion(Region);
+		return;
+	}
+
+	SplitAround(Cell, Region);
+}
+
+int32 FGridRegionLabels::AllocateRegion()
+{
+	++NumRegions;
+	if (!FreeRegions.IsEmpty())
+	{
+		const int32 Region = FreeRegions.Pop(EAllowShrinking::No);
+		RegionSizes[Region] = 0;
+		return Region;
+	}
+	return RegionSizes.Add(0);
+}
+
+void FGridRegionLabels::FreeRegion(int32 Region)
+{
+	--NumRegions;
+	RegionSizes[Region] = 0;
+	FreeRegions.Add(Region);
+}
+
+int32 FGridRegionLabels::FloodFill(const FGridCoordinate& Seed, int32 Region)
+{
+	const int32 GridWidth = GetGridSize().X;
+
+	Frontier.Reset();
+	Frontier.Add(Seed.Y * GridWidth + Seed.X);
+	Labels[Frontier[0]] = Region;
+
+	for (int32 Head = 0; Head < Frontier.Num(); ++Head)
+	{
+		const FGridCoordinate Cell(Frontier[Head] % GridWidth, Frontier[Head] / GridWidth);
+		for (const FGridCoordinate& Delta : NeighbourOffsets)
+		{
+			const FGridCoordinate Neighbour = Offset(Cell, Delta);
+			if (!IsOpen(Neighbour)) continue;
+
+			const int32 NeighbourIndex = Neighbour.Y * GridWidth + Neighbour.X;
+			if (Labels[NeighbourIndex] == Region) continue;
+
+			Labels[NeighbourIndex] = Region;
+			Frontier.Add(NeighbourIndex);
+		}
+	}
+	return Frontier.Num();
+}
+
+void FGridRegionLabels::SplitAround(const FGridCoordinate& Cell, int32 Region)
+{
+	// Open sides that stay joined through the ring of cells around Cell are still connected, which settles most edits
+	bool bRingOpen[8];
+	int32 FirstBlocked = INDEX_NONE;
+	for (int32 RingIndex = 0; RingIndex < 8; ++RingIndex)
+	{
+		bRingOpen[RingIndex] = IsOpen(Offset(Cell, RingOffsets[RingIndex]));
+		if (!bRingOpen[RingIndex] && FirstBlocked == INDEX_NONE) FirstBlocked = RingIndex;
+	}
+	if (FirstBlocked == INDEX_NONE) return;
+
+	FGridCoordinate Sides[4];
+	int32 NumSides = 0;
+	int32 Run = 0;
+	int32 FirstSideRun = INDEX_NONE;
+	bool bSidesInOneRun = true;
+	for (int32 Step = 1; Step <= 8; ++Step)
+	{
+		const int32 RingIndex = (FirstBlocked + Step) % 8;
+		if (!bRingOpen[RingIndex])
+		{
+			++Run;
+			continue;
+		}
+		if ((RingIndex & 1) == 0) continue;
+
+		Sides[NumSides++] = Offset(Cell, RingOffsets[RingIndex]);
+		if (FirstSideRun == INDEX_NONE) FirstSideRun = Run;
+		bSidesInOneRun &= FirstSideRun == Run;
+	}
+	if (NumSides < 2 || bSidesInOneRun) return;
+
+	// Flood from every side in lockstep until they all meet, or all but one ran out. A search that runs out walked a
+	// whole part cut off by the cell, so the work stays proportional to the parts that get relabelled
+	const int32 GridWidth = GetGridSize().X;
+	if (VisitedGeneration.Num() < Labels.Num())
+	{
+		VisitedGeneration.SetNumZeroed(Labels.Num());
+		VisitedSearch.SetNumUninitialized(Labels.Num());
+	}
+	if (++Generation == 0)
+	{
+		FMemory::Memzero(VisitedGeneration.GetData(), VisitedGeneration.Num() * sizeof(uint32));
+		Generation = 1;
+	}
+
+	int32 Group[4];
+	int32 Head[4];
+	for (int32 Search = 0; Search < NumSides; ++Search)
+	{
+		const int32 SideIndex = Sides[Search].Y * GridWidth + Sides[Search].X;
+		Group[Search] = Search;
+		Head[Search] = 0;
+		SplitSearches[Search].Reset();
+		SplitSearches[Search].Add(SideIndex);
+		VisitedGeneration[SideIndex] = Generation;
+		VisitedSearch[SideIndex] = static_cast<uint8>(Search);
+	}
+
+	auto FindGroup = [&Group](int32 Search)
+	{
+		while (Group[Search] != Search) Search = Group[Search];
+		return Search;
+	};
+
+	auto IsGroupRunning = [&](int32 Root)
+	{
+		for (int32 Search = 0; Search < NumSides; ++Search)
+		{
+			if (FindGroup(Search) == Root && Head[Search] < SplitSearches[Search].Num()) return true;
+		}
+		return false;
+	};
+
+	int32 RunningRoot = INDEX_NONE;
+	while (true)
+	{
+		for (int32 Search = 0; Search < NumSides; ++Search)
+		{
+			TArray<int32>& Visited = SplitSearches[Search];
+			if (Head[Search] >= Visited.Num()) continue;
+
+			const int32 CellIndex = Visited[Head[Search]++];
+			const FGridCoordinate Current(CellIndex % GridWidth, CellIndex / GridWidth);
+			for (const FGridCoordinate& Delta : NeighbourOffsets)
+			{
+				const FGridCoordinate Neighbour = Offset(Current, Delta);
+				if (!IsOpen(Neighbour)) continue;
+
+				const int32 NeighbourIndex = Neighbour.Y * GridWidth + Neighbour.X;
+				if (VisitedGeneration[NeighbourIndex] == Generation)
+				{
+					const int32 OwnRoot = FindGroup(Search);
+					const int32 OtherRoot = FindGroup(VisitedSearch[NeighbourIndex]);
+					if (OwnRoot != OtherRoot) Group[OtherRoot] = OwnRoot;
+					continue;
+				}
+
+				VisitedGeneration[NeighbourIndex] = Generation;
+				VisitedSearch[NeighbourIndex] = static_cast<uint8>(Search);
+				Visited.Add(NeighbourIndex);
+			}
+		}
+
+		int32 NumGroups = 0;
+		int32 NumRunning = 0;
+		RunningRoot = INDEX_NONE;
+		for (int32 Search = 0; Search < NumSides; ++Search)
+		{
+			if (FindGroup(Search) != Search) continue;
+			++NumGroups;
+			if (IsGroupRunning(Search))
+			{
+				++NumRunning;
+				RunningRoot = Search;
+			}
+		}
+
+		if (NumGroups == 1) return;
+		if (NumRunning <= 1) break;
+	}
+
+	auto GetGroupSize = [&](int32 Root)
+	{
+		int32 Size = 0;
+		for (int32 Search = 0; Search < NumSides; ++Search)
+		{
+			if (FindGroup(Search) == Root) Size += SplitSearches[Search].Num();
+		}
+		return Size;
+	};
+
+	// The part still growing keeps the label, or the largest one if every part was walked
+	int32 KeptRoot = RunningRoot;
+	if (KeptRoot == INDEX_NONE)
+	{
+		for (int32 Search = 0; Search < NumSides; ++Search)
+		{
+			if (FindGroup(Search) != Search) continue;
+			if (KeptRoot == INDEX_NONE || GetGroupSize(Search) > GetGroupSize(KeptRoot)) KeptRoot = Search;
+		}
+	}
+
+	for (int32 Root = 0; Root < NumSides; ++Root)
+	{
+		if (FindGroup(Root) != Root || Root == KeptRoot) continue;
+
+		const int32 NewRegion = AllocateRegion();
+		for (int32 Search = 0; Search < NumSides; ++Search)
+		{
+			if (FindGroup(Search) != Root) continue;
+
+			for (const int32 CellIndex : SplitSearches[Search])
+			{
+				Labels[CellIndex] = NewRegion;
+			}
+			RegionSizes[NewRegion] += SplitSearches[Search].Num();
+		}
+		RegionSizes[Region] -= RegionSizes[NewRegion];
+		LastCellsRelabelled += RegionSizes[NewRegion];
+	}
+}
@@ -0,0 +1,104 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Navigation/GridSpatialIndex.h"
+
+void FGridSpatialIndex::Init(const FIntPoint& InGridSize)
+{
+	GridSize = InGridSize;
+	UnitIdByCell.Init(INDEX_NONE, GridSize.X * GridSize.Y);
+	EntryByUnitId.Reset();
+	UnitIdsByTeam[0].Reset();
+	UnitIdsByTeam[1].Reset();
+}
+
+void FGridSpatialIndex::Add(int32 UnitId, EBattleTeam Team, const FGridCoordinate& Cell)
+{
+	check(UnitId >= 0);
+	if (UnitId >= EntryByUnitId.Num())
+	{
+		EntryByUnitId.SetNum(UnitId + 1);
+	}
+
+	TArray<int32>& TeamUnitIds = UnitIdsByTeam[static_cast<uint8>(Team)];
+
+	FEntry& Entry = EntryByUnitId[UnitId];
+	check(Entry.TeamSlot == INDEX_NONE);
+	Entry.Cell = Cell;
+	Entry.Team = Team;
+	Entry.TeamSlot = TeamUnitIds.Add(UnitId);
+
+	UnitIdByCell[Cell.Y * GridSize.X + Cell.X] = UnitId;
+}
+
+void FGridSpatialIndex::Remove(int32 UnitId)
+{
+	if (!EntryByUnitId.IsValidIndex(UnitId)) return;
+
+	FEntry& Entry = EntryByUnitId[UnitId];
+	if (Entry.TeamSlot == INDEX_NONE) return;
+
+	TArray<int32>& TeamUnitIds = UnitIdsByTeam[static_cast<uint8>(Entry.Team)];
+	const int32 LastUnitId = TeamUnitIds.Last();
+	TeamUnitIds.RemoveAtSwap(Entry.TeamSlot, 1, EAllowShrinking::No);
+	if (LastUnitId != UnitId)
+	{
+		EntryByUnitId[LastUnitId].TeamSlot = Entry.TeamSlot;
+	}
+
+	UnitIdByCell[Entry.Cell.Y * GridSize.X + Entry.Cell.X] = INDEX_NONE;
+	Entry.TeamSlot = INDEX_NONE;
+}
+
+void FGridSpatialIndex::Move(int32 UnitId, const FGridCoordinate& NewCell)
+{
+	FEntry& Entry = EntryByUnitId[UnitId];
+	check(Entry.TeamSlot != INDEX_NONE);
+
+	UnitIdByCell[Entry.Cell.Y * GridSize.X + Entry.Cell.X] = INDEX_NONE;
+	UnitIdByCell[NewCell.Y * GridSize.X + NewCell.X] = UnitId;
+	Entry.Cell = NewCell;
+}
+
+int32 FGridSpatialIndex::FindClosestEnemy(EBattleTeam Team, const FGridCoordinate& From) const
+{
+	const EBattleTeam EnemyTeam = Team == EBattleTeam::Red ? EBattleTeam::Blue : EBattleTeam::Red;
+	const TArray<int32>& EnemyUnitIds = UnitIdsByTeam[static_cast<uint8>(EnemyTeam)];
+	if (EnemyUnitIds.IsEmpty()) return INDEX_NONE;
+
+	const int32 MaxRadius = FMath::Max(From.X, GridSize.X - 1 - From.X) + FMath::Max(From.Y, GridSize.Y - 1 - From.Y);
+
+	int32 ScannedCells = 0;
+	for (int32 Radius = 1; Radius <= MaxRadius && ScannedCells <= EnemyUnitIds.Num(); ++Radius)
+	{
+		int32 ClosestEnemyUnitId = INDEX_NONE;
+		ForEachCellOnRing(From, Radius, [&](int32 CellIndex)
+		{
+			const int32 UnitId = UnitIdByCell[CellIndex];
+			if (UnitId == INDEX_NONE || EntryByUnitId[UnitId].Team != EnemyTeam) return;
+			if (ClosestEnemyUnitId == INDEX_NONE || UnitId < ClosestEnemyUnitId)
+			{
+				ClosestEnemyUnitId = UnitId;
+			}
+		});
+
+		if (ClosestEnemyUnitId != INDEX_NONE) return ClosestEnemyUnitId;
+
+		ScannedCells += 4 * Radius;
+	}
+
+	// Enemies are sparse compared to the area left to search, scanning them directly is cheaper
+	int32 ClosestEnemyUnitId = INDEX_NONE;
+	int32 ShortestGridDistance = TNumericLimits<int32>::Max();
+	for (const int32 UnitId : EnemyUnitIds)
+	{
+		const int32 GridDistance = Manhattan(From, EntryByUnitId[UnitId].Cell);
+		if (GridDistance < ShortestGridDistance ||
+			(GridDistance == ShortestGridDistance && UnitId < ClosestEnemyUnitId))
+		{
+			ShortestGridDistance = GridDistance;
+			ClosestEnemyUnitId = UnitId;
+		}
+	}
+	return ClosestEnemyUnitId;
+}
@@ -0,0 +1,556 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Replay/BattleReplay.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	constexpr uint32 ReplayMagic = 0x50524247; // "GBRP"
+	constexpr uint16 ReplayVersion = 1;
+	constexpr int64 HeaderSize = 44;
+
+	// Largest grid a replay may claim to run on, the same as for step deltas
+	constexpr int32 MaxGridExtent = 1 << 15;
+
+	// Id delta, team, HP, cooldown and cell of a unit in a keyframe take a byte each at least
+	constexpr int64 MinKeyframeUnitBytes = 6;
+
+	enum class EReplayRecord : uint8
+	{
+		Step = 0,
+		Keyframe = 1
+	};
+
+	// Direction codes pack dx + 7 and dy + 7 into a nibble each. Moves span at most 8 cells in total, so both
+	// offsets can never be +8 at once and 0xFF is free to announce offsets written as varints instead.
+	constexpr int32 MaxPackedMoveOffset = 7;
+	constexpr uint8 EscapedMoveCode = 0xFF;
+
+	void WriteFixed(TArray<uint8>& Bytes, int64 Offset, uint64 Value, int32 NumBytes)
+	{
+		for (int32 ByteIndex = 0; ByteIndex < NumBytes; ++ByteIndex)
+		{
+			Bytes[Offset + ByteIndex] = static_cast<uint8>(Value >> (8 * ByteIndex));
+		}
+	}
+
+	void AppendFixed(TArray<uint8>& Bytes, uint64 Value, int32 NumBytes)
+	{
+		const int64 Offset = Bytes.AddUninitialized(NumBytes);
+		WriteFixed(Bytes, Offset, Value, NumBytes);
+	}
+
+	void AppendVarUInt(TArray<uint8>& Bytes, uint32 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Bytes.Add(static_cast<uint8>(Value | 0x80));
+			Value >>= 7;
+		}
+		Bytes.Add(static_cast<uint8>(Value));
+	}
+
+	void AppendVarInt(TArray<uint8>& Bytes, int32 Value)
+	{
+		// Zigzag so small negative values stay short
+		AppendVarUInt(Bytes, (static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31));
+	}
+
+	/** Bounds checked cursor over replay bytes. Reads past the end return 0 and set bOverrun. */
+	struct FReplayReader
+	{
+		const uint8* Data;
+		int64 Size;
+		int64 Offset;
+		bool bOverrun = false;
+
+		uint8 ReadByte()
+		{
+			if (Offset >= Size)
+			{
+				bOverrun = true;
+				return 0;
+			}
+			return Data[Offset++];
+		}
+
+		uint64 ReadFixed(int32 NumBytes)
+		{
+			uint64 Value = 0;
+			for (int32 ByteIndex = 0; ByteIndex < NumBytes; ++ByteIndex)
+			{
+				Value |= static_cast<uint64>(ReadByte()) << (8 * ByteIndex);
+			}
+			return Value;
+		}
+
+		uint32 ReadVarUInt()
+		{
+			uint32 Value = 0;
+			for (int32 Shift = 0; Shift < 35; Shift += 7)
+			{
+				const uint8 Byte = ReadByte();
+				Value |= static_cast<uint32>(Byte & 0x7F) << Shift;
+				if (!(Byte & 0x80)) return Value;
+			}
+			bOverrun = true;
+			return 0;
+		}
+
+		int32 ReadVarInt()
+		{
+			const uint32 Encoded = ReadVarUInt();
+			return static_cast<int32>(Encoded >> 1) ^ -static_cast<int32>(Encoded & 1);
+		}
+	};
+}
+
+void FBattleReplayWriter::Begin(const FSimConfig& Config, int32 Seed, const FSimUnitStore& InitialUnits, int32 KeyframeInterval)
+{
+	Header = FBattleReplayHeader();
+	Header.GridSize = Config.GridSize;
+	Header.Seed = Seed;
+	Header.AttackPeriodSteps = Config.AttackPeriodSteps;
+	Header.KeyframeInterval = FMath::Max(1, KeyframeInterval);
+
+	Bytes.Reset();
+	KeyframeOffsets.Reset();
+	Bytes.AddZeroed(HeaderSize);
+
+	bRecording = true;
+	bFinished = false;
+
+	WriteKeyframe(InitialUnits);
+}
+
+void FBattleReplayWriter::AppendStep(const FStepDelta& StepDelta, const FSimUnitStore& UnitsAfterStep)
+{
+	if (!bRecording) return;
+
+	Bytes.Add(static_cast<uint8>(EReplayRecord::Step));
+	AppendVarUInt(Bytes, StepDelta.Events.Num());
+	AppendVarUInt(Bytes, StepDelta.Moves.Num());
+
+	// Event types, two bits each
+	for (int32 EventIndex = 0; EventIndex < StepDelta.Events.Num(); EventIndex += 4)
+	{
+		uint8 PackedTypes = 0;
+		for (int32 Lane = 0; Lane < 4 && EventIndex + Lane < StepDelta.Events.Num(); ++Lane)
+		{
+			PackedTypes |= static_cast<uint8>(StepDelta.Events[EventIndex + Lane].EventType) << (2 * Lane);
+		}
+		Bytes.Add(PackedTypes);
+	}
+
+	for (const FSimEvent& Event : StepDelta.Events)
+	{
+		AppendVarUInt(Bytes, Event.ActorId);
+		AppendVarUInt(Bytes, Event.OtherId);
+	}
+
+	// Moves are committed in unit order, so ids only grow within a step
+	int32 PreviousActorId = 0;
+	for (const FSimMove& Move : StepDelta.Moves)
+	{
+		AppendVarInt(Bytes, Move.ActorId - PreviousActorId);
+		PreviousActorId = Move.ActorId;
+
+		const int32 OffsetX = Move.To.X - Move.From.X;
+		const int32 OffsetY = Move.To.Y - Move.From.Y;
+		if (FMath::Abs(OffsetX) <= MaxPackedMoveOffset && FMath::Abs(OffsetY) <= MaxPackedMoveOffset)
+		{
+			Bytes.Add(static_cast<uint8>(((OffsetX + MaxPackedMoveOffset) << 4) | (OffsetY + MaxPackedMoveOffset)));
+		}
+		else
+		{
+			Bytes.Add(EscapedMoveCode);
+			AppendVarInt(Bytes, OffsetX);
+			AppendVarInt(Bytes, OffsetY);
+		}
+	}
+
+	++Header.NumSteps;
+	if (Header.NumSteps % Header.KeyframeInterval == 0)
+	{
+		WriteKeyframe(UnitsAfterStep);
+	}
+}
+
+void FBattleReplayWriter::WriteKeyframe(const FSimUnitStore& Units)
+{
+	KeyframeOffsets.Add(Bytes.Num());
+
+	// Prefixed with its size so sequential playback can skip it
+	TArray<uint8>& Payload = KeyframeScratch;
+	Payload.Reset();
+	AppendVarUInt(Payload, Header.NumSteps);
+	AppendVarUInt(Payload, Units.Num());
+
+	int32 PreviousId = 0;
+	for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+	{
+		AppendVarUInt(Payload, Units.Ids[UnitIndex] - PreviousId);
+		PreviousId = Units.Ids[UnitIndex];
+		Payload.Add(static_cast<uint8>(Units.Team[UnitIndex]));
+		AppendVarInt(Payload, Units.HP[UnitIndex]);
+		AppendVarUInt(Payload, Units.AttackCooldown[UnitIndex]);
+		AppendVarUInt(Payload, Units.CellX[UnitIndex]);
+		AppendVarUInt(Payload, Units.CellY[UnitIndex]);
+	}
+
+	Bytes.Add(static_cast<uint8>(EReplayRecord::Keyframe));
+	AppendVarUInt(Bytes, Payload.Num());
+	Bytes.Append(Payload);
+}
+
+const TArray<uint8>& FBattleReplayWriter::Finish()
+{
+	if (bFinished || !bRecording) return Bytes;
+
+	const int64 IndexOffset = Bytes.Num();
+	for (const uint64 KeyframeOffset : KeyframeOffsets)
+	{
+		AppendFixed(Bytes, KeyframeOffset, 8);
+	}
+	Header.NumKeyframes = KeyframeOffsets.Num();
+
+	WriteFixed(Bytes, 0, ReplayMagic, 4);
+	WriteFixed(Bytes, 4, ReplayVersion, 2);
+	WriteFixed(Bytes, 6, 0, 2);
+	WriteFixed(Bytes, 8, static_cast<uint32>(Header.GridSize.X), 4);
+	WriteFixed(Bytes, 12, static_cast<uint32>(Header.GridSize.Y), 4);
+	WriteFixed(Bytes, 16, static_cast<uint32>(Header.Seed), 4);
+	WriteFixed(Bytes, 20, static_cast<uint32>(Header.AttackPeriodSteps), 4);
+	WriteFixed(Bytes, 24, static_cast<uint32>(Header.KeyframeInterval), 4);
+	WriteFixed(Bytes, 28, static_cast<uint32>(Header.NumSteps), 4);
+	WriteFixed(Bytes, 32, static_cast<uint32>(Header.NumKeyframes), 4);
+	WriteFixed(Bytes, 36, static_cast<uint64>(IndexOffset), 8);
+
+	bRecording = false;
+	bFinished = true;
+	return Bytes;
+}
+
+bool FBattleReplayWriter::SaveToFile(const FString& Filename)
+{
+	if (!bRecording && !bFinished) return false;
+
+	Finish();
+	return FFileHelper::SaveArrayToFile(Bytes, *Filename);
+}
+
+void FBattleReplayWriter::Reset()
+{
+	Header = FBattleReplayHeader();
+	Bytes.Empty();
+	KeyframeOffsets.Empty();
+	bRecording = false;
+	bFinished = false;
+}
+
+FBattleReplayPlayer::FBattleReplayPlayer() = default;
+
+FBattleReplayPlayer::~FBattleReplayPlayer()
+{
+	Close();
+}
+
+bool FBattleReplayPlayer::OpenFile(const FString& Filename)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	if (MappedRegion)
+	{
+		Data = MappedRegion->GetMappedPtr();
+		DataSize = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		// Mapping is not available everywhere, e.g. inside pak files
+		MappedFile.Reset();
+		if (!FFileHelper::LoadFileToArray(OwnedBytes, *Filename))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Cannot open replay %s"), *Filename);
+			return false;
+		}
+		Data = OwnedBytes.GetData();
+		DataSize = OwnedBytes.Num();
+	}
+
+	return ParseHeader() && SeekToStep(0);
+}
+
+bool FBattleReplayPlayer::OpenMemory(TArray<uint8>&& InBytes)
+{
+	Close();
+
+	OwnedBytes = MoveTemp(InBytes);
+	Data = OwnedBytes.GetData();
+	DataSize = OwnedBytes.Num();
+
+	return ParseHeader() && SeekToStep(0);
+}
+
+void FBattleReplayPlayer::Close()
+{
+	// The region must go before the file it maps
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	OwnedBytes.Empty();
+
+	Data = nullptr;
+	DataSize = 0;
+	Header = FBattleReplayHeader();
+	Units.Reset();
+	StateHash = 0;
+	IndexOffset = 0;
+	ReadOffset = 0;
+	CurrentStep = 0;
+}
+
+bool FBattleReplayPlayer::Fail(const TCHAR* Reason)
+{
+	UE_LOG(LogTemp, Error, TEXT("Bad replay data at byte %lld: %s"), ReadOffset, Reason);
+	Close();
+	return false;
+}
+
+bool FBattleReplayPlayer::ParseHeader()
+{
+	if (DataSize < HeaderSize) return Fail(TEXT("truncated header"));
+
+	FReplayReader Reader { Data, DataSize, 0 };
+	if (Reader.ReadFixed(4) != ReplayMagic) return Fail(TEXT("not a replay"));
+	if (Reader.ReadFixed(2) != ReplayVersion) return Fail(TEXT("unsupported version"));
+	Reader.ReadFixed(2);
+
+	Header.GridSize.X = static_cast<int32>(Reader.ReadFixed(4));
+	Header.GridSize.Y = static_cast<int32>(Reader.ReadFixed(4));
+	Header.Seed = static_cast<int32>(Reader.ReadFixed(4));
+	Header.AttackPeriodSteps = static_cast<int32>(Reader.ReadFixed(4));
+	Header.KeyframeInterval = static_cast<int32>(Reader.ReadFixed(4));
+	Header.NumSteps = static_cast<int32>(Reader.ReadFixed(4));
+	Header.NumKeyframes = static_cast<int32>(Reader.ReadFixed(4));
+	IndexOffset = static_cast<int64>(Reader.ReadFixed(8));
+
+	if (Header.GridSize.X <= 0 || Header.GridSize.X > MaxGridExtent ||
+		Header.GridSize.Y <= 0 || Header.GridSize.Y > MaxGridExtent)
+	{
+		return Fail(TEXT("grid size out of range"));
+	}
+
+	if (Header.KeyframeInterval <= 0 || Header.NumKeyframes <= 0 || Header.NumSteps < 0 ||
+		IndexOffset < HeaderSize || IndexOffset + int64(Header.NumKeyframes) * 8 > DataSize)
+	{
+		return Fail(TEXT("inconsistent header"));
+	}
+	return true;
+}
+
+bool FBattleReplayPlayer::LoadKeyframe(int32 KeyframeIndex)
+{
+	FReplayReader IndexReader { Data, DataSize, IndexOffset + int64(KeyframeIndex) * 8 };
+	FReplayReader Reader { Data, DataSize, static_cast<int64>(IndexReader.ReadFixed(8)) };
+
+	if (Reader.ReadByte() != static_cast<uint8>(EReplayRecord::Keyframe)) return Fail(TEXT("keyframe index points elsewhere"));
+	const int64 PayloadSize = Reader.ReadVarUInt();
+	const int64 PayloadEnd = Reader.Offset + PayloadSize;
+	if (Reader.bOverrun || PayloadEnd > IndexOffset) return Fail(TEXT("truncated keyframe"));
+
+	CurrentStep = static_cast<int32>(Reader.ReadVarUInt());
+	const int64 NumUnits = Reader.ReadVarUInt();
+	if (NumUnits > PayloadSize / MinKeyframeUnitBytes) return Fail(TEXT("more units than the keyframe holds"));
+
+	// Units only spawn before the first keyframe, which lists every one of them, so no id can be larger than the
+	// number of units the whole replay could hold
+	const int64 MaxUnitId = DataSize / MinKeyframeUnitBytes;
+
+	Units.Reset();
+	int64 UnitId = 0;
+	for (int64 UnitIndex = 0; UnitIndex < NumUnits; ++UnitIndex)
+	{
+		const uint32 IdDelta = Reader.ReadVarUInt();
+		const uint8 Team = Reader.ReadByte();
+		const int32 HP = Reader.ReadVarInt();
+		const uint32 AttackCooldown = Reader.ReadVarUInt();
+		const uint32 CellX = Reader.ReadVarUInt();
+		const uint32 CellY = Reader.ReadVarUInt();
+		if (Reader.bOverrun) break;
+
+		UnitId += IdDelta;
+		if (IdDelta == 0 || UnitId > MaxUnitId) return Fail(TEXT("unit ids out of order or out of range"));
+		if (Team > static_cast<uint8>(EBattleTeam::Blue)) return Fail(TEXT("unknown team"));
+		if (CellX >= uint32(Header.GridSize.X) || CellY >= uint32(Header.GridSize.Y)) return Fail(TEXT("unit off the grid"));
+
+		FSimUnit Unit;
+		Unit.Id = static_cast<int32>(UnitId);
+		Unit.Team = static_cast<EBattleTeam>(Team);
+		Unit.HP = HP;
+		Unit.AttackCooldown = static_cast<int32>(AttackCooldown);
+		Unit.Cell = FGridCoordinate(static_cast<int32>(CellX), static_cast<int32>(CellY));
+		Units.Add(Unit);
+	}
+
+	if (Reader.bOverrun || Reader.Offset != PayloadEnd) return Fail(TEXT("truncated keyframe"));
+
+	StateHash = Units.ComputeStateHash();
+	ReadOffset = Reader.Offset;
+	return true;
+}
+
+bool FBattleReplayPlayer::SeekToStep(int32 Step)
+{
+	if (!IsOpen()) return false;
+
+	Step = FMath::Clamp(Step, 0, Header.NumSteps);
+
+	// Going forward from the current state is cheaper whenever no later keyframe lies in between
+	const int32 KeyframeIndex = FMath::Min(Step / Header.KeyframeInterval, Header.NumKeyframes - 1);
+	const int32 KeyframeStep = KeyframeIndex * Header.KeyframeInterval;
+	if (ReadOffset == 0 || Step < CurrentStep || KeyframeStep > CurrentStep)
+	{
+		if (!LoadKeyframe(KeyframeIndex)) return false;
+	}
+
+	FStepDelta SkippedStepDelta;
+	while (CurrentStep < Step)
+	{
+		if (!ReadNextStep(SkippedStepDelta)) return false;
+	}
+	return true;
+}
+
+bool FBattleReplayPlayer::ReadNextStep(FStepDelta& OutStepDelta)
+{
+	OutStepDelta.Moves.Reset();
+	OutStepDelta.Events.Reset();
+
+	if (!IsOpen() || IsAtEnd()) return false;
+
+	FReplayReader Reader { Data, IndexOffset, ReadOffset };
+
+	// Keyframes are only needed for seeking
+	uint8 RecordType = Reader.ReadByte();
+	if (RecordType == static_cast<uint8>(EReplayRecord::Keyframe))
+	{
+		const int64 PayloadSize = Reader.ReadVarUInt();
+		Reader.Offset += PayloadSize;
+		RecordType = Reader.ReadByte();
+	}
+	if (RecordType != static_cast<uint8>(EReplayRecord::Step)) return Fail(TEXT("expected a step record"));
+
+	const int32 NumEvents = static_cast<int32>(Reader.ReadVarUInt());
+	const int32 NumMoves = static_cast<int32>(Reader.ReadVarUInt());
+	if (Reader.bOverrun || NumEvents > (IndexOffset - Reader.Offset) * 4 || NumMoves > IndexOffset - Reader.Offset)
+	{
+		return Fail(TEXT("truncated step"));
+	}
+
+	OutStepDelta.Events.SetNumUninitialized(NumEvents, EAllowShrinking::No);
+	for (int32 EventIndex = 0; EventIndex < NumEvents; EventIndex += 4)
+	{
+		const uint8 PackedTypes = Reader.ReadByte();
+		for (int32 Lane = 0; Lane < 4 && EventIndex + Lane < NumEvents; ++Lane)
+		{
+			OutStepDelta.Events[EventIndex + Lane].EventType = static_cast<EEventType>((PackedTypes >> (2 * Lane)) & 3);
+		}
+	}
+
+	for (FSimEvent& Event : OutStepDelta.Events)
+	{
+		Event.ActorId = static_cast<int32>(Reader.ReadVarUInt());
+		Event.OtherId = static_cast<int32>(Reader.ReadVarUInt());
+	}
+
+	// Same rules as FBattleSimulation::Step: cooldowns tick first, then the events, then the committed moves
+	for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+	{
+		Units.AttackCooldown[UnitIndex] = FMath::Max(Units.AttackCooldown[UnitIndex] - 1, 0);
+	}
+
+	for (const FSimEvent& Event : OutStepDelta.Events)
+	{
+		const int32 ActorIndex = Units.FindIndex(Event.ActorId);
+		if (ActorIndex == INDEX_NONE) return Fail(TEXT("event for an unknown unit"));
+
+		switch (Event.EventType)
+		{
+		case EEventType::Attack: Units.AttackCooldown[ActorIndex] = Header.AttackPeriodSteps;
+			break;
+		case EEventType::Hit:
+			if (Units.IsAlive(ActorIndex))
+			{
+				StateHash -= Units.HashUnitState(ActorIndex);
+				Units.HP[ActorIndex] -= 1;
+				StateHash += Units.HashUnitState(ActorIndex);
+			}
+			else
+			{
+				Units.HP[ActorIndex] -= 1;
+			}
+			break;
+		case EEventType::Die:
+			if (Units.IsAlive(ActorIndex))
+			{
+				StateHash -= Units.HashUnitState(ActorIndex);
+				Units.Alive[ActorIndex] = false;
+			}
+			break;
+		default: return Fail(TEXT("unknown event type"));
+		}
+	}
+
+	OutStepDelta.Moves.SetNumUninitialized(NumMoves, EAllowShrinking::No);
+	int32 ActorId = 0;
+	for (FSimMove& Move : OutStepDelta.Moves)
+	{
+		ActorId += Reader.ReadVarInt();
+		const int32 ActorIndex = Units.FindIndex(ActorId);
+		if (ActorIndex == INDEX_NONE) return Fail(TEXT("move for an unknown unit"));
+
+		int32 OffsetX;
+		int32 OffsetY;
+		const uint8 MoveCode = Reader.ReadByte();
+		if (MoveCode == EscapedMoveCode)
+		{
+			OffsetX = Reader.ReadVarInt();
+			OffsetY = Reader.ReadVarInt();
+		}
+		else
+		{
+			OffsetX = (MoveCode >> 4) - MaxPackedMoveOffset;
+			OffsetY = (MoveCode & 0xF) - MaxPackedMoveOffset;
+		}
+
+		Move.ActorId = ActorId;
+		Move.From = Units.GetCell(ActorIndex);
+		Move.To = FGridCoordinate(Move.From.X + OffsetX, Move.From.Y + OffsetY);
+		if (Move.To.X < 0 || Move.To.X >= Header.GridSize.X || Move.To.Y < 0 || Move.To.Y >= Header.GridSize.Y)
+		{
+			return Fail(TEXT("move off the grid"));
+		}
+		StateHash -= Units.HashUnitState(ActorIndex);
+		Units.SetCell(ActorIndex, Move.To);
+		StateHash += Units.HashUnitState(ActorIndex);
+	}
+
+	if (Reader.bOverrun) return Fail(TEXT("truncated step"));
+
+	Units.Compact();
+	OutStepDelta.StateHash = StateHash;
+	OutStepDelta.GridSize = Header.GridSize;
+	ReadOffset = Reader.Offset;
+	++CurrentStep;
+	return true;
+}
@@ -0,0 +1,153 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Simulation/AsyncBattleRunner.h"
+
+#include "GridBattleStats.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "Simulation/BattleSimulation.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Async Steps Queued"), STAT_GridBattle_AsyncStepsQueued, STATGROUP_GridBattle);
+
+FAsyncBattleRunner::FAsyncBattleRunner() = default;
+
+FAsyncBattleRunner::~FAsyncBattleRunner()
+{
+	Shutdown();
+
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+}
+
+void FAsyncBattleRunner::Start(FBattleSimulation& InSimulation, float StepDurationSeconds, int32 MaxQueuedSteps)
+{
+	Shutdown();
+
+	if (!WakeEvent)
+	{
+		WakeEvent = FPlatformProcess::GetSynchEventFromPool(/*bIsManualReset*/ false);
+	}
+
+	Simulation = &InSimulation;
+	StepDuration = FMath::Max(0.f, StepDurationSeconds);
+
+	// Reserve every slot for the battle's worst step so publishing allocates nothing
+	const int32 NumUnits = InSimulation.GetUnits().Num();
+	Slots.SetNum(FMath::Max(1, MaxQueuedSteps));
+	for (FPublishedBattleStep& Slot : Slots)
+	{
+		Slot.Delta.Moves.Reserve(NumUnits);
+		Slot.Delta.Events.Reserve(NumUnits * 3);
+		Slot.Units.CopyFrom(InSimulation.GetUnits());
+	}
+
+	NumPublished.store(0);
+	NumConsumed.store(0);
+	bStopRequested.store(false);
+
+	Thread = FRunnableThread::Create(this, TEXT("GridBattleSimulation"), 0, TPri_AboveNormal);
+}
+
+void FAsyncBattleRunner::Shutdown()
+{
+	if (!Thread) return;
+
+	Thread->Kill(/*bShouldWait*/ true);
+	delete Thread;
+	Thread = nullptr;
+
+	Simulation = nullptr;
+	NumPublished.store(0);
+	NumConsumed.store(0);
+	SET_DWORD_STAT(STAT_GridBattle_AsyncStepsQueued, 0);
+}
+
+void FAsyncBattleRunner::Stop()
+{
+	bStopRequested.store(true);
+	WakeEvent->Trigger();
+}
+
+const FPublishedBattleStep* FAsyncBattleRunner::PeekStep() const
+{
+	const uint32 Consumed = NumConsumed.load(std::memory_order_relaxed);
+	if (Consumed == NumPublished.load(std::memory_order_acquire)) return nullptr;
+
+	return &Slots[Consumed % Slots.Num()];
+}
+
+void FAsyncBattleRunner::PopStep()
+{
+	const uint32 Consumed = NumConsumed.load(std::memory_order_relaxed);
+	check(Consumed != NumPublished.load(std::memory_order_acquire));
+
+	NumConsumed.store(Consumed + 1, std::memory_order_release);
+	WakeEvent->Trigger();
+}
+
+int32 FAsyncBattleRunner::GetNumQueuedSteps() const
+{
+	return static_cast<int32>(NumPublished.load(std::memory_order_acquire) - NumConsumed.load(std::memory_order_acquire));
+}
+
+void FAsyncBattleRunner::WaitFor(double Seconds) const
+{
+	WakeEvent->Wait(static_cast<uint32>(FMath::Clamp(FMath::CeilToInt(Seconds * 1000.0), 1, MAX_int32)));
+}
+
+uint32 FAsyncBattleRunner::Run()
+{
+	const uint32 NumSlots = Slots.Num();
+	double NextStepTime = FPlatformTime::Seconds();
+
+	while (!bStopRequested.load())
+	{
+		const uint32 Published = NumPublished.load(std::memory_order_relaxed);
+		const uint32 NumQueued = Published - NumConsumed.load(std::memory_order_acquire);
+		SET_DWORD_STAT(STAT_GridBattle_AsyncStepsQueued, NumQueued);
+
+		if (NumQueued >= NumSlots)
+		{
+			// Backlog full, wait for the consumer to free a slot
+			WaitFor(StepDuration > 0.f ? StepDuration : 0.001);
+			continue;
+		}
+
+		if (Simulation->IsBattleOver())
+		{
+			WaitFor(0.1);
+			continue;
+		}
+
+		const double Now = FPlatformTime::Seconds();
+		if (Now < NextStepTime)
+		{
+			WaitFor(NextStepTime - Now);
+			continue;
+		}
+
+		FPublishedBattleStep& Slot = Slots[Published % NumSlots];
+		Simulation->Step(Slot.Delta);
+		Slot.Units.CopyFrom(Simulation->GetUnits());
+		Slot.StepCount = Simulation->GetStepCount();
+		Slot.bBattleOver = Simulation->IsBattleOver();
+
+		NumPublished.store(Published + 1, std::memory_order_release);
+
+		NextStepTime += StepDuration;
+
+		// Further behind than the ring can absorb: drop the missed time rather than catching up in a burst
+		const double Lag = FPlatformTime::Seconds() - NextStepTime;
+		if (Lag > StepDuration * NumSlots)
+		{
+			NextStepTime = FPlatformTime::Seconds();
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Simulation/BattleBatchRunner.h"
+
+#include "Async/ParallelFor.h"
+#include "Simulation/BattleSimulation.h"
+
+FBattleSeedResult FBattleBatchRunner::PlayToCompletion(FBattleSimulation& Simulation, int32 Seed, int32 MaxSteps)
+{
+	Simulation.Reset(Seed);
+
+	FStepDelta StepDelta;
+	while (Simulation.GetStepCount() < MaxSteps && !Simulation.IsBattleOver())
+	{
+		Simulation.Step(StepDelta);
+	}
+
+	FBattleSeedResult Result;
+	Result.Seed = Seed;
+	Result.Steps = Simulation.GetStepCount();
+
+	const FSimUnitStore& Units = Simulation.GetUnits();
+	for (int32 Index = 0; Index < Units.Num(); ++Index)
+	{
+		(Units.Team[Index] == EBattleTeam::Red ? Result.RedAlive : Result.BlueAlive)++;
+		Result.SurvivorHP += Units.HP[Index];
+	}
+
+	if (!Simulation.IsBattleOver())
+	{
+		Result.Outcome = EBattleOutcome::Unfinished;
+	}
+	else if (Result.RedAlive > 0)
+	{
+		Result.Outcome = EBattleOutcome::RedWin;
+	}
+	else if (Result.BlueAlive > 0)
+	{
+		Result.Outcome = EBattleOutcome::BlueWin;
+	}
+	else
+	{
+		Result.Outcome = EBattleOutcome::Draw;
+	}
+
+	return Result;
+}
+
+void FBattleBatchRunner::Run(const FSimConfig& Config, int32 FirstSeed, int32 NumBattles, int32 MaxStepsPerBattle,
+                             FBattleBatchSummary& OutSummary, bool bSingleThreaded)
+{
+	OutSummary = FBattleBatchSummary();
+	NumBattles = FMath::Max(0, NumBattles);
+	OutSummary.Results.SetNum(NumBattles);
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	// Battles already keep every worker busy, planning inside a step in parallel as well would only add overhead
+	FSimConfig BattleConfig = Config;
+	BattleConfig.bParallelPlanning = false;
+
+	// One simulation per worker so grids and unit buffers are reused across that worker's battles.
+	// Each battle starts from Reset(Seed), so which worker plays it never affects the result.
+	TArray<FBattleSimulation> Simulations;
+	ParallelForWithTaskContext(TEXT("BattleBatchRunner"), Simulations, NumBattles,
+		[&BattleConfig](int32 /*ContextIndex*/, int32 /*NumContexts*/) { return FBattleSimulation(BattleConfig); },
+		[&OutSummary, FirstSeed, MaxStepsPerBattle](FBattleSimulation& Simulation, int32 BattleIndex)
+		{
+			OutSummary.Results[BattleIndex] = PlayToCompletion(Simulation, FirstSeed + BattleIndex, MaxStepsPerBattle);
+		},
+		bSingleThreaded ? EParallelForFlags::ForceSingleThread : EParallelForFlags::Unbalanced);
+
+	OutSummary.WallSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	if (NumBattles == 0)
+	{
+		return;
+	}
+
+	// Aggregate in seed order on the calling thread so the summary is identical for any thread count.
+	TArray<int32> SortedSteps;
+	SortedSteps.Reserve(NumBattles);
+
+	int64 TotalSteps = 0;
+	int64 WinnerHP = 0;
+	int64 WinnerSurvivors = 0;
+	int32 NumDecided = 0;
+	for (const FBattleSeedResult& Result : OutSummary.Results)
+	{
+		OutSummary.NumByOutcome[static_cast<int32>(Result.Outcome)]++;
+		SortedSteps.Add(Result.Steps);
+		TotalSteps += Result.Steps;
+
+		if (Result.Outcome == EBattleOutcome::RedWin || Result.Outcome == EBattleOutcome::BlueWin)
+		{
+			WinnerHP += Result.SurvivorHP;
+			WinnerSurvivors += Result.RedAlive + Result.BlueAlive;
+			++NumDecided;
+		}
+	}
+
+	SortedSteps.Sort();
+	OutSummary.MinSteps = SortedSteps[0];
+	OutSummary.MaxSteps = SortedSteps.Last();
+	OutSummary.MedianSteps = SortedSteps[NumBattles / 2];
+	OutSummary.P90Steps = SortedSteps[FMath::Min(NumBattles - 1, NumBattles * 9 / 10)];
+	OutSummary.MeanSteps = double(TotalSteps) / NumBattles;
+
+	if (NumDecided > 0)
+	{
+		OutSummary.MeanWinnerSurvivorHP = double(WinnerHP) / NumDecided;
+		OutSummary.MeanWinnerSurvivors = double(WinnerSurvivors) / NumDecided;
+	}
+}
+
+void FBattleBatchRunner::LogSummary(const FSimConfig& Config, const FBattleBatchSummary& Summary)
+{
+	const int32 NumBattles = Summary.Results.Num();
+
+	UE_LOG(LogTemp, Display, TEXT("Battle batch: %d battles from seed %d, grid=%dx%d units/team=%d, %.1fms wall"),
+	       NumBattles, NumBattles > 0 ? Summary.Results[0].Seed : 0, Config.GridSize.X, Config.GridSize.Y,
+	       Config.UnitsPerTeam, Summary.WallSeconds * 1000.0);
+	UE_LOG(LogTemp, Display, TEXT("Outcomes: red=%.1f%% blue=%.1f%% draw=%.1f%% unfinished=%.1f%%"),
+	       Summary.GetRate(EBattleOutcome::RedWin) * 100.0, Summary.GetRate(EBattleOutcome::BlueWin) * 100.0,
+	       Summary.GetRate(EBattleOutcome::Draw) * 100.0, Summary.GetRate(EBattleOutcome::Unfinished) * 100.0);
+	UE_LOG(LogTemp, Display, TEXT("Steps: min=%d median=%d p90=%d max=%d mean=%.1f"),
+	       Summary.MinSteps, Summary.MedianSteps, Summary.P90Steps, Summary.MaxSteps, Summary.MeanSteps);
+	UE_LOG(LogTemp, Display, TEXT("Winner survivors: units=%.2f hp=%.2f"),
+	       Summary.MeanWinnerSurvivors, Summary.MeanWinnerSurvivorHP);
+}
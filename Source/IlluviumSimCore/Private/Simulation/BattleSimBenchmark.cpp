@@ -0,0 +1,869 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Simulation/BattleSimBenchmark.h"
+
+#include "HAL/PlatformProcess.h"
+#include "Replay/BattleReplay.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+#include "Simulation/AsyncBattleRunner.h"
+#include "Simulation/BattleSimulation.h"
+#include "Templates/Function.h"
+
+namespace
+{
+	/**
+	 * Runs CheckSeed for NumSeeds seeds from FirstSeed and counts the seeds it failed. CheckSeed returns where the
+	 * seed went wrong, empty if it passed.
+	 */
+	int32 CountFailedSeeds(const TCHAR* CheckName, int32 FirstSeed, int32 NumSeeds, TFunctionRef<FString(int32 Seed)> CheckSeed)
+	{
+		int32 NumFailedSeeds = 0;
+		for (int32 Seed = FirstSeed; Seed < FirstSeed + NumSeeds; ++Seed)
+		{
+			const FString Failure = CheckSeed(Seed);
+			if (!Failure.IsEmpty())
+			{
+				UE_LOG(LogTemp, Error, TEXT("%s diverges: seed=%d %s"), CheckName, Seed, *Failure);
+				++NumFailedSeeds;
+			}
+		}
+		return NumFailedSeeds;
+	}
+
+	const TCHAR* GetDeterminismCheckName(EDeterminismCheck Check)
+	{
+		return Check == EDeterminismCheck::RepeatSeed ? TEXT("repeated seed")
+			: Check == EDeterminismCheck::SerialVsParallel ? TEXT("serial vs parallel")
+			: TEXT("replay vs live");
+	}
+
+	const TCHAR* GetPathCacheResultName(EPathCacheResult Result)
+	{
+		switch (Result)
+		{
+		case EPathCacheResult::Hit: return TEXT("hit");
+		case EPathCacheResult::Repaired: return TEXT("repaired");
+		case EPathCacheResult::Replanned: return TEXT("replanned");
+		case EPathCacheResult::Partial: return TEXT("partial");
+		default: return TEXT("no path");
+		}
+	}
+
+	/**
+	 * Plans every unit of Simulation towards its closest enemy twice, through FGridPathCache from the path it kept in
+	 * Snapshot and with a fresh search, both against the occupancy the step starts from.
+	 * @return the first unit whose two paths differ in length, empty if none.
+	 */
+	FString FindCachedPathMismatch(const FSimConfig& Config, const FBattleSimulation& Simulation,
+	                               const FBattleSimSnapshot& Snapshot)
+	{
+		const FSimUnitStore& Units = Simulation.GetUnits();
+		const int32 MaxCellsPerStep = FMath::Clamp(Config.MoveSquaresPerStep, 1, 8);
+		const bool bHasStaticObstacles = Config.StaticObstacles.IsValid() &&
+			Config.StaticObstacles->GetGridSize() == Config.GridSize;
+
+		FGridAStarContext& Context = FGridAStar::GetThreadContext();
+		FCachedGridPath CachedPath;
+		FCachedGridPath UpdatedPath;
+		TArray<FGridCoordinate> CachedCells;
+		TArray<FGridCoordinate> SearchedCells;
+
+		// Every living unit has an entry in Id order once the simulation has stepped with caching on
+		const uint8* PathData = Snapshot.PathData.IsEmpty() ? nullptr : Snapshot.PathData.GetData();
+		for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+		{
+			if (PathData)
+			{
+				PathData = CachedPath.Read(PathData);
+			}
+
+			const FGridCoordinate Cell = Units.GetCell(UnitIndex);
+			const int32 TargetUnitId = Simulation.GetSpatialIndex().FindClosestEnemy(Units.Team[UnitIndex], Cell);
+			if (TargetUnitId < 0) continue;
+
+			FPathRequest Request;
+			Request.Start = Cell;
+			Request.Goal = Units.GetCell(Units.FindIndex(TargetUnitId));
+			if (Manhattan(Request.Start, Request.Goal) <= Config.AttackRangeSquares) continue;
+
+			Request.GridSize = Config.GridSize;
+			Request.Occupancy = &Simulation.GetOccupancy();
+			Request.PassableOverrides.Add(Cell);
+			Request.SearchMode = Config.PathSearchMode;
+			if (bHasStaticObstacles)
+			{
+				Request.StaticObstacles = &Config.StaticObstacles->GetObstacles();
+				Request.Regions = Config.StaticObstacles.Get();
+			}
+			if (Config.MaxPathExpansions > 0)
+			{
+				Request.MaxExpansions = Config.MaxPathExpansions;
+				Request.bAllowPartialPath = true;
+			}
+
+			FGridCoordinate ReadMin, ReadMax;
+			const EPathCacheResult Result = FGridPathCache::FindPath(CachedPath, MaxCellsPerStep, Request, CachedCells,
+			                                                         UpdatedPath, Context, ReadMin, ReadMax);
+			const int32 NumCachedCells = Result == EPathCacheResult::NoPath ? 0 : CachedCells.Num();
+			const int32 NumSearchedCells = FGridAStar::FindPath(Request, SearchedCells, Context) ? SearchedCells.Num() : 0;
+			if (NumCachedCells != NumSearchedCells)
+			{
+				return FString::Printf(TEXT("unit=%d %s path of %d cells, search found %d"), Units.Ids[UnitIndex],
+				                       GetPathCacheResultName(Result), NumCachedCells, NumSearchedCells);
+			}
+		}
+		return FString();
+	}
+
+	/**
+	 * Checks Delta's moves against Before, the simulation as it was before the step. Every move must stay within
+	 * reach of a step and land on a free cell: open in Before or left by a unit that moved away or died, and taken by
+	 * no other move. LeftCells and LandedCells are scratch.
+	 * @return the first move that breaks this, empty if none.
+	 */
+	FString FindIllegalMove(const FSimConfig& Config, const FBattleSimulation& Before, const FStepDelta& Delta,
+	                        FGridOccupancy& LeftCells, FGridOccupancy& LandedCells)
+	{
+		const FSimUnitStore& Units = Before.GetUnits();
+		const int32 MaxCellsPerStep = FMath::Clamp(Config.MoveSquaresPerStep, 1, 8);
+		const FGridOccupancy* StaticObstacles = Config.StaticObstacles.IsValid() &&
+			Config.StaticObstacles->GetGridSize() == Config.GridSize ? &Config.StaticObstacles->GetObstacles() : nullptr;
+
+		LeftCells.Init(Config.GridSize);
+		LandedCells.Init(Config.GridSize);
+		for (const FSimMove& Move : Delta.Moves)
+		{
+			LeftCells.Set(Move.From);
+		}
+		for (const FSimEvent& Event : Delta.Events)
+		{
+			if (Event.EventType == EEventType::Die) LeftCells.Set(Units.GetCell(Units.FindIndex(Event.ActorId)));
+		}
+
+		for (const FSimMove& Move : Delta.Moves)
+		{
+			const TCHAR* Problem = nullptr;
+			if (!IsWithinGridBounds(Move.To, Config.GridSize))
+			{
+				Problem = TEXT("off the grid");
+			}
+			else if (Manhattan(Move.From, Move.To) < 1 || Manhattan(Move.From, Move.To) > MaxCellsPerStep)
+			{
+				Problem = TEXT("out of reach");
+			}
+			else if (StaticObstacles && StaticObstacles->IsSet(Move.To))
+			{
+				Problem = TEXT("onto an obstacle");
+			}
+			else if (Before.GetOccupancy().IsSet(Move.To) && !LeftCells.IsSet(Move.To))
+			{
+				Problem = TEXT("onto a unit that stayed");
+			}
+			else if (LandedCells.IsSet(Move.To))
+			{
+				Problem = TEXT("onto another move");
+			}
+
+			if (Problem)
+			{
+				return FString::Printf(TEXT("unit=%d moved (%d,%d)->(%d,%d) %s"), Move.ActorId, Move.From.X, Move.From.Y,
+				                       Move.To.X, Move.To.Y, Problem);
+			}
+			LandedCells.Set(Move.To);
+		}
+		return FString();
+	}
+
+	/**
+	 * Checks Delta's moves against Before, the simulation as it was before the step: units still waiting for a path
+	 * must keep walking the one they were handed. Counts their moves into InOutNumWaitingMoves.
+	 * @return the first such move off that path or further than a step along it, empty if none.
+	 */
+	FString FindMoveOffFollowedPath(const FSimConfig& Config, const FBattleSimulation& Before, const FStepDelta& Delta,
+	                                int64& InOutNumWaitingMoves)
+	{
+		const int32 MaxCellsPerStep = FMath::Clamp(Config.MoveSquaresPerStep, 1, 8);
+		for (const FSimMove& Move : Delta.Moves)
+		{
+			if (!Before.IsWaitingForPath(Move.ActorId)) continue;
+			++InOutNumWaitingMoves;
+
+			const TArrayView<const FGridCoordinate> Cells = Before.GetFollowedPath(Move.ActorId);
+			int32 FromIndex = INDEX_NONE;
+			int32 ToIndex = INDEX_NONE;
+			for (int32 CellIndex = 0; CellIndex < Cells.Num(); ++CellIndex)
+			{
+				if (FromIndex == INDEX_NONE && Cells[CellIndex] == Move.From) FromIndex = CellIndex;
+				else if (FromIndex != INDEX_NONE && Cells[CellIndex] == Move.To) ToIndex = CellIndex;
+			}
+
+			if (ToIndex == INDEX_NONE || ToIndex - FromIndex > MaxCellsPerStep)
+			{
+				return FString::Printf(TEXT("unit=%d waiting for a path moved (%d,%d)->(%d,%d) off the %d cells it follows"),
+				                       Move.ActorId, Move.From.X, Move.From.Y, Move.To.X, Move.To.Y, Cells.Num());
+			}
+		}
+		return FString();
+	}
+}
+
+void FBattleSimBenchmark::PlayBattle(const FSimConfig& Config, int32 MaxSteps, FBattleRunSummary& OutSummary)
+{
+	FBattleSimulation Simulation(Config);
+	Simulation.Reset(Config.Seed);
+
+	while (OutSummary.Deltas.Num() < MaxSteps && !Simulation.IsBattleOver())
+	{
+		const double StepStart = FPlatformTime::Seconds();
+		Simulation.Step(OutSummary.Deltas.AddDefaulted_GetRef());
+		const double StepSeconds = FPlatformTime::Seconds() - StepStart;
+
+		OutSummary.TotalSeconds += StepSeconds;
+		OutSummary.WorstStepSeconds = FMath::Max(OutSummary.WorstStepSeconds, StepSeconds);
+	}
+
+	OutSummary.RedAlive = Simulation.GetSpatialIndex().GetNumUnits(EBattleTeam::Red);
+	OutSummary.BlueAlive = Simulation.GetSpatialIndex().GetNumUnits(EBattleTeam::Blue);
+}
+
+FPlannerComparison FBattleSimBenchmark::CompareMovementPlanners(const FSimConfig& Config, int32 MaxSteps)
+{
+	FPlannerComparison Comparison;
+
+	FSimConfig PlannerConfig = Config;
+	PlannerConfig.MovementPlanner = EMovementPlanner::AStar;
+	PlayBattle(PlannerConfig, MaxSteps, Comparison.AStar);
+	PlannerConfig.MovementPlanner = EMovementPlanner::FlowField;
+	PlayBattle(PlannerConfig, MaxSteps, Comparison.FlowField);
+
+	const TArray<FStepDelta>& AStarDeltas = Comparison.AStar.Deltas;
+	const TArray<FStepDelta>& FlowFieldDeltas = Comparison.FlowField.Deltas;
+
+	const int32 CommonSteps = FMath::Min(AStarDeltas.Num(), FlowFieldDeltas.Num());
+	for (int32 StepIndex = 0; StepIndex < CommonSteps; ++StepIndex)
+	{
+		if (!(AStarDeltas[StepIndex] == FlowFieldDeltas[StepIndex]))
+		{
+			Comparison.FirstDivergentStep = StepIndex;
+			break;
+		}
+	}
+	if (Comparison.FirstDivergentStep == INDEX_NONE && AStarDeltas.Num() != FlowFieldDeltas.Num())
+	{
+		Comparison.FirstDivergentStep = CommonSteps;
+	}
+
+	return Comparison;
+}
+
+void FBattleSimBenchmark::LogPlannerComparison(const FSimConfig& Config, const FPlannerComparison& Comparison)
+{
+	auto LogRun = [](const TCHAR* Name, const FBattleRunSummary& Run)
+	{
+		const int32 Steps = Run.Deltas.Num();
+		UE_LOG(LogTemp, Display, TEXT("%s: steps=%d avg=%.3fms worst=%.3fms total=%.1fms alive red=%d blue=%d"),
+		       Name, Steps, Steps > 0 ? Run.TotalSeconds * 1000.0 / Steps : 0.0, Run.WorstStepSeconds * 1000.0,
+		       Run.TotalSeconds * 1000.0, Run.RedAlive, Run.BlueAlive);
+	};
+
+	UE_LOG(LogTemp, Display, TEXT("Planner benchmark: seed=%d grid=%dx%d units/team=%d"),
+	       Config.Seed, Config.GridSize.X, Config.GridSize.Y, Config.UnitsPerTeam);
+	LogRun(TEXT("AStar"), Comparison.AStar);
+	LogRun(TEXT("FlowField"), Comparison.FlowField);
+	if (Comparison.FirstDivergentStep == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Planners produced identical step deltas"));
+	}
+	else
+	{
+		UE_LOG(LogTemp, Display, TEXT("Planners diverge at step %d"), Comparison.FirstDivergentStep);
+	}
+}
+
+int32 FBattleSimBenchmark::VerifyParallelPlanning(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+{
+	FSimConfig SerialConfig = Config;
+	SerialConfig.bParallelPlanning = false;
+	FSimConfig ParallelConfig = Config;
+	ParallelConfig.bParallelPlanning = true;
+	ParallelConfig.ParallelPlanningMinUnits = 0;
+
+	FBattleSimulation SerialSimulation(SerialConfig);
+	FBattleSimulation ParallelSimulation(ParallelConfig);
+	FStepDelta SerialDelta;
+	FStepDelta ParallelDelta;
+
+	int64 NumStepsCompared = 0;
+	const int32 NumMismatchedSeeds = CountFailedSeeds(TEXT("Parallel planning"), FirstSeed, NumSeeds, [&](int32 Seed)
+	{
+		SerialSimulation.Reset(Seed);
+		ParallelSimulation.Reset(Seed);
+
+		while (SerialSimulation.GetStepCount() < MaxSteps && !SerialSimulation.IsBattleOver())
+		{
+			SerialSimulation.Step(SerialDelta);
+			ParallelSimulation.Step(ParallelDelta);
+			++NumStepsCompared;
+
+			if (!(SerialDelta == ParallelDelta))
+			{
+				return FString::Printf(TEXT("step=%d"), SerialSimulation.GetStepCount() - 1);
+			}
+		}
+		return FString();
+	});
+
+	UE_LOG(LogTemp, Display, TEXT("Parallel planning check: %d/%d seeds differ over %lld steps"),
+	       NumMismatchedSeeds, NumSeeds, NumStepsCompared);
+	return NumMismatchedSeeds;
+}
+
+int32 FBattleSimBenchmark::VerifyAsyncStepping(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+{
+	FBattleSimulation SyncSimulation(Config);
+	FBattleSimulation AsyncSimulation(Config);
+	FAsyncBattleRunner Runner;
+	FStepDelta SyncDelta;
+
+	int64 NumStepsCompared = 0;
+	const int32 NumMismatchedSeeds = CountFailedSeeds(TEXT("Async stepping"), FirstSeed, NumSeeds, [&](int32 Seed)
+	{
+		SyncSimulation.Reset(Seed);
+		AsyncSimulation.Reset(Seed);
+		Runner.Start(AsyncSimulation, /*StepDurationSeconds*/ 0.f, /*MaxQueuedSteps*/ 4);
+
+		FString Failure;
+		while (Failure.IsEmpty() && SyncSimulation.GetStepCount() < MaxSteps && !SyncSimulation.IsBattleOver())
+		{
+			const FPublishedBattleStep* Published = Runner.PeekStep();
+			if (!Published)
+			{
+				FPlatformProcess::YieldThread();
+				continue;
+			}
+
+			SyncSimulation.Step(SyncDelta);
+			++NumStepsCompared;
+
+			const TCHAR* Mismatch = !(Published->Delta == SyncDelta) ? TEXT("delta")
+				: Published->StepCount != SyncSimulation.GetStepCount() ? TEXT("StepCount")
+				: Published->bBattleOver != SyncSimulation.IsBattleOver() ? TEXT("bBattleOver")
+				: Published->Units.FindMismatchedColumn(SyncSimulation.GetUnits());
+			Runner.PopStep();
+
+			if (Mismatch)
+			{
+				Failure = FString::Printf(TEXT("step=%d %s"), SyncSimulation.GetStepCount() - 1, Mismatch);
+			}
+		}
+
+		Runner.Shutdown();
+		return Failure;
+	});
+
+	UE_LOG(LogTemp, Display, TEXT("Async stepping check: %d/%d seeds differ over %lld steps"),
+	       NumMismatchedSeeds, NumSeeds, NumStepsCompared);
+	return NumMismatchedSeeds;
+}
+
+int32 FBattleSimBenchmark::VerifyReplay(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps,
+                                       int32 KeyframeInterval)
+{
+	auto UnitsMatch = [](const FSimUnitStore& A, const FSimUnitStore& B)
+	{
+		return A.Ids == B.Ids && A.Team == B.Team && A.HP == B.HP && A.AttackCooldown == B.AttackCooldown &&
+			A.CellX == B.CellX && A.CellY == B.CellY;
+	};
+
+	FBattleSimulation Simulation(Config);
+	FBattleReplayWriter Writer;
+	FBattleReplayPlayer Player;
+	FStepDelta PlayedDelta;
+
+	// Snapshots of the recorded battle to compare seeks against
+	TArray<FStepDelta> RecordedDeltas;
+	TArray<FSimUnitStore> RecordedUnits;
+
+	int64 NumSteps = 0;
+	int64 NumReplayBytes = 0;
+	int64 NumNaiveBytes = 0;
+	const int32 NumMismatchedSeeds = CountFailedSeeds(TEXT("Replay"), FirstSeed, NumSeeds, [&](int32 Seed)
+	{
+		Simulation.Reset(Seed);
+		Writer.Begin(Config, Seed, Simulation.GetUnits(), KeyframeInterval);
+
+		RecordedDeltas.Reset();
+		RecordedUnits.Reset();
+		RecordedUnits.AddDefaulted_GetRef().CopyFrom(Simulation.GetUnits());
+		while (Simulation.GetStepCount() < MaxSteps && !Simulation.IsBattleOver())
+		{
+			FStepDelta& StepDelta = RecordedDeltas.AddDefaulted_GetRef();
+			Simulation.Step(StepDelta);
+			Writer.AppendStep(StepDelta, Simulation.GetUnits());
+			RecordedUnits.AddDefaulted_GetRef().CopyFrom(Simulation.GetUnits());
+
+			NumNaiveBytes += StepDelta.Moves.Num() * sizeof(FSimMove) + StepDelta.Events.Num() * sizeof(FSimEvent);
+		}
+
+		TArray<uint8> Bytes = Writer.Finish();
+		NumReplayBytes += Bytes.Num();
+		NumSteps += RecordedDeltas.Num();
+
+		if (!Player.OpenMemory(MoveTemp(Bytes)) || Player.GetNumSteps() != RecordedDeltas.Num())
+		{
+			return FString(TEXT("open"));
+		}
+		for (int32 StepIndex = 0; StepIndex < RecordedDeltas.Num(); ++StepIndex)
+		{
+			if (!Player.ReadNextStep(PlayedDelta) || !(PlayedDelta == RecordedDeltas[StepIndex]) ||
+				!UnitsMatch(Player.GetUnits(), RecordedUnits[StepIndex + 1]))
+			{
+				return FString::Printf(TEXT("playback step=%d"), StepIndex);
+			}
+		}
+
+		// Backwards, onto keyframes, between them and past the end
+		const int32 LastStep = RecordedDeltas.Num();
+		const int32 SeekSteps[] = { LastStep / 2, 0, KeyframeInterval, KeyframeInterval + 1, LastStep - 1, LastStep, LastStep + 5 };
+		for (const int32 SeekStep : SeekSteps)
+		{
+			const int32 ExpectedStep = FMath::Clamp(SeekStep, 0, LastStep);
+			if (!Player.SeekToStep(SeekStep) || Player.GetCurrentStep() != ExpectedStep ||
+				!UnitsMatch(Player.GetUnits(), RecordedUnits[ExpectedStep]))
+			{
+				return FString::Printf(TEXT("seek step=%d"), SeekStep);
+			}
+		}
+		return FString();
+	});
+
+	UE_LOG(LogTemp, Display, TEXT("Replay check: %d/%d seeds differ over %lld steps, %.1f bytes per step (%.1f as raw deltas)"),
+	       NumMismatchedSeeds, NumSeeds, NumSteps, NumSteps ? double(NumReplayBytes) / NumSteps : 0.0,
+	       NumSteps ? double(NumNaiveBytes) / NumSteps : 0.0);
+	return NumMismatchedSeeds;
+}
+
+int32 FBattleSimBenchmark::VerifySnapshots(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+{
+	FBattleSimulation Simulation(Config);
+	FBattleSimSnapshot Snapshot;
+	TArray<FStepDelta> RecordedDeltas;
+	FStepDelta StepDelta;
+
+	// Steps the simulation from the snapshot and compares against the recorded tail of the battle
+	auto ContinuesIdentically = [&](FBattleSimulation& Continued)
+	{
+		for (int32 StepIndex = Snapshot.StepCount; StepIndex < RecordedDeltas.Num(); ++StepIndex)
+		{
+			if (Continued.IsBattleOver()) return false;
+
+			Continued.Step(StepDelta);
+			if (!(StepDelta == RecordedDeltas[StepIndex])) return false;
+		}
+		return Continued.GetStepCount() == RecordedDeltas.Num();
+	};
+
+	const int32 NumMismatchedSeeds = CountFailedSeeds(TEXT("Snapshot restore"), FirstSeed, NumSeeds, [&](int32 Seed)
+	{
+		Simulation.Reset(Seed);
+		RecordedDeltas.Reset();
+		while (RecordedDeltas.Num() < MaxSteps && !Simulation.IsBattleOver())
+		{
+			if (RecordedDeltas.Num() == MaxSteps / 3)
+			{
+				Simulation.SaveSnapshot(Snapshot);
+			}
+			Simulation.Step(RecordedDeltas.AddDefaulted_GetRef());
+		}
+
+		// Battles that end before the snapshot step are checked from their start
+		if (RecordedDeltas.Num() <= MaxSteps / 3)
+		{
+			FBattleSimulation Restarted(Config);
+			Restarted.Reset(Seed);
+			Restarted.SaveSnapshot(Snapshot);
+		}
+
+		FBattleSimulation Fork(Config);
+		Fork.RestoreSnapshot(Snapshot);
+		const bool bForkMatches = ContinuesIdentically(Fork);
+
+		Simulation.RestoreSnapshot(Snapshot);
+		const bool bRewindMatches = ContinuesIdentically(Simulation);
+
+		if (!bForkMatches || !bRewindMatches)
+		{
+			return FString::Printf(TEXT("step=%d fork=%d rewind=%d"), Snapshot.StepCount, bForkMatches, bRewindMatches);
+		}
+		return FString();
+	});
+
+	UE_LOG(LogTemp, Display, TEXT("Snapshot check: %d/%d seeds differ, last snapshot held %d units in %d bytes"),
+	       NumMismatchedSeeds, NumSeeds, Snapshot.NumUnits, Snapshot.UnitData.Num());
+	return NumMismatchedSeeds;
+}
+
+FDivergenceReport FBattleSimBenchmark::FindFirstDivergence(const FSimConfig& Config, EDeterminismCheck Check,
+                                                           int32 Seed, int32 MaxSteps)
+{
+	FDivergenceReport Report;
+
+	FSimConfig ReferenceConfig = Config;
+	FSimConfig OtherConfig = Config;
+	if (Check == EDeterminismCheck::SerialVsParallel)
+	{
+		ReferenceConfig.bParallelPlanning = false;
+		OtherConfig.bParallelPlanning = true;
+		OtherConfig.ParallelPlanningMinUnits = 0;
+	}
+
+	auto CheckHashDrift = [&Report](const FBattleSimulation& Simulation)
+	{
+		if (Report.FirstHashDriftStep == INDEX_NONE && Simulation.GetStateHash() != Simulation.GetUnits().ComputeStateHash())
+		{
+			Report.FirstHashDriftStep = Simulation.GetStepCount() - 1;
+		}
+	};
+
+	// The reference runs to completion first, so the second run cannot share any state with it mid-battle
+	TArray<FStepDelta> ReferenceDeltas;
+	FBattleReplayWriter ReplayWriter;
+	{
+		FBattleSimulation Reference(ReferenceConfig);
+		Reference.Reset(Seed);
+		if (Check == EDeterminismCheck::ReplayVsLive)
+		{
+			ReplayWriter.Begin(ReferenceConfig, Seed, Reference.GetUnits());
+		}
+
+		while (ReferenceDeltas.Num() < MaxSteps && !Reference.IsBattleOver())
+		{
+			FStepDelta& StepDelta = ReferenceDeltas.AddDefaulted_GetRef();
+			Reference.Step(StepDelta);
+			CheckHashDrift(Reference);
+			if (ReplayWriter.IsRecording())
+			{
+				ReplayWriter.AppendStep(StepDelta, Reference.GetUnits());
+			}
+		}
+	}
+
+	FBattleSimulation Other(OtherConfig);
+	FBattleReplayPlayer ReplayPlayer;
+	if (Check == EDeterminismCheck::ReplayVsLive)
+	{
+		TArray<uint8> ReplayBytes = ReplayWriter.Finish();
+		ReplayPlayer.OpenMemory(MoveTemp(ReplayBytes));
+	}
+	else
+	{
+		Other.Reset(Seed);
+	}
+
+	FStepDelta OtherDelta;
+	for (const FStepDelta& ReferenceDelta : ReferenceDeltas)
+	{
+		if (Check == EDeterminismCheck::ReplayVsLive)
+		{
+			if (!ReplayPlayer.ReadNextStep(OtherDelta)) break;
+		}
+		else
+		{
+			if (Other.IsBattleOver()) break;
+			Other.Step(OtherDelta);
+			CheckHashDrift(Other);
+		}
+
+		if (!(OtherDelta == ReferenceDelta))
+		{
+			Report.FirstDivergentStep = Report.StepsCompared;
+			Report.ReferenceHash = ReferenceDelta.StateHash;
+			Report.OtherHash = OtherDelta.StateHash;
+			Report.bMovesDiffer = !(OtherDelta.Moves == ReferenceDelta.Moves);
+			Report.bEventsDiffer = !(OtherDelta.Events == ReferenceDelta.Events);
+			return Report;
+		}
+		++Report.StepsCompared;
+	}
+
+	// One run ended early
+	if (Report.StepsCompared != ReferenceDeltas.Num())
+	{
+		Report.FirstDivergentStep = Report.StepsCompared;
+	}
+	return Report;
+}
+
+void FBattleSimBenchmark::LogDivergenceReport(EDeterminismCheck Check, int32 Seed, const FDivergenceReport& Report)
+{
+	const TCHAR* CheckName = GetDeterminismCheckName(Check);
+
+	if (Report.FirstHashDriftStep != INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Maintained state hash drifted from a full recompute at step %d"), Report.FirstHashDriftStep);
+	}
+
+	if (Report.FirstDivergentStep == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Determinism check (%s, seed %d): identical over %d steps"),
+		       CheckName, Seed, Report.StepsCompared);
+		return;
+	}
+
+	UE_LOG(LogTemp, Error, TEXT("Determinism check (%s, seed %d): diverges at step %d, hash %016llx vs %016llx, moves %s, events %s"),
+	       CheckName, Seed, Report.FirstDivergentStep, Report.ReferenceHash, Report.OtherHash,
+	       Report.bMovesDiffer ? TEXT("differ") : TEXT("match"), Report.bEventsDiffer ? TEXT("differ") : TEXT("match"));
+}
+
+int32 FBattleSimBenchmark::VerifyDeterminism(const FSimConfig& Config, EDeterminismCheck Check, int32 FirstSeed,
+                                            int32 NumSeeds, int32 MaxSteps)
+{
+	const TCHAR* CheckName = GetDeterminismCheckName(Check);
+
+	int64 NumStepsCompared = 0;
+	const int32 NumMismatchedSeeds = CountFailedSeeds(TEXT("Determinism check"), FirstSeed, NumSeeds, [&](int32 Seed)
+	{
+		const FDivergenceReport Report = FindFirstDivergence(Config, Check, Seed, MaxSteps);
+		NumStepsCompared += Report.StepsCompared;
+		if (Report.FirstDivergentStep == INDEX_NONE && Report.FirstHashDriftStep == INDEX_NONE)
+		{
+			return FString();
+		}
+
+		LogDivergenceReport(Check, Seed, Report);
+		return FString::Printf(TEXT("(%s) step=%d hash drift step=%d"), CheckName, Report.FirstDivergentStep,
+		                       Report.FirstHashDriftStep);
+	});
+
+	UE_LOG(LogTemp, Display, TEXT("Determinism check (%s): %d/%d seeds differ over %lld steps"),
+	       CheckName, NumMismatchedSeeds, NumSeeds, NumStepsCompared);
+	return NumMismatchedSeeds;
+}
+
+int32 FBattleSimBenchmark::VerifyNetSerialization(const FSimConfig& Config, int32 MaxSteps)
+{
+	FBitWriter Writer(0, /*bAllowResize*/ true);
+	FStepDelta StepDelta;
+	FStepDelta DecodedDelta;
+
+	int32 NumMismatchedSteps = 0;
+	for (const int32 NumUnits : { 100, 1000, 10000 })
+	{
+		FSimConfig SizedConfig = Config;
+		SizedConfig.UnitsPerTeam = NumUnits / 2;
+		const int32 GridExtent = FMath::CeilToInt(FMath::Sqrt(4.f * NumUnits));
+		SizedConfig.GridSize = FIntPoint(GridExtent, GridExtent);
+
+		FBattleSimulation Simulation(SizedConfig);
+		Simulation.Reset(Config.Seed);
+
+		int64 NumBits = 0;
+		int64 NumPlainBytes = 0;
+		int64 NumMovesAndEvents = 0;
+		int32 NumSteps = 0;
+		while (NumSteps < MaxSteps && !Simulation.IsBattleOver())
+		{
+			Simulation.Step(StepDelta);
+			++NumSteps;
+
+			bool bWritten = false;
+			Writer.Reset();
+			StepDelta.NetSerialize(Writer, nullptr, bWritten);
+
+			bool bRead = false;
+			FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+			DecodedDelta.NetSerialize(Reader, nullptr, bRead);
+
+			if (!bWritten || !bRead || !(DecodedDelta == StepDelta) || DecodedDelta.GridSize != StepDelta.GridSize)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Step delta does not survive NetSerialize: units=%d step=%d"), NumUnits, NumSteps - 1);
+				++NumMismatchedSteps;
+			}
+
+			// Moves as five int32 fields, events as a byte and two int32s, plus the counts and the hash
+			NumBits += Writer.GetNumBits();
+			NumPlainBytes += StepDelta.Moves.Num() * 20 + StepDelta.Events.Num() * 9 + 16;
+			NumMovesAndEvents += StepDelta.Moves.Num() + StepDelta.Events.Num();
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("NetSerialize %d units on %dx%d: %.1f bytes per step over %d steps (%.1f as plain fields), %.2f bytes per move or event"),
+		       NumUnits, GridExtent, GridExtent, NumSteps ? NumBits / 8.0 / NumSteps : 0.0, NumSteps,
+		       NumSteps ? double(NumPlainBytes) / NumSteps : 0.0, NumMovesAndEvents ? NumBits / 8.0 / NumMovesAndEvents : 0.0);
+	}
+
+	return NumMismatchedSteps;
+}
+
+int32 FBattleSimBenchmark::VerifyPathCache(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+{
+	FSimConfig CachedConfig = Config;
+	CachedConfig.MovementPlanner = EMovementPlanner::AStar;
+	CachedConfig.bCachePaths = true;
+	FSimConfig UncachedConfig = CachedConfig;
+	UncachedConfig.bCachePaths = false;
+
+	FBattleSimulation Simulation(CachedConfig);
+	FBattleSimulation Uncached(UncachedConfig);
+	FBattleSimSnapshot Snapshot;
+	FStepDelta CachedDelta;
+	FStepDelta UncachedDelta;
+	FGridOccupancy LeftCells;
+	FGridOccupancy LandedCells;
+
+	int32 NumStepsCompared = 0;
+	double CachedSeconds = 0.0;
+	double UncachedSeconds = 0.0;
+	FPathCacheStats TotalStats;
+	int32 NumMismatchedSeeds = CountFailedSeeds(TEXT("Path cache"), FirstSeed, NumSeeds, [&](int32 Seed)
+	{
+		Simulation.Reset(Seed);
+
+		FString Failure;
+		int32 Step = 0;
+		while (Failure.IsEmpty() && Simulation.GetStepCount() < MaxSteps && !Simulation.IsBattleOver())
+		{
+			Step = Simulation.GetStepCount();
+			Simulation.SaveSnapshot(Snapshot);
+			Uncached.RestoreSnapshot(Snapshot);
+
+			Failure = FindCachedPathMismatch(CachedConfig, Uncached, Snapshot);
+			if (!Failure.IsEmpty()) break;
+
+			const double CachedStartTime = FPlatformTime::Seconds();
+			Simulation.Step(CachedDelta);
+			CachedSeconds += FPlatformTime::Seconds() - CachedStartTime;
+
+			Failure = FindIllegalMove(CachedConfig, Uncached, CachedDelta, LeftCells, LandedCells);
+			if (!Failure.IsEmpty()) break;
+
+			const double UncachedStartTime = FPlatformTime::Seconds();
+			Uncached.Step(UncachedDelta);
+			UncachedSeconds += FPlatformTime::Seconds() - UncachedStartTime;
+			++NumStepsCompared;
+
+			// Moves only land at the end of a step, so which cells a path took cannot change who attacks whom
+			if (CachedDelta.Events != UncachedDelta.Events)
+			{
+				Failure = TEXT("events");
+			}
+		}
+
+		if (!Failure.IsEmpty())
+		{
+			Failure = FString::Printf(TEXT("step=%d %s"), Step, *Failure);
+		}
+
+		const FPathCacheStats& Stats = Simulation.GetPathCacheStats();
+		TotalStats.Hits += Stats.Hits;
+		TotalStats.Repairs += Stats.Repairs;
+		TotalStats.Replans += Stats.Replans;
+		return Failure;
+	});
+
+	NumMismatchedSeeds += VerifyParallelPlanning(CachedConfig, FirstSeed, NumSeeds, MaxSteps);
+	NumMismatchedSeeds += VerifySnapshots(CachedConfig, FirstSeed, NumSeeds, MaxSteps);
+
+	const int64 NumPlans = TotalStats.Hits + TotalStats.Repairs + TotalStats.Replans;
+	UE_LOG(LogTemp, Display, TEXT("Path cache check: %d/%d seeds failed, hits=%lld (%.1f%%) repairs=%lld (%.1f%%) replans=%lld (%.1f%%)"),
+	       NumMismatchedSeeds, NumSeeds,
+	       TotalStats.Hits, NumPlans ? 100.0 * TotalStats.Hits / NumPlans : 0.0,
+	       TotalStats.Repairs, NumPlans ? 100.0 * TotalStats.Repairs / NumPlans : 0.0,
+	       TotalStats.Replans, NumPlans ? 100.0 * TotalStats.Replans / NumPlans : 0.0);
+	UE_LOG(LogTemp, Display, TEXT("Path cache timing over %d steps, each from the same state: cached %.3fms/step, uncached %.3fms/step"),
+	       NumStepsCompared, NumStepsCompared ? CachedSeconds * 1000.0 / NumStepsCompared : 0.0,
+	       NumStepsCompared ? UncachedSeconds * 1000.0 / NumStepsCompared : 0.0);
+	return NumMismatchedSeeds;
+}
+
+int32 FBattleSimBenchmark::VerifyPathScheduling(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+{
+	FSimConfig ScheduledConfig = Config;
+	ScheduledConfig.MovementPlanner = EMovementPlanner::AStar;
+	ScheduledConfig.bSchedulePaths = true;
+	FSimConfig UnscheduledConfig = ScheduledConfig;
+	UnscheduledConfig.bSchedulePaths = false;
+
+	FBattleSimulation Simulation(ScheduledConfig);
+	FBattleSimulation Unscheduled(UnscheduledConfig);
+	FBattleSimSnapshot Snapshot;
+	FStepDelta ScheduledDelta;
+	FStepDelta UnscheduledDelta;
+	FGridOccupancy LeftCells;
+	FGridOccupancy LandedCells;
+
+	int32 NumStepsCompared = 0;
+	int64 NumWaitingMoves = 0;
+	double ScheduledSeconds = 0.0;
+	double UnscheduledSeconds = 0.0;
+	double MaxScheduledSeconds = 0.0;
+	FPathSchedulerStats TotalStats;
+	int32 NumMismatchedSeeds = CountFailedSeeds(TEXT("Path scheduling"), FirstSeed, NumSeeds, [&](int32 Seed)
+	{
+		Simulation.Reset(Seed);
+
+		FString Failure;
+		int32 Step = 0;
+		while (Failure.IsEmpty() && Simulation.GetStepCount() < MaxSteps && !Simulation.IsBattleOver())
+		{
+			// Restoring brings the queue and the followed paths along, even though Unscheduled never uses them
+			Step = Simulation.GetStepCount();
+			Simulation.SaveSnapshot(Snapshot);
+			Unscheduled.RestoreSnapshot(Snapshot);
+
+			const double ScheduledStartTime = FPlatformTime::Seconds();
+			Simulation.Step(ScheduledDelta);
+			const double StepSeconds = FPlatformTime::Seconds() - ScheduledStartTime;
+			ScheduledSeconds += StepSeconds;
+			MaxScheduledSeconds = FMath::Max(MaxScheduledSeconds, StepSeconds);
+
+			Failure = FindIllegalMove(ScheduledConfig, Unscheduled, ScheduledDelta, LeftCells, LandedCells);
+			if (!Failure.IsEmpty()) break;
+
+			Failure = FindMoveOffFollowedPath(ScheduledConfig, Unscheduled, ScheduledDelta, NumWaitingMoves);
+			if (!Failure.IsEmpty()) break;
+
+			const double UnscheduledStartTime = FPlatformTime::Seconds();
+			Unscheduled.Step(UnscheduledDelta);
+			UnscheduledSeconds += FPlatformTime::Seconds() - UnscheduledStartTime;
+			++NumStepsCompared;
+
+			// Scheduled paths may arrive later and pick other cells, but moves only land at the end of a step
+			if (ScheduledDelta.Events != UnscheduledDelta.Events)
+			{
+				Failure = TEXT("events");
+			}
+		}
+
+		if (!Failure.IsEmpty())
+		{
+			Failure = FString::Printf(TEXT("step=%d %s"), Step, *Failure);
+		}
+
+		const FPathSchedulerStats& Stats = Simulation.GetPathSchedulerStats();
+		TotalStats.Requests += Stats.Requests;
+		TotalStats.Coalesced += Stats.Coalesced;
+		TotalStats.Searches += Stats.Searches;
+		TotalStats.PartialSearches += Stats.PartialSearches;
+		TotalStats.RequestersServed += Stats.RequestersServed;
+		TotalStats.TotalLatencyFrames += Stats.TotalLatencyFrames;
+		TotalStats.MaxLatencyFrames = FMath::Max(TotalStats.MaxLatencyFrames, Stats.MaxLatencyFrames);
+		TotalStats.PeakQueueDepth = FMath::Max(TotalStats.PeakQueueDepth, Stats.PeakQueueDepth);
+		return Failure;
+	});
+
+	// A wall-clock budget serves a different number of requests on every run
+	ScheduledConfig.PathBudgetMicroseconds = 0;
+	NumMismatchedSeeds += VerifyParallelPlanning(ScheduledConfig, FirstSeed, NumSeeds, MaxSteps);
+	NumMismatchedSeeds += VerifySnapshots(ScheduledConfig, FirstSeed, NumSeeds, MaxSteps);
+
+	UE_LOG(LogTemp, Display, TEXT("Path scheduling check: %d/%d seeds failed, requests=%lld coalesced=%lld searches=%lld (%lld partial), latency mean %.2f max %d steps, peak queue %d, %lld moves while waiting"),
+	       NumMismatchedSeeds, NumSeeds, TotalStats.Requests, TotalStats.Coalesced, TotalStats.Searches,
+	       TotalStats.PartialSearches, TotalStats.GetMeanLatencyFrames(), TotalStats.MaxLatencyFrames,
+	       TotalStats.PeakQueueDepth, NumWaitingMoves);
+	UE_LOG(LogTemp, Display, TEXT("Path scheduling timing over %d steps, each from the same state: scheduled %.3fms/step (max %.3fms), unscheduled %.3fms/step"),
+	       NumStepsCompared, NumStepsCompared ? ScheduledSeconds * 1000.0 / NumStepsCompared : 0.0,
+	       MaxScheduledSeconds * 1000.0, NumStepsCompared ? UnscheduledSeconds * 1000.0 / NumStepsCompared : 0.0);
+	return NumMismatchedSeeds;
+}
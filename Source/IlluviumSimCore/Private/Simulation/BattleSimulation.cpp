@@ -0,0 +1,770 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Simulation/BattleSimulation.h"
+
+#include "Async/ParallelFor.h"
+#include "GridBattleStats.h"
+#include "Navigation/GridAStar.h"
+
+DECLARE_CYCLE_STAT(TEXT("Simulation Step"), STAT_GridBattle_Step, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("Find Closest Enemy"), STAT_GridBattle_FindClosestEnemy, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("Build Flow Fields"), STAT_GridBattle_BuildFlowFields, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("Plan Units (Parallel)"), STAT_GridBattle_PlanUnits, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("Resolve Units"), STAT_GridBattle_ResolveUnits, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Plans Redone"), STAT_GridBattle_PlansRedone, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Cache Hits"), STAT_GridBattle_PathCacheHits, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Cache Repairs"), STAT_GridBattle_PathCacheRepairs, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path Cache Replans"), STAT_GridBattle_PathCacheReplans, STATGROUP_GridBattle);
+
+namespace
+{
+	void WriteBytes(TArray<uint8>& Out, const void* Source, int32 NumBytes)
+	{
+		const int32 Offset = Out.AddUninitialized(NumBytes);
+		FMemory::Memcpy(Out.GetData() + Offset, Source, NumBytes);
+	}
+
+	void ReadBytes(const uint8*& Data, void* Destination, int32 NumBytes)
+	{
+		FMemory::Memcpy(Destination, Data, NumBytes);
+		Data += NumBytes;
+	}
+}
+
+FBattleSimulation::FBattleSimulation(const FSimConfig& InConfig)
+	: Config(InConfig)
+{
+}
+
+void FBattleSimulation::Reset(int32 Seed)
+{
+	RandomStream.Initialize(Seed);
+	Units.Reset();
+	NextUnitId = 1;
+	StepCount = 0;
+	StateHash = 0;
+	CachedPaths.Reset();
+	PathCacheStats = FPathCacheStats();
+	FollowedPaths.Reset();
+	PathScheduler.Reset(Config.GridSize.X);
+	UpdateStaticObstacles();
+
+	Occupancy.Init(Config.GridSize);
+	SpatialIndex.Init(Config.GridSize);
+
+	SpawnInitialTeams();
+}
+
+void FBattleSimulation::SaveSnapshot(FBattleSimSnapshot& OutSnapshot) const
+{
+	OutSnapshot.GridSize = Config.GridSize;
+	OutSnapshot.StepCount = StepCount;
+	OutSnapshot.NextUnitId = NextUnitId;
+	OutSnapshot.RandomSeed = RandomStream.GetCurrentSeed();
+	OutSnapshot.NumUnits = Units.Num();
+
+	OutSnapshot.UnitData.Reset();
+	Units.WriteColumns(OutSnapshot.UnitData);
+
+	OutSnapshot.PathData.Reset();
+	if (!CachedPaths.IsEmpty())
+	{
+		for (const int32 UnitId : Units.Ids)
+		{
+			CachedPaths[UnitId].Write(OutSnapshot.PathData);
+		}
+	}
+
+	OutSnapshot.ScheduleData.Reset();
+	if (!FollowedPaths.IsEmpty())
+	{
+		PathScheduler.Write(OutSnapshot.ScheduleData);
+		for (const int32 UnitId : Units.Ids)
+		{
+			const FFollowedPath& Followed = FollowedPaths[UnitId];
+			const int32 NumCells = Followed.Cells.Num();
+			WriteBytes(OutSnapshot.ScheduleData, &Followed.Progress, sizeof(Followed.Progress));
+			WriteBytes(OutSnapshot.ScheduleData, &NumCells, sizeof(NumCells));
+			WriteBytes(OutSnapshot.ScheduleData, Followed.Cells.GetData(), NumCells * Followed.Cells.GetTypeSize());
+		}
+	}
+}
+
+void FBattleSimulation::RestoreSnapshot(const FBattleSimSnapshot& Snapshot)
+{
+	check(Snapshot.IsValid());
+
+	// Occupancy and the spatial index hold exactly the living units, so taking those out empties them
+	if (Occupancy.GetGridSize() == Snapshot.GridSize && SpatialIndex.GetGridSize() == Snapshot.GridSize)
+	{
+		for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+		{
+			Occupancy.Clear(Units.GetCell(UnitIndex));
+			SpatialIndex.Remove(Units.Ids[UnitIndex]);
+		}
+	}
+	else
+	{
+		Occupancy.Init(Snapshot.GridSize);
+		SpatialIndex.Init(Snapshot.GridSize);
+	}
+
+	Config.GridSize = Snapshot.GridSize;
+	UpdateStaticObstacles();
+	StepCount = Snapshot.StepCount;
+	NextUnitId = Snapshot.NextUnitId;
+	RandomStream.Initialize(Snapshot.RandomSeed);
+
+	Units.ReadColumns(Snapshot.UnitData.GetData(), Snapshot.NumUnits);
+	StateHash = 0;
+	for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+	{
+		const FGridCoordinate Cell = Units.GetCell(UnitIndex);
+		Occupancy.Set(Cell);
+		SpatialIndex.Add(Units.Ids[UnitIndex], Units.Team[UnitIndex], Cell);
+		StateHash += Units.HashUnitState(UnitIndex);
+	}
+
+	for (FCachedGridPath& CachedPath : CachedPaths)
+	{
+		CachedPath.Reset();
+	}
+	if (!Snapshot.PathData.IsEmpty())
+	{
+		CachedPaths.SetNum(FMath::Max(CachedPaths.Num(), NextUnitId));
+		const uint8* PathData = Snapshot.PathData.GetData();
+		for (const int32 UnitId : Units.Ids)
+		{
+			PathData = CachedPaths[UnitId].Read(PathData);
+		}
+	}
+
+	for (FFollowedPath& Followed : FollowedPaths)
+	{
+		Followed.Cells.Reset();
+		Followed.Progress = 0;
+	}
+	PathScheduler.Reset(Config.GridSize.X);
+	if (!Snapshot.ScheduleData.IsEmpty())
+	{
+		FollowedPaths.SetNum(FMath::Max(FollowedPaths.Num(), NextUnitId));
+		const uint8* ScheduleData = PathScheduler.Read(Snapshot.ScheduleData.GetData());
+		for (const int32 UnitId : Units.Ids)
+		{
+			FFollowedPath& Followed = FollowedPaths[UnitId];
+			int32 NumCells = 0;
+			ReadBytes(ScheduleData, &Followed.Progress, sizeof(Followed.Progress));
+			ReadBytes(ScheduleData, &NumCells, sizeof(NumCells));
+			Followed.Cells.SetNumUninitialized(NumCells);
+			ReadBytes(ScheduleData, Followed.Cells.GetData(), NumCells * Followed.Cells.GetTypeSize());
+		}
+	}
+}
+
+void FBattleSimulation::SpawnInitialTeams()
+{
+	const int32 NumCells = Config.GridSize.X * Config.GridSize.Y;
+	const int32 NumOpenCells = StaticRegions ? StaticRegions->GetNumOpenCells() : NumCells;
+	if (NumOpenCells < 2)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No room for a battle on a %dx%d grid with %d open cells"),
+		       Config.GridSize.X, Config.GridSize.Y, NumOpenCells);
+		return;
+	}
+
+	const int32 UnitsPerTeam = FMath::Clamp(Config.UnitsPerTeam, 1, NumOpenCells / 2);
+
+	// Random draws land on a free cell at least half the time while half the grid stays free. Denser battles take
+	// the next cell of a partial shuffle of the open cells instead, so draws stay bounded however full it gets
+	TArray<int32> OpenCells;
+	if ((NumOpenCells - 2 * UnitsPerTeam) * 2 < NumCells)
+	{
+		OpenCells.Reserve(NumOpenCells);
+		for (int32 Y = 0; Y < Config.GridSize.Y; ++Y)
+		{
+			for (int32 X = 0; X < Config.GridSize.X; ++X)
+			{
+				if (!StaticRegions || !StaticRegions->IsObstacle(FGridCoordinate(X, Y))) OpenCells.Add(Y * Config.GridSize.X + X);
+			}
+		}
+	}
+
+	int32 NumTaken = 0;
+	auto SpawnUnit = [&](EBattleTeam Team)
+	{
+		FSimUnit NewUnit;
+		NewUnit.Id = NextUnitId++;
+		NewUnit.Team = Team;
+		NewUnit.HP = RandomStream.RandRange(Config.MinHP, Config.MaxHP);
+		if (OpenCells.IsEmpty())
+		{
+			do { NewUnit.Cell = MakeRandomCell(); }
+			while (Occupancy.IsSet(NewUnit.Cell) || (StaticRegions && StaticRegions->IsObstacle(NewUnit.Cell)));
+		}
+		else
+		{
+			OpenCells.Swap(NumTaken, RandomStream.RandRange(NumTaken, OpenCells.Num() - 1));
+			const int32 CellIndex = OpenCells[NumTaken++];
+			NewUnit.Cell = FGridCoordinate(CellIndex % Config.GridSize.X, CellIndex / Config.GridSize.X);
+		}
+		Units.Add(NewUnit);
+		StateHash += FSimUnitStore::HashUnitState(NewUnit.Id, NewUnit.Team, NewUnit.HP, NewUnit.Cell);
+		Occupancy.Set(NewUnit.Cell);
+		SpatialIndex.Add(NewUnit.Id, NewUnit.Team, NewUnit.Cell);
+	};
+
+	for (int32 UnitIndex = 0; UnitIndex < UnitsPerTeam; ++UnitIndex)
+	{
+		SpawnUnit(EBattleTeam::Red);
+		SpawnUnit(EBattleTeam::Blue);
+	}
+}
+
+FGridCoordinate FBattleSimulation::MakeRandomCell() const
+{
+	const int32 X = RandomStream.RandRange(0, Config.GridSize.X - 1);
+	const int32 Y = RandomStream.RandRange(0, Config.GridSize.Y - 1);
+	return FGridCoordinate(X, Y);
+}
+
+int32 FBattleSimulation::FindClosestEnemyUnitId(int32 SourceUnitIndex) const
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_FindClosestEnemy);
+	return SpatialIndex.FindClosestEnemy(Units.Team[SourceUnitIndex], Units.GetCell(SourceUnitIndex));
+}
+
+bool FBattleSimulation::IsBattleOver() const
+{
+	return SpatialIndex.GetNumUnits(EBattleTeam::Red) == 0 || SpatialIndex.GetNumUnits(EBattleTeam::Blue) == 0;
+}
+
+TArrayView<const FGridCoordinate> FBattleSimulation::GetFollowedPath(int32 UnitId) const
+{
+	if (!FollowedPaths.IsValidIndex(UnitId)) return TArrayView<const FGridCoordinate>();
+	return FollowedPaths[UnitId].Cells;
+}
+
+void FBattleSimulation::BuildFlowFields()
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_BuildFlowFields);
+	for (const EBattleTeam Team : { EBattleTeam::Red, EBattleTeam::Blue })
+	{
+		FlowFieldSources.Reset();
+		for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+		{
+			if (Units.IsAlive(UnitIndex) && Units.Team[UnitIndex] != Team) FlowFieldSources.Add(Units.GetCell(UnitIndex));
+		}
+		FlowFieldByTeam[static_cast<uint8>(Team)].Build(StepOccupancy, FlowFieldSources,
+		                                                 StaticRegions ? &StaticRegions->GetObstacles() : nullptr);
+	}
+}
+
+void FBattleSimulation::UpdateStaticObstacles()
+{
+	StaticRegions = Config.StaticObstacles;
+	if (StaticRegions.IsValid() && StaticRegions->GetGridSize() != Config.GridSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Static obstacles for a %dx%d grid ignored on a %dx%d grid"),
+		       StaticRegions->GetGridSize().X, StaticRegions->GetGridSize().Y, Config.GridSize.X, Config.GridSize.Y);
+		StaticRegions.Reset();
+	}
+}
+
+void FBattleSimulation::EnsureNavHierarchy()
+{
+	const int32 ClusterSize = FMath::Clamp(Config.HierarchyClusterSize, FGridHierarchy::MinClusterSize, FGridHierarchy::MaxClusterSize);
+	if (!NavHierarchy.IsBuilt() || NavHierarchy.GetGridSize() != Config.GridSize || NavHierarchy.GetClusterSize() != ClusterSize ||
+		NavHierarchyRegions != StaticRegions)
+	{
+		if (StaticRegions)
+		{
+			NavHierarchy.Build(StaticRegions->GetObstacles(), ClusterSize);
+		}
+		else
+		{
+			NavHierarchy.Init(Config.GridSize, ClusterSize);
+		}
+		NavHierarchyRegions = StaticRegions;
+	}
+}
+
+void FBattleSimulation::Step(FStepDelta& OutStepDelta)
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_Step);
+
+	OutStepDelta.Moves.Reset();
+	OutStepDelta.Events.Reset();
+
+	StepOccupancy.CopyFrom(Occupancy);
+
+	if (Config.MovementPlanner == EMovementPlanner::FlowField)
+	{
+		BuildFlowFields();
+	}
+	else if (Config.MovementPlanner == EMovementPlanner::Hierarchical)
+	{
+		EnsureNavHierarchy();
+	}
+	else if (Config.bSchedulePaths)
+	{
+		if (FollowedPaths.Num() < NextUnitId) FollowedPaths.SetNum(NextUnitId);
+	}
+	else if (Config.bCachePaths && CachedPaths.Num() < NextUnitId)
+	{
+		CachedPaths.SetNum(NextUnitId);
+	}
+
+	// Units are compacted at the end of every step, so everything stored now is alive and in Id order
+	const int32 NumActingUnits = Units.Num();
+
+	// Cooldowns only ever change for their own unit, ticking them all up front matches ticking each on its turn
+	int32* AttackCooldowns = Units.AttackCooldown.GetData();
+	for (int32 UnitIndex = 0; UnitIndex < NumActingUnits; ++UnitIndex)
+	{
+		AttackCooldowns[UnitIndex] = FMath::Max(AttackCooldowns[UnitIndex] - 1, 0);
+	}
+
+	PlannedMoves.Reset();
+
+	if (Config.bParallelPlanning && NumActingUnits >= Config.ParallelPlanningMinUnits)
+	{
+		ActUnitsWithParallelPlanning(OutStepDelta);
+	}
+	else
+	{
+		ActUnitsSerially(OutStepDelta);
+	}
+
+	// Planned in acting order, so moves are already sorted by unit Id
+	for (const FPlannedMove& Move : PlannedMoves)
+	{
+		if (!Units.IsAlive(Move.UnitIndex)) continue;
+		if (Units.GetCell(Move.UnitIndex) != Move.FromCell) continue;
+
+		const int32 MovingUnitId = Units.Ids[Move.UnitIndex];
+		StateHash -= Units.HashUnitState(Move.UnitIndex);
+		Units.SetCell(Move.UnitIndex, Move.ToCell);
+		StateHash += Units.HashUnitState(Move.UnitIndex);
+		Occupancy.Clear(Move.FromCell);
+		Occupancy.Set(Move.ToCell);
+		SpatialIndex.Move(MovingUnitId, Move.ToCell);
+		OutStepDelta.Moves.Add({MovingUnitId, Move.FromCell, Move.ToCell});
+	}
+
+	if (UsesPathScheduler())
+	{
+		ServePathRequests();
+	}
+
+	Units.Compact();
+	++StepCount;
+
+	OutStepDelta.StateHash = StateHash;
+	OutStepDelta.GridSize = Config.GridSize;
+	checkSlow(StateHash == Units.ComputeStateHash());
+}
+
+void FBattleSimulation::ActUnitsSerially(FStepDelta& OutStepDelta)
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_ResolveUnits);
+
+	const int32 NumActingUnits = Units.Num();
+	for (int32 ActingIndex = 0; ActingIndex < NumActingUnits; ++ActingIndex)
+	{
+		const int32 ClosestEnemyUnitId = FindClosestEnemyUnitId(ActingIndex);
+		if (ClosestEnemyUnitId < 0) continue;
+
+		const FGridCoordinate ActingCell = Units.GetCell(ActingIndex);
+		const int32 TargetIndex = Units.FindIndex(ClosestEnemyUnitId);
+		const FGridCoordinate TargetCell = Units.GetCell(TargetIndex);
+
+		if (Manhattan(ActingCell, TargetCell) <= Config.AttackRangeSquares)
+		{
+			ResolveAttack(ActingIndex, TargetIndex, OutStepDelta);
+			continue;
+		}
+
+		FGridCoordinate NextCell, ReadMin, ReadMax;
+		const bool bHasNextCell = PlanMove(ActingIndex, TargetCell, NextCell, ReadMin, ReadMax, SerialPathUpdate);
+		CommitPathUpdate(ActingIndex, SerialPathUpdate);
+
+		if (bHasNextCell)
+		{
+			TryReserveMove(ActingIndex, ActingCell, NextCell);
+		}
+	}
+}
+
+void FBattleSimulation::ActUnitsWithParallelPlanning(FStepDelta& OutStepDelta)
+{
+	const int32 NumActingUnits = Units.Num();
+	UnitPlans.SetNum(NumActingUnits, EAllowShrinking::No);
+
+	// Plan: everything read here stays untouched until the loop below starts
+	{
+		GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_PlanUnits);
+		ParallelFor(NumActingUnits, [this](int32 ActingIndex)
+		{
+			FUnitPlan& Plan = UnitPlans[ActingIndex];
+			Plan.TargetUnitId = FindClosestEnemyUnitId(ActingIndex);
+			Plan.bHasMovePlan = false;
+			if (Plan.TargetUnitId < 0) return;
+
+			const FGridCoordinate TargetCell = Units.GetCell(Units.FindIndex(Plan.TargetUnitId));
+			if (Manhattan(Units.GetCell(ActingIndex), TargetCell) <= Config.AttackRangeSquares) return;
+
+			Plan.bHasMovePlan = true;
+			Plan.bHasNextCell = PlanMove(ActingIndex, TargetCell, Plan.NextCell, Plan.ReadMin, Plan.ReadMax, Plan.PathUpdate);
+		}, EParallelForFlags::Unbalanced);
+	}
+
+	// Commit in Id order, exactly like ActUnitsSerially but starting from the plans
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_ResolveUnits);
+
+	ChangedCells.Init(Config.GridSize);
+	ChangedCellList.Reset();
+
+	for (int32 ActingIndex = 0; ActingIndex < NumActingUnits; ++ActingIndex)
+	{
+		FUnitPlan& Plan = UnitPlans[ActingIndex];
+
+		int32 TargetUnitId = Plan.TargetUnitId;
+		bool bPlanIsCurrent = true;
+		if (TargetUnitId >= 0 && !Units.IsAlive(Units.FindIndex(TargetUnitId)))
+		{
+			// Positions do not change until the moves are applied, so removing units can only change the closest
+			// enemy when the closest one itself was removed
+			TargetUnitId = FindClosestEnemyUnitId(ActingIndex);
+			bPlanIsCurrent = false;
+		}
+		if (TargetUnitId < 0) continue;
+
+		const FGridCoordinate ActingCell = Units.GetCell(ActingIndex);
+		const int32 TargetIndex = Units.FindIndex(TargetUnitId);
+		const FGridCoordinate TargetCell = Units.GetCell(TargetIndex);
+
+		if (Manhattan(ActingCell, TargetCell) <= Config.AttackRangeSquares)
+		{
+			if (ResolveAttack(ActingIndex, TargetIndex, OutStepDelta))
+			{
+				MarkCellChanged(TargetCell);
+			}
+			continue;
+		}
+
+		FGridCoordinate NextCell = Plan.NextCell;
+		bool bHasNextCell = Plan.bHasNextCell;
+		if (!bPlanIsCurrent || !Plan.bHasMovePlan || HasChangedCellIn(Plan.ReadMin, Plan.ReadMax))
+		{
+			INC_DWORD_STAT(STAT_GridBattle_PlansRedone);
+			FGridCoordinate ReadMin, ReadMax;
+			bHasNextCell = PlanMove(ActingIndex, TargetCell, NextCell, ReadMin, ReadMax, Plan.PathUpdate);
+		}
+		CommitPathUpdate(ActingIndex, Plan.PathUpdate);
+
+		if (bHasNextCell && TryReserveMove(ActingIndex, ActingCell, NextCell))
+		{
+			MarkCellChanged(ActingCell);
+			MarkCellChanged(NextCell);
+		}
+	}
+}
+
+bool FBattleSimulation::PlanMove(int32 ActingIndex, const FGridCoordinate& TargetCell, FGridCoordinate& OutNextCell,
+                                 FGridCoordinate& OutReadMin, FGridCoordinate& OutReadMax,
+                                 FPathUpdate& OutPathUpdate) const
+{
+	OutPathUpdate.bIsSet = false;
+
+	const int32 MaxCellsThisStep = FMath::Clamp(Config.MoveSquaresPerStep, 1, 8);
+	const FGridCoordinate ActingCell = Units.GetCell(ActingIndex);
+
+	if (Config.MovementPlanner == EMovementPlanner::FlowField)
+	{
+		// The field itself is fixed for the step, the walk only reads StepOccupancy along its own cells
+		OutReadMin = FGridCoordinate(ActingCell.X - MaxCellsThisStep, ActingCell.Y - MaxCellsThisStep);
+		OutReadMax = FGridCoordinate(ActingCell.X + MaxCellsThisStep, ActingCell.Y + MaxCellsThisStep);
+
+		const FGridFlowField& FlowField = FlowFieldByTeam[static_cast<uint8>(Units.Team[ActingIndex])];
+		return FlowField.FindNextCell(ActingCell, MaxCellsThisStep, StepOccupancy, OutNextCell);
+	}
+
+	if (UsesPathScheduler())
+	{
+		return PlanFollowedPathMove(ActingIndex, TargetCell, MaxCellsThisStep, OutNextCell, OutReadMin, OutReadMax, OutPathUpdate);
+	}
+
+	FPathRequest PathRequest;
+	PathRequest.Start = ActingCell;
+	PathRequest.Goal = TargetCell;
+	PathRequest.GridSize = Config.GridSize;
+	PathRequest.Occupancy = &StepOccupancy;
+	PathRequest.PassableOverrides.Add(ActingCell);
+	if (StaticRegions)
+	{
+		PathRequest.StaticObstacles = &StaticRegions->GetObstacles();
+		PathRequest.Regions = StaticRegions.Get();
+	}
+
+	// Keeps the capacity of the longest path this thread has built, so steady-state searches never grow it
+	static thread_local TArray<FGridCoordinate> Path;
+
+	if (Config.MovementPlanner == EMovementPlanner::Hierarchical)
+	{
+		PathRequest.MaxRefinedCells = MaxCellsThisStep;
+
+		FGridHierarchyContext& HierarchyContext = FGridHierarchy::GetThreadContext();
+		const bool bFound = NavHierarchy.FindPath(PathRequest, Path, HierarchyContext);
+
+		OutReadMin = HierarchyContext.LastReadMin;
+		OutReadMax = HierarchyContext.LastReadMax;
+
+		if (!bFound || Path.Num() < 2) return false;
+
+		OutNextCell = Path[FMath::Min(MaxCellsThisStep, Path.Num() - 1)];
+		return true;
+	}
+
+	PathRequest.SearchMode = Config.PathSearchMode;
+	if (Config.MaxPathExpansions > 0)
+	{
+		PathRequest.MaxExpansions = Config.MaxPathExpansions;
+		PathRequest.bAllowPartialPath = true;
+	}
+
+	FGridAStarContext& SearchContext = FGridAStar::GetThreadContext();
+	bool bFound;
+	if (Config.bCachePaths)
+	{
+		OutPathUpdate.bIsSet = true;
+		OutPathUpdate.Result = FGridPathCache::FindPath(CachedPaths[Units.Ids[ActingIndex]], MaxCellsThisStep,
+		                                                PathRequest, Path, OutPathUpdate.Path, SearchContext,
+		                                                OutReadMin, OutReadMax);
+		bFound = OutPathUpdate.Result != EPathCacheResult::NoPath;
+	}
+	else
+	{
+		bFound = FGridAStar::FindPath(PathRequest, Path, SearchContext);
+
+		OutReadMin = FGridCoordinate(SearchContext.LastExpandedMin.X - 1, SearchContext.LastExpandedMin.Y - 1);
+		OutReadMax = FGridCoordinate(SearchContext.LastExpandedMax.X + 1, SearchContext.LastExpandedMax.Y + 1);
+	}
+
+	if (!bFound || Path.Num() < 2) return false;
+
+	const int32 TargetPathIndex = FMath::Min(1 + (MaxCellsThisStep - 1), Path.Num() - 1);
+	OutNextCell = Path[TargetPathIndex];
+	return true;
+}
+
+bool FBattleSimulation::PlanFollowedPathMove(int32 ActingIndex, const FGridCoordinate& TargetCell, int32 MaxCellsThisStep,
+                                             FGridCoordinate& OutNextCell, FGridCoordinate& OutReadMin,
+                                             FGridCoordinate& OutReadMax, FPathUpdate& OutPathUpdate) const
+{
+	const FGridCoordinate ActingCell = Units.GetCell(ActingIndex);
+	const FFollowedPath& Followed = FollowedPaths[Units.Ids[ActingIndex]];
+
+	OutPathUpdate.bIsSet = true;
+	OutPathUpdate.WantedGoal = TargetCell;
+	OutReadMin = ActingCell;
+	OutReadMax = ActingCell;
+
+	// Only the path moves the unit, so it stands at most a blocked move behind where it was last seen
+	int32 PathIndex = INDEX_NONE;
+	for (int32 CellIndex = Followed.Progress; CellIndex < Followed.Cells.Num(); ++CellIndex)
+	{
+		if (Followed.Cells[CellIndex] == ActingCell)
+		{
+			PathIndex = CellIndex;
+			break;
+		}
+	}
+	OutPathUpdate.FollowedIndex = PathIndex;
+	if (PathIndex == INDEX_NONE)
+	{
+		OutPathUpdate.bWantsPath = true;
+		return false;
+	}
+
+	const int32 LastIndex = FMath::Min(PathIndex + MaxCellsThisStep, Followed.Cells.Num() - 1);
+	int32 NextIndex = PathIndex;
+	while (NextIndex < LastIndex)
+	{
+		const FGridCoordinate& Cell = Followed.Cells[NextIndex + 1];
+		OutReadMin = FGridCoordinate(FMath::Min(OutReadMin.X, Cell.X), FMath::Min(OutReadMin.Y, Cell.Y));
+		OutReadMax = FGridCoordinate(FMath::Max(OutReadMax.X, Cell.X), FMath::Max(OutReadMax.Y, Cell.Y));
+		if (StepOccupancy.IsSet(Cell)) break;
+		++NextIndex;
+	}
+
+	// The target itself standing at the end of the path does not block it
+	const bool bBlocked = NextIndex < LastIndex && Followed.Cells[NextIndex + 1] != TargetCell;
+	OutPathUpdate.bWantsPath = bBlocked || Followed.Cells.Last() != TargetCell;
+
+	if (NextIndex == PathIndex) return false;
+
+	OutNextCell = Followed.Cells[NextIndex];
+	return true;
+}
+
+void FBattleSimulation::CommitPathUpdate(int32 ActingIndex, FPathUpdate& PathUpdate)
+{
+	if (!PathUpdate.bIsSet) return;
+	PathUpdate.bIsSet = false;
+
+	// Units killed earlier in the step still take their turn, but have nothing left to keep
+	if (!Units.IsAlive(ActingIndex)) return;
+
+	if (UsesPathScheduler())
+	{
+		FFollowedPath& Followed = FollowedPaths[Units.Ids[ActingIndex]];
+		if (PathUpdate.FollowedIndex != INDEX_NONE) Followed.Progress = PathUpdate.FollowedIndex;
+		Followed.bWantsPath = PathUpdate.bWantsPath;
+		Followed.WantedGoal = PathUpdate.WantedGoal;
+		return;
+	}
+
+	Swap(CachedPaths[Units.Ids[ActingIndex]], PathUpdate.Path);
+
+	switch (PathUpdate.Result)
+	{
+	case EPathCacheResult::Hit:
+		++PathCacheStats.Hits;
+		INC_DWORD_STAT(STAT_GridBattle_PathCacheHits);
+		break;
+	case EPathCacheResult::Repaired:
+		++PathCacheStats.Repairs;
+		INC_DWORD_STAT(STAT_GridBattle_PathCacheRepairs);
+		break;
+	default:
+		++PathCacheStats.Replans;
+		INC_DWORD_STAT(STAT_GridBattle_PathCacheReplans);
+		break;
+	}
+}
+
+void FBattleSimulation::ServePathRequests()
+{
+	// Queued from where the units stand after their moves, which is where the paths handed out start. Units that
+	// attacked or whose path still holds drop what they had waiting
+	for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+	{
+		const int32 UnitId = Units.Ids[UnitIndex];
+		FFollowedPath& Followed = FollowedPaths[UnitId];
+		if (Followed.bWantsPath && Units.IsAlive(UnitIndex))
+		{
+			const FGridCoordinate Cell = Units.GetCell(UnitIndex);
+			PathScheduler.Enqueue(UnitId, Cell, Followed.WantedGoal, Manhattan(Cell, Followed.WantedGoal));
+		}
+		else
+		{
+			PathScheduler.Cancel(UnitId);
+		}
+		Followed.bWantsPath = false;
+	}
+
+	FPathRequest BaseRequest;
+	BaseRequest.GridSize = Config.GridSize;
+	BaseRequest.Occupancy = &Occupancy;
+	BaseRequest.SearchMode = Config.PathSearchMode;
+	if (StaticRegions)
+	{
+		BaseRequest.StaticObstacles = &StaticRegions->GetObstacles();
+		BaseRequest.Regions = StaticRegions.Get();
+	}
+
+	const int32 MaxExpansions = Config.PathBudgetPerStep > 0 ? Config.PathBudgetPerStep : MAX_int32;
+	PathScheduler.Serve(BaseRequest, MaxExpansions, Config.PathBudgetMicroseconds * 1e-6,
+		[this](int32 UnitId, EGridSearchResult, const TArray<FGridCoordinate>& Path)
+		{
+			FFollowedPath& Followed = FollowedPaths[UnitId];
+			Followed.Cells = Path;
+			Followed.Progress = 0;
+		});
+}
+
+bool FBattleSimulation::ResolveAttack(int32 ActingIndex, int32 TargetIndex, FStepDelta& OutStepDelta)
+{
+	const bool IsAttackReady = (Units.AttackCooldown[ActingIndex] == 0);
+	if (!IsAttackReady) return false;
+
+	const int32 ActingUnitId = Units.Ids[ActingIndex];
+	const int32 TargetUnitId = Units.Ids[TargetIndex];
+
+	Units.AttackCooldown[ActingIndex] = Config.AttackPeriodSteps;
+
+	OutStepDelta.Events.Add({EEventType::Attack, ActingUnitId, TargetUnitId});
+
+	const uint64 TargetHashBeforeHit = Units.HashUnitState(TargetIndex);
+	Units.HP[TargetIndex] -= 1;
+	OutStepDelta.Events.Add({EEventType::Hit, TargetUnitId, ActingUnitId});
+
+	if (Units.HP[TargetIndex] <= 0 && Units.Alive[TargetIndex])
+	{
+		const FGridCoordinate TargetCell = Units.GetCell(TargetIndex);
+		Units.Alive[TargetIndex] = false;
+		StepOccupancy.Clear(TargetCell);
+		Occupancy.Clear(TargetCell);
+		SpatialIndex.Remove(TargetUnitId);
+		if (CachedPaths.IsValidIndex(TargetUnitId)) CachedPaths[TargetUnitId].Empty();
+		if (FollowedPaths.IsValidIndex(TargetUnitId)) FollowedPaths[TargetUnitId].Cells.Empty();
+		StateHash -= TargetHashBeforeHit;
+		OutStepDelta.Events.Add({EEventType::Die, TargetUnitId, ActingUnitId});
+		return true;
+	}
+
+	// Dead units no longer count towards the hash
+	if (Units.Alive[TargetIndex])
+	{
+		StateHash += Units.HashUnitState(TargetIndex) - TargetHashBeforeHit;
+	}
+	return false;
+}
+
+bool FBattleSimulation::TryReserveMove(int32 ActingIndex, const FGridCoordinate& ActingCell, const FGridCoordinate& NextCell)
+{
+	if (StepOccupancy.IsSet(NextCell)) return false;
+
+	PlannedMoves.Add({ActingIndex, ActingCell, NextCell});
+	StepOccupancy.Clear(ActingCell);
+	StepOccupancy.Set(NextCell); // reserve
+	return true;
+}
+
+void FBattleSimulation::MarkCellChanged(const FGridCoordinate& Cell)
+{
+	if (ChangedCells.IsSet(Cell)) return;
+
+	ChangedCells.Set(Cell);
+	ChangedCellList.Add(Cell);
+}
+
+bool FBattleSimulation::HasChangedCellIn(const FGridCoordinate& Min, const FGridCoordinate& Max) const
+{
+	const int32 MinX = FMath::Max(Min.X, 0);
+	const int32 MinY = FMath::Max(Min.Y, 0);
+	const int32 MaxX = FMath::Min(Max.X, Config.GridSize.X - 1);
+	const int32 MaxY = FMath::Min(Max.Y, Config.GridSize.Y - 1);
+	if (MinX > MaxX || MinY > MaxY) return false;
+
+	// Walk whichever is shorter, the changed cells or the rectangle
+	const int64 Area = int64(MaxX - MinX + 1) * (MaxY - MinY + 1);
+	if (ChangedCellList.Num() <= Area)
+	{
+		for (const FGridCoordinate& Cell : ChangedCellList)
+		{
+			if (Cell.X >= MinX && Cell.X <= MaxX && Cell.Y >= MinY && Cell.Y <= MaxY) return true;
+		}
+		return false;
+	}
+
+	for (int32 Y = MinY; Y <= MaxY; ++Y)
+	{
+		for (int32 X = MinX; X <= MaxX; ++X)
+		{
+			if (ChangedCells.IsSet(FGridCoordinate(X, Y))) return true;
+		}
+	}
+	return false;
+}
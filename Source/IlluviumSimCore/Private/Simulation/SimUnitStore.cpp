@@ -0,0 +1,194 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Simulation/SimUnitStore.h"
+
+void FSimUnitStore::Reset()
+{
+	Ids.Reset();
+	CellX.Reset();
+	CellY.Reset();
+	HP.Reset();
+	AttackCooldown.Reset();
+	Team.Reset();
+	Alive.Reset();
+	IndexById.Reset();
+}
+
+int32 FSimUnitStore::Add(const FSimUnit& Unit)
+{
+	check(Unit.Id >= 0 && (Ids.IsEmpty() || Unit.Id > Ids.Last()));
+
+	const int32 Index = Ids.Add(Unit.Id);
+	CellX.Add(Unit.Cell.X);
+	CellY.Add(Unit.Cell.Y);
+	HP.Add(Unit.HP);
+	AttackCooldown.Add(Unit.AttackCooldown);
+	Team.Add(Unit.Team);
+	Alive.Add(Unit.bAlive);
+
+	if (Unit.Id >= IndexById.Num())
+	{
+		const int32 OldNum = IndexById.Num();
+		IndexById.SetNumUninitialized(Unit.Id + 1);
+		for (int32 Id = OldNum; Id < IndexById.Num(); ++Id)
+		{
+			IndexById[Id] = INDEX_NONE;
+		}
+	}
+	IndexById[Unit.Id] = Index;
+	return Index;
+}
+
+void FSimUnitStore::CopyFrom(const FSimUnitStore& Other)
+{
+	// Reset and Append keep the capacity already allocated, unlike assignment
+	auto CopyArray = [](auto& To, const auto& From)
+	{
+		To.Reset();
+		To.Append(From);
+	};
+
+	CopyArray(Ids, Other.Ids);
+	CopyArray(CellX, Other.CellX);
+	CopyArray(CellY, Other.CellY);
+	CopyArray(HP, Other.HP);
+	CopyArray(AttackCooldown, Other.AttackCooldown);
+	CopyArray(Team, Other.Team);
+	CopyArray(Alive, Other.Alive);
+	CopyArray(IndexById, Other.IndexById);
+}
+
+void FSimUnitStore::WriteColumns(TArray<uint8>& Out) const
+{
+	auto WriteColumn = [&Out](const auto& Column)
+	{
+		const int32 NumBytes = Column.Num() * Column.GetTypeSize();
+		const int32 Offset = Out.AddUninitialized(NumBytes);
+		FMemory::Memcpy(Out.GetData() + Offset, Column.GetData(), NumBytes);
+	};
+
+	WriteColumn(Ids);
+	WriteColumn(CellX);
+	WriteColumn(CellY);
+	WriteColumn(HP);
+	WriteColumn(AttackCooldown);
+	WriteColumn(Team);
+}
+
+const uint8* FSimUnitStore::ReadColumns(const uint8* Data, int32 NumUnits)
+{
+	for (const int32 UnitId : Ids)
+	{
+		IndexById[UnitId] = INDEX_NONE;
+	}
+
+	auto ReadColumn = [&Data, NumUnits](auto& Column)
+	{
+		Column.SetNumUninitialized(NumUnits, EAllowShrinking::No);
+		const int32 NumBytes = NumUnits * Column.GetTypeSize();
+		FMemory::Memcpy(Column.GetData(), Data, NumBytes);
+		Data += NumBytes;
+	};
+
+	ReadColumn(Ids);
+	ReadColumn(CellX);
+	ReadColumn(CellY);
+	ReadColumn(HP);
+	ReadColumn(AttackCooldown);
+	ReadColumn(Team);
+
+	Alive.SetNumUninitialized(NumUnits, EAllowShrinking::No);
+	for (int32 Index = 0; Index < NumUnits; ++Index)
+	{
+		Alive[Index] = true;
+	}
+
+	// Ids are ascending, so the last one bounds the lookup
+	const int32 OldLookupNum = IndexById.Num();
+	if (NumUnits > 0 && Ids.Last() >= OldLookupNum)
+	{
+		IndexById.SetNumUninitialized(Ids.Last() + 1, EAllowShrinking::No);
+		for (int32 Id = OldLookupNum; Id < IndexById.Num(); ++Id)
+		{
+			IndexById[Id] = INDEX_NONE;
+		}
+	}
+	for (int32 Index = 0; Index < NumUnits; ++Index)
+	{
+		IndexById[Ids[Index]] = Index;
+	}
+
+	return Data;
+}
+
+void FSimUnitStore::Compact()
+{
+	int32 WriteIndex = 0;
+	for (int32 ReadIndex = 0; ReadIndex < Ids.Num(); ++ReadIndex)
+	{
+		if (!Alive[ReadIndex])
+		{
+			IndexById[Ids[ReadIndex]] = INDEX_NONE;
+			continue;
+		}
+
+		if (WriteIndex != ReadIndex)
+		{
+			Ids[WriteIndex] = Ids[ReadIndex];
+			CellX[WriteIndex] = CellX[ReadIndex];
+			CellY[WriteIndex] = CellY[ReadIndex];
+			HP[WriteIndex] = HP[ReadIndex];
+			AttackCooldown[WriteIndex] = AttackCooldown[ReadIndex];
+			Team[WriteIndex] = Team[ReadIndex];
+			Alive[WriteIndex] = true;
+			IndexById[Ids[WriteIndex]] = WriteIndex;
+		}
+		++WriteIndex;
+	}
+
+	const int32 NumRemoved = Ids.Num() - WriteIndex;
+	if (NumRemoved == 0) return;
+
+	Ids.SetNum(WriteIndex, EAllowShrinking::No);
+	CellX.SetNum(WriteIndex, EAllowShrinking::No);
+	CellY.SetNum(WriteIndex, EAllowShrinking::No);
+	HP.SetNum(WriteIndex, EAllowShrinking::No);
+	AttackCooldown.SetNum(WriteIndex, EAllowShrinking::No);
+	Team.SetNum(WriteIndex, EAllowShrinking::No);
+	Alive.SetNum(WriteIndex, EAllowShrinking::No);
+}
+
+FSimUnit FSimUnitStore::GetUnit(int32 Index) const
+{
+	FSimUnit Unit;
+	Unit.Id = Ids[Index];
+	Unit.Team = Team[Index];
+	Unit.HP = HP[Index];
+	Unit.Cell = GetCell(Index);
+	Unit.AttackCooldown = AttackCooldown[Index];
+	Unit.bAlive = Alive[Index];
+	return Unit;
+}
+
+uint64 FSimUnitStore::ComputeStateHash() const
+{
+	uint64 StateHash = 0;
+	for (int32 Index = 0; Index < Num(); ++Index)
+	{
+		if (Alive[Index]) StateHash += HashUnitState(Index);
+	}
+	return StateHash;
+}
+
+const TCHAR* FSimUnitStore::FindMismatchedColumn(const FSimUnitStore& Other) const
+{
+	if (Ids != Other.Ids) return TEXT("Ids");
+	if (Team != Other.Team) return TEXT("Team");
+	if (HP != Other.HP) return TEXT("HP");
+	if (AttackCooldown != Other.AttackCooldown) return TEXT("AttackCooldown");
+	if (CellX != Other.CellX) return TEXT("CellX");
+	if (CellY != Other.CellY) return TEXT("CellY");
+	if (Alive != Other.Alive) return TEXT("Alive");
+	return nullptr;
+}
@@ -0,0 +1,47 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumSimCore/Public/Simulation/StepDeltaRing.h"
+
+void FStepDeltaRing::Initialize(int32 InCapacity, int32 MovesPerStep, int32 EventsPerStep)
+{
+	Slots.SetNum(FMath::Max(1, InCapacity));
+	for (FStepDelta& Slot : Slots)
+	{
+		Slot.Moves.Reserve(MovesPerStep);
+		Slot.Events.Reserve(EventsPerStep);
+	}
+	Reset();
+}
+
+void FStepDeltaRing::Reset()
+{
+	for (FStepDelta& Slot : Slots)
+	{
+		Slot.Moves.Reset();
+		Slot.Events.Reset();
+	}
+	LatestSlot = INDEX_NONE;
+	NumStored = 0;
+}
+
+FStepDelta& FStepDeltaRing::Advance()
+{
+	check(Slots.Num() > 0);
+
+	LatestSlot = (LatestSlot + 1) % Slots.Num();
+	NumStored = FMath::Min(NumStored + 1, Slots.Num());
+
+	FStepDelta& Delta = Slots[LatestSlot];
+	Delta.Moves.Reset();
+	Delta.Events.Reset();
+	return Delta;
+}
+
+const FStepDelta* FStepDeltaRing::GetRecent(int32 StepsAgo) const
+{
+	if (StepsAgo < 0 || StepsAgo >= NumStored) return nullptr;
+
+	const int32 Slot = (LatestSlot - StepsAgo + Slots.Num()) % Slots.Num();
+	return &Slots[Slot];
+}
@@ -0,0 +1,160 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Replay/BattleReplay.h"
+#include "Templates/Function.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr auto GridBattleTestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+		EAutomationTestFlags::CommandletContext | EAutomationTestFlags::EngineFilter;
+
+	constexpr int64 ReplayHeaderSize = 44;
+	constexpr int64 GridSizeOffset = 8;
+	constexpr int64 IndexOffsetOffset = 36;
+
+	/** A unit of a keyframe as its raw fields, so tests can write what FBattleReplayWriter never would. */
+	struct FRawKeyframeUnit
+	{
+		uint32 IdDelta;
+		uint8 Team;
+		uint32 HP;
+		uint32 AttackCooldown;
+		uint32 CellX;
+		uint32 CellY;
+	};
+
+	void AppendVarUInt(TArray<uint8>& Bytes, uint32 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Bytes.Add(static_cast<uint8>(Value | 0x80));
+			Value >>= 7;
+		}
+		Bytes.Add(static_cast<uint8>(Value));
+	}
+
+	void WriteFixed(TArray<uint8>& Bytes, int64 Offset, uint64 Value, int32 NumBytes)
+	{
+		for (int32 ByteIndex = 0; ByteIndex < NumBytes; ++ByteIndex)
+		{
+			Bytes[Offset + ByteIndex] = static_cast<uint8>(Value >> (8 * ByteIndex));
+		}
+	}
+
+	/**
+	 * A replay of no steps on a 10x10 grid whose only keyframe claims NumUnits units and holds Units. The header and
+	 * index come from FBattleReplayWriter, the keyframe is swapped in after it.
+	 */
+	TArray<uint8> MakeKeyframeReplay(uint32 NumUnits, TConstArrayView<FRawKeyframeUnit> Units)
+	{
+		FSimConfig Config;
+		Config.GridSize = FIntPoint(10, 10);
+		FBattleReplayWriter Writer;
+		Writer.Begin(Config, /*Seed*/ 1, FSimUnitStore());
+		TArray<uint8> Bytes = Writer.Finish();
+
+		TArray<uint8> Payload;
+		AppendVarUInt(Payload, 0);
+		AppendVarUInt(Payload, NumUnits);
+		for (const FRawKeyframeUnit& Unit : Units)
+		{
+			AppendVarUInt(Payload, Unit.IdDelta);
+			Payload.Add(Unit.Team);
+			AppendVarUInt(Payload, Unit.HP << 1);
+			AppendVarUInt(Payload, Unit.AttackCooldown);
+			AppendVarUInt(Payload, Unit.CellX);
+			AppendVarUInt(Payload, Unit.CellY);
+		}
+
+		TArray<uint8> Keyframe;
+		Keyframe.Add(1);
+		AppendVarUInt(Keyframe, Payload.Num());
+		Keyframe.Append(Payload);
+
+		// The index keeps pointing at the keyframe right after the header, only where the index starts moves
+		const int64 OldIndexOffset = Bytes.Num() - 8;
+		Bytes.RemoveAt(ReplayHeaderSize, OldIndexOffset - ReplayHeaderSize);
+		Bytes.Insert(Keyframe, ReplayHeaderSize);
+		WriteFixed(Bytes, IndexOffsetOffset, ReplayHeaderSize + Keyframe.Num(), 8);
+		return Bytes;
+	}
+
+	const FRawKeyframeUnit ValidUnits[] = {
+		{ 1, 0, 10, 0, 2, 3 },
+		{ 1, 1, 12, 1, 7, 9 }
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBattleReplayKeyframeLoopbackTest, "IlluviumSimCore.Replay.KeyframeLoopback", GridBattleTestFlags)
+
+bool FBattleReplayKeyframeLoopbackTest::RunTest(const FString& Parameters)
+{
+	// Guards MakeKeyframeReplay: the malformed cases below only differ from this one in the field they break
+	FBattleReplayPlayer Player;
+	if (!TestTrue(TEXT("Opens a well-formed keyframe"), Player.OpenMemory(MakeKeyframeReplay(2, ValidUnits))))
+	{
+		return true;
+	}
+
+	const FSimUnitStore& Units = Player.GetUnits();
+	if (TestEqual(TEXT("Units"), Units.Num(), 2))
+	{
+		TestEqual(TEXT("Second unit Id"), Units.Ids[1], 2);
+		TestTrue(TEXT("Second unit Team"), Units.Team[1] == EBattleTeam::Blue);
+		TestEqual(TEXT("Second unit HP"), Units.HP[1], 12);
+		TestEqual(TEXT("Second unit AttackCooldown"), Units.AttackCooldown[1], 1);
+		TestTrue(TEXT("Second unit cell"), Units.GetCell(1) == FGridCoordinate(7, 9));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBattleReplayMalformedTest, "IlluviumSimCore.Replay.Malformed", GridBattleTestFlags)
+
+bool FBattleReplayMalformedTest::RunTest(const FString& Parameters)
+{
+	struct FMalformedKeyframe
+	{
+		const TCHAR* Name;
+		TFunction<void(FRawKeyframeUnit& SecondUnit)> Break;
+	};
+	const FMalformedKeyframe Keyframes[] = {
+		{ TEXT("Repeated unit id"), [](FRawKeyframeUnit& Unit) { Unit.IdDelta = 0; } },
+		{ TEXT("Id delta wrapping around"), [](FRawKeyframeUnit& Unit) { Unit.IdDelta = MAX_uint32; } },
+		{ TEXT("Id far past anything the replay holds"), [](FRawKeyframeUnit& Unit) { Unit.IdDelta = 1u << 30; } },
+		{ TEXT("Unknown team"), [](FRawKeyframeUnit& Unit) { Unit.Team = 7; } },
+		{ TEXT("Cell right of the grid"), [](FRawKeyframeUnit& Unit) { Unit.CellX = 10; } },
+		{ TEXT("Cell at a negative row"), [](FRawKeyframeUnit& Unit) { Unit.CellY = MAX_uint32; } }
+	};
+
+	FBattleReplayPlayer Player;
+	for (const FMalformedKeyframe& Keyframe : Keyframes)
+	{
+		FRawKeyframeUnit Units[] = { ValidUnits[0], ValidUnits[1] };
+		Keyframe.Break(Units[1]);
+		TestFalse(Keyframe.Name, Player.OpenMemory(MakeKeyframeReplay(2, Units)));
+		TestEqual(FString::Printf(TEXT("%s: units kept"), Keyframe.Name), Player.GetUnits().Num(), 0);
+	}
+
+	TestFalse(TEXT("More units than the keyframe holds"), Player.OpenMemory(MakeKeyframeReplay(1000, ValidUnits)));
+
+	const TPair<const TCHAR*, FIntPoint> GridSizes[] = {
+		{ TEXT("Empty grid"), FIntPoint(0, 10) },
+		{ TEXT("Negative grid"), FIntPoint(10, MIN_int32) },
+		{ TEXT("Grid wider than any battle runs on"), FIntPoint(1 << 20, 10) }
+	};
+	for (const TPair<const TCHAR*, FIntPoint>& GridSize : GridSizes)
+	{
+		TArray<uint8> Bytes = MakeKeyframeReplay(2, ValidUnits);
+		WriteFixed(Bytes, GridSizeOffset, static_cast<uint32>(GridSize.Value.X), 4);
+		WriteFixed(Bytes, GridSizeOffset + 4, static_cast<uint32>(GridSize.Value.Y), 4);
+		TestFalse(GridSize.Key, Player.OpenMemory(MoveTemp(Bytes)));
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,388 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "HAL/PlatformProcess.h"
+#include "Replay/BattleReplay.h"
+#include "Simulation/AsyncBattleRunner.h"
+#include "Simulation/BattleSimBenchmark.h"
+#include "Simulation/BattleSimulation.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr auto GridBattleTestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+		EAutomationTestFlags::CommandletContext | EAutomationTestFlags::EngineFilter;
+
+	/** Small, crowded battles that end within a few hundred steps. */
+	FSimConfig MakeTestConfig(EMovementPlanner Planner)
+	{
+		FSimConfig Config;
+		Config.GridSize = FIntPoint(40, 40);
+		Config.UnitsPerTeam = 150;
+		Config.MoveSquaresPerStep = 2;
+		Config.MovementPlanner = Planner;
+		return Config;
+	}
+
+	TArray<TPair<FString, FSimConfig>> MakePlannerConfigs()
+	{
+		TArray<TPair<FString, FSimConfig>> Configs;
+		Configs.Emplace(TEXT("AStar"), MakeTestConfig(EMovementPlanner::AStar));
+		Configs.Emplace(TEXT("FlowField"), MakeTestConfig(EMovementPlanner::FlowField));
+		Configs.Emplace(TEXT("Hierarchical"), MakeTestConfig(EMovementPlanner::Hierarchical));
+
+		FSimConfig JumpPointConfig = MakeTestConfig(EMovementPlanner::AStar);
+		JumpPointConfig.PathSearchMode = EGridSearchMode::JumpPoint;
+		Configs.Emplace(TEXT("JumpPoint"), JumpPointConfig);
+		return Configs;
+	}
+
+	constexpr int32 TestFirstSeed = 1;
+	constexpr int32 TestNumSeeds = 4;
+	constexpr int32 TestMaxSteps = 200;
+
+	/** @return the name of the first field of Actual that differs from Expected, null if they match. */
+	const TCHAR* FindMismatchedDeltaField(const FStepDelta& Actual, const FStepDelta& Expected)
+	{
+		return Actual.Moves != Expected.Moves ? TEXT("Moves")
+			: Actual.Events != Expected.Events ? TEXT("Events")
+			: Actual.StateHash != Expected.StateHash ? TEXT("StateHash")
+			: nullptr;
+	}
+
+	/** Plays Config from Seed for up to TestMaxSteps, recording every delta and the units before and after each. */
+	void RecordBattle(const FSimConfig& Config, int32 Seed, TArray<FStepDelta>& OutDeltas, TArray<FSimUnitStore>& OutUnits)
+	{
+		FBattleSimulation Simulation(Config);
+		Simulation.Reset(Seed);
+
+		OutDeltas.Reset();
+		OutUnits.Reset();
+		OutUnits.AddDefaulted_GetRef().CopyFrom(Simulation.GetUnits());
+		while (OutDeltas.Num() < TestMaxSteps && !Simulation.IsBattleOver())
+		{
+			Simulation.Step(OutDeltas.AddDefaulted_GetRef());
+			OutUnits.AddDefaulted_GetRef().CopyFrom(Simulation.GetUnits());
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBattleSimParallelPlanningTest, "IlluviumSimCore.Simulation.ParallelPlanning", GridBattleTestFlags)
+
+bool FBattleSimParallelPlanningTest::RunTest(const FString& Parameters)
+{
+	FStepDelta SerialDelta;
+	FStepDelta ParallelDelta;
+	for (const TPair<FString, FSimConfig>& Config : MakePlannerConfigs())
+	{
+		FSimConfig SerialConfig = Config.Value;
+		SerialConfig.bParallelPlanning = false;
+		FSimConfig ParallelConfig = Config.Value;
+		ParallelConfig.bParallelPlanning = true;
+		ParallelConfig.ParallelPlanningMinUnits = 0;
+
+		int32 NumMoves = 0;
+		int32 NumEvents = 0;
+		for (int32 Seed = TestFirstSeed; Seed < TestFirstSeed + TestNumSeeds; ++Seed)
+		{
+			FBattleSimulation Serial(SerialConfig);
+			FBattleSimulation Parallel(ParallelConfig);
+			Serial.Reset(Seed);
+			Parallel.Reset(Seed);
+
+			while (Serial.GetStepCount() < TestMaxSteps && !Serial.IsBattleOver())
+			{
+				Serial.Step(SerialDelta);
+				Parallel.Step(ParallelDelta);
+				NumMoves += SerialDelta.Moves.Num();
+				NumEvents += SerialDelta.Events.Num();
+
+				const TCHAR* Mismatch = FindMismatchedDeltaField(ParallelDelta, SerialDelta);
+				if (!Mismatch) Mismatch = Parallel.GetUnits().FindMismatchedColumn(Serial.GetUnits());
+				if (Mismatch)
+				{
+					AddError(FString::Printf(TEXT("%s seed=%d step=%d: parallel %s differs from serial"), *Config.Key, Seed,
+					                         Serial.GetStepCount() - 1, Mismatch));
+					break;
+				}
+			}
+		}
+
+		// Plans made in parallel only get redone when units interfere, which takes both movement and fighting
+		TestTrue(FString::Printf(TEXT("%s: battles move and fight"), *Config.Key), NumMoves > 0 && NumEvents > 0);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBattleSimAsyncSteppingTest, "IlluviumSimCore.Simulation.AsyncStepping", GridBattleTestFlags)
+
+bool FBattleSimAsyncSteppingTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 MaxQueuedSteps = 4;
+
+	FAsyncBattleRunner Runner;
+	FStepDelta SyncDelta;
+	for (const TPair<FString, FSimConfig>& Config : MakePlannerConfigs())
+	{
+		for (int32 Seed = TestFirstSeed; Seed < TestFirstSeed + TestNumSeeds; ++Seed)
+		{
+			FBattleSimulation SyncSimulation(Config.Value);
+			FBattleSimulation AsyncSimulation(Config.Value);
+			SyncSimulation.Reset(Seed);
+			AsyncSimulation.Reset(Seed);
+			Runner.Start(AsyncSimulation, /*StepDurationSeconds*/ 0.f, MaxQueuedSteps);
+
+			int32 MaxQueued = 0;
+			while (SyncSimulation.GetStepCount() < TestMaxSteps && !SyncSimulation.IsBattleOver())
+			{
+				MaxQueued = FMath::Max(MaxQueued, Runner.GetNumQueuedSteps());
+				const FPublishedBattleStep* Published = Runner.PeekStep();
+				if (!Published)
+				{
+					FPlatformProcess::YieldThread();
+					continue;
+				}
+
+				SyncSimulation.Step(SyncDelta);
+				const TCHAR* Mismatch = FindMismatchedDeltaField(Published->Delta, SyncDelta);
+				if (!Mismatch && Published->StepCount != SyncSimulation.GetStepCount()) Mismatch = TEXT("StepCount");
+				if (!Mismatch && Published->bBattleOver != SyncSimulation.IsBattleOver()) Mismatch = TEXT("bBattleOver");
+				if (!Mismatch) Mismatch = Published->Units.FindMismatchedColumn(SyncSimulation.GetUnits());
+				Runner.PopStep();
+
+				if (Mismatch)
+				{
+					AddError(FString::Printf(TEXT("%s seed=%d step=%d: published %s differs from the synchronous step"),
+					                         *Config.Key, Seed, SyncSimulation.GetStepCount() - 1, Mismatch));
+					break;
+				}
+			}
+
+			Runner.Shutdown();
+			TestTrue(FString::Printf(TEXT("%s seed=%d: at most %d steps queued, saw %d"), *Config.Key, Seed, MaxQueuedSteps, MaxQueued),
+			         MaxQueued <= MaxQueuedSteps);
+			TestTrue(FString::Printf(TEXT("%s seed=%d: worker ran every consumed step"), *Config.Key, Seed),
+			         AsyncSimulation.GetStepCount() >= SyncSimulation.GetStepCount());
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBattleSimReplayTest, "IlluviumSimCore.Simulation.Replay", GridBattleTestFlags)
+
+bool FBattleSimReplayTest::RunTest(const FString& Parameters)
+{
+	// Several keyframes per battle, so seeks land on, between and past them
+	constexpr int32 KeyframeInterval = 50;
+
+	TArray<FStepDelta> RecordedDeltas;
+	TArray<FSimUnitStore> RecordedUnits;
+	FBattleReplayWriter Writer;
+	FBattleReplayPlayer Player;
+	FStepDelta PlayedDelta;
+	for (const TPair<FString, FSimConfig>& Config : MakePlannerConfigs())
+	{
+		int64 NumReplayBytes = 0;
+		int64 NumRawBytes = 0;
+		for (int32 Seed = TestFirstSeed; Seed < TestFirstSeed + TestNumSeeds; ++Seed)
+		{
+			RecordBattle(Config.Value, Seed, RecordedDeltas, RecordedUnits);
+			Writer.Begin(Config.Value, Seed, RecordedUnits[0], KeyframeInterval);
+			for (int32 StepIndex = 0; StepIndex < RecordedDeltas.Num(); ++StepIndex)
+			{
+				const FStepDelta& StepDelta = RecordedDeltas[StepIndex];
+				Writer.AppendStep(StepDelta, RecordedUnits[StepIndex + 1]);
+				NumRawBytes += StepDelta.Moves.Num() * sizeof(FSimMove) + StepDelta.Events.Num() * sizeof(FSimEvent);
+			}
+			TArray<uint8> Bytes = Writer.Finish();
+			NumReplayBytes += Bytes.Num();
+
+			const FString SeedName = FString::Printf(TEXT("%s seed=%d"), *Config.Key, Seed);
+			if (!TestTrue(SeedName + TEXT(": opens"), Player.OpenMemory(MoveTemp(Bytes)))) continue;
+
+			const int32 LastStep = RecordedDeltas.Num();
+			TestEqual(SeedName + TEXT(": NumSteps"), Player.GetNumSteps(), LastStep);
+			TestEqual(SeedName + TEXT(": NumKeyframes"), Player.GetHeader().NumKeyframes, 1 + LastStep / KeyframeInterval);
+			TestEqual(SeedName + TEXT(": Seed"), Player.GetHeader().Seed, Seed);
+
+			for (int32 StepIndex = 0; StepIndex < LastStep; ++StepIndex)
+			{
+				const TCHAR* Mismatch = !Player.ReadNextStep(PlayedDelta) ? TEXT("ReadNextStep")
+					: FindMismatchedDeltaField(PlayedDelta, RecordedDeltas[StepIndex]);
+				if (!Mismatch && Player.GetStateHash() != RecordedDeltas[StepIndex].StateHash) Mismatch = TEXT("player state hash");
+				if (!Mismatch) Mismatch = Player.GetUnits().FindMismatchedColumn(RecordedUnits[StepIndex + 1]);
+				if (Mismatch)
+				{
+					AddError(FString::Printf(TEXT("%s playback step=%d: %s differs from the recorded battle"), *SeedName,
+					                         StepIndex, Mismatch));
+					break;
+				}
+			}
+			TestTrue(SeedName + TEXT(": at end after playback"), Player.IsAtEnd());
+
+			// Backwards, onto keyframes, between them and past the end
+			const int32 SeekSteps[] = { LastStep / 2, 0, KeyframeInterval, KeyframeInterval + 1, LastStep - 1, LastStep, LastStep + 5 };
+			for (const int32 SeekStep : SeekSteps)
+			{
+				const int32 ExpectedStep = FMath::Clamp(SeekStep, 0, LastStep);
+				const TCHAR* Mismatch = !Player.SeekToStep(SeekStep) ? TEXT("SeekToStep")
+					: Player.GetCurrentStep() != ExpectedStep ? TEXT("current step")
+					: Player.GetUnits().FindMismatchedColumn(RecordedUnits[ExpectedStep]);
+				if (Mismatch)
+				{
+					AddError(FString::Printf(TEXT("%s seek step=%d: %s differs from the recorded battle"), *SeedName,
+					                         SeekStep, Mismatch));
+				}
+			}
+		}
+
+		TestTrue(FString::Printf(TEXT("%s: replay of %lld bytes smaller than the %lld bytes of raw deltas"), *Config.Key,
+		                         NumReplayBytes, NumRawBytes), NumReplayBytes < NumRawBytes);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBattleSimSnapshotsTest, "IlluviumSimCore.Simulation.Snapshots", GridBattleTestFlags)
+
+bool FBattleSimSnapshotsTest::RunTest(const FString& Parameters)
+{
+	// Kept paths and queued path requests travel in the snapshot as well
+	TArray<TPair<FString, FSimConfig>> Configs = MakePlannerConfigs();
+	FSimConfig CachedConfig = MakeTestConfig(EMovementPlanner::AStar);
+	CachedConfig.bCachePaths = true;
+	Configs.Emplace(TEXT("AStar/Cached"), CachedConfig);
+	FSimConfig ScheduledConfig = MakeTestConfig(EMovementPlanner::AStar);
+	ScheduledConfig.bSchedulePaths = true;
+	ScheduledConfig.PathBudgetPerStep = 256;
+	Configs.Emplace(TEXT("AStar/Scheduled"), ScheduledConfig);
+
+	TArray<FStepDelta> RecordedDeltas;
+	TArray<FSimUnitStore> RecordedUnits;
+	FBattleSimSnapshot Snapshot;
+	FBattleSimSnapshot Resaved;
+	FStepDelta StepDelta;
+	for (const TPair<FString, FSimConfig>& Config : Configs)
+	{
+		for (int32 Seed = TestFirstSeed; Seed < TestFirstSeed + TestNumSeeds; ++Seed)
+		{
+			const FString SeedName = FString::Printf(TEXT("%s seed=%d"), *Config.Key, Seed);
+			RecordBattle(Config.Value, Seed, RecordedDeltas, RecordedUnits);
+			if (!TestTrue(SeedName + TEXT(": battle lasts two steps"), RecordedDeltas.Num() >= 2)) continue;
+
+			// Halfway through, with paths kept and requests queued
+			FBattleSimulation Simulation(Config.Value);
+			Simulation.Reset(Seed);
+			while (Simulation.GetStepCount() < RecordedDeltas.Num() / 2)
+			{
+				Simulation.Step(StepDelta);
+			}
+			Simulation.SaveSnapshot(Snapshot);
+			while (!Simulation.IsBattleOver() && Simulation.GetStepCount() < RecordedDeltas.Num())
+			{
+				Simulation.Step(StepDelta);
+			}
+
+			FBattleSimulation Fork(Config.Value);
+			Fork.RestoreSnapshot(Snapshot);
+
+			// Saving right after restoring gives back the snapshot it came from
+			Fork.SaveSnapshot(Resaved);
+			const TCHAR* SnapshotMismatch = Resaved.StepCount != Snapshot.StepCount ? TEXT("StepCount")
+				: Resaved.NextUnitId != Snapshot.NextUnitId ? TEXT("NextUnitId")
+				: Resaved.RandomSeed != Snapshot.RandomSeed ? TEXT("RandomSeed")
+				: Resaved.NumUnits != Snapshot.NumUnits ? TEXT("NumUnits")
+				: Resaved.UnitData != Snapshot.UnitData ? TEXT("UnitData")
+				: Resaved.PathData != Snapshot.PathData ? TEXT("PathData")
+				: Resaved.ScheduleData != Snapshot.ScheduleData ? TEXT("ScheduleData")
+				: nullptr;
+			if (SnapshotMismatch)
+			{
+				AddError(FString::Printf(TEXT("%s: %s of the restored battle's snapshot differs"), *SeedName, SnapshotMismatch));
+			}
+
+			Simulation.RestoreSnapshot(Snapshot);
+			const TPair<const TCHAR*, FBattleSimulation*> Continuations[] = { { TEXT("fork"), &Fork }, { TEXT("rewind"), &Simulation } };
+			for (const TPair<const TCHAR*, FBattleSimulation*>& Continuation : Continuations)
+			{
+				FBattleSimulation& Continued = *Continuation.Value;
+				for (int32 StepIndex = Snapshot.StepCount; StepIndex < RecordedDeltas.Num(); ++StepIndex)
+				{
+					const TCHAR* Mismatch = Continued.IsBattleOver() ? TEXT("bBattleOver") : nullptr;
+					if (!Mismatch)
+					{
+						Continued.Step(StepDelta);
+						Mismatch = FindMismatchedDeltaField(StepDelta, RecordedDeltas[StepIndex]);
+					}
+					if (!Mismatch) Mismatch = Continued.GetUnits().FindMismatchedColumn(RecordedUnits[StepIndex + 1]);
+					if (Mismatch)
+					{
+						AddError(FString::Printf(TEXT("%s %s step=%d: %s differs from the original battle"), *SeedName,
+						                         Continuation.Key, StepIndex, Mismatch));
+						break;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBattleSimDeterminismTest, "IlluviumSimCore.Simulation.Determinism", GridBattleTestFlags)
+
+bool FBattleSimDeterminismTest::RunTest(const FString& Parameters)
+{
+	const TPair<FString, EDeterminismCheck> Checks[] = {
+		{ TEXT("RepeatSeed"), EDeterminismCheck::RepeatSeed },
+		{ TEXT("SerialVsParallel"), EDeterminismCheck::SerialVsParallel },
+		{ TEXT("ReplayVsLive"), EDeterminismCheck::ReplayVsLive }
+	};
+
+	for (const TPair<FString, FSimConfig>& Config : MakePlannerConfigs())
+	{
+		for (const TPair<FString, EDeterminismCheck>& Check : Checks)
+		{
+			for (int32 Seed = TestFirstSeed; Seed < TestFirstSeed + TestNumSeeds; ++Seed)
+			{
+				const FString SeedName = FString::Printf(TEXT("%s %s seed=%d"), *Config.Key, *Check.Key, Seed);
+				const FDivergenceReport Report = FBattleSimBenchmark::FindFirstDivergence(Config.Value, Check.Value, Seed, TestMaxSteps);
+
+				TestTrue(SeedName + TEXT(": steps compared"), Report.StepsCompared > 0);
+				if (Report.FirstDivergentStep != INDEX_NONE)
+				{
+					AddError(FString::Printf(TEXT("%s step=%d: %s differs"), *SeedName, Report.FirstDivergentStep,
+					                         Report.bMovesDiffer ? TEXT("Moves") : Report.bEventsDiffer ? TEXT("Events") : TEXT("StateHash")));
+				}
+				if (Report.FirstHashDriftStep != INDEX_NONE)
+				{
+					AddError(FString::Printf(TEXT("%s step=%d: maintained StateHash differs from a full recompute"), *SeedName,
+					                         Report.FirstHashDriftStep));
+				}
+			}
+		}
+	}
+
+	// The hash follows the units: other seeds spawn other units, and every attack changes HP and cooldowns
+	FBattleSimulation Simulation(MakeTestConfig(EMovementPlanner::AStar));
+	Simulation.Reset(TestFirstSeed + 1);
+	const uint64 OtherSeedHash = Simulation.GetStateHash();
+	Simulation.Reset(TestFirstSeed);
+	TestTrue(TEXT("Other seed, other StateHash"), Simulation.GetStateHash() != OtherSeedHash);
+
+	FStepDelta StepDelta;
+	while (Simulation.GetStepCount() < TestMaxSteps && !Simulation.IsBattleOver())
+	{
+		const uint64 HashBeforeStep = Simulation.GetStateHash();
+		Simulation.Step(StepDelta);
+		if (!StepDelta.Events.IsEmpty() && StepDelta.StateHash == HashBeforeStep)
+		{
+			AddError(FString::Printf(TEXT("step=%d: StateHash unchanged by %d events"), Simulation.GetStepCount() - 1,
+			                         StepDelta.Events.Num()));
+			break;
+		}
+	}
+	return true;
+}
+
+#endif
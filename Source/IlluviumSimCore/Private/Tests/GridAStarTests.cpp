@@ -0,0 +1,270 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Navigation/GridAStar.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr auto GridBattleTestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+		EAutomationTestFlags::CommandletContext | EAutomationTestFlags::EngineFilter;
+
+	const FGridCoordinate ReferenceNeighbourOffsets[4] { { +1, 0 }, { 0, +1 }, { -1, 0 }, { 0, -1 } };
+
+	/**
+	 * The search FGridAStar replaced: the whole open list is sorted before every pop and an improved cell overwrites
+	 * its open entry in place. Counts the open cells it found again at a lower cost into OutNumRediscovered.
+	 */
+	bool FindReferencePath(const FPathRequest& PathRequest, TArray<FGridCoordinate>& OutPath, int32& OutNumRediscovered)
+	{
+		OutPath.Reset();
+		if (!IsWithinGridBounds(PathRequest.Start, PathRequest.GridSize) ||
+			!IsWithinGridBounds(PathRequest.Goal, PathRequest.GridSize))
+		{
+			return false;
+		}
+
+		if (PathRequest.Start == PathRequest.Goal)
+		{
+			OutPath.Add(PathRequest.Goal);
+			return true;
+		}
+
+		TArray<FSearchNode> OpenListNodes;
+		TSet<FGridCoordinate> ClosedCoordinates;
+		TMap<FGridCoordinate, FSearchNode> BestNodeByCoordinate;
+		int32 InsertionCounter = 0;
+
+		const FSearchNode StartNode{ PathRequest.Start, 0, Manhattan(PathRequest.Start, PathRequest.Goal), { INT32_MIN, INT32_MIN }, InsertionCounter++ };
+		OpenListNodes.Add(StartNode);
+		BestNodeByCoordinate.Add(PathRequest.Start, StartNode);
+
+		while (!OpenListNodes.IsEmpty())
+		{
+			OpenListNodes.Sort([](const FSearchNode& A, const FSearchNode& B) { return A < B; });
+			const FSearchNode CurrentNode = OpenListNodes[0];
+			OpenListNodes.RemoveAt(0);
+
+			if (CurrentNode.Coordinate == PathRequest.Goal)
+			{
+				for (FGridCoordinate Coordinate = CurrentNode.Coordinate; Coordinate.X != INT32_MIN;
+				     Coordinate = BestNodeByCoordinate[Coordinate].ParentCoordinate)
+				{
+					OutPath.Add(Coordinate);
+				}
+				Algo::Reverse(OutPath);
+				return true;
+			}
+
+			ClosedCoordinates.Add(CurrentNode.Coordinate);
+
+			for (const FGridCoordinate& Offset : ReferenceNeighbourOffsets)
+			{
+				const FGridCoordinate NeighborCoordinate(CurrentNode.Coordinate.X + Offset.X, CurrentNode.Coordinate.Y + Offset.Y);
+				if (!IsWithinGridBounds(NeighborCoordinate, PathRequest.GridSize) ||
+					(!(NeighborCoordinate == PathRequest.Goal) && PathRequest.IsBlocked(NeighborCoordinate)) ||
+					ClosedCoordinates.Contains(NeighborCoordinate))
+				{
+					continue;
+				}
+
+				const int32 TentativeCostFromStart = CurrentNode.CostFromStart + 1;
+				const int32 TentativeEstimatedTotal = TentativeCostFromStart + Manhattan(NeighborCoordinate, PathRequest.Goal);
+
+				const FSearchNode* ExistingBestForNeighbor = BestNodeByCoordinate.Find(NeighborCoordinate);
+				const bool IsBetterPath =
+					(!ExistingBestForNeighbor) ||
+					(TentativeCostFromStart < ExistingBestForNeighbor->CostFromStart) ||
+					(TentativeCostFromStart == ExistingBestForNeighbor->CostFromStart &&
+					 TentativeEstimatedTotal < ExistingBestForNeighbor->EstimatedTotalCost);
+				if (!IsBetterPath)
+					continue;
+
+				const FSearchNode UpdatedNeighborNode{ NeighborCoordinate, TentativeCostFromStart, TentativeEstimatedTotal, CurrentNode.Coordinate, InsertionCounter++ };
+				BestNodeByCoordinate.Add(NeighborCoordinate, UpdatedNeighborNode);
+
+				const int32 ExistingIndex = OpenListNodes.IndexOfByPredicate([&](const FSearchNode& Node) { return Node.Coordinate == NeighborCoordinate; });
+				if (ExistingIndex != INDEX_NONE)
+				{
+					++OutNumRediscovered;
+					OpenListNodes[ExistingIndex] = UpdatedNeighborNode;
+				}
+				else
+				{
+					OpenListNodes.Add(UpdatedNeighborNode);
+				}
+			}
+		}
+		return false;
+	}
+
+	/** Blocks each cell of Occupancy with probability Density. */
+	void FillRandomObstacles(FRandomStream& Random, float Density, FGridOccupancy& Occupancy, const FIntPoint& GridSize)
+	{
+		Occupancy.Init(GridSize);
+		for (int32 Y = 0; Y < GridSize.Y; ++Y)
+		{
+			for (int32 X = 0; X < GridSize.X; ++X)
+			{
+				if (Random.FRand() < Density)
+				{
+					Occupancy.Set(FGridCoordinate(X, Y));
+				}
+			}
+		}
+	}
+
+	FGridCoordinate RandomCell(FRandomStream& Random, const FIntPoint& GridSize)
+	{
+		return FGridCoordinate(Random.RandRange(0, GridSize.X - 1), Random.RandRange(0, GridSize.Y - 1));
+	}
+
+	/** @return what is wrong with Path as a walk from Request's start to its goal, empty if nothing. */
+	FString FindIllegalStep(const FPathRequest& Request, const TArray<FGridCoordinate>& Path)
+	{
+		if (Path.IsEmpty() || !(Path[0] == Request.Start) || !(Path.Last() == Request.Goal))
+		{
+			return TEXT("does not lead from start to goal");
+		}
+		for (int32 CellIndex = 1; CellIndex < Path.Num(); ++CellIndex)
+		{
+			const FGridCoordinate& Cell = Path[CellIndex];
+			if (Manhattan(Path[CellIndex - 1], Cell) != 1)
+			{
+				return FString::Printf(TEXT("jumps from cell %d to (%d,%d)"), CellIndex - 1, Cell.X, Cell.Y);
+			}
+			if (!(Cell == Request.Goal) && Request.IsBlocked(Cell))
+			{
+				return FString::Printf(TEXT("walks through blocked cell (%d,%d)"), Cell.X, Cell.Y);
+			}
+		}
+		return FString();
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridAStarMatchesReferenceTest, "IlluviumSimCore.Navigation.AStar.MatchesReference", GridBattleTestFlags)
+
+bool FGridAStarMatchesReferenceTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumCases = 400;
+
+	FRandomStream Random(7);
+	FGridAStarContext Context;
+	FGridOccupancy Occupancy;
+	TArray<FGridCoordinate> Path, ReferencePath;
+	int32 NumFound = 0;
+	int32 NumRediscovered = 0;
+
+	for (int32 CaseIndex = 0; CaseIndex < NumCases; ++CaseIndex)
+	{
+		FPathRequest Request;
+		Request.GridSize = FIntPoint(Random.RandRange(5, 45), Random.RandRange(5, 45));
+		FillRandomObstacles(Random, Random.FRand() * 0.4f, Occupancy, Request.GridSize);
+		Request.Occupancy = &Occupancy;
+		Request.Start = RandomCell(Random, Request.GridSize);
+		Request.Goal = RandomCell(Random, Request.GridSize);
+
+		// One context across every case, as the simulation reuses them across searches and grid sizes
+		const bool bReferenceFound = FindReferencePath(Request, ReferencePath, NumRediscovered);
+		const bool bFound = FGridAStar::FindPath(Request, Path, Context);
+		NumFound += bReferenceFound;
+
+		const FString CaseName = FString::Printf(TEXT("Case %d, %dx%d from (%d,%d) to (%d,%d)"), CaseIndex,
+			Request.GridSize.X, Request.GridSize.Y, Request.Start.X, Request.Start.Y, Request.Goal.X, Request.Goal.Y);
+		if (!TestEqual(CaseName + TEXT(": found a path"), bFound, bReferenceFound) ||
+			!TestEqual(CaseName + TEXT(": path length"), Path.Num(), ReferencePath.Num()))
+		{
+			continue;
+		}
+
+		for (int32 CellIndex = 0; CellIndex < Path.Num(); ++CellIndex)
+		{
+			if (!(Path[CellIndex] == ReferencePath[CellIndex]))
+			{
+				AddError(FString::Printf(TEXT("%s: cell %d is (%d,%d), the reference took (%d,%d)"), *CaseName, CellIndex,
+					Path[CellIndex].X, Path[CellIndex].Y, ReferencePath[CellIndex].X, ReferencePath[CellIndex].Y));
+				break;
+			}
+		}
+	}
+
+	// Otherwise the fields were too open or too closed to say anything about tie-breaking
+	TestTrue(TEXT("Some cases found a path"), NumFound > NumCases / 2);
+	TestTrue(TEXT("Some searches found open cells again at a lower cost"), NumRediscovered > 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridJumpPointMatchesAStarTest, "IlluviumSimCore.Navigation.JumpPoint.MatchesAStarLength", GridBattleTestFlags)
+
+bool FGridJumpPointMatchesAStarTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 GridExtent = 80;
+	const FIntPoint GridSize(GridExtent, GridExtent);
+
+	struct FField
+	{
+		const TCHAR* Name;
+		FGridOccupancy Obstacles;
+	};
+	FField Fields[3] = { { TEXT("Open") }, { TEXT("WallWithGap") }, { TEXT("Random") } };
+	Fields[0].Obstacles.Init(GridSize);
+	Fields[1].Obstacles.Init(GridSize);
+	for (int32 Y = 0; Y < GridExtent; ++Y)
+	{
+		if (Y != GridExtent / 2) Fields[1].Obstacles.Set(FGridCoordinate(GridExtent / 2, Y));
+	}
+	FRandomStream Random(11);
+	FillRandomObstacles(Random, 0.25f, Fields[2].Obstacles, GridSize);
+
+	// Far enough apart vertically that open columns run past MaxVerticalJumpRows and turn at new jump points
+	TArray<TPair<FGridCoordinate, FGridCoordinate>> Endpoints = {
+		{ FGridCoordinate(3, 2), FGridCoordinate(70, 77) },
+		{ FGridCoordinate(70, 77), FGridCoordinate(3, 2) },
+		{ FGridCoordinate(10, 0), FGridCoordinate(10, GridExtent - 1) },
+		{ FGridCoordinate(GridExtent - 1, 5), FGridCoordinate(0, 60) }
+	};
+	for (int32 EndpointIndex = 0; EndpointIndex < 200; ++EndpointIndex)
+	{
+		Endpoints.Emplace(RandomCell(Random, GridSize), RandomCell(Random, GridSize));
+	}
+
+	FGridAStarContext Context;
+	TArray<FGridCoordinate> AStarPath, JumpPointPath;
+	for (const FField& Field : Fields)
+	{
+		int32 NumFound = 0;
+		for (const TPair<FGridCoordinate, FGridCoordinate>& Endpoint : Endpoints)
+		{
+			FPathRequest Request;
+			Request.GridSize = GridSize;
+			Request.Occupancy = &Field.Obstacles;
+			Request.Start = Endpoint.Key;
+			Request.Goal = Endpoint.Value;
+
+			const bool bAStarFound = FGridAStar::FindPath(Request, AStarPath, Context);
+			Request.SearchMode = EGridSearchMode::JumpPoint;
+			const bool bJumpPointFound = FGridAStar::FindPath(Request, JumpPointPath, Context);
+			NumFound += bAStarFound;
+
+			const FString CaseName = FString::Printf(TEXT("%s from (%d,%d) to (%d,%d)"), Field.Name,
+				Request.Start.X, Request.Start.Y, Request.Goal.X, Request.Goal.Y);
+			if (!TestEqual(CaseName + TEXT(": found a path"), bJumpPointFound, bAStarFound) || !bAStarFound)
+			{
+				continue;
+			}
+
+			TestEqual(CaseName + TEXT(": path length"), JumpPointPath.Num(), AStarPath.Num());
+			const FString IllegalStep = FindIllegalStep(Request, JumpPointPath);
+			if (!IllegalStep.IsEmpty())
+			{
+				AddError(CaseName + TEXT(": jump point path ") + IllegalStep);
+			}
+		}
+		TestTrue(FString::Printf(TEXT("%s: some endpoints are connected"), Field.Name), NumFound > Endpoints.Num() / 2);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,206 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Navigation/GridPathCache.h"
+#include "Simulation/BattleSimulation.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr auto GridBattleTestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+		EAutomationTestFlags::CommandletContext | EAutomationTestFlags::EngineFilter;
+
+	/** The cells of the straight runs between consecutive Corners. */
+	TArray<FGridCoordinate> MakeCornerPath(TConstArrayView<FGridCoordinate> Corners)
+	{
+		TArray<FGridCoordinate> Cells;
+		Cells.Add(Corners[0]);
+		for (int32 CornerIndex = 1; CornerIndex < Corners.Num(); ++CornerIndex)
+		{
+			const FGridCoordinate& To = Corners[CornerIndex];
+			while (!(Cells.Last() == To))
+			{
+				FGridCoordinate Cell = Cells.Last();
+				Cell.X += FMath::Sign(To.X - Cell.X);
+				if (Cell.X == Cells.Last().X) Cell.Y += FMath::Sign(To.Y - Cell.Y);
+				Cells.Add(Cell);
+			}
+		}
+		return Cells;
+	}
+
+	/** @return what is wrong with Path as an answer to Request, empty if nothing. */
+	FString FindIllegalStep(const FPathRequest& Request, const TArray<FGridCoordinate>& Path)
+	{
+		if (Path.IsEmpty() || !(Path[0] == Request.Start) || !(Path.Last() == Request.Goal))
+		{
+			return TEXT("does not lead from start to goal");
+		}
+		for (int32 CellIndex = 1; CellIndex < Path.Num(); ++CellIndex)
+		{
+			const FGridCoordinate& Cell = Path[CellIndex];
+			if (Manhattan(Path[CellIndex - 1], Cell) != 1)
+			{
+				return FString::Printf(TEXT("jumps from cell %d to (%d,%d)"), CellIndex - 1, Cell.X, Cell.Y);
+			}
+			if (!(Cell == Request.Goal) && Request.IsBlocked(Cell))
+			{
+				return FString::Printf(TEXT("walks through blocked cell (%d,%d)"), Cell.X, Cell.Y);
+			}
+		}
+		return FString();
+	}
+
+	const TCHAR* GetResultName(EPathCacheResult Result)
+	{
+		switch (Result)
+		{
+		case EPathCacheResult::Hit: return TEXT("Hit");
+		case EPathCacheResult::Repaired: return TEXT("Repaired");
+		case EPathCacheResult::Replanned: return TEXT("Replanned");
+		case EPathCacheResult::Partial: return TEXT("Partial");
+		default: return TEXT("NoPath");
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathCacheResultsTest, "IlluviumSimCore.Navigation.PathCache.Results", GridBattleTestFlags)
+
+bool FGridPathCacheResultsTest::RunTest(const FString& Parameters)
+{
+	const FIntPoint GridSize(8, 8);
+
+	// Right along the top row, then down the fifth column
+	const FGridCoordinate CachedCorners[] = { { 0, 0 }, { 4, 0 }, { 4, 4 } };
+	FCachedGridPath CachedPath;
+	CachedPath.Assign(MakeCornerPath(CachedCorners));
+
+	struct FCacheCase
+	{
+		const TCHAR* Name;
+		FGridCoordinate Start;
+		FGridCoordinate Goal;
+		TArray<FGridCoordinate> Blocked;
+		EPathCacheResult Expected;
+		int32 MaxWalkedCells = 2;
+		int32 MaxExpansions = MAX_int32;
+		bool bCached = true;
+	};
+	const FCacheCase Cases[] = {
+		{ TEXT("Walked along an unchanged path"), { 2, 0 }, { 4, 4 }, {}, EPathCacheResult::Hit },
+		{ TEXT("Goal moved on past the end"), { 1, 0 }, { 4, 6 }, {}, EPathCacheResult::Repaired },
+		{ TEXT("Goal moved back inside the path's box"), { 0, 0 }, { 3, 3 }, {}, EPathCacheResult::Repaired },
+		{ TEXT("Run blocked around a corner"), { 0, 0 }, { 4, 4 }, { { 3, 0 }, { 4, 0 }, { 4, 1 } }, EPathCacheResult::Repaired },
+		{ TEXT("Run blocked on a straight stretch"), { 0, 0 }, { 4, 4 }, { { 2, 0 } }, EPathCacheResult::Replanned },
+		{ TEXT("Blocked with only a longer way round"), { 4, 1 }, { 4, 4 }, { { 4, 2 } }, EPathCacheResult::Replanned, 5 },
+		{ TEXT("Start off the path"), { 1, 1 }, { 4, 4 }, {}, EPathCacheResult::Replanned },
+		{ TEXT("Walked further than allowed"), { 3, 0 }, { 4, 4 }, {}, EPathCacheResult::Replanned },
+		{ TEXT("Nothing cached"), { 0, 0 }, { 4, 4 }, {}, EPathCacheResult::Replanned, 2, MAX_int32, false },
+		{ TEXT("Search out of budget"), { 1, 1 }, { 7, 7 }, {}, EPathCacheResult::Partial, 2, 4 },
+		{ TEXT("Goal walled in"), { 2, 0 }, { 4, 4 }, { { 3, 4 }, { 5, 4 }, { 4, 3 }, { 4, 5 } }, EPathCacheResult::NoPath }
+	};
+
+	FGridAStarContext Context;
+	FGridOccupancy Occupancy;
+	FCachedGridPath EmptyPath;
+	for (const FCacheCase& Case : Cases)
+	{
+		Occupancy.Init(GridSize);
+		for (const FGridCoordinate& Cell : Case.Blocked)
+		{
+			Occupancy.Set(Cell);
+		}
+
+		FPathRequest Request;
+		Request.Start = Case.Start;
+		Request.Goal = Case.Goal;
+		Request.GridSize = GridSize;
+		Request.Occupancy = &Occupancy;
+		Request.MaxExpansions = Case.MaxExpansions;
+		Request.bAllowPartialPath = Case.MaxExpansions != MAX_int32;
+
+		TArray<FGridCoordinate> Path;
+		FCachedGridPath UpdatedPath;
+		FGridCoordinate ReadMin, ReadMax;
+		const EPathCacheResult Result = FGridPathCache::FindPath(Case.bCached ? CachedPath : EmptyPath, Case.MaxWalkedCells,
+		                                                         Request, Path, UpdatedPath, Context, ReadMin, ReadMax);
+		if (!TestTrue(FString::Printf(TEXT("%s: result %s, expected %s"), Case.Name, GetResultName(Result),
+		                              GetResultName(Case.Expected)), Result == Case.Expected))
+		{
+			continue;
+		}
+
+		if (Result == EPathCacheResult::NoPath)
+		{
+			TestEqual(FString::Printf(TEXT("%s: path cells"), Case.Name), Path.Num(), 0);
+			TestFalse(FString::Printf(TEXT("%s: keeps a path"), Case.Name), UpdatedPath.IsSet());
+			continue;
+		}
+		if (Result == EPathCacheResult::Partial)
+		{
+			TestTrue(FString::Printf(TEXT("%s: starts at Start"), Case.Name), !Path.IsEmpty() && Path[0] == Case.Start);
+			TestFalse(FString::Printf(TEXT("%s: keeps the partial path"), Case.Name), UpdatedPath.IsSet());
+			continue;
+		}
+
+		const FString IllegalStep = FindIllegalStep(Request, Path);
+		if (!IllegalStep.IsEmpty())
+		{
+			AddError(FString::Printf(TEXT("%s: path %s"), Case.Name, *IllegalStep));
+			continue;
+		}
+
+		TArray<FGridCoordinate> SearchedPath;
+		FGridAStar::FindPath(Request, SearchedPath, Context);
+		TestEqual(FString::Printf(TEXT("%s: path cells against a fresh search"), Case.Name), Path.Num(), SearchedPath.Num());
+
+		// Only Manhattan-length paths are kept, the longer way round is searched again next time
+		const bool bManhattanLength = Path.Num() - 1 == Manhattan(Case.Start, Case.Goal);
+		TestEqual(FString::Printf(TEXT("%s: keeps the path"), Case.Name), UpdatedPath.IsSet(), bManhattanLength);
+		if (UpdatedPath.IsSet())
+		{
+			TArray<FGridCoordinate> KeptPath;
+			UpdatedPath.Decode(KeptPath);
+			TestTrue(FString::Printf(TEXT("%s: kept path is the one returned"), Case.Name), KeptPath == Path);
+		}
+
+		for (const FGridCoordinate& Cell : Case.Blocked)
+		{
+			TestTrue(FString::Printf(TEXT("%s: read box holds blocked cell (%d,%d)"), Case.Name, Cell.X, Cell.Y),
+			         Cell.X >= ReadMin.X && Cell.X <= ReadMax.X && Cell.Y >= ReadMin.Y && Cell.Y <= ReadMax.Y);
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathCacheBattleTest, "IlluviumSimCore.Navigation.PathCache.Battle", GridBattleTestFlags)
+
+bool FGridPathCacheBattleTest::RunTest(const FString& Parameters)
+{
+	// Small and crowded, so units both walk their paths undisturbed and get cut off by others
+	FSimConfig Config;
+	Config.GridSize = FIntPoint(40, 40);
+	Config.UnitsPerTeam = 150;
+	Config.MoveSquaresPerStep = 2;
+	Config.MovementPlanner = EMovementPlanner::AStar;
+	Config.bCachePaths = true;
+
+	FBattleSimulation Simulation(Config);
+	Simulation.Reset(1);
+	FStepDelta StepDelta;
+	while (Simulation.GetStepCount() < 100 && !Simulation.IsBattleOver())
+	{
+		Simulation.Step(StepDelta);
+	}
+
+	const FPathCacheStats& Stats = Simulation.GetPathCacheStats();
+	TestTrue(TEXT("Units walk cached paths"), Stats.Hits > 0);
+	TestTrue(TEXT("Units repair cached paths"), Stats.Repairs > 0);
+	TestTrue(TEXT("Units replan"), Stats.Replans > 0);
+	TestTrue(TEXT("Most plans avoid a full search"), Stats.Hits + Stats.Repairs > Stats.Replans);
+	return true;
+}
+
+#endif
@@ -0,0 +1,286 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Navigation/GridPathScheduler.h"
+#include "Simulation/BattleSimulation.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr auto GridBattleTestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+		EAutomationTestFlags::CommandletContext | EAutomationTestFlags::EngineFilter;
+
+	constexpr int32 TestGridExtent = 20;
+
+	/** What Serve() handed one requester. */
+	struct FServedPath
+	{
+		int32 RequesterId;
+		EGridSearchResult Result;
+		TArray<FGridCoordinate> Path;
+	};
+
+	FPathRequest MakeBaseRequest()
+	{
+		FPathRequest Base;
+		Base.GridSize = FIntPoint(TestGridExtent, TestGridExtent);
+		return Base;
+	}
+
+	/** Serves Scheduler once, appending every requester it answered to OutServed. */
+	void Serve(FGridPathScheduler& Scheduler, int32 MaxExpansions, TArray<FServedPath>& OutServed)
+	{
+		Scheduler.Serve(MakeBaseRequest(), MaxExpansions, 0.0,
+			[&OutServed](int32 RequesterId, EGridSearchResult Result, const TArray<FGridCoordinate>& Path)
+			{
+				OutServed.Add({RequesterId, Result, Path});
+			});
+	}
+
+	const FServedPath* FindServed(const TArray<FServedPath>& Served, int32 RequesterId)
+	{
+		return Served.FindByPredicate([RequesterId](const FServedPath& Path) { return Path.RequesterId == RequesterId; });
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathSchedulerCoalesceTest, "IlluviumSimCore.Navigation.PathScheduler.Coalesce", GridBattleTestFlags)
+
+bool FGridPathSchedulerCoalesceTest::RunTest(const FString& Parameters)
+{
+	FGridPathScheduler Scheduler;
+	Scheduler.Reset(TestGridExtent);
+
+	const FGridCoordinate Start(1, 1);
+	const FGridCoordinate Goal(12, 7);
+	Scheduler.Enqueue(1, Start, Goal, 10);
+	Scheduler.Enqueue(2, Start, Goal, 10);
+	Scheduler.Enqueue(2, Start, Goal, 10);
+	Scheduler.Enqueue(3, Start, FGridCoordinate(3, 9), 10);
+
+	TestEqual(TEXT("Queue depth"), Scheduler.GetQueueDepth(), 2);
+	TestEqual(TEXT("Coalesced requests"), Scheduler.GetStats().Coalesced, int64(2));
+
+	TArray<FServedPath> Served;
+	Serve(Scheduler, MAX_int32, Served);
+
+	TestEqual(TEXT("Searches"), Scheduler.GetStats().Searches, int64(2));
+	TestEqual(TEXT("Requesters served"), Served.Num(), 3);
+	const FServedPath* First = FindServed(Served, 1);
+	const FServedPath* Second = FindServed(Served, 2);
+	if (TestTrue(TEXT("Both requesters of the shared search served"), First && Second))
+	{
+		TestTrue(TEXT("Shared search answered in the order asked"), First < Second);
+		TestTrue(TEXT("Shared search result"), First->Result == EGridSearchResult::Found && Second->Result == EGridSearchResult::Found);
+		TestTrue(TEXT("Shared search path"), First->Path == Second->Path);
+		TestEqual(TEXT("Shared search path cells"), First->Path.Num(), Manhattan(Start, Goal) + 1);
+	}
+	TestEqual(TEXT("Queue depth once served"), Scheduler.GetQueueDepth(), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathSchedulerBudgetTest, "IlluviumSimCore.Navigation.PathScheduler.Budget", GridBattleTestFlags)
+
+bool FGridPathSchedulerBudgetTest::RunTest(const FString& Parameters)
+{
+	FGridPathScheduler Scheduler;
+	Scheduler.Reset(TestGridExtent);
+
+	const FGridCoordinate Start(0, 0);
+	const FGridCoordinate Goal(19, 19);
+	Scheduler.Enqueue(1, Start, Goal, 0);
+	Scheduler.Enqueue(2, FGridCoordinate(5, 5), FGridCoordinate(6, 5), 1);
+
+	constexpr int32 MaxExpansions = 8;
+	TArray<FServedPath> Served;
+	Serve(Scheduler, MaxExpansions, Served);
+
+	const FPathSchedulerStats& Stats = Scheduler.GetStats();
+	TestEqual(TEXT("Searches"), Stats.Searches, int64(1));
+	TestEqual(TEXT("Partial searches"), Stats.PartialSearches, int64(1));
+	TestTrue(TEXT("Nodes expanded within budget"), Stats.NodesExpanded <= MaxExpansions);
+	TestTrue(TEXT("Request behind the budget still queued"), Scheduler.IsQueued(2));
+
+	if (TestEqual(TEXT("Requesters served"), Served.Num(), 1))
+	{
+		const FServedPath& Partial = Served[0];
+		TestEqual(TEXT("Served requester"), Partial.RequesterId, 1);
+		TestTrue(TEXT("Result is out of budget"), Partial.Result == EGridSearchResult::OutOfBudget);
+		TestTrue(TEXT("Partial path leads away from Start"), Partial.Path.Num() > 1 && Partial.Path[0] == Start);
+		TestTrue(TEXT("Partial path stops short of Goal"), !Partial.Path.IsEmpty() && !(Partial.Path.Last() == Goal));
+	}
+
+	Served.Reset();
+	Serve(Scheduler, MaxExpansions, Served);
+	TestTrue(TEXT("Next Serve() answers the waiting request"), Served.Num() == 1 && Served[0].RequesterId == 2 &&
+	         Served[0].Result == EGridSearchResult::Found);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathSchedulerAgingTest, "IlluviumSimCore.Navigation.PathScheduler.Aging", GridBattleTestFlags)
+
+bool FGridPathSchedulerAgingTest::RunTest(const FString& Parameters)
+{
+	// One search per Serve() against a stream of urgent requests, so only aging gets the slow one through
+	constexpr int32 SlowPriority = 40;
+	constexpr int32 MaxFrames = 100;
+	constexpr int32 SlowRequesterId = 0;
+
+	for (const int32 AgingPerFrame : { 2, 0 })
+	{
+		FGridPathScheduler Scheduler;
+		Scheduler.Reset(TestGridExtent);
+		Scheduler.AgingPerFrame = AgingPerFrame;
+		Scheduler.Enqueue(SlowRequesterId, FGridCoordinate(0, 0), FGridCoordinate(1, 0), SlowPriority);
+
+		int32 ServedFrame = INDEX_NONE;
+		TArray<FServedPath> Served;
+		for (int32 Frame = 0; Frame < MaxFrames && ServedFrame == INDEX_NONE; ++Frame)
+		{
+			Scheduler.Enqueue(Frame + 1, FGridCoordinate(Frame % TestGridExtent, 5), FGridCoordinate(Frame % TestGridExtent, 6), 0);
+
+			Served.Reset();
+			Serve(Scheduler, 1, Served);
+			if (FindServed(Served, SlowRequesterId)) ServedFrame = Frame;
+		}
+
+		if (AgingPerFrame > 0)
+		{
+			// Newer urgent requests count AgingPerFrame higher every frame, ties go to the older request
+			const int32 ExpectedFrame = SlowPriority / AgingPerFrame;
+			TestEqual(TEXT("Frame the aged request is served on"), ServedFrame, ExpectedFrame);
+			TestEqual(TEXT("Max latency"), Scheduler.GetStats().MaxLatencyFrames, ExpectedFrame);
+		}
+		else
+		{
+			TestEqual(TEXT("Frame the request is served on without aging"), ServedFrame, int32(INDEX_NONE));
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathSchedulerWriteReadTest, "IlluviumSimCore.Navigation.PathScheduler.WriteRead", GridBattleTestFlags)
+
+bool FGridPathSchedulerWriteReadTest::RunTest(const FString& Parameters)
+{
+	FGridPathScheduler Scheduler;
+	Scheduler.Reset(TestGridExtent);
+
+	// Shared, replaced and aged requests, some of them served before the queue is written and the last one queued
+	// ahead of older ones
+	Scheduler.Enqueue(1, FGridCoordinate(0, 0), FGridCoordinate(10, 10), 20);
+	Scheduler.Enqueue(2, FGridCoordinate(0, 0), FGridCoordinate(10, 10), 20);
+	Scheduler.Enqueue(3, FGridCoordinate(4, 4), FGridCoordinate(4, 15), 5);
+	Scheduler.Enqueue(4, FGridCoordinate(19, 0), FGridCoordinate(0, 19), 30);
+	TArray<FServedPath> Served;
+	Serve(Scheduler, 16, Served);
+	Scheduler.Enqueue(4, FGridCoordinate(18, 0), FGridCoordinate(0, 19), 30);
+	Scheduler.Enqueue(5, FGridCoordinate(2, 2), FGridCoordinate(3, 3), 1);
+
+	TArray<uint8> Bytes;
+	Scheduler.Write(Bytes);
+	Bytes.Add(0xAB);
+
+	FGridPathScheduler Restored;
+	Restored.Reset(TestGridExtent);
+	const uint8* End = Restored.Read(Bytes.GetData());
+	TestTrue(TEXT("Read stops where Write stopped"), End == Bytes.GetData() + Bytes.Num() - 1);
+	TestEqual(TEXT("Queue depth"), Restored.GetQueueDepth(), Scheduler.GetQueueDepth());
+	for (int32 RequesterId = 1; RequesterId <= 5; ++RequesterId)
+	{
+		TestEqual(FString::Printf(TEXT("Requester %d queued"), RequesterId), Restored.IsQueued(RequesterId), Scheduler.IsQueued(RequesterId));
+	}
+
+	// Requests for a queued start and goal still join it
+	Scheduler.Enqueue(6, FGridCoordinate(2, 2), FGridCoordinate(3, 3), 1);
+	Restored.Enqueue(6, FGridCoordinate(2, 2), FGridCoordinate(3, 3), 1);
+	TestEqual(TEXT("Coalesced after Read"), Restored.GetStats().Coalesced, int64(1));
+
+	// Both queues serve the same requesters in the same order with the same paths, a little at a time
+	TArray<FServedPath> Expected;
+	TArray<FServedPath> Actual;
+	for (int32 Frame = 0; Frame < 20 && Scheduler.GetQueueDepth() > 0; ++Frame)
+	{
+		Serve(Scheduler, 16, Expected);
+		Serve(Restored, 16, Actual);
+	}
+	TestEqual(TEXT("Queue depth once drained"), Restored.GetQueueDepth(), 0);
+
+	if (!TestEqual(TEXT("Requesters served"), Actual.Num(), Expected.Num())) return true;
+	for (int32 Index = 0; Index < Expected.Num(); ++Index)
+	{
+		const TCHAR* Field = Actual[Index].RequesterId != Expected[Index].RequesterId ? TEXT("RequesterId")
+			: Actual[Index].Result != Expected[Index].Result ? TEXT("Result")
+			: Actual[Index].Path != Expected[Index].Path ? TEXT("Path")
+			: nullptr;
+		if (Field)
+		{
+			AddError(FString::Printf(TEXT("Served request %d differs after Read: %s"), Index, Field));
+			break;
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathSchedulerBattleTest, "IlluviumSimCore.Navigation.PathScheduler.Battle", GridBattleTestFlags)
+
+bool FGridPathSchedulerBattleTest::RunTest(const FString& Parameters)
+{
+	// A budget small enough that requests queue up for several steps
+	FSimConfig Config;
+	Config.GridSize = FIntPoint(40, 40);
+	Config.UnitsPerTeam = 150;
+	Config.MoveSquaresPerStep = 2;
+	Config.MovementPlanner = EMovementPlanner::AStar;
+	Config.bSchedulePaths = true;
+	Config.PathBudgetPerStep = 256;
+
+	FBattleSimulation Simulation(Config);
+	Simulation.Reset(1);
+
+	// Copies of the paths units were waiting on when the step started
+	TMap<int32, TArray<FGridCoordinate>> WaitingPaths;
+	FStepDelta StepDelta;
+	int32 NumWaitingMoves = 0;
+	while (Simulation.GetStepCount() < 100 && !Simulation.IsBattleOver())
+	{
+		WaitingPaths.Reset();
+		const FSimUnitStore& Units = Simulation.GetUnits();
+		for (const int32 UnitId : Units.Ids)
+		{
+			if (Simulation.IsWaitingForPath(UnitId))
+			{
+				const TArrayView<const FGridCoordinate> Cells = Simulation.GetFollowedPath(UnitId);
+				WaitingPaths.Add(UnitId, TArray<FGridCoordinate>(Cells.GetData(), Cells.Num()));
+			}
+		}
+
+		const int32 Step = Simulation.GetStepCount();
+		Simulation.Step(StepDelta);
+
+		for (const FSimMove& Move : StepDelta.Moves)
+		{
+			const TArray<FGridCoordinate>* Cells = WaitingPaths.Find(Move.ActorId);
+			if (!Cells) continue;
+
+			++NumWaitingMoves;
+			const int32 FromIndex = Cells->Find(Move.From);
+			const int32 ToIndex = Cells->Find(Move.To);
+			if (FromIndex == INDEX_NONE || ToIndex <= FromIndex || ToIndex - FromIndex > Config.MoveSquaresPerStep)
+			{
+				AddError(FString::Printf(TEXT("step=%d unit=%d waiting for a path moved (%d,%d)->(%d,%d) off the %d cells it follows"),
+				                         Step, Move.ActorId, Move.From.X, Move.From.Y, Move.To.X, Move.To.Y, Cells->Num()));
+				return true;
+			}
+		}
+	}
+
+	const FPathSchedulerStats& Stats = Simulation.GetPathSchedulerStats();
+	TestTrue(TEXT("Requests wait through several steps"), Stats.MaxLatencyFrames > 1);
+	TestTrue(TEXT("Requests share searches"), Stats.Coalesced > 0);
+	TestTrue(TEXT("Units move while waiting for a path"), NumWaitingMoves > 0);
+	return true;
+}
+
+#endif
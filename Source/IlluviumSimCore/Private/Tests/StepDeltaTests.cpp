@@ -0,0 +1,94 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BattleTypes.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+#include "Simulation/BattleSimBenchmark.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr auto GridBattleTestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+		EAutomationTestFlags::CommandletContext | EAutomationTestFlags::EngineFilter;
+
+	/** The fields NetSerialize reads before any move or event, followed by ExtraBits zero bits. */
+	void WriteStepHeader(FBitWriter& Writer, uint32 NumMoves, uint32 NumEvents, uint32 GridX, uint32 GridY, int32 ExtraBits = 0)
+	{
+		uint64 StateHash = 0;
+		Writer.SerializeIntPacked(NumMoves);
+		Writer.SerializeIntPacked(NumEvents);
+		Writer.SerializeIntPacked(GridX);
+		Writer.SerializeIntPacked(GridY);
+		Writer << StateHash;
+
+		for (int32 BitIndex = 0; BitIndex < ExtraBits; ++BitIndex)
+		{
+			uint8 Bit = 0;
+			Writer.SerializeBits(&Bit, 1);
+		}
+	}
+
+	bool ReadStep(FBitWriter& Writer, FStepDelta& OutDelta)
+	{
+		bool bSuccess = false;
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		OutDelta.NetSerialize(Reader, nullptr, bSuccess);
+		return bSuccess;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStepDeltaNetSerializeLoopbackTest, "IlluviumSimCore.StepDelta.NetSerializeLoopback", GridBattleTestFlags)
+
+bool FStepDeltaNetSerializeLoopbackTest::RunTest(const FString& Parameters)
+{
+	FSimConfig Config;
+	Config.MoveSquaresPerStep = 2;
+	TestEqual(TEXT("Steps that do not decode to the original delta"), FBattleSimBenchmark::VerifyNetSerialization(Config, 50), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStepDeltaNetSerializeMalformedTest, "IlluviumSimCore.StepDelta.NetSerializeMalformed", GridBattleTestFlags)
+
+bool FStepDeltaNetSerializeMalformedTest::RunTest(const FString& Parameters)
+{
+	struct FMalformedHeader
+	{
+		const TCHAR* Name;
+		uint32 NumMoves;
+		uint32 NumEvents;
+		uint32 GridX;
+		uint32 GridY;
+	};
+	const FMalformedHeader Headers[] = {
+		{ TEXT("Event count negative as int32"), 0, 3200000000u, 100, 100 },
+		{ TEXT("Move count of a full maximum grid"), 1u << 30, 0, 1u << 15, 1u << 15 },
+		{ TEXT("Grid wider than any step runs on"), 0, 0, (1u << 15) + 1, 1 },
+		{ TEXT("More moves than cells"), 101, 0, 10, 10 },
+		{ TEXT("Counts within the caps but no bits behind them"), 60000, 180000, 1000, 1000 }
+	};
+
+	FStepDelta Decoded;
+	for (const FMalformedHeader& Header : Headers)
+	{
+		FBitWriter Writer(0, /*bAllowResize*/ true);
+		WriteStepHeader(Writer, Header.NumMoves, Header.NumEvents, Header.GridX, Header.GridY);
+		TestFalse(Header.Name, ReadStep(Writer, Decoded));
+
+		// Nothing past the header is there to decode, so nothing is kept from it
+		TestTrue(FString::Printf(TEXT("%s: decoded no more than the packet holds"), Header.Name),
+		         Decoded.Moves.Num() <= 1 && Decoded.Events.Num() <= 1);
+	}
+
+	// A few hundred zero bits decode to at most that many moves before running out
+	FBitWriter Writer(0, /*bAllowResize*/ true);
+	WriteStepHeader(Writer, 60000, 0, 1000, 1000, 256);
+	TestFalse(TEXT("Truncated moves"), ReadStep(Writer, Decoded));
+	TestTrue(TEXT("Truncated moves: decoded no more than the packet holds"), Decoded.Moves.Num() <= 256);
+
+	return true;
+}
+
+#endif
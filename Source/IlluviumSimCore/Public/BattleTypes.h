@@ -0,0 +1,200 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+#include "Navigation/GridAStar.h"
+#include "UObject/Object.h"
+#include "BattleTypes.generated.h"
+
+UENUM(BlueprintType)
+enum class EBattleTeam : uint8
+{
+	Red,
+	Blue
+};
+
+UENUM(BlueprintType)
+enum class EMovementPlanner : uint8
+{
+	// One A* search per moving unit towards its closest enemy
+	AStar,
+	// One multi-source distance field per team, units step downhill towards the nearest enemy
+	FlowField,
+	// HPA*: a search over precomputed cluster entrances, refined only as far as the unit walks this step
+	Hierarchical
+};
+
+UENUM(BlueprintType)
+enum class EEventType : uint8
+{
+	Attack,
+	Hit,
+	Die
+};
+
+USTRUCT(BlueprintType)
+struct FSimConfig
+{
+	GENERATED_USTRUCT_BODY()
+	FIntPoint GridSize = {100, 100};
+
+	/**
+	 * Walls no unit enters, with their regions, shared read-only between simulations. AGridGameState takes them from
+	 * the AGridMap. Null means an open grid; ignored unless it matches GridSize.
+	 */
+	TSharedPtr<const FGridRegionLabels> StaticObstacles;
+
+	// Core rules
+	UPROPERTY(EditAnywhere)
+	int32 MoveSquaresPerStep = 1;
+	UPROPERTY(EditAnywhere)
+	int32 AttackRangeSquares = 1;
+	UPROPERTY(EditAnywhere)
+	int32 AttackPeriodSteps = 2;
+	UPROPERTY(EditAnywhere)
+	int32 MinHP = 2;
+	UPROPERTY(EditAnywhere)
+	int32 MaxHP = 5;
+
+	// Setup
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1"))
+	int32 UnitsPerTeam = 1;
+	UPROPERTY(EditAnywhere)
+	EMovementPlanner MovementPlanner = EMovementPlanner::AStar;
+	/** Side of the square clusters the hierarchical planner cuts the grid into. */
+	UPROPERTY(EditAnywhere, meta=(ClampMin="4", ClampMax="16", EditCondition="MovementPlanner == EMovementPlanner::Hierarchical"))
+	int32 HierarchyClusterSize = 16;
+	/** Search the A* planner runs. Jump point search finds equally short paths, but not always the same ones. */
+	UPROPERTY(EditAnywhere, meta=(EditCondition="MovementPlanner == EMovementPlanner::AStar"))
+	EGridSearchMode PathSearchMode = EGridSearchMode::AStar;
+	/**
+	 * Units keep their path between steps and only repair the parts that broke, searching again only when a repair
+	 * would make it longer. Paths stay shortest paths, but not always the ones a fresh search would pick, so battles
+	 * differ from uncached ones.
+	 */
+	UPROPERTY(EditAnywhere, meta=(EditCondition="MovementPlanner == EMovementPlanner::AStar"))
+	bool bCachePaths = false;
+	/**
+	 * Units follow the last path they were handed and queue a new search when their target moved off its end or the
+	 * path ran out or got blocked. The queue is served after every step within PathBudgetPerStep, closest units
+	 * first, and units still waiting keep following their old path. Takes precedence over bCachePaths.
+	 */
+	UPROPERTY(EditAnywhere, meta=(EditCondition="MovementPlanner == EMovementPlanner::AStar"))
+	bool bSchedulePaths = false;
+
+	// Performance
+	/** Plans targets and moves on worker threads, then resolves them in unit order. Step results are unchanged. */
+	UPROPERTY(EditAnywhere)
+	bool bParallelPlanning = true;
+	/** Fewer living units than this are planned serially, where task overhead outweighs the searches. */
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0", EditCondition="bParallelPlanning"))
+	int32 ParallelPlanningMinUnits = 64;
+	/**
+	 * Caps the nodes one A* planning search may expand, 0 for no cap. A unit whose search runs out heads for the
+	 * cell closest to its target that the search reached and searches again next step, which bounds the worst-case
+	 * step time at the price of detours.
+	 */
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0", EditCondition="MovementPlanner == EMovementPlanner::AStar"))
+	int32 MaxPathExpansions = 0;
+	/** Nodes the scheduled searches may expand per step, 0 for no cap. */
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0", EditCondition="bSchedulePaths"))
+	int32 PathBudgetPerStep = 4096;
+	/**
+	 * Also stops serving scheduled searches after this long per step, 0 for no limit. Battles then depend on how
+	 * fast the machine is, so replays, snapshots and parallel planning no longer reproduce them.
+	 */
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0", EditCondition="bSchedulePaths"))
+	int32 PathBudgetMicroseconds = 0;
+
+	// Random seed
+	UPROPERTY(EditAnywhere)
+	int32 Seed = 1337;
+};
+
+USTRUCT()
+struct FSimEvent
+{
+	GENERATED_USTRUCT_BODY()
+	
+	UPROPERTY()	
+	EEventType EventType = EEventType::Attack;
+	UPROPERTY()
+	int32 ActorId = -1;
+	UPROPERTY()
+	int32 OtherId = -1;
+
+	bool operator==(const FSimEvent& R) const
+	{
+		return EventType == R.EventType && ActorId == R.ActorId && OtherId == R.OtherId;
+	}
+};
+
+USTRUCT()
+struct FSimMove
+{
+	GENERATED_USTRUCT_BODY()
+	
+	UPROPERTY()
+	int32 ActorId = -1;
+	UPROPERTY()
+	FGridCoordinate From;
+	UPROPERTY()
+	FGridCoordinate To;
+
+	bool operator==(const FSimMove& R) const { return ActorId == R.ActorId && From == R.From && To == R.To; }
+};
+
+USTRUCT()
+struct ILLUVIUMSIMCORE_API FStepDelta
+{
+	GENERATED_USTRUCT_BODY()
+	
+	UPROPERTY()
+	TArray<FSimMove> Moves;
+	UPROPERTY()
+	TArray<FSimEvent> Events;
+
+	/** Grid the step ran on. Sets the bit width of the cells NetSerialize sends. */
+	UPROPERTY()
+	FIntPoint GridSize = {0, 0};
+
+	/**
+	 * Hash of every living unit's Id, team, HP and cell after the step, see FSimUnitStore::HashUnitState. Equal
+	 * hashes on two machines or runs mean the battles are still in sync.
+	 */
+	UPROPERTY()
+	uint64 StateHash = 0;
+
+	bool operator==(const FStepDelta& R) const { return Moves == R.Moves && Events == R.Events && StateHash == R.StateHash; }
+
+	/**
+	 * Bit packed replication. Move sources are quantized to the grid's bit width and destinations sent as direction
+	 * codes, 3 bits for single cell moves. Ids are delta coded within the step, and the Hit and Die following an
+	 * Attack cost 3 bits each.
+	 */
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FStepDelta> : public TStructOpsTypeTraitsBase2<FStepDelta>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+USTRUCT()
+struct FSimUnit
+{
+	GENERATED_USTRUCT_BODY()
+
+	int32 Id = -1;
+	EBattleTeam Team = EBattleTeam::Red;
+	int32 HP = 1;
+	FGridCoordinate Cell;
+	int32 AttackCooldown = 0;
+	bool bAlive = true;
+};
@@ -0,0 +1,32 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Shipping builds never wrap GMalloc, Install() does nothing there. */
+#define GRIDBATTLE_WITH_ALLOCATION_COUNTER (!UE_BUILD_SHIPPING)
+
+/**
+ * Counts every allocation made through GMalloc by wrapping it in a forwarding proxy. Meant for benchmark
+ * processes: once installed the proxy stays for the lifetime of the process. Counters are process wide, so
+ * measure on a quiet process and read the difference around the code of interest.
+ *
+ * Games and the editor install it at startup when run with -CountAllocations, see FIlluviumSimCoreModule.
+ */
+struct ILLUVIUMSIMCORE_API FAllocationCounter
+{
+	/**
+	 * Wraps GMalloc. Swapping GMalloc is not safe while other threads allocate, so this refuses once the engine
+	 * loop is running, except in commandlets. Safe to call more than once. @return whether the counter is installed.
+	 */
+	static bool Install();
+	static bool IsInstalled();
+
+	static uint64 GetNumAllocations();
+	/** Sum of the sizes requested by Malloc and Realloc calls. */
+	static uint64 GetAllocatedBytes();
+
+	/** Allocations made by the calling thread only, unaffected by other threads of a busy process. */
+	static uint64 GetNumAllocationsOnCurrentThread();
+};
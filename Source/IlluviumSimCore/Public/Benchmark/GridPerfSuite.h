@@ -0,0 +1,117 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+
+struct FGridPerfSuiteSettings
+{
+	TArray<int32> GridSizes { 100, 256, 512, 1024, 2048 };
+
+	/** Fractions of randomly blocked cells for the FindPath sweep. */
+	TArray<float> ObstacleDensities { 0.f, 0.1f, 0.25f };
+
+	/** Adds the ATestActor layout: a full-height wall through the middle with a single gap. */
+	bool bWallWithGap = true;
+
+	/** Adds the same wall without the gap, so every query crosses into another region and has no path. */
+	bool bSealedWall = true;
+
+	/** Repeats every A* layout with FPathRequest::Regions labelled from the obstacles ("/Regions"). */
+	bool bRegionLabels = true;
+
+	/**
+	 * Repeats every FindPath layout with EGridSearchMode::JumpPoint ("/JPS"). Paths whose length differs from A*'s
+	 * count as path mismatches.
+	 */
+	bool bJumpPointSearch = true;
+
+	/**
+	 * Repeats every FindPath layout through FGridHierarchy, once refined to the goal ("/HPA") and once refined a
+	 * single cell like a simulation step ("/HPA-Lazy").
+	 */
+	bool bHierarchical = true;
+	int32 HierarchyClusterSize = 16;
+
+	/** Total units on the field for the stepping sweep, split evenly between the teams. */
+	TArray<int32> UnitCounts { 2, 100, 1000, 10000, 50000 };
+
+	TArray<EMovementPlanner> Planners { EMovementPlanner::AStar, EMovementPlanner::FlowField, EMovementPlanner::Hierarchical };
+
+	/** Repeats the AStar planner with FSimConfig::bCachePaths ("AStar/Cached"). */
+	bool bCachedPaths = true;
+
+	/**
+	 * Node budget for the "/Budget" runs: every A* layout with partial paths allowed, where successes only count
+	 * searches that reached the goal, and the AStar planner with FSimConfig::MaxPathExpansions. 0 skips them.
+	 */
+	int32 ExpansionBudget = 1024;
+
+	/** FSimConfig::PathBudgetPerStep for the AStar planner with FSimConfig::bSchedulePaths ("AStar/Scheduled"). 0 skips it. */
+	int32 PathBudgetPerStep = 4096;
+
+	/** Timed FindPath calls per grid and obstacle layout. */
+	int32 PathQueries = 64;
+
+	/** Timed steps per grid, unit count and planner. Fewer if the battle ends first. */
+	int32 StepsPerRun = 20;
+
+	bool bParallelPlanning = false;
+
+	int32 Seed = 1337;
+};
+
+struct FGridPerfStats
+{
+	double Median = 0.0;
+	double P99 = 0.0;
+	double Mean = 0.0;
+	double Max = 0.0;
+
+	/** Sorts Samples in place. */
+	static FGridPerfStats FromSamples(TArray<double>& Samples);
+};
+
+struct FGridPerfResult
+{
+	/** "FindPath" or "Step". */
+	FString Suite;
+	/** Obstacle layout for FindPath, movement planner for Step. */
+	FString Scenario;
+	int32 GridSize = 0;
+	int32 Units = 0;
+	int32 Calls = 0;
+
+	FGridPerfStats TimeMs;
+	/** FindPath only. */
+	FGridPerfStats NodesExpanded;
+	/** FindPath: searches that reached the goal. Step: moves plus events produced. */
+	int64 Successes = 0;
+
+	/** FindPath "/JPS" only: searches whose path length differs from A*'s on the same endpoints. */
+	int32 PathMismatches = 0;
+
+	/** Only filled in when FAllocationCounter is installed. */
+	double BytesPerCall = 0.0;
+	double AllocationsPerCall = 0.0;
+};
+
+/**
+ * Headless performance sweep over FGridAStar::FindPath and FBattleSimulation::Step. Run it on a quiet process
+ * (e.g. the GridBenchmark commandlet) and compare the JSON output between builds.
+ */
+struct ILLUVIUMSIMCORE_API FGridPerfSuite
+{
+	static void Run(const FGridPerfSuiteSettings& Settings, TArray<FGridPerfResult>& OutResults);
+
+	static void RunFindPath(const FGridPerfSuiteSettings& Settings, TArray<FGridPerfResult>& OutResults);
+	static void RunStep(const FGridPerfSuiteSettings& Settings, TArray<FGridPerfResult>& OutResults);
+
+	/** Sum of FGridPerfResult::PathMismatches. Anything but 0 means a search mode returned longer paths. */
+	static int32 CountPathMismatches(const TArray<FGridPerfResult>& Results);
+
+	static FString ToJson(const FGridPerfSuiteSettings& Settings, const TArray<FGridPerfResult>& Results);
+
+	static void LogResult(const FGridPerfResult& Result);
+};
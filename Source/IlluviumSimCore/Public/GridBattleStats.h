@@ -0,0 +1,18 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+DECLARE_STATS_GROUP(TEXT("GridBattle"), STATGROUP_GridBattle, STATCAT_Advanced);
+
+/** Insights channel for the battle scopes. Enable with -trace=GridBattle or "Trace.Enable GridBattle". */
+UE_TRACE_CHANNEL_EXTERN(GridBattleChannel, ILLUVIUMSIMCORE_API);
+
+/** Times the enclosing scope under Stat in "stat GridBattle" and as a named event on GridBattleChannel. */
+#define GRIDBATTLE_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, GridBattleChannel)
@@ -0,0 +1,214 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+#include "Navigation/GridOccupancy.h"
+#include "Navigation/GridRegionLabels.h"
+#include "GridAStar.generated.h"
+
+UENUM(BlueprintType)
+enum class EGridSearchMode : uint8
+{
+	// Expands every cell it reaches
+	AStar,
+	// Jump point search for the 4-connected uniform-cost grid: only expands cells where a shortest path may turn.
+	// Paths are as short as AStar's but may take different cells. Vertical scans stop after a few rows and carry on
+	// from a new jump point, so open maps cost about what AStar does while walls and corridors cost far less
+	JumpPoint
+};
+
+/** How the last search on a FGridAStarContext ended. */
+enum class EGridSearchResult : uint8
+{
+	Found,
+	NoPath,
+	/** The request's budget ran out first. FGridAStar::ResumePath carries on from where it stopped. */
+	OutOfBudget
+};
+
+FORCEINLINE bool IsWithinGridBounds(const FGridCoordinate& Coordinate, const FIntPoint& GridSize)
+{
+	return Coordinate.X >= 0 && Coordinate.X < GridSize.X &&
+			Coordinate.Y >= 0 && Coordinate.Y < GridSize.Y;
+}
+
+struct FPathRequest
+{
+	FGridCoordinate Start;
+	FGridCoordinate Goal;
+	FIntPoint  GridSize { 100,100 };
+
+	/** Blocked cells, not owned. Must match GridSize; null means nothing is blocked. */
+	const FGridOccupancy* Occupancy = nullptr;
+
+	/** Cells that never open up, such as walls, not owned. Unlike Occupancy, PassableOverrides do not apply to them. */
+	const FGridOccupancy* StaticObstacles = nullptr;
+
+	/**
+	 * Regions between the static obstacles, not owned. Must match GridSize and StaticObstacles. When set, an open Goal
+	 * in another region than Start fails without a search.
+	 */
+	const FGridRegionLabels* Regions = nullptr;
+
+	/** Cells that stay passable even when set in Occupancy, e.g. the requester's own cell. Goal is always passable. */
+	TArray<FGridCoordinate, TInlineAllocator<2>> PassableOverrides;
+
+	/** Inclusive box the search stays inside, clamped to the grid. Defaults to the whole grid. */
+	FGridCoordinate SearchMin { 0, 0 };
+	FGridCoordinate SearchMax { MAX_int32, MAX_int32 };
+
+	/**
+	 * Hierarchical searches stop refining once the path runs this many cells past Start and return that prefix.
+	 * Flat searches always return the whole path.
+	 */
+	int32 MaxRefinedCells = MAX_int32;
+
+	EGridSearchMode SearchMode = EGridSearchMode::AStar;
+
+	/**
+	 * Flat searches stop after expanding this many nodes in one call, jump points for EGridSearchMode::JumpPoint.
+	 * Deterministic, unlike MaxSearchSeconds.
+	 */
+	int32 MaxExpansions = MAX_int32;
+
+	/** Flat searches stop after about this long in one call, checked every 64 expansions. 0 means no limit. */
+	double MaxSearchSeconds = 0.0;
+
+	/**
+	 * A search that runs out of budget returns the path to the expanded node closest to Goal instead of failing,
+	 * so the requester can head that way while the search finishes.
+	 */
+	bool bAllowPartialPath = false;
+
+	/** Start and Goal are open cells in different static regions, so no search can connect them. */
+	FORCEINLINE bool IsWalledOff() const
+	{
+		if (!Regions || !IsWithinGridBounds(Start, GridSize) || !IsWithinGridBounds(Goal, GridSize)) return false;
+
+		checkSlow(Regions->GetGridSize() == GridSize);
+		const int32 StartRegion = Regions->GetRegion(Start);
+		const int32 GoalRegion = Regions->GetRegion(Goal);
+		return StartRegion != INDEX_NONE && GoalRegion != INDEX_NONE && StartRegion != GoalRegion;
+	}
+
+	FORCEINLINE bool IsBlocked(const FGridCoordinate& Coordinate) const
+	{
+		return (StaticObstacles && StaticObstacles->IsSet(Coordinate)) ||
+			(Occupancy && Occupancy->IsSet(Coordinate) && !PassableOverrides.Contains(Coordinate));
+	}
+};
+
+struct FSearchNode
+{
+	FGridCoordinate Coordinate;
+	int32 CostFromStart { 0 };
+	int32 EstimatedTotalCost { 0 };
+	FGridCoordinate ParentCoordinate { INT32_MIN, INT32_MIN };
+	int32  InsertionOrderForTies { 0 };
+
+	bool operator<(const FSearchNode& Other) const
+	{
+		if (EstimatedTotalCost != Other.EstimatedTotalCost)
+			return EstimatedTotalCost < Other.EstimatedTotalCost;
+
+		if (CostFromStart != Other.CostFromStart)
+			return CostFromStart > Other.CostFromStart;
+
+		return InsertionOrderForTies < Other.InsertionOrderForTies;
+	}
+};
+
+/**
+ * Reusable scratch state for FGridAStar. Per-cell data lives in flat arrays indexed by Y * GridSize.X + X and is
+ * validated through generation stamps, so consecutive searches neither clear nor reallocate anything once the
+ * arrays have grown to the largest grid seen and the open list to the largest search.
+ */
+struct ILLUVIUMSIMCORE_API FGridAStarContext
+{
+	/** Grows the per-cell arrays to fit GridSize and opens a new search generation. */
+	void BeginSearch(const FIntPoint& GridSize);
+
+	FORCEINLINE bool IsVisited(int32 CellIndex) const { return VisitedGeneration[CellIndex] == Generation; }
+	FORCEINLINE bool IsClosed(int32 CellIndex) const { return ClosedGeneration[CellIndex] == Generation; }
+
+	/**
+	 * Open list as a binary heap ordered by FSearchNode::operator<. Superseded entries are skipped on pop. Grows on
+	 * demand, as most searches touch a few hundred cells of grids with millions.
+	 */
+	TArray<FSearchNode> OpenHeap;
+
+	TArray<int32> CostFromStart;
+	TArray<int32> ParentIndex;
+	/** InsertionOrderForTies of the live open entry for a cell; older heap entries for the same cell are stale. */
+	TArray<int32> OpenInsertionOrder;
+	TArray<uint32> VisitedGeneration;
+	TArray<uint32> ClosedGeneration;
+
+	uint32 Generation = 0;
+
+	/** Number of nodes popped and expanded by the last search, jump points for EGridSearchMode::JumpPoint. */
+	int32 LastNodesExpanded = 0;
+
+	/**
+	 * Bounding box of the nodes expanded and, for jump point search, the cells scanned by the last search. Every
+	 * cell whose blocked state the search tested lies at most one cell outside it, so the result holds as long as
+	 * no cell in that margin changes.
+	 */
+	FGridCoordinate LastExpandedMin;
+	FGridCoordinate LastExpandedMax;
+
+	EGridSearchResult LastResult = EGridSearchResult::NoPath;
+
+	/** The last search ran out of budget on the same Start, Goal, grid, search box and mode as Request. */
+	bool CanResume(const FPathRequest& Request) const;
+
+private:
+	friend struct FGridAStar;
+
+	/** Remembers Request and its start cell for CanResume and partial paths. */
+	void BeginPending(const FPathRequest& Request, int32 StartIndex);
+
+	/** What a search that ran out of budget needs to carry on. */
+	FGridCoordinate PendingStart;
+	FGridCoordinate PendingGoal;
+	FGridCoordinate PendingSearchMin;
+	FGridCoordinate PendingSearchMax;
+	FIntPoint PendingGridSize { 0, 0 };
+	EGridSearchMode PendingSearchMode = EGridSearchMode::AStar;
+	int32 NextInsertionOrder = 0;
+
+	/** Expanded cell with the least remaining cost, where partial paths lead. */
+	int32 BestCellIndex = INDEX_NONE;
+	int32 BestRemainingCost = MAX_int32;
+};
+
+USTRUCT()
+struct ILLUVIUMSIMCORE_API FGridAStar
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** Runs the search on a thread-local context. */
+	static bool FindPath(const FPathRequest& Req, TArray<FGridCoordinate>& OutPath);
+
+	/** The context used by the calling thread for FindPath without an explicit context. */
+	static FGridAStarContext& GetThreadContext();
+
+	/**
+	 * @return true if OutPath leads from Start to Goal, or toward Goal when the budget ran out and
+	 * Req.bAllowPartialPath is set. Context.LastResult tells which.
+	 */
+	static bool FindPath(const FPathRequest& Req, TArray<FGridCoordinate>& OutPath, FGridAStarContext& Context);
+
+	/**
+	 * Carries on the search Context ran out of budget on, with a fresh budget from Req, or starts over if
+	 * Context.CanResume(Req) is false. Cells already searched keep the blocked state they had then, so resume only
+	 * while Req's obstacles are unchanged.
+	 */
+	static bool ResumePath(const FPathRequest& Req, TArray<FGridCoordinate>& OutPath, FGridAStarContext& Context);
+
+private:
+	static bool FindAStarPath(const FPathRequest& Req, TArray<FGridCoordinate>& OutPath, FGridAStarContext& Context, bool bResume);
+	static bool FindJumpPointPath(const FPathRequest& Req, TArray<FGridCoordinate>& OutPath, FGridAStarContext& Context, bool bResume);
+};
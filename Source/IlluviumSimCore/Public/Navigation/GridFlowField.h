@@ -0,0 +1,44 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+#include "Navigation/GridOccupancy.h"
+
+/**
+ * Multi-source BFS distance field over a 4-connected grid. Every free cell stores its step distance to the
+ * closest source; occupied cells other than the sources are never entered. Units follow the field downhill
+ * instead of running a search of their own.
+ */
+struct ILLUVIUMSIMCORE_API FGridFlowField
+{
+	static constexpr int32 Unreachable = MAX_int32;
+
+	/**
+	 * Rebuilds the field. Sources get distance 0 even if they are occupied. StaticObstacles, if given, are never
+	 * entered either. Buffers are reused across builds.
+	 */
+	void Build(const FGridOccupancy& Occupancy, TArrayView<const FGridCoordinate> Sources,
+	           const FGridOccupancy* StaticObstacles = nullptr);
+
+	FORCEINLINE int32 GetDistance(const FGridCoordinate& Cell) const
+	{
+		return Distances[Cell.Y * GridSize.X + Cell.X];
+	}
+
+	/**
+	 * Walks downhill from Start for up to MaxSteps cells and never onto a source. The walk also stops in front of
+	 * cells set in LiveOccupancy, which may hold reservations made after the field was built.
+	 * @return false if no step could be taken.
+	 */
+	bool FindNextCell(const FGridCoordinate& Start, int32 MaxSteps, const FGridOccupancy& LiveOccupancy,
+	                  FGridCoordinate& OutCell) const;
+
+	const FIntPoint& GetGridSize() const { return GridSize; }
+
+private:
+	TArray<int32> Distances;
+	TArray<int32> Frontier;
+	FIntPoint GridSize { 0, 0 };
+};
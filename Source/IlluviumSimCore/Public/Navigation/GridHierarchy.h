@@ -0,0 +1,208 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+#include "Navigation/GridAStar.h"
+#include "Navigation/GridOccupancy.h"
+
+/**
+ * Reusable scratch state for FGridHierarchy::FindPath, per-node data validated through generation stamps like
+ * FGridAStarContext.
+ */
+struct ILLUVIUMSIMCORE_API FGridHierarchyContext
+{
+	/** Grows the per-node arrays to NumNodes and opens a new search generation. */
+	void BeginSearch(int32 NumNodes);
+
+	FORCEINLINE bool IsVisited(int32 NodeIndex) const { return VisitedGeneration[NodeIndex] == Generation; }
+	FORCEINLINE bool IsClosed(int32 NodeIndex) const { return ClosedGeneration[NodeIndex] == Generation; }
+
+	struct FOpenNode
+	{
+		int32 NodeIndex;
+		int32 CostFromStart;
+		int32 EstimatedTotalCost;
+		int32 InsertionOrderForTies;
+
+		bool operator<(const FOpenNode& Other) const
+		{
+			if (EstimatedTotalCost != Other.EstimatedTotalCost)
+				return EstimatedTotalCost < Other.EstimatedTotalCost;
+
+			if (CostFromStart != Other.CostFromStart)
+				return CostFromStart > Other.CostFromStart;
+
+			return InsertionOrderForTies < Other.InsertionOrderForTies;
+		}
+	};
+
+	/** Open list over entrance nodes, superseded entries are skipped on pop. */
+	TArray<FOpenNode> OpenHeap;
+
+	TArray<int32> CostFromStart;
+	TArray<int32> ParentNode;
+	TArray<int32> OpenInsertionOrder;
+	TArray<uint32> VisitedGeneration;
+	TArray<uint32> ClosedGeneration;
+
+	uint32 Generation = 0;
+
+	/** Static distances from Start and Goal to the entrances of their clusters, by slot. */
+	TArray<int32> StartDistances;
+	TArray<int32> GoalDistances;
+
+	/** Breadth first search within one cluster. */
+	TArray<bool> ClusterBlocked;
+	TArray<int32> ClusterDistances;
+	TArray<int32> ClusterFrontier;
+
+	/** Abstract path from Start to Goal as nodes, then the cells refinement walks towards. */
+	TArray<int32> AbstractPath;
+	TArray<FGridCoordinate> Waypoints;
+	TArray<FGridCoordinate> Segment;
+
+	/** Runs the local refinement searches. */
+	FGridAStarContext LocalContext;
+
+	/** Abstract nodes plus local cells expanded by the last search. */
+	int32 LastNodesExpanded = 0;
+
+	/**
+	 * Box around every cell of the request's Occupancy the last search read, margin included. Entrances and the
+	 * abstract graph only depend on the static obstacles, so the result holds as long as no cell inside changes.
+	 */
+	FGridCoordinate LastReadMin;
+	FGridCoordinate LastReadMax;
+};
+
+/**
+ * Hierarchical pathfinding (HPA*) for large grids. The grid is cut into square clusters. Every run of open cells
+ * along a cluster border gets one or two entrances, and the static path lengths between the entrances of a
+ * cluster are precomputed. A search runs A* over the entrances and refines only the first few cells of the result
+ * with bounded FGridAStar searches, where the request's Occupancy (units) is taken into account.
+ *
+ * Entrances live in fixed slots, one per border cell, so editing an obstacle only rebuilds its cluster and the
+ * neighbours that share a border with it.
+ */
+struct ILLUVIUMSIMCORE_API FGridHierarchy
+{
+	static constexpr int32 MinClusterSize = 4;
+	/** Four sides of this many cells fill the 64 bit slot mask of a cluster. */
+	static constexpr int32 MaxClusterSize = 16;
+
+	/** Builds the hierarchy for an obstacle-free grid. */
+	void Init(const FIntPoint& InGridSize, int32 InClusterSize);
+
+	/** Builds the hierarchy over Obstacles, which it copies. */
+	void Build(const FGridOccupancy& InObstacles, int32 InClusterSize);
+
+	/** Edits one static cell and marks its cluster for RebuildDirtyClusters. */
+	void SetObstacle(const FGridCoordinate& Cell, bool bBlocked);
+
+	/** Recomputes the entrances and distances of the edited clusters and their neighbours. @return clusters rebuilt. */
+	int32 RebuildDirtyClusters();
+
+	bool IsBuilt() const { return !Clusters.IsEmpty(); }
+	bool HasDirtyClusters() const { return !DirtyClusters.IsEmpty(); }
+
+	/**
+	 * Finds a path from Request.Start towards Request.Goal over the static obstacles, then refines it against
+	 * Request.Occupancy until it runs Request.MaxRefinedCells cells past Start. Start and Goal closer than a
+	 * cluster apart get a single bounded search instead. Request.StaticObstacles and the search bounds are
+	 * replaced by the hierarchy's own, Request.Regions must describe the same obstacles if set. Must not run while
+	 * obstacles are being edited.
+	 * @return false if no step towards Goal could be found; OutPath then holds nothing.
+	 */
+	bool FindPath(const FPathRequest& Request, TArray<FGridCoordinate>& OutPath, FGridHierarchyContext& Context) const;
+
+	/** Runs the search on a thread-local context. */
+	bool FindPath(const FPathRequest& Request, TArray<FGridCoordinate>& OutPath) const;
+
+	/** The context used by the calling thread for FindPath without an explicit context. */
+	static FGridHierarchyContext& GetThreadContext();
+
+	const FGridOccupancy& GetObstacles() const { return Obstacles; }
+	const FIntPoint& GetGridSize() const { return Obstacles.GetGridSize(); }
+	int32 GetClusterSize() const { return ClusterSize; }
+
+	/** Entrances over all clusters. */
+	int32 GetNumEntrances() const { return NodeClusters.Num(); }
+
+private:
+	enum EClusterSide : int32
+	{
+		SideMinX,
+		SideMaxX,
+		SideMinY,
+		SideMaxY,
+		NumSides
+	};
+
+	struct FCluster
+	{
+		FGridCoordinate Min;
+		FGridCoordinate Max;
+
+		/** Bit Side * MaxClusterSize + Offset is set if the border cell at Offset along Side is an entrance. */
+		uint64 SlotMask = 0;
+
+		/** Set slots in ascending order. */
+		TArray<int32, TInlineAllocator<16>> Slots;
+
+		/** Static path lengths within the cluster between Slots[I] and Slots[J] at I * Slots.Num() + J. */
+		TArray<int32> Distances;
+
+		/** Graph node of Slots[0], the other slots follow in order. */
+		int32 FirstNode = 0;
+
+		bool bDirty = false;
+	};
+
+	FORCEINLINE int32 GetClusterIndex(const FGridCoordinate& Cell) const
+	{
+		return (Cell.Y / ClusterSize) * NumClusters.X + Cell.X / ClusterSize;
+	}
+
+	FGridCoordinate GetSlotCell(const FCluster& Cluster, int32 Slot) const;
+
+	/** Neighbouring cluster across Side, or INDEX_NONE at the edge of the grid. */
+	int32 GetNeighbourCluster(int32 ClusterIndex, EClusterSide Side) const;
+
+	void BuildAllClusters();
+
+	/** Numbers the entrances of all clusters consecutively, in cluster and slot order. */
+	void NumberNodes();
+
+	/** Places the entrances along the border between ClusterIndex and its neighbour across Side. */
+	void BuildBorder(int32 ClusterIndex, EClusterSide Side);
+
+	/** Rebuilds Slots and Distances from the cluster's SlotMask. */
+	void BuildClusterDistances(int32 ClusterIndex, FGridHierarchyContext& Scratch);
+
+	/** Copies the cluster's static obstacles into Scratch.ClusterBlocked for SearchCluster. */
+	void LoadClusterObstacles(const FCluster& Cluster, FGridHierarchyContext& Scratch) const;
+
+	/**
+	 * Static breadth first search from Source within the cluster loaded last. Leaves the distances in
+	 * Scratch.ClusterDistances, Unreachable for open cells it could not reach and -1 for blocked ones.
+	 */
+	void SearchCluster(const FCluster& Cluster, const FGridCoordinate& Source, FGridHierarchyContext& Scratch) const;
+
+	/** Runs the abstract search and leaves the cells to refine towards in Context.Waypoints. */
+	bool FindWaypoints(const FPathRequest& Request, FGridHierarchyContext& Context) const;
+
+	/** Bounded local search appended to OutPath. @return false if the local search found nothing. */
+	bool RefineSegment(const FPathRequest& Request, const FGridCoordinate& From, const FGridCoordinate& To,
+	                   const FGridCoordinate& SearchMin, const FGridCoordinate& SearchMax,
+	                   TArray<FGridCoordinate>& OutPath, FGridHierarchyContext& Context) const;
+
+	FGridOccupancy Obstacles;
+	int32 ClusterSize = MaxClusterSize;
+	FIntPoint NumClusters { 0, 0 };
+	TArray<FCluster> Clusters;
+	/** Cluster of every graph node. */
+	TArray<int32> NodeClusters;
+	TArray<int32> DirtyClusters;
+};
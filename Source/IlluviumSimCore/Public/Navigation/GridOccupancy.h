@@ -0,0 +1,57 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+
+/**
+ * Dense one-bit-per-cell occupancy grid. Bit index is Y * GridSize.X + X.
+ * Callers are expected to bounds-check coordinates before querying.
+ */
+struct ILLUVIUMSIMCORE_API FGridOccupancy
+{
+	/** Resizes to GridSize and clears every cell. */
+	void Init(const FIntPoint& InGridSize);
+
+	/** Copies Other, reusing the existing allocation when the grid sizes match. */
+	void CopyFrom(const FGridOccupancy& Other);
+
+	/** Resizes to InGridSize and loads bits saved from GetWords. Missing words are cleared. */
+	void InitFromWords(const FIntPoint& InGridSize, TArrayView<const uint64> InWords);
+
+	void ClearAll();
+
+	FORCEINLINE bool IsSet(const FGridCoordinate& Cell) const
+	{
+		const int32 BitIndex = ToBitIndex(Cell);
+		return (Words[BitIndex >> 6] & (1ull << (BitIndex & 63))) != 0;
+	}
+
+	FORCEINLINE void Set(const FGridCoordinate& Cell)
+	{
+		const int32 BitIndex = ToBitIndex(Cell);
+		Words[BitIndex >> 6] |= (1ull << (BitIndex & 63));
+	}
+
+	FORCEINLINE void Clear(const FGridCoordinate& Cell)
+	{
+		const int32 BitIndex = ToBitIndex(Cell);
+		Words[BitIndex >> 6] &= ~(1ull << (BitIndex & 63));
+	}
+
+	FORCEINLINE const FIntPoint& GetGridSize() const { return GridSize; }
+
+	/** The bits 64 to a word, bit I of word W is bit index W * 64 + I. */
+	const TArray<uint64>& GetWords() const { return Words; }
+
+private:
+	FORCEINLINE int32 ToBitIndex(const FGridCoordinate& Cell) const
+	{
+		checkSlow(Cell.X >= 0 && Cell.X < GridSize.X && Cell.Y >= 0 && Cell.Y < GridSize.Y);
+		return Cell.Y * GridSize.X + Cell.X;
+	}
+
+	TArray<uint64> Words;
+	FIntPoint GridSize { 0, 0 };
+};
@@ -0,0 +1,81 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+#include "Navigation/GridAStar.h"
+
+/**
+ * A shortest path kept between searches. Only paths as long as the Manhattan distance between their ends are kept:
+ * those never step back along either axis, so they are stored as one bit per step, and they remain shortest paths
+ * for as long as their cells stay free.
+ */
+struct ILLUVIUMSIMCORE_API FCachedGridPath
+{
+	bool IsSet() const { return bIsSet; }
+
+	/** Keeps Cells if it is a Manhattan-length path, otherwise clears. */
+	void Assign(const TArray<FGridCoordinate>& Cells);
+
+	void Reset();
+
+	/** Frees the step bits as well. */
+	void Empty();
+
+	/** Replaces OutCells with the cells from Start to the end of the path. */
+	void Decode(TArray<FGridCoordinate>& OutCells) const;
+
+	/** Appends the path to Out. */
+	void Write(TArray<uint8>& Out) const;
+
+	/** Reads a path written by Write. @return the byte after it. */
+	const uint8* Read(const uint8* Data);
+
+	int32 GetNumSteps() const { return NumSteps; }
+
+private:
+	FGridCoordinate Start;
+	/** +1 or -1, the direction of every step along its axis. */
+	int8 DirectionX = 1;
+	int8 DirectionY = 1;
+	bool bIsSet = false;
+	int32 NumSteps = 0;
+	/** Bit I is set if step I runs along X. */
+	TArray<uint64> StepBits;
+};
+
+enum class EPathCacheResult : uint8
+{
+	/** The cached path was still free and only lost the cells walked since. */
+	Hit,
+	/** The cached path was re-aimed at a moved goal or spliced around newly blocked cells. */
+	Repaired,
+	/** A full search replaced the cached path. */
+	Replanned,
+	/** The full search ran out of Request's budget. OutPath only leads toward the goal and is not kept. */
+	Partial,
+	/** Not even a full search found a path. */
+	NoPath
+};
+
+/**
+ * Keeps a path alive across searches whose start walks along it and whose goal and blocked cells change a little
+ * at a time. Repairs only search the stretches that broke, bounded to the box between their ends, and every path
+ * returned is as short as a full search's.
+ */
+struct ILLUVIUMSIMCORE_API FGridPathCache
+{
+	/**
+	 * Finds a path for Request starting from Cached. Request.Start must lie within MaxWalkedCells steps along the
+	 * cached path, or else it is searched from scratch like a goal that moved off its box or a stretch that cannot
+	 * be spliced at Manhattan length.
+	 * @param OutPath the path from Request.Start to Request.Goal, empty for NoPath.
+	 * @param OutCached what to pass as Cached next time, must not be Cached itself.
+	 * @param OutReadMin, OutReadMax box around every cell whose blocked state the result depended on.
+	 */
+	static EPathCacheResult FindPath(const FCachedGridPath& Cached, int32 MaxWalkedCells, const FPathRequest& Request,
+	                                 TArray<FGridCoordinate>& OutPath, FCachedGridPath& OutCached,
+	                                 FGridAStarContext& Context, FGridCoordinate& OutReadMin,
+	                                 FGridCoordinate& OutReadMax);
+};
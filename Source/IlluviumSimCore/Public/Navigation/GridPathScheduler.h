@@ -0,0 +1,131 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+#include "Navigation/GridAStar.h"
+#include "Templates/Function.h"
+
+/** Totals since the last Reset(), and the queue as the last Serve() left it. */
+struct FPathSchedulerStats
+{
+	int64 Requests = 0;
+	/** Requests that joined one already waiting for the same start and goal instead of adding a search. */
+	int64 Coalesced = 0;
+	/** Searches run, each answering every requester of its start and goal. */
+	int64 Searches = 0;
+	/** Searches cut short by the budget, answered with a partial path. */
+	int64 PartialSearches = 0;
+	int64 RequestersServed = 0;
+	int64 NodesExpanded = 0;
+
+	/** Serve() calls a request waited for, summed over the requesters served and at most. */
+	int64 TotalLatencyFrames = 0;
+	int32 MaxLatencyFrames = 0;
+
+	int32 QueueDepth = 0;
+	int32 PeakQueueDepth = 0;
+	double LastServeMs = 0.0;
+
+	double GetMeanLatencyFrames() const { return RequestersServed > 0 ? double(TotalLatencyFrames) / RequestersServed : 0.0; }
+};
+
+/**
+ * Path requests queued up and served a budget at a time, most urgent first. Each requester has at most one request
+ * waiting, a new one replaces it, and requests for the same start and goal share one search. Lower priorities are
+ * served first, and every Serve() a request waits through counts AgingPerFrame lower, so none starves.
+ */
+class ILLUVIUMSIMCORE_API FGridPathScheduler
+{
+public:
+	/** Priority a waiting request gains on newer ones per Serve(). */
+	int32 AgingPerFrame = 2;
+
+	/** Drops every request and zeroes the stats. GridWidth is the X size of the grid requests will run on. */
+	void Reset(int32 InGridWidth);
+
+	/**
+	 * Queues a path from Start to Goal for RequesterId, replacing the one it had waiting. A replaced request keeps
+	 * its age, so requesters whose start changes every frame still get their turn.
+	 */
+	void Enqueue(int32 RequesterId, const FGridCoordinate& Start, const FGridCoordinate& Goal, int32 Priority);
+
+	void Cancel(int32 RequesterId);
+
+	bool IsQueued(int32 RequesterId) const { return EntryByRequester.Contains(RequesterId); }
+
+	/** Requests waiting, counting those for the same start and goal once. */
+	int32 GetQueueDepth() const { return EntryByPair.Num(); }
+
+	/**
+	 * Searches the queued requests in priority order with Base's grid, obstacles and search mode until MaxExpansions
+	 * nodes have been expanded or MaxSeconds have passed, 0 for no time limit. The search the budget runs out on is
+	 * answered with its partial path. OnServed gets every requester of a served request in the order they asked and
+	 * must not queue or cancel requests.
+	 */
+	void Serve(const FPathRequest& Base, int32 MaxExpansions, double MaxSeconds,
+	           TFunctionRef<void(int32 RequesterId, EGridSearchResult Result, const TArray<FGridCoordinate>& Path)> OnServed);
+
+	const FPathSchedulerStats& GetStats() const { return Stats; }
+
+	/** Appends the queue to Out. Stats are not included. */
+	void Write(TArray<uint8>& Out) const;
+
+	/** Replaces the queue with one written by Write. @return the byte after it. */
+	const uint8* Read(const uint8* Data);
+
+private:
+	struct FEntry
+	{
+		FGridCoordinate Start;
+		FGridCoordinate Goal;
+		int64 Key = 0;
+		/** Orders entries of equal Key by when they were first queued. */
+		int32 Sequence = 0;
+		int32 EnqueueFrame = 0;
+		/** Bumped whenever the entry is requeued or freed, so older heap entries for it are skipped. */
+		int32 Version = 0;
+		TArray<int32, TInlineAllocator<1>> Requesters;
+	};
+
+	struct FQueued
+	{
+		int64 Key;
+		int32 Sequence;
+		int32 EntryIndex;
+		int32 Version;
+
+		bool operator<(const FQueued& Other) const
+		{
+			return Key != Other.Key ? Key < Other.Key : Sequence < Other.Sequence;
+		}
+	};
+
+	uint64 MakePairKey(const FGridCoordinate& Start, const FGridCoordinate& Goal) const;
+
+	int32 AddEntry(const FGridCoordinate& Start, const FGridCoordinate& Goal, int32 EnqueueFrame);
+	void FreeEntry(int32 EntryIndex);
+	void PushEntry(int32 EntryIndex);
+
+	/** Removes RequesterId from its entry, freeing the entry once nobody waits on it. @return its EnqueueFrame. */
+	int32 RemoveRequester(int32 RequesterId, int32 EntryIndex);
+
+	/** Rebuilds the heap from the live entries once stale ones make up most of it. */
+	void CompactHeap();
+
+	TArray<FEntry> Entries;
+	TArray<int32> FreeEntries;
+	TMap<uint64, int32> EntryByPair;
+	TMap<int32, int32> EntryByRequester;
+	TArray<FQueued> Heap;
+
+	int32 GridWidth = 0;
+	int32 Frame = 0;
+	int32 NextSequence = 0;
+
+	FPathSchedulerStats Stats;
+
+	FGridAStarContext SearchContext;
+	TArray<FGridCoordinate> Path;
+};
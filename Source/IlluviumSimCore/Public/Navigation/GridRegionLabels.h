@@ -0,0 +1,83 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridTypes.h"
+#include "Navigation/GridOccupancy.h"
+
+/**
+ * Static obstacles plus a label per open cell naming its 4-connected region, so whether two cells are connected at
+ * all is a pair of lookups. Edits relabel incrementally: opening a cell merges the regions around it into the
+ * largest one, and blocking a cell only floods the parts it may have cut off.
+ */
+struct ILLUVIUMSIMCORE_API FGridRegionLabels
+{
+	/** Labels an obstacle-free grid as a single region. */
+	void Init(const FIntPoint& InGridSize);
+
+	/** Labels the regions between Obstacles, which it copies. */
+	void Build(const FGridOccupancy& InObstacles);
+
+	/** Edits one static cell and updates the labels it affects. */
+	void SetObstacle(const FGridCoordinate& Cell, bool bBlocked);
+
+	/** Region of an open cell, INDEX_NONE for obstacles. */
+	FORCEINLINE int32 GetRegion(const FGridCoordinate& Cell) const
+	{
+		checkSlow(IsWithinGrid(Cell));
+		return Labels[Cell.Y * GetGridSize().X + Cell.X];
+	}
+
+	/** Both cells are open and a path between them exists around the obstacles. */
+	FORCEINLINE bool AreConnected(const FGridCoordinate& A, const FGridCoordinate& B) const
+	{
+		const int32 Region = GetRegion(A);
+		return Region != INDEX_NONE && Region == GetRegion(B);
+	}
+
+	FORCEINLINE bool IsObstacle(const FGridCoordinate& Cell) const { return Obstacles.IsSet(Cell); }
+
+	const FGridOccupancy& GetObstacles() const { return Obstacles; }
+	const FIntPoint& GetGridSize() const { return Obstacles.GetGridSize(); }
+	int32 GetNumRegions() const { return NumRegions; }
+	int32 GetNumOpenCells() const { return NumOpenCells; }
+
+	/** Cells relabelled by the last SetObstacle. */
+	int32 GetLastCellsRelabelled() const { return LastCellsRelabelled; }
+
+private:
+	FORCEINLINE bool IsWithinGrid(const FGridCoordinate& Cell) const
+	{
+		return Cell.X >= 0 && Cell.X < GetGridSize().X && Cell.Y >= 0 && Cell.Y < GetGridSize().Y;
+	}
+
+	FORCEINLINE bool IsOpen(const FGridCoordinate& Cell) const { return IsWithinGrid(Cell) && !Obstacles.IsSet(Cell); }
+
+	int32 AllocateRegion();
+	void FreeRegion(int32 Region);
+
+	/** Gives the open cells connected to Seed that are not labelled Region yet the label Region. @return their number. */
+	int32 FloodFill(const FGridCoordinate& Seed, int32 Region);
+
+	/** Relabels whatever blocking Cell cut off from the region it was in. */
+	void SplitAround(const FGridCoordinate& Cell, int32 Region);
+
+	FGridOccupancy Obstacles;
+	TArray<int32> Labels;
+
+	/** Open cells per region. Labels of emptied regions are reused. */
+	TArray<int32> RegionSizes;
+	TArray<int32> FreeRegions;
+
+	int32 NumRegions = 0;
+	int32 NumOpenCells = 0;
+	int32 LastCellsRelabelled = 0;
+
+	/** Scratch for FloodFill and SplitAround, indices of cells. */
+	TArray<int32> Frontier;
+	TArray<uint32> VisitedGeneration;
+	TArray<uint8> VisitedSearch;
+	uint32 Generation = 0;
+	TArray<int32> SplitSearches[4];
+};
@@ -0,0 +1,90 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+
+/**
+ * Cell to unit lookup plus dense per-team unit lists for the living units of a battle.
+ * Nearest-enemy queries expand Manhattan rings around the source and fall back to a scan of the enemy team
+ * once the rings cover more cells than there are enemies, so both dense and sparse battles stay cheap.
+ */
+struct ILLUVIUMSIMCORE_API FGridSpatialIndex
+{
+	/** Resizes to GridSize and removes every unit. */
+	void Init(const FIntPoint& InGridSize);
+
+	void Add(int32 UnitId, EBattleTeam Team, const FGridCoordinate& Cell);
+	void Remove(int32 UnitId);
+	void Move(int32 UnitId, const FGridCoordinate& NewCell);
+
+	/** @return the unit on Cell or INDEX_NONE. */
+	FORCEINLINE int32 GetUnitAt(const FGridCoordinate& Cell) const
+	{
+		return UnitIdByCell[Cell.Y * GridSize.X + Cell.X];
+	}
+
+	FORCEINLINE int32 GetNumUnits(EBattleTeam Team) const
+	{
+		return UnitIdsByTeam[static_cast<uint8>(Team)].Num();
+	}
+
+	FORCEINLINE const FIntPoint& GetGridSize() const { return GridSize; }
+
+	/** Closest unit not on Team by Manhattan distance, ties go to the smallest Id. INDEX_NONE if there is none. */
+	int32 FindClosestEnemy(EBattleTeam Team, const FGridCoordinate& From) const;
+
+	/** Calls Func(UnitId) for every unit within Range squares of Center, nearest rings first. */
+	template <typename FuncType>
+	void ForEachUnitInRange(const FGridCoordinate& Center, int32 Range, FuncType&& Func) const
+	{
+		for (int32 Radius = 0; Radius <= Range; ++Radius)
+		{
+			ForEachCellOnRing(Center, Radius, [&](int32 CellIndex)
+			{
+				const int32 UnitId = UnitIdByCell[CellIndex];
+				if (UnitId != INDEX_NONE) Func(UnitId);
+			});
+		}
+	}
+
+private:
+	struct FEntry
+	{
+		FGridCoordinate Cell;
+		EBattleTeam Team = EBattleTeam::Red;
+		/** Position in UnitIdsByTeam, INDEX_NONE when the unit is not indexed. */
+		int32 TeamSlot = INDEX_NONE;
+	};
+
+	/** Calls Func(CellIndex) for every in-bounds cell at exactly Radius squares from Center. */
+	template <typename FuncType>
+	void ForEachCellOnRing(const FGridCoordinate& Center, int32 Radius, FuncType&& Func) const
+	{
+		if (Radius == 0)
+		{
+			Func(Center.Y * GridSize.X + Center.X);
+			return;
+		}
+
+		const int32 MinOffsetX = FMath::Max(-Radius, -Center.X);
+		const int32 MaxOffsetX = FMath::Min(Radius, GridSize.X - 1 - Center.X);
+		for (int32 OffsetX = MinOffsetX; OffsetX <= MaxOffsetX; ++OffsetX)
+		{
+			const int32 X = Center.X + OffsetX;
+			const int32 OffsetY = Radius - FMath::Abs(OffsetX);
+
+			const int32 LowerY = Center.Y - OffsetY;
+			if (LowerY >= 0) Func(LowerY * GridSize.X + X);
+
+			const int32 UpperY = Center.Y + OffsetY;
+			if (OffsetY != 0 && UpperY < GridSize.Y) Func(UpperY * GridSize.X + X);
+		}
+	}
+
+	TArray<int32> UnitIdByCell;
+	TArray<FEntry> EntryByUnitId;
+	TArray<int32> UnitIdsByTeam[2];
+	FIntPoint GridSize { 0, 0 };
+};
@@ -0,0 +1,123 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+#include "Simulation/SimUnitStore.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Battle replay file (.gbreplay), little endian:
+ *
+ * Header     Magic "GBRP", version, grid size, seed, attack period, keyframe interval, step and keyframe counts and
+ *            the offset of the keyframe index.
+ * Records    One step record per step. Before the first step and after every KeyframeInterval-th step, a keyframe
+ *            record holding the full unit state.
+ * Index      One 64-bit file offset per keyframe, so seeking jumps to the keyframe at or before the step.
+ *
+ * Steps store event types packed four per byte, ids as varints, and moves as an id delta plus a one-byte direction
+ * code relative to the mover's current cell. Damage and cooldowns follow from the events, so players rebuild the
+ * exact unit state between keyframes without running the simulation, state hashes included.
+ */
+struct FBattleReplayHeader
+{
+	FIntPoint GridSize { 0, 0 };
+	int32 Seed = 0;
+	int32 AttackPeriodSteps = 0;
+	int32 KeyframeInterval = 0;
+	int32 NumSteps = 0;
+	int32 NumKeyframes = 0;
+};
+
+/** Encodes a battle into the replay format step by step. */
+class ILLUVIUMSIMCORE_API FBattleReplayWriter
+{
+public:
+	/** Starts a new replay of a battle whose units right after the reset are InitialUnits. */
+	void Begin(const FSimConfig& Config, int32 Seed, const FSimUnitStore& InitialUnits, int32 KeyframeInterval = 100);
+
+	/** Appends one step. UnitsAfterStep must be the compacted units right after it. */
+	void AppendStep(const FStepDelta& StepDelta, const FSimUnitStore& UnitsAfterStep);
+
+	/** Writes the keyframe index and header. No steps can be appended afterwards. */
+	const TArray<uint8>& Finish();
+
+	/** Finishes the replay if needed and writes it to Filename. */
+	bool SaveToFile(const FString& Filename);
+
+	/** Drops the replay, recorded or finished. */
+	void Reset();
+
+	bool IsRecording() const { return bRecording; }
+	const FBattleReplayHeader& GetHeader() const { return Header; }
+	int32 GetNumSteps() const { return Header.NumSteps; }
+	int64 GetNumBytes() const { return Bytes.Num(); }
+
+private:
+	void WriteKeyframe(const FSimUnitStore& Units);
+
+	FBattleReplayHeader Header;
+	TArray<uint8> Bytes;
+	TArray<uint64> KeyframeOffsets;
+	TArray<uint8> KeyframeScratch;
+	bool bRecording = false;
+	bool bFinished = false;
+};
+
+/**
+ * Plays a replay back without a simulation: it decodes step deltas in order and keeps the unit state they lead to.
+ * Files are memory mapped where the platform supports it.
+ */
+class ILLUVIUMSIMCORE_API FBattleReplayPlayer
+{
+public:
+	FBattleReplayPlayer();
+	~FBattleReplayPlayer();
+
+	bool OpenFile(const FString& Filename);
+	bool OpenMemory(TArray<uint8>&& InBytes);
+	void Close();
+
+	bool IsOpen() const { return Data != nullptr; }
+	const FBattleReplayHeader& GetHeader() const { return Header; }
+	int32 GetNumSteps() const { return Header.NumSteps; }
+
+	/** Number of steps applied to GetUnits(). */
+	int32 GetCurrentStep() const { return CurrentStep; }
+	bool IsAtEnd() const { return CurrentStep >= Header.NumSteps; }
+
+	/** Moves to the state right after Step steps by loading the closest keyframe before it and replaying forward. */
+	bool SeekToStep(int32 Step);
+
+	/** Decodes the next step into OutStepDelta and applies it to GetUnits(). @return false at the end or on bad data. */
+	bool ReadNextStep(FStepDelta& OutStepDelta);
+
+	/** Units after GetCurrentStep() steps, ordered by Id. */
+	const FSimUnitStore& GetUnits() const { return Units; }
+
+	/** State hash of GetUnits(), the one the recorded simulation had after the same step. */
+	uint64 GetStateHash() const { return StateHash; }
+
+private:
+	bool ParseHeader();
+	bool LoadKeyframe(int32 KeyframeIndex);
+	bool Fail(const TCHAR* Reason);
+
+	FBattleReplayHeader Header;
+	const uint8* Data = nullptr;
+	int64 DataSize = 0;
+	int64 IndexOffset = 0;
+	int64 ReadOffset = 0;
+	int32 CurrentStep = 0;
+
+	FSimUnitStore Units;
+	uint64 StateHash = 0;
+
+	// Backing storage, either a mapped file or bytes owned by the player
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray<uint8> OwnedBytes;
+};
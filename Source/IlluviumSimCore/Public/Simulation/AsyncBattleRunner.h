@@ -0,0 +1,81 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+#include "HAL/Runnable.h"
+#include "Simulation/SimUnitStore.h"
+
+class FBattleSimulation;
+class FRunnableThread;
+class FEvent;
+
+/** One step published by FAsyncBattleRunner: its delta and the units as they were right after it. */
+struct FPublishedBattleStep
+{
+	FStepDelta Delta;
+	FSimUnitStore Units;
+	int32 StepCount = 0;
+	bool bBattleOver = false;
+};
+
+/**
+ * Steps an FBattleSimulation on a thread of its own at a fixed rate and publishes every step through a bounded
+ * single-producer single-consumer ring of recycled slots. It runs exactly the steps the synchronous mode would,
+ * only their timing differs.
+ *
+ * Backlog policy: no step is ever dropped. The worker pauses while MaxQueuedSteps steps wait to be consumed, and
+ * when it falls further behind schedule than the ring can absorb it forgets the missed time instead of bursting
+ * through it. A slow step or a slow consumer slows the battle down rather than snowballing into catch-up steps.
+ */
+class ILLUVIUMSIMCORE_API FAsyncBattleRunner : public FRunnable
+{
+public:
+	FAsyncBattleRunner();
+	virtual ~FAsyncBattleRunner() override;
+
+	/**
+	 * Starts stepping Simulation, which must already be reset, every StepDurationSeconds (0 steps as fast as the
+	 * consumer allows). The caller must not touch Simulation until Shutdown() returns.
+	 */
+	void Start(FBattleSimulation& Simulation, float StepDurationSeconds, int32 MaxQueuedSteps);
+
+	/** Stops and joins the worker and discards every unconsumed step. Simulation is left at the last step run. */
+	void Shutdown();
+
+	bool IsRunning() const { return Thread != nullptr; }
+
+	/** Oldest unconsumed step, or null. Consumer thread only; valid until PopStep(). */
+	const FPublishedBattleStep* PeekStep() const;
+
+	/** Releases the step returned by PeekStep() back to the worker. */
+	void PopStep();
+
+	int32 GetNumQueuedSteps() const;
+
+	//~ Begin FRunnable Interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable Interface
+
+private:
+	/** Waits on WakeEvent for up to Seconds, returning early on PopStep() or Stop(). */
+	void WaitFor(double Seconds) const;
+
+	FBattleSimulation* Simulation = nullptr;
+	float StepDuration = 0.1f;
+
+	TArray<FPublishedBattleStep> Slots;
+
+	/** Monotonic step counters, slot = counter % Slots.Num(). Written by one side each, read by the other. */
+	std::atomic<uint32> NumPublished { 0 };
+	std::atomic<uint32> NumConsumed { 0 };
+
+	std::atomic<bool> bStopRequested { false };
+
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+};
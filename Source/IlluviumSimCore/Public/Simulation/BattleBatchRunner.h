@@ -0,0 +1,68 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+
+class FBattleSimulation;
+
+enum class EBattleOutcome : uint8
+{
+	RedWin,
+	BlueWin,
+	/** The last units of both teams died in the same step. */
+	Draw,
+	/** Still running after MaxStepsPerBattle. */
+	Unfinished
+};
+
+struct FBattleSeedResult
+{
+	int32 Seed = 0;
+	EBattleOutcome Outcome = EBattleOutcome::Unfinished;
+	int32 Steps = 0;
+	int32 RedAlive = 0;
+	int32 BlueAlive = 0;
+	/** Summed HP of all living units when the battle stopped. */
+	int32 SurvivorHP = 0;
+};
+
+struct FBattleBatchSummary
+{
+	/** One entry per battle, Results[i] was played from FirstSeed + i. */
+	TArray<FBattleSeedResult> Results;
+
+	int32 NumByOutcome[4] = {};
+
+	int32 MinSteps = 0;
+	int32 MaxSteps = 0;
+	double MeanSteps = 0.0;
+	int32 MedianSteps = 0;
+	int32 P90Steps = 0;
+
+	/** Average over decided battles of the winner's summed HP and living unit count. */
+	double MeanWinnerSurvivorHP = 0.0;
+	double MeanWinnerSurvivors = 0.0;
+
+	double WallSeconds = 0.0;
+
+	int32 GetNum(EBattleOutcome Outcome) const { return NumByOutcome[static_cast<int32>(Outcome)]; }
+	double GetRate(EBattleOutcome Outcome) const { return Results.Num() > 0 ? double(GetNum(Outcome)) / Results.Num() : 0.0; }
+};
+
+/**
+ * Plays one config across many seeds to completion on the task graph, without actors or pacing.
+ * Every battle owns its simulation state and results are stored by seed, so the summary does not
+ * depend on the number of worker threads.
+ */
+struct ILLUVIUMSIMCORE_API FBattleBatchRunner
+{
+	static void Run(const FSimConfig& Config, int32 FirstSeed, int32 NumBattles, int32 MaxStepsPerBattle,
+	                FBattleBatchSummary& OutSummary, bool bSingleThreaded = false);
+
+	/** Resets Simulation to Seed with its current config and plays until the battle is over or MaxSteps ran. */
+	static FBattleSeedResult PlayToCompletion(FBattleSimulation& Simulation, int32 Seed, int32 MaxSteps);
+
+	static void LogSummary(const FSimConfig& Config, const FBattleBatchSummary& Summary);
+};
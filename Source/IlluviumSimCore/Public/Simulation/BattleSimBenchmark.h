@@ -0,0 +1,128 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+
+struct FBattleRunSummary
+{
+	TArray<FStepDelta> Deltas;
+	double TotalSeconds = 0.0;
+	double WorstStepSeconds = 0.0;
+	int32 RedAlive = 0;
+	int32 BlueAlive = 0;
+};
+
+struct FPlannerComparison
+{
+	FBattleRunSummary AStar;
+	FBattleRunSummary FlowField;
+	/** First step whose deltas differ between the planners, INDEX_NONE if the battles are identical. */
+	int32 FirstDivergentStep = INDEX_NONE;
+};
+
+/** What FBattleSimBenchmark::FindFirstDivergence plays against a reference run of the simulation. */
+enum class EDeterminismCheck : uint8
+{
+	/** A second simulation with the same config and seed. */
+	RepeatSeed,
+	/** The reference with serial planning against parallel planning forced on. */
+	SerialVsParallel,
+	/** A replay recorded from the reference run, played back. */
+	ReplayVsLive
+};
+
+struct FDivergenceReport
+{
+	int32 StepsCompared = 0;
+	/** First step whose deltas or state hashes differ, INDEX_NONE if the runs agree. */
+	int32 FirstDivergentStep = INDEX_NONE;
+	uint64 ReferenceHash = 0;
+	uint64 OtherHash = 0;
+	bool bMovesDiffer = false;
+	bool bEventsDiffer = false;
+	/** First step after which a simulation's maintained state hash disagreed with a full recompute. */
+	int32 FirstHashDriftStep = INDEX_NONE;
+};
+
+struct ILLUVIUMSIMCORE_API FBattleSimBenchmark
+{
+	/** Plays Config from Config.Seed for up to MaxSteps with the A* and the flow field planner. */
+	static FPlannerComparison CompareMovementPlanners(const FSimConfig& Config, int32 MaxSteps);
+
+	/** Plays Config from Config.Seed for up to MaxSteps, timing every step. */
+	static void PlayBattle(const FSimConfig& Config, int32 MaxSteps, FBattleRunSummary& OutSummary);
+
+	static void LogPlannerComparison(const FSimConfig& Config, const FPlannerComparison& Comparison);
+
+	/**
+	 * Plays Config for NumSeeds seeds from FirstSeed once with serial and once with parallel planning, the latter
+	 * forced on regardless of unit count, and compares every step delta. Logs the first mismatch of each seed.
+	 * @return the number of seeds whose battles differ.
+	 */
+	static int32 VerifyParallelPlanning(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps);
+
+	/**
+	 * Plays Config for NumSeeds seeds from FirstSeed on an FAsyncBattleRunner, consumed as fast as it publishes,
+	 * and compares every published delta, step count and unit column with a synchronous simulation. Logs the first
+	 * mismatch of each seed.
+	 * @return the number of seeds whose battles differ.
+	 */
+	static int32 VerifyAsyncStepping(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps);
+
+	/**
+	 * Records Config for NumSeeds seeds from FirstSeed into a replay, plays it back comparing every step and its
+	 * units with the simulation, then seeks to a few steps and compares their units. Logs the replay size per step.
+	 * @return the number of seeds whose replays differ.
+	 */
+	static int32 VerifyReplay(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps,
+	                          int32 KeyframeInterval = 100);
+
+	/**
+	 * Plays Config for NumSeeds seeds from FirstSeed, snapshots a third of the way in and checks that both a fresh
+	 * simulation restored from it and the original one rewound to it replay the rest of the battle identically.
+	 * @return the number of seeds whose continued battles differ.
+	 */
+	static int32 VerifySnapshots(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps);
+
+	/** Plays Seed twice as described by Check and reports the first step where the runs part. */
+	static FDivergenceReport FindFirstDivergence(const FSimConfig& Config, EDeterminismCheck Check, int32 Seed,
+	                                             int32 MaxSteps);
+
+	static void LogDivergenceReport(EDeterminismCheck Check, int32 Seed, const FDivergenceReport& Report);
+
+	/**
+	 * Runs FindFirstDivergence for NumSeeds seeds from FirstSeed and logs the report of every seed whose runs part
+	 * or whose state hash drifts. @return the number of those seeds.
+	 */
+	static int32 VerifyDeterminism(const FSimConfig& Config, EDeterminismCheck Check, int32 FirstSeed, int32 NumSeeds,
+	                               int32 MaxSteps);
+
+	/**
+	 * Plays Config at 100, 1k and 10k units, each on a grid a quarter full, and round trips every step delta
+	 * through FStepDelta::NetSerialize in memory. Logs the bytes per step against plain int32 fields.
+	 * @return the number of steps that did not decode to the original delta.
+	 */
+	static int32 VerifyNetSerialization(const FSimConfig& Config, int32 MaxSteps);
+
+	/**
+	 * Plays Config with FSimConfig::bCachePaths for NumSeeds seeds from FirstSeed. Before every step, each unit's
+	 * kept path is taken through FGridPathCache and must come out as long as a fresh FGridAStar search from the same
+	 * state. Every step is also played uncached from a snapshot taken before it: the cached step's moves must land on
+	 * cells that were free or left during the step, and its events must match. Then runs VerifyParallelPlanning and
+	 * VerifySnapshots with caching on. Logs the time of both kinds of step and the cache hits, repairs and replans.
+	 * @return the number of seeds that failed any of the checks.
+	 */
+	static int32 VerifyPathCache(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps);
+
+	/**
+	 * Plays Config with FSimConfig::bSchedulePaths for NumSeeds seeds from FirstSeed. Every scheduled move must land
+	 * on a free cell, and units still waiting for a path must move along the one they follow. Every step is also
+	 * played unscheduled from the same state, timed against it and checked to have the same events. Then runs
+	 * VerifyParallelPlanning and VerifySnapshots with scheduling on and no time budget. Logs the queue depth, request
+	 * latency, coalesced requests and moves made while waiting.
+	 * @return the number of seeds that failed any of the checks.
+	 */
+	static int32 VerifyPathScheduling(const FSimConfig& Config, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps);
+};
@@ -0,0 +1,249 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+#include "Navigation/GridFlowField.h"
+#include "Navigation/GridHierarchy.h"
+#include "Navigation/GridOccupancy.h"
+#include "Navigation/GridPathCache.h"
+#include "Navigation/GridPathScheduler.h"
+#include "Navigation/GridSpatialIndex.h"
+#include "Simulation/SimUnitStore.h"
+
+/**
+ * Everything that carries a battle from one step to the next, as a flat buffer. Snapshots are independent of the
+ * rules, so one snapshot can be restored into simulations with different configs on the same grid.
+ */
+struct ILLUVIUMSIMCORE_API FBattleSimSnapshot
+{
+	bool IsValid() const { return GridSize.X > 0 && GridSize.Y > 0; }
+
+	FIntPoint GridSize { 0, 0 };
+	int32 StepCount = 0;
+	int32 NextUnitId = 1;
+	int32 RandomSeed = 0;
+	int32 NumUnits = 0;
+
+	/** FSimUnitStore::WriteColumns of the living units. */
+	TArray<uint8> UnitData;
+
+	/** FCachedGridPath::Write of every living unit's path in Id order, empty if the simulation cached none. */
+	TArray<uint8> PathData;
+
+	/**
+	 * FGridPathScheduler::Write of the queue, then every living unit's followed path in Id order. Empty if the
+	 * simulation scheduled none.
+	 */
+	TArray<uint8> ScheduleData;
+};
+
+/** How moving units with FSimConfig::bCachePaths came by their paths. */
+struct FPathCacheStats
+{
+	int64 Hits = 0;
+	int64 Repairs = 0;
+	int64 Replans = 0;
+};
+
+/**
+ * The battle rules as a plain C++ object: spawning, targeting, attacks and movement planning.
+ * Needs no world, actor or tick, so battles can be stepped headless, in batches or from any thread
+ * (one simulation per thread).
+ */
+class ILLUVIUMSIMCORE_API FBattleSimulation
+{
+public:
+	FBattleSimulation() = default;
+	explicit FBattleSimulation(const FSimConfig& InConfig);
+
+	/** Takes effect on the next Reset() or RestoreSnapshot(), apart from GridSize which a snapshot brings along. */
+	void SetConfig(const FSimConfig& InConfig) { Config = InConfig; }
+	const FSimConfig& GetConfig() const { return Config; }
+
+	/** Clears the battle and spawns fresh teams from Seed. */
+	void Reset(int32 Seed);
+
+	/** Runs one step of the rules and writes what happened into OutStepDelta. */
+	void Step(FStepDelta& OutStepDelta);
+
+	bool IsBattleOver() const;
+
+	/** Captures the state between steps. Reusing OutSnapshot allocates nothing once it has held a larger battle. */
+	void SaveSnapshot(FBattleSimSnapshot& OutSnapshot) const;
+
+	/**
+	 * Continues the battle from Snapshot under the current config. Costs O(units), without touching every cell,
+	 * whenever the simulation was already on the snapshot's grid.
+	 */
+	void RestoreSnapshot(const FBattleSimSnapshot& Snapshot);
+
+	/** Number of steps run since the last Reset(). */
+	int32 GetStepCount() const { return StepCount; }
+
+	/** Hash of the living units, maintained as they change. Matches FSimUnitStore::ComputeStateHash(). */
+	uint64 GetStateHash() const { return StateHash; }
+
+	/** Living units, ordered by Id. */
+	const FSimUnitStore& GetUnits() const { return Units; }
+	const FGridOccupancy& GetOccupancy() const { return Occupancy; }
+	const FGridSpatialIndex& GetSpatialIndex() const { return SpatialIndex; }
+
+	/** Totals since the last Reset(). */
+	const FPathCacheStats& GetPathCacheStats() const { return PathCacheStats; }
+
+	/** Totals since the last Reset(), only counting with FSimConfig::bSchedulePaths. */
+	const FPathSchedulerStats& GetPathSchedulerStats() const { return PathScheduler.GetStats(); }
+
+	/** FSimConfig::bSchedulePaths: the last path handed to the unit with UnitId, empty if it has none. */
+	TArrayView<const FGridCoordinate> GetFollowedPath(int32 UnitId) const;
+
+	/** FSimConfig::bSchedulePaths: whether the unit with UnitId waits in the queue for a new path. */
+	bool IsWaitingForPath(int32 UnitId) const { return PathScheduler.IsQueued(UnitId); }
+
+private:
+	/** Places the teams on distinct open cells drawn from RandomStream. */
+	void SpawnInitialTeams();
+	FGridCoordinate MakeRandomCell() const;
+	int32 FindClosestEnemyUnitId(int32 SourceUnitIndex) const;
+	void BuildFlowFields();
+
+	/** Takes the config's static obstacles if they match the grid. */
+	void UpdateStaticObstacles();
+
+	/** (Re)builds NavHierarchy when the grid, cluster size or static obstacles no longer match it. */
+	void EnsureNavHierarchy();
+
+	/** Acts every unit in turn, planning each one against the state left by the units before it. */
+	void ActUnitsSerially(FStepDelta& OutStepDelta);
+
+	/**
+	 * Plans every unit's target and move concurrently against the state at the start of the acting loop, then
+	 * resolves them in unit order. A plan is replanned on the spot when an earlier unit killed its target or
+	 * changed a cell it read, so the outcome matches ActUnitsSerially exactly.
+	 */
+	void ActUnitsWithParallelPlanning(FStepDelta& OutStepDelta);
+
+	/** What changes about the path a unit keeps between steps once its turn comes. */
+	struct FPathUpdate
+	{
+		bool bIsSet = false;
+
+		/** FSimConfig::bCachePaths: the path to keep and how PlanMove came by it. */
+		EPathCacheResult Result = EPathCacheResult::NoPath;
+		FCachedGridPath Path;
+
+		/** FSimConfig::bSchedulePaths: where along its followed path the unit stood, and the goal of a new one. */
+		int32 FollowedIndex = INDEX_NONE;
+		bool bWantsPath = false;
+		FGridCoordinate WantedGoal;
+	};
+
+	bool UsesPathScheduler() const { return Config.MovementPlanner == EMovementPlanner::AStar && Config.bSchedulePaths; }
+
+	/**
+	 * Picks the cell the unit at ActingIndex walks to this step on its way to TargetCell, against StepOccupancy.
+	 * OutReadMin/OutReadMax bound every cell of StepOccupancy the decision depended on. Leaves the unit's kept
+	 * path untouched, what to change about it goes to OutPathUpdate.
+	 */
+	bool PlanMove(int32 ActingIndex, const FGridCoordinate& TargetCell, FGridCoordinate& OutNextCell,
+	              FGridCoordinate& OutReadMin, FGridCoordinate& OutReadMax, FPathUpdate& OutPathUpdate) const;
+
+	/** PlanMove with FSimConfig::bSchedulePaths: walks the unit's followed path as far as it is free. */
+	bool PlanFollowedPathMove(int32 ActingIndex, const FGridCoordinate& TargetCell, int32 MaxCellsThisStep,
+	                          FGridCoordinate& OutNextCell, FGridCoordinate& OutReadMin, FGridCoordinate& OutReadMax,
+	                          FPathUpdate& OutPathUpdate) const;
+
+	/** Keeps what the unit's move was planned with: its new cached path, or its progress and path request. */
+	void CommitPathUpdate(int32 ActingIndex, FPathUpdate& PathUpdate);
+
+	/** Queues the path requests of the step from where the units stand now and serves them within budget. */
+	void ServePathRequests();
+
+	/** Attacks with the unit at ActingIndex if its cooldown allows. @return true if the target died. */
+	bool ResolveAttack(int32 ActingIndex, int32 TargetIndex, FStepDelta& OutStepDelta);
+
+	/** Reserves NextCell in StepOccupancy and queues the move unless the cell is taken. */
+	bool TryReserveMove(int32 ActingIndex, const FGridCoordinate& ActingCell, const FGridCoordinate& NextCell);
+
+	void MarkCellChanged(const FGridCoordinate& Cell);
+	bool HasChangedCellIn(const FGridCoordinate& Min, const FGridCoordinate& Max) const;
+
+	FSimConfig Config;
+
+	FRandomStream RandomStream;
+
+	FSimUnitStore Units;
+
+	int32 NextUnitId = 1;
+
+	int32 StepCount = 0;
+
+	uint64 StateHash = 0;
+
+	/** Cells held by living units, kept in sync with spawns, moves and deaths. */
+	FGridOccupancy Occupancy;
+
+	/** Working copy of Occupancy for the running step, also holding cells reserved by planned moves. */
+	FGridOccupancy StepOccupancy;
+
+	/** Living units by cell and team, kept in sync with spawns, moves and deaths. */
+	FGridSpatialIndex SpatialIndex;
+
+	/** Distance fields towards the enemies of each team, indexed by EBattleTeam. Only built by the flow field planner. */
+	FGridFlowField FlowFieldByTeam[2];
+	TArray<FGridCoordinate> FlowFieldSources;
+
+	/** Config.StaticObstacles as of the last Reset() or RestoreSnapshot(), null if there were none for the grid. */
+	TSharedPtr<const FGridRegionLabels> StaticRegions;
+
+	/** Cluster graph over the static obstacles. Only built by the hierarchical planner. */
+	FGridHierarchy NavHierarchy;
+	TSharedPtr<const FGridRegionLabels> NavHierarchyRegions;
+
+	/** Paths kept between steps by unit Id. Only used with FSimConfig::bCachePaths. */
+	TArray<FCachedGridPath> CachedPaths;
+	FPathUpdate SerialPathUpdate;
+	FPathCacheStats PathCacheStats;
+
+	/** The last path PathScheduler handed a unit and how far along it the unit got. */
+	struct FFollowedPath
+	{
+		TArray<FGridCoordinate> Cells;
+		int32 Progress = 0;
+
+		/** Set by the unit's move this step, queued once the moves are applied. */
+		bool bWantsPath = false;
+		FGridCoordinate WantedGoal;
+	};
+
+	/** By unit Id. Only used with FSimConfig::bSchedulePaths. */
+	TArray<FFollowedPath> FollowedPaths;
+	FGridPathScheduler PathScheduler;
+
+	struct FPlannedMove
+	{
+		int32 UnitIndex;
+		FGridCoordinate FromCell;
+		FGridCoordinate ToCell;
+	};
+	TArray<FPlannedMove> PlannedMoves;
+
+	/** What a unit decided against the state at the start of the acting loop. */
+	struct FUnitPlan
+	{
+		int32 TargetUnitId = INDEX_NONE;
+		bool bHasMovePlan = false;
+		bool bHasNextCell = false;
+		FGridCoordinate NextCell;
+		FGridCoordinate ReadMin;
+		FGridCoordinate ReadMax;
+		FPathUpdate PathUpdate;
+	};
+	TArray<FUnitPlan> UnitPlans;
+
+	/** Cells of StepOccupancy changed by deaths and reservations since the parallel plans were made. */
+	FGridOccupancy ChangedCells;
+	TArray<FGridCoordinate> ChangedCellList;
+};
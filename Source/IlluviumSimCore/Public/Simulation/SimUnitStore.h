@@ -0,0 +1,99 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+
+/**
+ * Structure-of-arrays storage for simulated units.
+ * Units are dense and ordered by ascending Id, which is the order the simulation acts in. A unit that dies keeps
+ * its slot (with Alive cleared) until Compact() runs at the end of the step, so indices are stable within a step.
+ */
+struct ILLUVIUMSIMCORE_API FSimUnitStore
+{
+	void Reset();
+
+	/** Appends a unit. Its Id must be greater than every Id already stored. @return the unit's index. */
+	int32 Add(const FSimUnit& Unit);
+
+	/** Makes this store an exact copy of Other, reusing the memory it already holds. */
+	void CopyFrom(const FSimUnitStore& Other);
+
+	/**
+	 * Appends Ids, cells, HP, cooldowns and teams as contiguous columns to Out. Alive is not written, call it
+	 * between steps when every stored unit is alive.
+	 */
+	void WriteColumns(TArray<uint8>& Out) const;
+
+	/**
+	 * Replaces the units with NumUnits living units read from columns written by WriteColumns. Touches only the
+	 * Id lookup entries of the old and new units and allocates nothing once the arrays are large enough.
+	 * @return the byte after the columns.
+	 */
+	const uint8* ReadColumns(const uint8* Data, int32 NumUnits);
+
+	/** Drops dead units in one pass, keeping the remaining ones in Id order and their Id lookup up to date. */
+	void Compact();
+
+	FORCEINLINE int32 Num() const { return Ids.Num(); }
+
+	/** @return the index of the unit with UnitId or INDEX_NONE once it was compacted away. */
+	FORCEINLINE int32 FindIndex(int32 UnitId) const
+	{
+		return IndexById.IsValidIndex(UnitId) ? IndexById[UnitId] : INDEX_NONE;
+	}
+
+	FORCEINLINE FGridCoordinate GetCell(int32 Index) const { return FGridCoordinate(CellX[Index], CellY[Index]); }
+
+	FORCEINLINE void SetCell(int32 Index, const FGridCoordinate& Cell)
+	{
+		CellX[Index] = Cell.X;
+		CellY[Index] = Cell.Y;
+	}
+
+	FORCEINLINE bool IsAlive(int32 Index) const { return Alive[Index]; }
+
+	FSimUnit GetUnit(int32 Index) const;
+
+	/**
+	 * Hash of the state of one unit, its cooldown aside. The hash of a battle is the sum of these over the living
+	 * units, so it can be kept up to date by subtracting a unit's old hash and adding its new one on every change.
+	 */
+	static FORCEINLINE uint64 HashUnitState(int32 UnitId, EBattleTeam UnitTeam, int32 UnitHP, const FGridCoordinate& Cell)
+	{
+		uint64 Hash = MixHashBits((uint64(uint32(UnitId)) << 32) | uint32(UnitHP));
+		Hash = MixHashBits(Hash ^ ((uint64(uint32(Cell.X)) << 32) | uint32(Cell.Y)));
+		return MixHashBits(Hash + static_cast<uint64>(UnitTeam));
+	}
+
+	FORCEINLINE uint64 HashUnitState(int32 Index) const
+	{
+		return HashUnitState(Ids[Index], Team[Index], HP[Index], GetCell(Index));
+	}
+
+	/** Sums HashUnitState over the living units from scratch. */
+	uint64 ComputeStateHash() const;
+
+	/** @return the name of the first column that differs from Other's, null if every column matches. */
+	const TCHAR* FindMismatchedColumn(const FSimUnitStore& Other) const;
+
+	TArray<int32> Ids;
+	TArray<int32> CellX;
+	TArray<int32> CellY;
+	TArray<int32> HP;
+	TArray<int32> AttackCooldown;
+	TArray<EBattleTeam> Team;
+	TArray<bool> Alive;
+
+private:
+	/** SplitMix64 finalizer. */
+	static FORCEINLINE uint64 MixHashBits(uint64 Value)
+	{
+		Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+		Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+		return Value ^ (Value >> 31);
+	}
+
+	TArray<int32> IndexById;
+};
@@ -0,0 +1,39 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+
+/**
+ * A fixed set of recycled step deltas. Advance() hands out the oldest delta with its arrays emptied but their
+ * capacity kept, so producing deltas allocates nothing once every slot has grown to the busiest step. The most
+ * recent deltas stay readable until they are recycled.
+ */
+class ILLUVIUMSIMCORE_API FStepDeltaRing
+{
+public:
+	/** Sizes the ring and reserves room in every slot. Capacity already reserved beyond that is kept. */
+	void Initialize(int32 InCapacity, int32 MovesPerStep, int32 EventsPerStep);
+
+	/** Forgets the stored deltas but keeps their memory. */
+	void Reset();
+
+	/** Recycles the oldest delta, empties it and makes it the latest. */
+	FStepDelta& Advance();
+
+	/** The delta produced StepsAgo steps before the latest one, or null if it was never produced or was recycled. */
+	const FStepDelta* GetRecent(int32 StepsAgo = 0) const;
+
+	int32 Num() const { return NumStored; }
+	int32 GetCapacity() const { return Slots.Num(); }
+
+	/** Upper bounds for one step of a battle with NumUnits units: a move each, and attack, hit and death events. */
+	static int32 GetMaxMovesPerStep(int32 NumUnits) { return NumUnits; }
+	static int32 GetMaxEventsPerStep(int32 NumUnits) { return NumUnits * 3; }
+
+private:
+	TArray<FStepDelta> Slots;
+	int32 LatestSlot = INDEX_NONE;
+	int32 NumStored = 0;
+};
@@ -0,0 +1,95 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "IlluviumTT/Public/Commandlets/GridBenchmarkCommandlet.h"
+
+#include "Benchmark/AllocationCounter.h"
+#include "Benchmark/GridPerfSuite.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	template <typename ValueType>
+	void ParseList(const FString& Params, const TCHAR* Key, TArray<ValueType>& OutValues)
+	{
+		FString ListText;
+		if (!FParse::Value(*Params, Key, ListText)) return;
+
+		TArray<FString> Entries;
+		ListText.ParseIntoArray(Entries, TEXT(","));
+
+		OutValues.Reset();
+		for (const FString& Entry : Entries)
+		{
+			ValueType Value;
+			LexFromString(Value, *Entry);
+			OutValues.Add(Value);
+		}
+	}
+}
+
+UGridBenchmarkCommandlet::UGridBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UGridBenchmarkCommandlet::Main(const FString& Params)
+{
+	FGridPerfSuiteSettings Settings;
+	if (FParse::Param(*Params, TEXT("Quick")))
+	{
+		Settings.GridSizes = { 100, 256 };
+		Settings.UnitCounts = { 2, 100, 1000 };
+		Settings.PathQueries = 16;
+		Settings.StepsPerRun = 5;
+	}
+
+	ParseList(Params, TEXT("GridSizes="), Settings.GridSizes);
+	ParseList(Params, TEXT("Densities="), Settings.ObstacleDensities);
+	ParseList(Params, TEXT("UnitCounts="), Settings.UnitCounts);
+	FParse::Value(*Params, TEXT("PathQueries="), Settings.PathQueries);
+	FParse::Value(*Params, TEXT("Steps="), Settings.StepsPerRun);
+	FParse::Value(*Params, TEXT("Seed="), Settings.Seed);
+	FParse::Value(*Params, TEXT("ExpansionBudget="), Settings.ExpansionBudget);
+	FParse::Value(*Params, TEXT("PathBudgetPerStep="), Settings.PathBudgetPerStep);
+	Settings.bWallWithGap = !FParse::Param(*Params, TEXT("NoWall"));
+	Settings.bSealedWall = !FParse::Param(*Params, TEXT("NoWall"));
+	Settings.bRegionLabels = !FParse::Param(*Params, TEXT("NoRegions"));
+	Settings.bJumpPointSearch = !FParse::Param(*Params, TEXT("NoJPS"));
+	Settings.bParallelPlanning = FParse::Param(*Params, TEXT("ParallelPlanning"));
+
+	if (!FParse::Param(*Params, TEXT("NoAllocationCounting")))
+	{
+		FAllocationCounter::Install();
+	}
+
+	TArray<FGridPerfResult> Results;
+	FGridPerfSuite::Run(Settings, Results);
+
+	FString OutputPath;
+	if (!FParse::Value(*Params, TEXT("Output="), OutputPath))
+	{
+		OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") /
+			FString::Printf(TEXT("GridBenchmark-%s.json"), *FDateTime::Now().ToString());
+	}
+
+	if (!FFileHelper::SaveStringToFile(FGridPerfSuite::ToJson(Settings, Results), *OutputPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write benchmark results to %s"), *OutputPath);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %d benchmark results to %s"), Results.Num(), *OutputPath);
+
+	const int32 NumPathMismatches = FGridPerfSuite::CountPathMismatches(Results);
+	if (NumPathMismatches > 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%d jump point paths differ in length from A*'s"), NumPathMismatches);
+		return 1;
+	}
+	return 0;
+}
@@ -2,9 +2,17 @@
 
 #include "Core/BattleSimGameMode.h"
 #include "Core/GridGameState.h"
+#include "GridBattleStats.h"
 #include "IlluviumTT/Public/GridMap/GridMap.h"
+#include "IlluviumTT/Public/Spheres/InstancedUnitVisualizer.h"
 #include "IlluviumTT/Public/Spheres/SimulatedSphere.h"
 
+DECLARE_CYCLE_STAT(TEXT("Apply Step Delta To Visuals"), STAT_GridBattle_ApplyStepDeltaToVisuals, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("Sync Missing Visuals"), STAT_GridBattle_SyncMissingVisuals, STATGROUP_GridBattle);
+DECLARE_CYCLE_STAT(TEXT("Cleanup Dead Visuals"), STAT_GridBattle_CleanupDeadVisuals, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sphere Actors Spawned"), STAT_GridBattle_SphereActorsSpawned, STATGROUP_GridBattle);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Spheres"), STAT_GridBattle_PooledSpheres, STATGROUP_GridBattle);
+
 ABattleSimGameMode::ABattleSimGameMode()
 {
 	PrimaryActorTick.bCanEverTick = false; // visuals update via delegate, not per-tick
@@ -19,7 +27,22 @@ void ABattleSimGameMode::BeginPlay()
 
 	ActiveGridMap = GridGameState->ActiveGridMap;
 
-	GridGameState->OnSimulationStepProduced.AddDynamic(this, &ABattleSimGameMode::HandleSimulationStepProduced);
+	if (bUseInstancedVisuals)
+	{
+		UClass* VisualizerClass = InstancedVisualizerClass ? *InstancedVisualizerClass : AInstancedUnitVisualizer::StaticClass();
+		InstancedVisualizer = GetWorld()->SpawnActor<AInstancedUnitVisualizer>(VisualizerClass, FTransform::Identity);
+		if (InstancedVisualizer)
+		{
+			InstancedVisualizer->SetStepDuration(1.f / FMath::Max(1.f, GridGameState->SimulationStepsPerSecond));
+		}
+	}
+	else
+	{
+		WarmSpherePool(SpherePoolWarmupSize);
+	}
+
+	GridGameState->OnSimulationStepProducedNative.AddUObject(this, &ABattleSimGameMode::HandleSimulationStepProduced);
+	GridGameState->OnSimulationStateReplaced.AddUObject(this, &ABattleSimGameMode::HandleSimulationStateReplaced);
 
 	SyncMissingVisuals();
 }
@@ -28,16 +51,26 @@ void ABattleSimGameMode::ResetSimulationWithSeed(int32 Seed)
 {
 	if (!GridGameState) return;
 
+	GridGameState->ResetSimulation(Seed);
+}
+
+void ABattleSimGameMode::HandleSimulationStateReplaced()
+{
+	// Spheres still fading out from earlier deaths return to the pool on their own
 	for (auto& Entry : VisualByUnitId)
 	{
 		if (ASimulatedSphere* Visual = Entry.Value)
 		{
-			Visual->Destroy();
+			ReleaseSphere(Visual);
 		}
 	}
 	VisualByUnitId.Reset();
 
-	GridGameState->ResetSimulation(Seed);
+	if (InstancedVisualizer)
+	{
+		InstancedVisualizer->ClearUnits();
+	}
+
 	SyncMissingVisuals();
 }
 
@@ -48,31 +81,54 @@ void ABattleSimGameMode::HandleSimulationStepProduced(const FStepDelta& StepDelt
 
 void ABattleSimGameMode::SyncMissingVisuals()
 {
-	if (!SimulatedSphereClass || !GridGameState) return;
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_SyncMissingVisuals);
+
+	if (!GridGameState) return;
+
+	const FSimUnitStore& Units = GridGameState->GetUnits();
 
-	const TMap<int32, FSimUnit>& Units = GridGameState->GetUnitsById();
-	for (const auto& UnitEntry : Units)
+	if (InstancedVisualizer)
 	{
-		const int32 UnitId = UnitEntry.Key;
-		const FSimUnit& SimulationUnit = UnitEntry.Value;
+		for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+		{
+			const int32 UnitId = Units.Ids[UnitIndex];
+			if (!Units.IsAlive(UnitIndex) || InstancedVisualizer->HasUnit(UnitId)) continue;
+
+			InstancedVisualizer->AddUnit(UnitId, Units.Team[UnitIndex], CellToWorld(Units.GetCell(UnitIndex)));
+		}
+		return;
+	}
+
+	if (!SimulatedSphereClass) return;
 
-		if (!SimulationUnit.bAlive) continue;
+	for (int32 UnitIndex = 0; UnitIndex < Units.Num(); ++UnitIndex)
+	{
+		const int32 UnitId = Units.Ids[UnitIndex];
+
+		if (!Units.IsAlive(UnitIndex)) continue;
 		if (VisualByUnitId.Contains(UnitId)) continue;
 
-		const FVector SpawnLocation = CellToWorld(SimulationUnit.Cell);
-		ASimulatedSphere* SpawnedVisual = GetWorld()->SpawnActor<ASimulatedSphere>(
-			SimulatedSphereClass, SpawnLocation, FRotator::ZeroRotator);
-		if (SpawnedVisual)
+		const FVector SpawnLocation = CellToWorld(Units.GetCell(UnitIndex));
+		ASimulatedSphere* Visual = AcquireSphere(SpawnLocation);
+		if (Visual)
 		{
-			SpawnedVisual->Init(UnitId, SimulationUnit.Team, SpawnLocation, /*StepDuration*/
-			                    1.f / FMath::Max(1.f, GridGameState->SimulationStepsPerSecond));
-			VisualByUnitId.Add(UnitId, SpawnedVisual);
+			Visual->Init(UnitId, Units.Team[UnitIndex], SpawnLocation, /*StepDuration*/
+			             1.f / FMath::Max(1.f, GridGameState->SimulationStepsPerSecond));
+			VisualByUnitId.Add(UnitId, Visual);
 		}
 	}
 }
 
 void ABattleSimGameMode::ApplyStepDeltaToVisuals(const FStepDelta& StepDelta)
 {
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_ApplyStepDeltaToVisuals);
+
+	if (InstancedVisualizer)
+	{
+		ApplyStepDeltaToInstances(StepDelta);
+		return;
+	}
+
 	for (const FSimMove& MoveRecord : StepDelta.Moves)
 	{
 		ASimulatedSphere* Visual = VisualByUnitId.FindRef(MoveRecord.ActorId);
@@ -104,21 +160,97 @@ void ABattleSimGameMode::ApplyStepDeltaToVisuals(const FStepDelta& StepDelta)
 	SyncMissingVisuals();
 }
 
+void ABattleSimGameMode::ApplyStepDeltaToInstances(const FStepDelta& StepDelta)
+{
+	for (const FSimMove& MoveRecord : StepDelta.Moves)
+	{
+		InstancedVisualizer->OnUnitNewCell(MoveRecord.ActorId, CellToWorld(MoveRecord.From), CellToWorld(MoveRecord.To));
+	}
+
+	for (const FSimEvent& SimulationEvent : StepDelta.Events)
+	{
+		switch (SimulationEvent.EventType)
+		{
+		case EEventType::Attack: InstancedVisualizer->OnUnitAttack(SimulationEvent.ActorId);
+			break;
+		case EEventType::Hit: InstancedVisualizer->OnUnitHit(SimulationEvent.ActorId);
+			break;
+		case EEventType::Die: InstancedVisualizer->OnUnitDie(SimulationEvent.ActorId);
+			break;
+		default: break;
+		}
+	}
+
+	// Dead units fade out and free their instance on their own
+	SyncMissingVisuals();
+}
+
 void ABattleSimGameMode::CleanupDeadVisuals()
 {
-	const TMap<int32, FSimUnit>& Units = GridGameState->GetUnitsById();
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_CleanupDeadVisuals);
+
+	const FSimUnitStore& Units = GridGameState->GetUnits();
 
 	for (auto It = VisualByUnitId.CreateIterator(); It; ++It)
 	{
-		const int32 UnitId = It->Key;
-		const FSimUnit* Unit = Units.Find(UnitId);
-		if (!Unit || !Unit->bAlive)
+		const int32 UnitIndex = Units.FindIndex(It->Key);
+		if (UnitIndex == INDEX_NONE || !Units.IsAlive(UnitIndex))
 		{
 			It.RemoveCurrent();
 		}
 	}
 }
 
+ASimulatedSphere* ABattleSimGameMode::AcquireSphere(const FVector& Location)
+{
+	while (SpherePool.Num() > 0)
+	{
+		ASimulatedSphere* Sphere = SpherePool.Pop(EAllowShrinking::No);
+		DEC_DWORD_STAT(STAT_GridBattle_PooledSpheres);
+
+		// Pooled spheres can still be destroyed from outside, e.g. by a level transition
+		if (IsValid(Sphere)) return Sphere;
+	}
+
+	return SpawnPooledSphere(Location);
+}
+
+void ABattleSimGameMode::ReleaseSphere(ASimulatedSphere* Sphere)
+{
+	if (!IsValid(Sphere) || !Sphere->IsActive()) return;
+
+	Sphere->Deactivate();
+	SpherePool.Add(Sphere);
+	INC_DWORD_STAT(STAT_GridBattle_PooledSpheres);
+}
+
+void ABattleSimGameMode::WarmSpherePool(int32 NumSpheres)
+{
+	if (!SimulatedSphereClass) return;
+
+	SpherePool.Reserve(NumSpheres);
+	while (SpherePool.Num() < NumSpheres)
+	{
+		ASimulatedSphere* Sphere = SpawnPooledSphere(GetActorLocation());
+		if (!Sphere) break;
+
+		Sphere->Deactivate();
+		SpherePool.Add(Sphere);
+		INC_DWORD_STAT(STAT_GridBattle_PooledSpheres);
+	}
+}
+
+ASimulatedSphere* ABattleSimGameMode::SpawnPooledSphere(const FVector& Location)
+{
+	ASimulatedSphere* Sphere = GetWorld()->SpawnActor<ASimulatedSphere>(SimulatedSphereClass, Location, FRotator::ZeroRotator);
+	if (Sphere)
+	{
+		INC_DWORD_STAT(STAT_GridBattle_SphereActorsSpawned);
+		Sphere->OnFadedOut.BindUObject(this, &ABattleSimGameMode::ReleaseSphere);
+	}
+	return Sphere;
+}
+
 FVector ABattleSimGameMode::CellToWorld(const FGridCoordinate& Cell) const
 {
 	if (!ActiveGridMap) return FVector::ZeroVector;
@@ -3,9 +3,250 @@
 
 #include "IlluviumTT/Public/Core/GridGameState.h"
 
+#include "Benchmark/AllocationCounter.h"
 #include "EngineUtils.h"
+#include "GridBattleStats.h"
+#include "HAL/IConsoleManager.h"
 #include "IlluviumTT/Public/GridMap/GridMap.h"
-#include "Navigation/GridAStar.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "Simulation/BattleBatchRunner.h"
+#include "Simulation/BattleSimBenchmark.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Steps This Frame"), STAT_GridBattle_StepsThisFrame, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Moves This Frame"), STAT_GridBattle_MovesThisFrame, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Events This Frame"), STAT_GridBattle_EventsThisFrame, STATGROUP_GridBattle);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Units Alive"), STAT_GridBattle_UnitsAlive, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Step Allocations"), STAT_GridBattle_StepAllocations, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Step Listener Allocations"), STAT_GridBattle_StepListenerAllocations, STATGROUP_GridBattle);
+
+TRACE_DECLARE_INT_COUNTER(GridBattleStepsThisFrame, TEXT("GridBattle/StepsThisFrame"));
+TRACE_DECLARE_INT_COUNTER(GridBattleStepMoves, TEXT("GridBattle/StepMoves"));
+TRACE_DECLARE_INT_COUNTER(GridBattleStepEvents, TEXT("GridBattle/StepEvents"));
+TRACE_DECLARE_INT_COUNTER(GridBattleUnitsAlive, TEXT("GridBattle/UnitsAlive"));
+
+namespace
+{
+	using FSeedCheck = TFunction<void(AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)>;
+
+	/**
+	 * Plays seeds of the current battle config through RunCheck. Args from FirstArg on: [NumSeeds] [MaxSteps]
+	 * [FirstSeed], FirstSeed defaulting to the config's seed.
+	 */
+	void RunSeedCheck(const TArray<FString>& Args, int32 FirstArg, UWorld* World, int32 DefaultNumSeeds,
+		int32 DefaultMaxSteps, const FSeedCheck& RunCheck)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		const int32 NumSeeds = Args.Num() > FirstArg ? FCString::Atoi(*Args[FirstArg]) : DefaultNumSeeds;
+		const int32 MaxSteps = Args.Num() > FirstArg + 1 ? FCString::Atoi(*Args[FirstArg + 1]) : DefaultMaxSteps;
+		const int32 FirstSeed = Args.Num() > FirstArg + 2 ? FCString::Atoi(*Args[FirstArg + 2]) : GameState->SimulationConfig.Seed;
+		RunCheck(*GameState, FirstSeed, NumSeeds, MaxSteps);
+	}
+
+	/** Console command running RunSeedCheck on all of its args. */
+	FConsoleCommandWithWorldAndArgsDelegate MakeSeedCheckCommand(int32 DefaultNumSeeds, int32 DefaultMaxSteps, FSeedCheck RunCheck)
+	{
+		return FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([=](const TArray<FString>& Args, UWorld* World)
+		{
+			RunSeedCheck(Args, 0, World, DefaultNumSeeds, DefaultMaxSteps, RunCheck);
+		});
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GBenchmarkMovementPlannersCommand(
+	TEXT("GridBattle.BenchmarkPlanners"),
+	TEXT("Plays the current battle config with the A* and flow field planners and logs timings. Args: [MaxSteps]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		const int32 MaxSteps = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		GameState->BenchmarkMovementPlanners(MaxSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GRunBattleBatchCommand(
+	TEXT("GridBattle.RunBatch"),
+	TEXT("Plays the current battle config headless across many seeds and logs aggregate results. Args: [NumBattles] [MaxSteps] [FirstSeed]"),
+	MakeSeedCheckCommand(1000, 1000, [](AGridGameState& GameState, int32 FirstSeed, int32 NumBattles, int32 MaxSteps)
+	{
+		GameState.RunBattleBatch(FirstSeed, NumBattles, MaxSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GVerifyParallelPlanningCommand(
+	TEXT("GridBattle.VerifyParallelPlanning"),
+	TEXT("Plays the current battle config with serial and parallel planning and checks the step deltas match. Args: [NumSeeds] [MaxSteps] [FirstSeed]"),
+	MakeSeedCheckCommand(100, 1000, [](AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+	{
+		FBattleSimBenchmark::VerifyParallelPlanning(GameState.SimulationConfig, FirstSeed, NumSeeds, MaxSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GVerifyAsyncSimulationCommand(
+	TEXT("GridBattle.VerifyAsyncSimulation"),
+	TEXT("Plays the current battle config on the async runner and checks every step matches synchronous stepping. Args: [NumSeeds] [MaxSteps] [FirstSeed]"),
+	MakeSeedCheckCommand(20, 1000, [](AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+	{
+		FBattleSimBenchmark::VerifyAsyncStepping(GameState.SimulationConfig, FirstSeed, NumSeeds, MaxSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GCountStepAllocationsCommand(
+	TEXT("GridBattle.CountStepAllocations"),
+	TEXT("Counts the heap allocations of the next simulation steps on the game thread and logs them, needs -CountAllocations. Args: [NumSteps]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		const int32 NumSteps = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		GameState->CountStepAllocations(NumSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GSaveReplayCommand(
+	TEXT("GridBattle.SaveReplay"),
+	TEXT("Saves the battle recorded since the last reset, see bRecordReplay. Args: [Filename]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		GameState->SaveReplay(Args.Num() > 0 ? Args[0] : FString());
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GPlayReplayCommand(
+	TEXT("GridBattle.PlayReplay"),
+	TEXT("Stops the simulation and plays a replay file, relative names are looked up in Saved/Replays. Args: <Filename> [Speed]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState || Args.Num() == 0) return;
+
+		if (Args.Num() > 1)
+		{
+			GameState->ReplayPlaybackSpeed = FMath::Max(0.f, FCString::Atof(*Args[1]));
+		}
+		GameState->PlayReplay(Args[0]);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GSeekReplayCommand(
+	TEXT("GridBattle.SeekReplay"),
+	TEXT("Jumps the playing replay to a step. Args: <Step>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState || Args.Num() == 0) return;
+
+		GameState->SeekReplay(FCString::Atoi(*Args[0]));
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GStopReplayCommand(
+	TEXT("GridBattle.StopReplay"),
+	TEXT("Closes the playing replay and restarts the simulation."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		GameState->StopReplay();
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GVerifyReplayCommand(
+	TEXT("GridBattle.VerifyReplay"),
+	TEXT("Records the current battle config into replays and checks playback and seeking reproduce it. Args: [NumSeeds] [MaxSteps] [FirstSeed]"),
+	MakeSeedCheckCommand(20, 1000, [](AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+	{
+		FBattleSimBenchmark::VerifyReplay(GameState.SimulationConfig, FirstSeed, NumSeeds, MaxSteps,
+		                                  GameState.ReplayKeyframeInterval);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GSaveSnapshotCommand(
+	TEXT("GridBattle.SaveSnapshot"),
+	TEXT("Remembers the current battle state so GridBattle.RestoreSnapshot can rewind to it."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		GameState->SaveSimulationSnapshot();
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GRestoreSnapshotCommand(
+	TEXT("GridBattle.RestoreSnapshot"),
+	TEXT("Rewinds the battle to the state saved by GridBattle.SaveSnapshot."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		GameState->RestoreSimulationSnapshot();
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GVerifySnapshotsCommand(
+	TEXT("GridBattle.VerifySnapshots"),
+	TEXT("Plays the current battle config and checks battles restored from a mid-battle snapshot continue identically. Args: [NumSeeds] [MaxSteps] [FirstSeed]"),
+	MakeSeedCheckCommand(20, 1000, [](AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+	{
+		FBattleSimBenchmark::VerifySnapshots(GameState.SimulationConfig, FirstSeed, NumSeeds, MaxSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GFindDivergenceCommand(
+	TEXT("GridBattle.FindDivergence"),
+	TEXT("Plays seeds of the current battle config twice and logs the first step where the runs differ. Args: [Repeat|Parallel|Replay] [NumSeeds] [MaxSteps] [FirstSeed]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		EDeterminismCheck Check = EDeterminismCheck::RepeatSeed;
+		if (Args.Num() > 0 && Args[0].Equals(TEXT("Parallel"), ESearchCase::IgnoreCase))
+		{
+			Check = EDeterminismCheck::SerialVsParallel;
+		}
+		else if (Args.Num() > 0 && Args[0].Equals(TEXT("Replay"), ESearchCase::IgnoreCase))
+		{
+			Check = EDeterminismCheck::ReplayVsLive;
+		}
+
+		RunSeedCheck(Args, 1, World, 1, 1000, [Check](AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+		{
+			FBattleSimBenchmark::VerifyDeterminism(GameState.SimulationConfig, Check, FirstSeed, NumSeeds, MaxSteps);
+		});
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GVerifyNetSerializeCommand(
+	TEXT("GridBattle.VerifyNetSerialize"),
+	TEXT("Round-trips the step deltas of 100, 1k and 10k unit battles through NetSerialize and logs their size. Args: [MaxSteps]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGridGameState* GameState = World ? World->GetGameState<AGridGameState>() : nullptr;
+		if (!GameState) return;
+
+		const int32 MaxSteps = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		FBattleSimBenchmark::VerifyNetSerialization(GameState->SimulationConfig, MaxSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GVerifyPathCacheCommand(
+	TEXT("GridBattle.VerifyPathCache"),
+	TEXT("Plays the current battle config with cached paths, checks it against uncached steps and logs cache hits and timings. Args: [NumSeeds] [MaxSteps] [FirstSeed]"),
+	MakeSeedCheckCommand(10, 500, [](AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+	{
+		FBattleSimBenchmark::VerifyPathCache(GameState.SimulationConfig, FirstSeed, NumSeeds, MaxSteps);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GVerifyPathSchedulingCommand(
+	TEXT("GridBattle.VerifyPathScheduling"),
+	TEXT("Plays the current battle config with scheduled paths, checks it stays deterministic and logs queue depth, request latency and timings. Args: [NumSeeds] [MaxSteps] [FirstSeed]"),
+	MakeSeedCheckCommand(10, 500, [](AGridGameState& GameState, int32 FirstSeed, int32 NumSeeds, int32 MaxSteps)
+	{
+		FBattleSimBenchmark::VerifyPathScheduling(GameState.SimulationConfig, FirstSeed, NumSeeds, MaxSteps);
+	}));
+
+namespace
+{
+	FString ResolveReplayPath(const FString& Filename)
+	{
+		const FString ReplayDirectory = FPaths::ProjectSavedDir() / TEXT("Replays");
+		return FPaths::IsRelative(Filename) ? ReplayDirectory / Filename : Filename;
+	}
+}
 
 AGridGameState::AGridGameState()
 {
@@ -20,6 +261,15 @@ void AGridGameState::BeginPlay()
 	StartSimulation();
 }
 
+void AGridGameState::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	AsyncRunner.Shutdown();
+	StopRecordingReplay();
+	ReplayPlayer.Close();
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void AGridGameState::DiscoverGridMap()
 {
 	for (TActorIterator<AGridMap> It(GetWorld()); It; ++It)
@@ -31,6 +281,7 @@ void AGridGameState::DiscoverGridMap()
 	if (ActiveGridMap)
 	{
 		SimulationConfig.GridSize = FIntPoint(ActiveGridMap->XSize, ActiveGridMap->YSize);
+		SimulationConfig.StaticObstacles = ActiveGridMap->GetSharedObstacleRegions();
 	}
 }
 
@@ -47,195 +298,313 @@ void AGridGameState::StartSimulation()
 
 void AGridGameState::ResetSimulation(int32 Seed)
 {
-	RandomStream.Initialize(Seed);
-	UnitsById.Reset();
-	NextUnitId = 1;
+	// Unconsumed steps of the previous battle are dropped with the worker
+	AsyncRunner.Shutdown();
+	StopRecordingReplay();
+	ReplayPlayer.Close();
 
 	DiscoverGridMap();
 
-	SpawnInitialTeams();
+	Simulation.SetConfig(SimulationConfig);
+	Simulation.Reset(Seed);
+	StepAccumulatorSeconds = 0.f;
+
+	ResetStepDeltaHistory(Simulation.GetUnits().Num());
+
+	if (bRecordReplay)
+	{
+		ReplayWriter.Begin(SimulationConfig, Seed, Simulation.GetUnits(), ReplayKeyframeInterval);
+	}
+
+	if (bAsyncSimulation)
+	{
+		PresentedUnits.CopyFrom(Simulation.GetUnits());
+		AsyncRunner.Start(Simulation, StepDurationSeconds, AsyncMaxQueuedSteps);
+	}
+
+	OnSimulationStateReplaced.Broadcast();
+}
+
+void AGridGameState::ResetStepDeltaHistory(int32 NumUnits)
+{
+	// Units only die after spawning, so the initial count bounds every step of this battle
+	StepDeltaHistory.Initialize(StepDeltaHistorySize, FStepDeltaRing::GetMaxMovesPerStep(NumUnits),
+	                            FStepDeltaRing::GetMaxEventsPerStep(NumUnits));
+}
+
+bool AGridGameState::SaveSimulationSnapshot()
+{
+	// The async worker owns the simulation and runs ahead of what is shown
+	if (IsSimulatingAsync() || IsPlayingReplay())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Snapshots need the synchronous simulation"));
+		return false;
+	}
+
+	Simulation.SaveSnapshot(DebugSnapshot);
+	UE_LOG(LogTemp, Log, TEXT("Saved simulation snapshot at step %d"), DebugSnapshot.StepCount);
+	return true;
 }
 
-void AGridGameState::SpawnInitialTeams()
+bool AGridGameState::RestoreSimulationSnapshot()
 {
-	auto SpawnUnit = [&](EBattleTeam Team)
+	if (IsSimulatingAsync() || IsPlayingReplay() || !DebugSnapshot.IsValid())
 	{
-		FSimUnit NewUnit;
-		NewUnit.Id = NextUnitId++;
-		NewUnit.Team = Team;
-		NewUnit.HP = RandomStream.RandRange(SimulationConfig.MinHP, SimulationConfig.MaxHP);
-		do { NewUnit.Cell = MakeRandomFreeCell(); }
-		while (IsCellOccupied(NewUnit.Cell));
-		UnitsById.Add(NewUnit.Id, NewUnit);
-	};
+		UE_LOG(LogTemp, Warning, TEXT("No simulation snapshot to restore"));
+		return false;
+	}
+
+	// The recorded steps no longer lead to the restored state
+	StopRecordingReplay();
 
-	SpawnUnit(EBattleTeam::Red);
-	SpawnUnit(EBattleTeam::Blue);
+	Simulation.RestoreSnapshot(DebugSnapshot);
+	ResetStepDeltaHistory(Simulation.GetUnits().Num());
+	StepAccumulatorSeconds = 0.f;
+	OnSimulationStateReplaced.Broadcast();
+	return true;
 }
 
-FGridCoordinate AGridGameState::MakeRandomFreeCell() const
+bool AGridGameState::SaveReplay(const FString& Filename)
 {
-	const int32 X = RandomStream.RandRange(0, SimulationConfig.GridSize.X - 1);
-	const int32 Y = RandomStream.RandRange(0, SimulationConfig.GridSize.Y - 1);
-	return FGridCoordinate(X, Y);
+	if (!ReplayWriter.IsRecording())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No replay is being recorded, enable bRecordReplay before the reset"));
+		return false;
+	}
+
+	const FString ReplayPath = ResolveReplayPath(Filename.IsEmpty()
+		? FString::Printf(TEXT("Battle-%d-%s.gbreplay"), ReplayWriter.GetHeader().Seed, *FDateTime::Now().ToString())
+		: Filename);
+
+	const int32 NumSteps = ReplayWriter.GetNumSteps();
+	if (!ReplayWriter.SaveToFile(ReplayPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write replay %s"), *ReplayPath);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Saved replay %s: %d steps in %lld bytes"), *ReplayPath, NumSteps, ReplayWriter.GetNumBytes());
+	return true;
 }
 
-bool AGridGameState::IsCellOccupied(const FGridCoordinate& Cell, int32 IgnoredUnitId) const
+void AGridGameState::StopRecordingReplay()
 {
-	for (const auto& Entry : UnitsById)
+	if (ReplayWriter.IsRecording() && ReplayWriter.GetNumSteps() > 0)
 	{
-		const FSimUnit& Unit = Entry.Value;
-		if (!Unit.bAlive) continue;
-		if (Unit.Id == IgnoredUnitId) continue;
-		if (Unit.Cell == Cell) return true;
+		SaveReplay();
 	}
-	return false;
+	ReplayWriter.Reset();
 }
 
-int32 AGridGameState::FindClosestEnemyUnitId(const FSimUnit& SourceUnit) const
+bool AGridGameState::PlayReplay(const FString& Filename)
 {
-	int32 ClosestEnemyUnitId = -1;
-	int32 ShortestGridDistance = TNumericLimits<int32>::Max();
+	AsyncRunner.Shutdown();
+	StopRecordingReplay();
 
-	for (const auto& Entry : UnitsById)
+	const FString ReplayPath = ResolveReplayPath(Filename);
+	if (!ReplayPlayer.OpenFile(ReplayPath))
 	{
-		const FSimUnit& CandidateUnit = Entry.Value;
-		if (!CandidateUnit.bAlive || CandidateUnit.Team == SourceUnit.Team)
-			continue;
+		// The simulation was stopped, pick it back up rather than leave the battle frozen
+		ResetSimulation(SimulationConfig.Seed);
+		return false;
+	}
 
-		const int32 GridDistanceToCandidate = Manhattan(SourceUnit.Cell, CandidateUnit.Cell);
-		const bool IsStrictlyCloser = GridDistanceToCandidate < ShortestGridDistance;
-		const bool IsTieButSmallerId = (GridDistanceToCandidate == ShortestGridDistance) &&
-			(CandidateUnit.Id < ClosestEnemyUnitId);
+	const FBattleReplayHeader& Header = ReplayPlayer.GetHeader();
+	if (Header.GridSize != SimulationConfig.GridSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Replay %s was recorded on a %dx%d grid, the map is %dx%d"), *ReplayPath,
+		       Header.GridSize.X, Header.GridSize.Y, SimulationConfig.GridSize.X, SimulationConfig.GridSize.Y);
+	}
 
-		if (IsStrictlyCloser || IsTieButSmallerId)
-		{
-			ShortestGridDistance = GridDistanceToCandidate;
-			ClosestEnemyUnitId = CandidateUnit.Id;
-		}
+	StepAccumulatorSeconds = 0.f;
+	ResetStepDeltaHistory(ReplayPlayer.GetUnits().Num());
+
+	UE_LOG(LogTemp, Log, TEXT("Playing replay %s: seed %d, %d steps"), *ReplayPath, Header.Seed, Header.NumSteps);
+	OnSimulationStateReplaced.Broadcast();
+	return true;
+}
+
+void AGridGameState::SeekReplay(int32 Step)
+{
+	if (!IsPlayingReplay()) return;
+
+	// A failed seek closes the player on bad data
+	if (!ReplayPlayer.SeekToStep(Step))
+	{
+		ResetSimulation(SimulationConfig.Seed);
+		return;
 	}
-	return ClosestEnemyUnitId;
+
+	StepAccumulatorSeconds = 0.f;
+	OnSimulationStateReplaced.Broadcast();
 }
 
-bool AGridGameState::IsBattleOver() const
+void AGridGameState::StopReplay()
 {
-	bool AnyRed = false, AnyBlue = false;
-	for (const auto& Entry : UnitsById)
+	if (!IsPlayingReplay()) return;
+
+	ResetSimulation(SimulationConfig.Seed);
+}
+
+void AGridGameState::BenchmarkMovementPlanners(int32 MaxSteps)
+{
+	const FPlannerComparison Comparison = FBattleSimBenchmark::CompareMovementPlanners(SimulationConfig, MaxSteps);
+	FBattleSimBenchmark::LogPlannerComparison(SimulationConfig, Comparison);
+}
+
+void AGridGameState::RunBattleBatch(int32 FirstSeed, int32 NumBattles, int32 MaxStepsPerBattle)
+{
+	FBattleBatchSummary Summary;
+	FBattleBatchRunner::Run(SimulationConfig, FirstSeed, NumBattles, MaxStepsPerBattle, Summary);
+	FBattleBatchRunner::LogSummary(SimulationConfig, Summary);
+}
+
+void AGridGameState::CountStepAllocations(int32 NumSteps)
+{
+	if (!FAllocationCounter::IsInstalled())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("CountStepAllocations needs the allocation counter, run with -CountAllocations (not available in shipping builds)"));
+		return;
+	}
+
+	AllocationCountStepsLeft = FMath::Max(1, NumSteps);
+	AllocationCountSteps = 0;
+	AllocationCountStepsThatAllocated = 0;
+	AllocationCountSimulationTotal = 0;
+	AllocationCountListenerTotal = 0;
+}
+
+void AGridGameState::RecordStepAllocations(uint64 SimulationAllocations, uint64 ListenerAllocations)
+{
+	INC_DWORD_STAT_BY(STAT_GridBattle_StepAllocations, SimulationAllocations);
+	INC_DWORD_STAT_BY(STAT_GridBattle_StepListenerAllocations, ListenerAllocations);
+
+	if (AllocationCountStepsLeft <= 0) return;
+
+	++AllocationCountSteps;
+	AllocationCountStepsThatAllocated += SimulationAllocations > 0 ? 1 : 0;
+	AllocationCountSimulationTotal += SimulationAllocations;
+	AllocationCountListenerTotal += ListenerAllocations;
+
+	if (--AllocationCountStepsLeft == 0)
 	{
-		const FSimUnit& Unit = Entry.Value;
-		if (!Unit.bAlive) continue;
-		if (Unit.Team == EBattleTeam::Red) AnyRed = true;
-		else AnyBlue = true;
+		UE_LOG(LogTemp, Log, TEXT("Step allocations over %d steps: %llu in the simulation (%d steps allocated), %llu in step listeners"),
+		       AllocationCountSteps, AllocationCountSimulationTotal, AllocationCountStepsThatAllocated, AllocationCountListenerTotal);
 	}
-	return !(AnyRed && AnyBlue);
 }
 
 void AGridGameState::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
+	int32 StepsThisFrame;
+	if (IsPlayingReplay())
+	{
+		StepsThisFrame = PlayReplaySteps(DeltaSeconds);
+	}
+	else
+	{
+		StepsThisFrame = IsSimulatingAsync() ? PresentAsyncSteps() : StepSynchronously(DeltaSeconds);
+	}
+
+	const int32 NumUnitsAlive = GetUnits().Num();
+	SET_DWORD_STAT(STAT_GridBattle_UnitsAlive, NumUnitsAlive);
+	TRACE_COUNTER_SET(GridBattleUnitsAlive, NumUnitsAlive);
+	TRACE_COUNTER_SET(GridBattleStepsThisFrame, StepsThisFrame);
+}
+
+int32 AGridGameState::StepSynchronously(float DeltaSeconds)
+{
+	int32 StepsThisFrame = 0;
+
 	StepAccumulatorSeconds += DeltaSeconds;
-	while (StepAccumulatorSeconds >= StepDurationSeconds && !IsBattleOver())
+	while (StepAccumulatorSeconds >= StepDurationSeconds && !Simulation.IsBattleOver())
 	{
-		FStepDelta ProducedStepDelta;
-		RunOneSimulationStep(ProducedStepDelta);
+		const uint64 AllocationsBeforeStep = FAllocationCounter::GetNumAllocationsOnCurrentThread();
+
+		FStepDelta& ProducedStepDelta = StepDeltaHistory.Advance();
+		Simulation.Step(ProducedStepDelta);
+		++StepsThisFrame;
 
-		OnSimulationStepProduced.Broadcast(ProducedStepDelta);
+		BroadcastStep(ProducedStepDelta, FAllocationCounter::GetNumAllocationsOnCurrentThread() - AllocationsBeforeStep);
 
 		StepAccumulatorSeconds -= StepDurationSeconds;
 	}
+
+	return StepsThisFrame;
 }
 
-void AGridGameState::RunOneSimulationStep(FStepDelta& OutStepDelta)
+int32 AGridGameState::PresentAsyncSteps()
 {
-	OutStepDelta.Moves.Reset();
-	OutStepDelta.Events.Reset();
+	int32 StepsThisFrame = 0;
 
-	TSet<FGridCoordinate> OccupiedCells;
-	for (const auto& Entry : UnitsById)
+	// Bounded by AsyncMaxQueuedSteps, the worker cannot publish past the slots we have not released
+	while (const FPublishedBattleStep* PublishedStep = AsyncRunner.PeekStep())
 	{
-		const FSimUnit& Unit = Entry.Value;
-		if (Unit.bAlive) OccupiedCells.Add(Unit.Cell);
+		const uint64 AllocationsBeforeCopy = FAllocationCounter::GetNumAllocationsOnCurrentThread();
+
+		FStepDelta& PresentedStepDelta = StepDeltaHistory.Advance();
+		PresentedStepDelta.Moves.Append(PublishedStep->Delta.Moves);
+		PresentedStepDelta.Events.Append(PublishedStep->Delta.Events);
+		PresentedStepDelta.StateHash = PublishedStep->Delta.StateHash;
+		PresentedStepDelta.GridSize = PublishedStep->Delta.GridSize;
+		PresentedUnits.CopyFrom(PublishedStep->Units);
+		AsyncRunner.PopStep();
+		++StepsThisFrame;
+
+		BroadcastStep(PresentedStepDelta, FAllocationCounter::GetNumAllocationsOnCurrentThread() - AllocationsBeforeCopy);
 	}
 
-	TArray<int32> AliveUnitIds;
-	for (const auto& Entry : UnitsById) if (Entry.Value.bAlive) AliveUnitIds.Add(Entry.Key);
-	AliveUnitIds.Sort([](int32 A, int32 B) { return A < B; });
+	return StepsThisFrame;
+}
 
-	struct FPlannedMove
-	{
-		int32 UnitId;
-		FGridCoordinate FromCell;
-		FGridCoordinate ToCell;
-	};
-	TArray<FPlannedMove> PlannedMoves;
+int32 AGridGameState::PlayReplaySteps(float DeltaSeconds)
+{
+	int32 StepsThisFrame = 0;
 
-	for (int32 UnitId : AliveUnitIds)
+	StepAccumulatorSeconds += DeltaSeconds * ReplayPlaybackSpeed;
+	while (StepAccumulatorSeconds >= StepDurationSeconds && !ReplayPlayer.IsAtEnd())
 	{
-		FSimUnit& ActingUnit = UnitsById[UnitId];
-
-		if (ActingUnit.AttackCooldown > 0) { ActingUnit.AttackCooldown--; }
+		FStepDelta& ReplayedStepDelta = StepDeltaHistory.Advance();
+		if (!ReplayPlayer.ReadNextStep(ReplayedStepDelta))
+		{
+			// Bad data closed the player
+			ResetSimulation(SimulationConfig.Seed);
+			break;
+		}
+		++StepsThisFrame;
 
-		const int32 ClosestEnemyUnitId = FindClosestEnemyUnitId(ActingUnit);
-		if (ClosestEnemyUnitId < 0) continue;
+		BroadcastStep(ReplayedStepDelta, /*SimulationAllocations*/ 0);
 
-		FSimUnit& TargetUnit = UnitsById[ClosestEnemyUnitId];
-		const int32 GridDistanceToTarget = Manhattan(ActingUnit.Cell, TargetUnit.Cell);
+		StepAccumulatorSeconds -= StepDurationSeconds;
+	}
 
-		if (GridDistanceToTarget <= SimulationConfig.AttackRangeSquares)
-		{
-			const bool IsAttackReady = (ActingUnit.AttackCooldown == 0);
-			if (IsAttackReady)
-			{
-				ActingUnit.AttackCooldown = SimulationConfig.AttackPeriodSteps;
-
-				OutStepDelta.Events.Add({EEventType::Attack, ActingUnit.Id, TargetUnit.Id});
-
-				TargetUnit.HP -= 1;
-				OutStepDelta.Events.Add({EEventType::Hit, TargetUnit.Id, ActingUnit.Id});
-
-				if (TargetUnit.HP <= 0 && TargetUnit.bAlive)
-				{
-					TargetUnit.bAlive = false;
-					OccupiedCells.Remove(TargetUnit.Cell);
-					OutStepDelta.Events.Add({EEventType::Die, TargetUnit.Id, ActingUnit.Id});
-				}
-			}
-			continue;
-		}
+	return StepsThisFrame;
+}
 
-		FPathRequest PathRequest;
-		PathRequest.Start = ActingUnit.Cell;
-		PathRequest.Goal = TargetUnit.Cell;
-		PathRequest.GridSize = SimulationConfig.GridSize;
-		PathRequest.Blocked = OccupiedCells;
-		PathRequest.Blocked.Remove(ActingUnit.Cell);
+void AGridGameState::BroadcastStep(const FStepDelta& StepDelta, uint64 SimulationAllocations)
+{
+	INC_DWORD_STAT(STAT_GridBattle_StepsThisFrame);
+	INC_DWORD_STAT_BY(STAT_GridBattle_MovesThisFrame, StepDelta.Moves.Num());
+	INC_DWORD_STAT_BY(STAT_GridBattle_EventsThisFrame, StepDelta.Events.Num());
+	TRACE_COUNTER_SET(GridBattleStepMoves, StepDelta.Moves.Num());
+	TRACE_COUNTER_SET(GridBattleStepEvents, StepDelta.Events.Num());
 
-		TArray<FGridCoordinate> Path;
-		const bool bFound = FGridAStar::FindPath(PathRequest, Path);
-		if (bFound && Path.Num() >= 2)
-		{
-			const int32 MaxCellsThisStep = FMath::Clamp(SimulationConfig.MoveSquaresPerStep, 1, 8);
-			const int32 TargetPathIndex = FMath::Min(1 + (MaxCellsThisStep - 1), Path.Num() - 1);
-			const FGridCoordinate NextCell = Path[TargetPathIndex];
-
-			if (!OccupiedCells.Contains(NextCell))
-			{
-				PlannedMoves.Add({ActingUnit.Id, ActingUnit.Cell, NextCell});
-				OccupiedCells.Remove(ActingUnit.Cell);
-				OccupiedCells.Add(NextCell); // reserve
-			}
-		}
+	if (ReplayWriter.IsRecording())
+	{
+		ReplayWriter.AppendStep(StepDelta, GetUnits());
 	}
 
-	PlannedMoves.Sort([](const FPlannedMove& L, const FPlannedMove& R) { return L.UnitId < R.UnitId; });
-	for (const FPlannedMove& Move : PlannedMoves)
+	const uint64 AllocationsBeforeListeners = FAllocationCounter::GetNumAllocationsOnCurrentThread();
+
+	OnSimulationStepProducedNative.Broadcast(StepDelta);
+	if (bBroadcastStepsToBlueprints)
 	{
-		FSimUnit& MovingUnit = UnitsById[Move.UnitId];
-		if (!MovingUnit.bAlive) continue;
-		if (MovingUnit.Cell != Move.FromCell) continue;
+		OnSimulationStepProduced.Broadcast(StepDelta);
+	}
 
-		MovingUnit.Cell = Move.ToCell;
-		OutStepDelta.Moves.Add({MovingUnit.Id, Move.FromCell, Move.ToCell});
+	if (FAllocationCounter::IsInstalled())
+	{
+		RecordStepAllocations(SimulationAllocations, FAllocationCounter::GetNumAllocationsOnCurrentThread() - AllocationsBeforeListeners);
 	}
 }
@@ -22,6 +22,7 @@ AGridMap::AGridMap()
 
 void AGridMap::Rebuild()
 {
+	SyncObstacleRegions();
 	if (!TileMesh) return;
 
 	InstancedMeshComponent->SetStaticMesh(TileMesh);
@@ -41,6 +42,12 @@ void AGridMap::OnConstruction(const FTransform& Transform)
 	Rebuild();
 }
 
+void AGridMap::PostLoad()
+{
+	Super::PostLoad();
+	SyncObstacleRegions();
+}
+
 void AGridMap::BeginPlay()
 {
 	Super::BeginPlay();
@@ -67,6 +74,8 @@ void AGridMap::BuildGrid()
 	{
 		for (int32 x = 0; x < XSize; ++x)
 		{
+			if (ObstacleRegions.IsObstacle(FGridCoordinate(x, y))) continue;
+
 			const FVector Location(OriginX + x * CellSize, OriginY + y * CellSize, 0.0f);
 			const FTransform Xform(FRotator::ZeroRotator, Location, FVector(1.0f));
 
@@ -90,3 +99,155 @@ void AGridMap::ClearGrid()
 		InstancedMeshComponent->ClearInstances();
 	}
 }
+
+void AGridMap::BlockBrushCells()
+{
+	SetBrushCells(true);
+}
+
+void AGridMap::ClearBrushCells()
+{
+	SetBrushCells(false);
+}
+
+void AGridMap::ScatterObstacles()
+{
+	Modify();
+	SyncObstacleRegions();
+
+	FRandomStream Random(ScatterSeed);
+	for (int32 y = 0; y < YSize; ++y)
+	{
+		for (int32 x = 0; x < XSize; ++x)
+		{
+			if (Random.FRand() < ScatterDensity)
+			{
+				SetObstacle(FGridCoordinate(x, y), true);
+			}
+		}
+	}
+	FinishObstacleEdit();
+}
+
+void AGridMap::ClearAllObstacles()
+{
+	Modify();
+	ObstacleGridSize = FIntPoint(XSize, YSize);
+	ObstacleWords.Reset();
+	ObstacleWords.SetNumZeroed(FMath::DivideAndRoundUp(XSize * YSize, 64));
+	FinishObstacleEdit();
+}
+
+void AGridMap::SetObstacle(const FGridCoordinate& Cell, bool bBlocked)
+{
+	const FIntPoint GridSize(XSize, YSize);
+	if (ObstacleGridSize != GridSize || ObstacleRegions.GetGridSize() != GridSize)
+	{
+		SyncObstacleRegions();
+	}
+	if (Cell.X < 0 || Cell.X >= XSize || Cell.Y < 0 || Cell.Y >= YSize) return;
+
+	ObstacleRegions.SetObstacle(Cell, bBlocked);
+	SharedObstacleRegions.Reset();
+
+	// Same bit layout as FGridOccupancy, so the saved words stay in step without copying them all
+	const int32 CellIndex = Cell.Y * XSize + Cell.X;
+	const uint64 Bit = uint64(1) << (CellIndex & 63);
+	if (bBlocked)
+	{
+		ObstacleWords[CellIndex >> 6] |= Bit;
+	}
+	else
+	{
+		ObstacleWords[CellIndex >> 6] &= ~Bit;
+	}
+}
+
+bool AGridMap::IsObstacle(const FGridCoordinate& Cell) const
+{
+	return ObstacleRegions.GetGridSize() == FIntPoint(XSize, YSize)
+		&& Cell.X >= 0 && Cell.X < XSize && Cell.Y >= 0 && Cell.Y < YSize
+		&& ObstacleRegions.IsObstacle(Cell);
+}
+
+TSharedPtr<const FGridRegionLabels> AGridMap::GetSharedObstacleRegions() const
+{
+	const FIntPoint GridSize(XSize, YSize);
+	if (ObstacleRegions.GetGridSize() != GridSize || ObstacleRegions.GetNumOpenCells() == GridSize.X * GridSize.Y)
+	{
+		return nullptr;
+	}
+
+	if (!SharedObstacleRegions)
+	{
+		SharedObstacleRegions = MakeShared<FGridRegionLabels>(ObstacleRegions);
+	}
+	return SharedObstacleRegions;
+}
+
+void AGridMap::SyncObstacleRegions()
+{
+	const FIntPoint GridSize(XSize, YSize);
+	if (ObstacleGridSize == GridSize && ObstacleRegions.GetGridSize() == GridSize
+		&& ObstacleRegions.GetObstacles().GetWords() == ObstacleWords)
+	{
+		return;
+	}
+
+	FGridOccupancy Obstacles;
+	if (ObstacleGridSize == GridSize)
+	{
+		Obstacles.InitFromWords(GridSize, ObstacleWords);
+	}
+	else
+	{
+		FGridOccupancy Previous;
+		Previous.InitFromWords(ObstacleGridSize, ObstacleWords);
+
+		Obstacles.Init(GridSize);
+		const int32 SharedX = FMath::Min(GridSize.X, ObstacleGridSize.X);
+		const int32 SharedY = FMath::Min(GridSize.Y, ObstacleGridSize.Y);
+		for (int32 y = 0; y < SharedY; ++y)
+		{
+			for (int32 x = 0; x < SharedX; ++x)
+			{
+				if (Previous.IsSet(FGridCoordinate(x, y)))
+				{
+					Obstacles.Set(FGridCoordinate(x, y));
+				}
+			}
+		}
+	}
+
+	ObstacleGridSize = GridSize;
+	ObstacleWords = Obstacles.GetWords();
+	ObstacleRegions.Build(Obstacles);
+	SharedObstacleRegions.Reset();
+}
+
+void AGridMap::SetBrushCells(bool bBlocked)
+{
+	Modify();
+	SyncObstacleRegions();
+
+	const int32 MinX = FMath::Max(FMath::Min(ObstacleBrushMin.X, ObstacleBrushMax.X), 0);
+	const int32 MinY = FMath::Max(FMath::Min(ObstacleBrushMin.Y, ObstacleBrushMax.Y), 0);
+	const int32 MaxX = FMath::Min(FMath::Max(ObstacleBrushMin.X, ObstacleBrushMax.X), XSize - 1);
+	const int32 MaxY = FMath::Min(FMath::Max(ObstacleBrushMin.Y, ObstacleBrushMax.Y), YSize - 1);
+	for (int32 y = MinY; y <= MaxY; ++y)
+	{
+		for (int32 x = MinX; x <= MaxX; ++x)
+		{
+			SetObstacle(FGridCoordinate(x, y), bBlocked);
+		}
+	}
+	FinishObstacleEdit();
+}
+
+void AGridMap::FinishObstacleEdit()
+{
+	SyncObstacleRegions();
+	UE_LOG(LogTemp, Display, TEXT("GridMap obstacles: %d blocked cells, %d regions"),
+	       XSize * YSize - ObstacleRegions.GetNumOpenCells(), ObstacleRegions.GetNumRegions());
+	Rebuild();
+}
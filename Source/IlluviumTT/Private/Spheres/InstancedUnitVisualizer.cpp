@@ -0,0 +1,165 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Spheres/InstancedUnitVisualizer.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GridBattleStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Instanced Visuals Tick"), STAT_GridBattle_InstancedVisualsTick, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Instances Animated"), STAT_GridBattle_InstancesAnimated, STATGROUP_GridBattle);
+
+AInstancedUnitVisualizer::AInstancedUnitVisualizer()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	InstancedMeshComponent = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("UnitInstancedMeshComponent"));
+	SetRootComponent(InstancedMeshComponent);
+
+	InstancedMeshComponent->SetMobility(EComponentMobility::Movable);
+	InstancedMeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstancedMeshComponent->NumCustomDataFloats = NumCustomDataFloats;
+}
+
+void AInstancedUnitVisualizer::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UnitMesh)
+	{
+		InstancedMeshComponent->SetStaticMesh(UnitMesh);
+	}
+	if (UnitMaterial)
+	{
+		InstancedMeshComponent->SetMaterial(0, UnitMaterial);
+	}
+}
+
+void AInstancedUnitVisualizer::AddUnit(int32 UnitId, EBattleTeam Team, const FVector& WorldLocation)
+{
+	if (InstanceByUnitId.Contains(UnitId)) return;
+
+	FUnitVisualAnimator::FSettings Settings;
+	Settings.StepDuration = StepDuration;
+	Settings.EmissiveDecay = EmissiveDecay;
+	Settings.DieFadeTime = DieFadeTime;
+
+	const int32 InstanceIndex = Animator.AddSlot(WorldLocation, Settings);
+	if (InstanceIndex == UnitIds.Num())
+	{
+		const int32 NewInstanceIndex = InstancedMeshComponent->AddInstance(FTransform(FQuat::Identity, WorldLocation, UnitScale), /*bWorldSpace*/ true);
+		check(NewInstanceIndex == InstanceIndex);
+
+		UnitIds.AddUninitialized();
+		TeamColors.AddUninitialized();
+	}
+
+	UnitIds[InstanceIndex] = UnitId;
+	TeamColors[InstanceIndex] = Team == EBattleTeam::Red ? RedTeamColor : BlueTeamColor;
+	InstanceByUnitId.Add(UnitId, InstanceIndex);
+
+	WriteInstance(InstanceIndex, FUnitVisualAnimator::LocationChanged | FUnitVisualAnimator::EmissiveChanged);
+	InstancedMeshComponent->MarkRenderStateDirty();
+}
+
+void AInstancedUnitVisualizer::OnUnitNewCell(int32 UnitId, const FVector& FromWorld, const FVector& ToWorld)
+{
+	const int32* InstanceIndex = InstanceByUnitId.Find(UnitId);
+	if (!InstanceIndex) return;
+
+	Animator.StartMove(*InstanceIndex, FromWorld, ToWorld);
+}
+
+void AInstancedUnitVisualizer::OnUnitAttack(int32 UnitId)
+{
+	Flash(UnitId, AttackEmissive);
+}
+
+void AInstancedUnitVisualizer::OnUnitHit(int32 UnitId)
+{
+	Flash(UnitId, HitEmissive);
+}
+
+void AInstancedUnitVisualizer::OnUnitDie(int32 UnitId)
+{
+	const int32* InstanceIndex = InstanceByUnitId.Find(UnitId);
+	if (!InstanceIndex) return;
+
+	Animator.StartDying(*InstanceIndex, DieEmissive);
+}
+
+void AInstancedUnitVisualizer::Flash(int32 UnitId, float Emissive)
+{
+	const int32* InstanceIndex = InstanceByUnitId.Find(UnitId);
+	if (!InstanceIndex) return;
+
+	Animator.Flash(*InstanceIndex, Emissive);
+}
+
+void AInstancedUnitVisualizer::ClearUnits()
+{
+	InstancedMeshComponent->ClearInstances();
+
+	InstanceByUnitId.Reset();
+	Animator.Reset();
+	UnitIds.Reset();
+	TeamColors.Reset();
+}
+
+void AInstancedUnitVisualizer::Tick(float DeltaTime)
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_InstancedVisualsTick);
+	INC_DWORD_STAT_BY(STAT_GridBattle_InstancesAnimated, Animator.GetNumAwake());
+
+	Super::Tick(DeltaTime);
+
+	if (Animator.GetNumAwake() == 0) return;
+
+	Animator.Advance(DeltaTime);
+
+	const TArray<FUnitVisualAnimator::FChange>& Changes = Animator.GetChanges();
+	for (const FUnitVisualAnimator::FChange& Change : Changes)
+	{
+		if (Change.Flags & FUnitVisualAnimator::FadedOut)
+		{
+			ReleaseInstance(Change.Slot);
+		}
+		else
+		{
+			WriteInstance(Change.Slot, Change.Flags);
+		}
+	}
+
+	if (Changes.Num() > 0)
+	{
+		InstancedMeshComponent->MarkRenderStateDirty();
+	}
+}
+
+void AInstancedUnitVisualizer::WriteInstance(int32 InstanceIndex, uint8 ChangeFlags)
+{
+	if (ChangeFlags & FUnitVisualAnimator::LocationChanged)
+	{
+		InstancedMeshComponent->UpdateInstanceTransform(InstanceIndex, FTransform(FQuat::Identity, Animator.GetLocation(InstanceIndex), UnitScale),
+		                                                /*bWorldSpace*/ true, /*bMarkRenderStateDirty*/ false, /*bTeleport*/ true);
+	}
+
+	if (ChangeFlags & (FUnitVisualAnimator::EmissiveChanged | FUnitVisualAnimator::OpacityChanged))
+	{
+		const FLinearColor& Color = TeamColors[InstanceIndex];
+		const float CustomData[NumCustomDataFloats] { Color.R, Color.G, Color.B, Animator.GetEmissive(InstanceIndex), Animator.GetOpacity(InstanceIndex) };
+		InstancedMeshComponent->SetCustomData(InstanceIndex, CustomData, /*bMarkRenderStateDirty*/ false);
+	}
+}
+
+void AInstancedUnitVisualizer::ReleaseInstance(int32 InstanceIndex)
+{
+	InstanceByUnitId.Remove(UnitIds[InstanceIndex]);
+	UnitIds[InstanceIndex] = INDEX_NONE;
+	Animator.ReleaseSlot(InstanceIndex);
+
+	// Removing would shift every later instance index, hide the slot until a new unit takes it
+	InstancedMeshComponent->UpdateInstanceTransform(InstanceIndex, FTransform(FQuat::Identity, Animator.GetLocation(InstanceIndex), FVector::ZeroVector),
+	                                                /*bWorldSpace*/ true, /*bMarkRenderStateDirty*/ false, /*bTeleport*/ true);
+	InstancedMeshComponent->SetCustomDataValue(InstanceIndex, 4, 0.f, /*bMarkRenderStateDirty*/ false);
+}
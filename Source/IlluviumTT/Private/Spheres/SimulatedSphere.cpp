@@ -3,12 +3,12 @@
 
 #include "Spheres/SimulatedSphere.h"
 
+#include "Spheres/SphereAnimationSubsystem.h"
 
 ASimulatedSphere::ASimulatedSphere()
 {
-	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bCanEverTick = false;
 
-	PrimaryActorTick.bCanEverTick = true;
 	SphereMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("SphereMesh"));
 	SetRootComponent(SphereMesh);
 	SphereMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
@@ -26,30 +26,57 @@ void ASimulatedSphere::BeginPlay()
 	ApplyTeamColor();
 }
 
-void ASimulatedSphere::Tick(float DeltaTime)
+void ASimulatedSphere::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	ReleaseAnimationSlot();
+	OnFadedOut.Unbind();
 
-	if (LerpAlpha < 1.f && StepDuration > 0.f)
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASimulatedSphere::ReleaseAnimationSlot()
+{
+	if (AnimationSubsystem && AnimationSlot != INDEX_NONE)
 	{
-		LerpAlpha = FMath::Min(1.f, LerpAlpha + DeltaTime / StepDuration);
-		const FVector P = FMath::Lerp(FromPos, ToPos, LerpAlpha);
-		SetActorLocation(P);
+		AnimationSubsystem->UnregisterSphere(AnimationSlot);
 	}
+	AnimationSlot = INDEX_NONE;
+}
 
-	if (MaterialInstance)
+void ASimulatedSphere::Deactivate()
+{
+	ReleaseAnimationSlot();
+	UnitId = -1;
+	SetActorHiddenInGame(true);
+}
+
+void ASimulatedSphere::ApplyAnimation(const FUnitVisualAnimator& Animator, int32 Slot, uint8 ChangeFlags)
+{
+	if (ChangeFlags & FUnitVisualAnimator::LocationChanged)
+	{
+		SetActorLocation(Animator.GetLocation(Slot));
+	}
+
+	if ((ChangeFlags & FUnitVisualAnimator::EmissiveChanged) && MaterialInstance)
 	{
-		EmissiveCurrent = FMath::FInterpTo(EmissiveCurrent, EmissiveTarget, DeltaTime, EmissiveDecay);
-		MaterialInstance->SetScalarParameterValue(EmissiveParam, EmissiveCurrent);
-		EmissiveTarget = FMath::FInterpTo(EmissiveTarget, 0.f, DeltaTime, EmissiveDecay * 0.5f);
+		MaterialInstance->SetScalarParameterValue(EmissiveParam, Animator.GetEmissive(Slot));
 	}
 
-	if (bDying)
+	if (ChangeFlags & FUnitVisualAnimator::OpacityChanged)
 	{
-		DieTimer += DeltaTime;
-		const float Opacity = 1.f - FMath::Clamp(DieTimer / DieFadeTime, 0.f, 1.f);
-		SphereMesh->SetScalarParameterValueOnMaterials(TEXT("Opacity"), Opacity);
-		if (DieTimer >= DieFadeTime) Destroy();
+		SphereMesh->SetScalarParameterValueOnMaterials(OpacityParam, Animator.GetOpacity(Slot));
+	}
+
+	if (ChangeFlags & FUnitVisualAnimator::FadedOut)
+	{
+		if (OnFadedOut.IsBound())
+		{
+			OnFadedOut.Execute(this);
+		}
+		else
+		{
+			Destroy();
+		}
 	}
 }
 
@@ -64,32 +91,52 @@ void ASimulatedSphere::Init(int32 InId, EBattleTeam InTeam, const FVector& Start
 {
 	UnitId = InId;
 	Team = InTeam;
-	StepDuration = InStepDuration;
-	FromPos = ToPos = StartWorld;
 	SetActorLocation(StartWorld);
+	SetActorHiddenInGame(false);
 	ApplyTeamColor();
+
+	// A reused sphere may still carry the glow and fade of its previous unit
+	if (MaterialInstance)
+	{
+		MaterialInstance->SetScalarParameterValue(EmissiveParam, 0.f);
+	}
+	SphereMesh->SetScalarParameterValueOnMaterials(OpacityParam, 1.f);
+
+	if (!AnimationSubsystem)
+	{
+		AnimationSubsystem = GetWorld()->GetSubsystem<USphereAnimationSubsystem>();
+		if (!AnimationSubsystem) return;
+	}
+
+	ReleaseAnimationSlot();
+
+	FUnitVisualAnimator::FSettings Settings;
+	Settings.StepDuration = InStepDuration;
+	Settings.EmissiveDecay = EmissiveDecay;
+	Settings.DieFadeTime = DieFadeTime;
+	AnimationSlot = AnimationSubsystem->RegisterSphere(this, StartWorld, Settings);
 }
 
 void ASimulatedSphere::OnNewCell(const FVector& FromWorld, const FVector& ToWorld)
 {
-	FromPos = FromWorld;
-	ToPos = ToWorld;
-	LerpAlpha = 0.f;
+	if (AnimationSlot == INDEX_NONE) return;
+	AnimationSubsystem->GetAnimator().StartMove(AnimationSlot, FromWorld, ToWorld);
 }
 
 void ASimulatedSphere::OnAttack()
 {
-	EmissiveTarget = 25.f;
+	if (AnimationSlot == INDEX_NONE) return;
+	AnimationSubsystem->GetAnimator().Flash(AnimationSlot, 25.f);
 }
 
 void ASimulatedSphere::OnHit()
 {
-	EmissiveTarget = 40.f;
+	if (AnimationSlot == INDEX_NONE) return;
+	AnimationSubsystem->GetAnimator().Flash(AnimationSlot, 40.f);
 }
 
 void ASimulatedSphere::OnDie()
 {
-	bDying = true;
-	DieTimer = 0.f;
-	EmissiveTarget = 80.f;
+	if (AnimationSlot == INDEX_NONE) return;
+	AnimationSubsystem->GetAnimator().StartDying(AnimationSlot, 80.f);
 }
@@ -0,0 +1,66 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Spheres/SphereAnimationSubsystem.h"
+
+#include "GridBattleStats.h"
+#include "Spheres/SimulatedSphere.h"
+
+DECLARE_CYCLE_STAT(TEXT("Sphere Animation Tick"), STAT_GridBattle_SphereAnimationTick, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Spheres Animated"), STAT_GridBattle_SpheresAnimated, STATGROUP_GridBattle);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sphere Visual Updates"), STAT_GridBattle_SphereVisualUpdates, STATGROUP_GridBattle);
+
+int32 USphereAnimationSubsystem::RegisterSphere(ASimulatedSphere* Sphere, const FVector& Location,
+                                                const FUnitVisualAnimator::FSettings& Settings)
+{
+	const int32 Slot = Animator.AddSlot(Location, Settings);
+	if (Slot >= SpheresBySlot.Num())
+	{
+		SpheresBySlot.SetNumZeroed(Slot + 1);
+	}
+	SpheresBySlot[Slot] = Sphere;
+	return Slot;
+}
+
+void USphereAnimationSubsystem::UnregisterSphere(int32 Slot)
+{
+	if (!SpheresBySlot.IsValidIndex(Slot) || !SpheresBySlot[Slot]) return;
+
+	SpheresBySlot[Slot] = nullptr;
+	Animator.ReleaseSlot(Slot);
+}
+
+void USphereAnimationSubsystem::Tick(float DeltaTime)
+{
+	GRIDBATTLE_SCOPE_CYCLE_COUNTER(STAT_GridBattle_SphereAnimationTick);
+	INC_DWORD_STAT_BY(STAT_GridBattle_SpheresAnimated, Animator.GetNumAwake());
+
+	if (Animator.GetNumAwake() == 0) return;
+
+	Animator.Advance(DeltaTime);
+
+	const TArray<FUnitVisualAnimator::FChange>& Changes = Animator.GetChanges();
+	INC_DWORD_STAT_BY(STAT_GridBattle_SphereVisualUpdates, Changes.Num());
+
+	// Actor and material updates stay on the game thread; a sphere that fades out unregisters itself while destroyed
+	for (const FUnitVisualAnimator::FChange& Change : Changes)
+	{
+		if (ASimulatedSphere* Sphere = SpheresBySlot[Change.Slot])
+		{
+			Sphere->ApplyAnimation(Animator, Change.Slot, Change.Flags);
+		}
+	}
+}
+
+TStatId USphereAnimationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USphereAnimationSubsystem, STATGROUP_Tickables);
+}
+
+void USphereAnimationSubsystem::Deinitialize()
+{
+	Animator.Reset();
+	SpheresBySlot.Reset();
+
+	Super::Deinitialize();
+}
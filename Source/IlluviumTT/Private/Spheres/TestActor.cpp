@@ -35,24 +35,39 @@ void ATestActor::BeginPlay()
 		FIntPoint(Map->XSize, Map->YSize)
 	};
 
-	// Optional: block a simple “wall” to verify detour
-	if (bPlaceSimpleWall)
+	// Optional: block a simple “wall” to verify detour, on top of the map's own obstacles
+	FGridOccupancy WallCells;
+	WallCells.CopyFrom(Map->GetObstacleRegions().GetObstacles());
+	if (WallCells.GetGridSize() != Request.GridSize)
+	{
+		WallCells.Init(Request.GridSize);
+	}
+	if (bPlaceSimpleWall && WallX >= 0 && WallX < Map->XSize)
 	{
 		for (int32 y = 0; y < Map->YSize; ++y)
 		{
 			// Make a gap so path must route through it
 			if (y == Map->YSize / 2) continue;
-			Request.Blocked.Add(FGridCoordinate(WallX, y));
+			WallCells.Set(FGridCoordinate(WallX, y));
 		}
 	}
+	Request.Occupancy = &WallCells;
+	if (!bPlaceSimpleWall)
+	{
+		Request.Regions = &Map->GetObstacleRegions();
+	}
+	Request.SearchMode = SearchMode;
 
 	// Run A*
 	TArray<FGridCoordinate> Path;
+	const double SearchStart = FPlatformTime::Seconds();
 	const bool bFound = FGridAStar::FindPath(Request, Path);
+	const double SearchMs = (FPlatformTime::Seconds() - SearchStart) * 1000.0;
 
-	UE_LOG(LogTemp, Display, TEXT("A* result: %s, nodes=%d"),
+	UE_LOG(LogTemp, Display, TEXT("%s result: %s, nodes=%d, expanded=%d, %.3fms"),
+	       SearchMode == EGridSearchMode::JumpPoint ? TEXT("JPS") : TEXT("A*"),
 	       bFound ? TEXT("FOUND") : TEXT("NO PATH"),
-	       Path.Num());
+	       Path.Num(), FGridAStar::GetThreadContext().LastNodesExpanded, SearchMs);
 
 	// Draw result
 	if (bFound && Path.Num() > 0)
@@ -0,0 +1,207 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Spheres/UnitVisualAnimator.h"
+
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// Below this a flash is invisible, the slot can stop animating
+	constexpr float EmissiveRestThreshold = 0.01f;
+
+	// Awake slots per worker batch, smaller sets are cheaper to advance inline
+	constexpr int32 MinSlotsForParallelAdvance = 1024;
+}
+
+int32 FUnitVisualAnimator::AddSlot(const FVector& Location, const FSettings& Settings)
+{
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		Slot = FreeSlots.Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		Slot = FromPositions.AddUninitialized();
+		ToPositions.AddUninitialized();
+		LerpAlphas.AddUninitialized();
+		EmissiveCurrents.AddUninitialized();
+		EmissiveTargets.AddUninitialized();
+		DieTimers.AddUninitialized();
+		Dying.AddUninitialized();
+		AwakeIndices.Add(INDEX_NONE);
+		StepDurations.AddUninitialized();
+		EmissiveDecays.AddUninitialized();
+		DieFadeTimes.AddUninitialized();
+	}
+
+	FromPositions[Slot] = Location;
+	ToPositions[Slot] = Location;
+	LerpAlphas[Slot] = 1.f;
+	EmissiveCurrents[Slot] = 0.f;
+	EmissiveTargets[Slot] = 0.f;
+	DieTimers[Slot] = 0.f;
+	Dying[Slot] = false;
+	StepDurations[Slot] = Settings.StepDuration;
+	EmissiveDecays[Slot] = Settings.EmissiveDecay;
+	DieFadeTimes[Slot] = Settings.DieFadeTime;
+	return Slot;
+}
+
+void FUnitVisualAnimator::ReleaseSlot(int32 Slot)
+{
+	const int32 AwakeIndex = AwakeIndices[Slot];
+	if (AwakeIndex != INDEX_NONE)
+	{
+		// Swap the last awake slot into the gap, so mass releases stay linear
+		AwakeIndices[Slot] = INDEX_NONE;
+		AwakeSlots.RemoveAtSwap(AwakeIndex, 1, EAllowShrinking::No);
+		if (AwakeIndex < AwakeSlots.Num())
+		{
+			AwakeIndices[AwakeSlots[AwakeIndex]] = AwakeIndex;
+		}
+	}
+	Dying[Slot] = false;
+	FreeSlots.Add(Slot);
+}
+
+void FUnitVisualAnimator::Reset()
+{
+	FromPositions.Reset();
+	ToPositions.Reset();
+	LerpAlphas.Reset();
+	EmissiveCurrents.Reset();
+	EmissiveTargets.Reset();
+	DieTimers.Reset();
+	Dying.Reset();
+	AwakeIndices.Reset();
+	StepDurations.Reset();
+	EmissiveDecays.Reset();
+	DieFadeTimes.Reset();
+	AwakeSlots.Reset();
+	FreeSlots.Reset();
+	Changes.Reset();
+}
+
+void FUnitVisualAnimator::StartMove(int32 Slot, const FVector& From, const FVector& To)
+{
+	FromPositions[Slot] = From;
+	ToPositions[Slot] = To;
+	LerpAlphas[Slot] = 0.f;
+	Wake(Slot);
+}
+
+void FUnitVisualAnimator::Flash(int32 Slot, float Emissive)
+{
+	EmissiveTargets[Slot] = Emissive;
+	Wake(Slot);
+}
+
+void FUnitVisualAnimator::StartDying(int32 Slot, float Emissive)
+{
+	Dying[Slot] = true;
+	DieTimers[Slot] = 0.f;
+	EmissiveTargets[Slot] = Emissive;
+	Wake(Slot);
+}
+
+void FUnitVisualAnimator::Wake(int32 Slot)
+{
+	if (AwakeIndices[Slot] != INDEX_NONE) return;
+
+	AwakeIndices[Slot] = AwakeSlots.Add(Slot);
+}
+
+uint8 FUnitVisualAnimator::AdvanceSlot(int32 Slot, float DeltaTime)
+{
+	uint8 Flags = None;
+
+	if (LerpAlphas[Slot] < 1.f)
+	{
+		LerpAlphas[Slot] = StepDurations[Slot] > 0.f ? FMath::Min(1.f, LerpAlphas[Slot] + DeltaTime / StepDurations[Slot]) : 1.f;
+		Flags |= LocationChanged;
+	}
+
+	// Same easing as the original per-sphere tick
+	const float PreviousEmissive = EmissiveCurrents[Slot];
+	EmissiveCurrents[Slot] = FMath::FInterpTo(EmissiveCurrents[Slot], EmissiveTargets[Slot], DeltaTime, EmissiveDecays[Slot]);
+	EmissiveTargets[Slot] = FMath::FInterpTo(EmissiveTargets[Slot], 0.f, DeltaTime, EmissiveDecays[Slot] * 0.5f);
+
+	const bool bEmissiveAtRest = EmissiveCurrents[Slot] <= EmissiveRestThreshold && EmissiveTargets[Slot] <= EmissiveRestThreshold;
+	if (bEmissiveAtRest)
+	{
+		// Settle on exactly zero so the last pushed value leaves no glow behind
+		EmissiveCurrents[Slot] = 0.f;
+		EmissiveTargets[Slot] = 0.f;
+	}
+	if (EmissiveCurrents[Slot] != PreviousEmissive)
+	{
+		Flags |= EmissiveChanged;
+	}
+
+	if (Dying[Slot])
+	{
+		DieTimers[Slot] += DeltaTime;
+		Flags |= OpacityChanged;
+		if (DieTimers[Slot] >= DieFadeTimes[Slot])
+		{
+			Flags |= FadedOut;
+		}
+	}
+
+	return Flags;
+}
+
+void FUnitVisualAnimator::Advance(float DeltaTime, bool bAllowParallel)
+{
+	const int32 NumAwake = AwakeSlots.Num();
+	Changes.SetNumUninitialized(NumAwake, EAllowShrinking::No);
+
+	auto AdvanceAwake = [this, DeltaTime](int32 AwakeIndex)
+	{
+		const int32 Slot = AwakeSlots[AwakeIndex];
+		Changes[AwakeIndex] = { Slot, AdvanceSlot(Slot, DeltaTime) };
+	};
+
+	if (bAllowParallel && NumAwake >= MinSlotsForParallelAdvance)
+	{
+		ParallelFor(NumAwake, AdvanceAwake);
+	}
+	else
+	{
+		for (int32 AwakeIndex = 0; AwakeIndex < NumAwake; ++AwakeIndex)
+		{
+			AdvanceAwake(AwakeIndex);
+		}
+	}
+
+	// Put finished slots to sleep and keep only the entries that changed something. Both arrays are compacted in
+	// place; the write indices never pass the read index, so no entry is overwritten before it is read.
+	int32 NumStillAwake = 0;
+	int32 NumChanges = 0;
+	for (int32 AwakeIndex = 0; AwakeIndex < NumAwake; ++AwakeIndex)
+	{
+		const FChange Change = Changes[AwakeIndex];
+		const int32 Slot = Change.Slot;
+
+		const bool bStillAnimating = !(Change.Flags & FadedOut) &&
+			(Dying[Slot] || LerpAlphas[Slot] < 1.f || EmissiveCurrents[Slot] > 0.f || EmissiveTargets[Slot] > 0.f);
+		if (bStillAnimating)
+		{
+			AwakeIndices[Slot] = NumStillAwake;
+			AwakeSlots[NumStillAwake++] = Slot;
+		}
+		else
+		{
+			AwakeIndices[Slot] = INDEX_NONE;
+		}
+
+		if (Change.Flags != None)
+		{
+			Changes[NumChanges++] = Change;
+		}
+	}
+	AwakeSlots.SetNum(NumStillAwake, EAllowShrinking::No);
+	Changes.SetNum(NumChanges, EAllowShrinking::No);
+}
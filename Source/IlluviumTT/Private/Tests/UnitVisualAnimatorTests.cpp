@@ -0,0 +1,135 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Spheres/UnitVisualAnimator.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr auto UnitVisualTestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+		EAutomationTestFlags::EngineFilter;
+
+	bool HasChange(const FUnitVisualAnimator& Animator, int32 Slot, uint8 Flag)
+	{
+		return Animator.GetChanges().ContainsByPredicate([Slot, Flag](const FUnitVisualAnimator::FChange& Change)
+		{
+			return Change.Slot == Slot && (Change.Flags & Flag) != 0;
+		});
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FUnitVisualAnimatorSleepTest, "IlluviumTT.Visuals.UnitVisualAnimator.MixedSleep", UnitVisualTestFlags)
+
+bool FUnitVisualAnimatorSleepTest::RunTest(const FString& Parameters)
+{
+	FUnitVisualAnimator::FSettings SlowSettings;
+	SlowSettings.StepDuration = 1.f;
+	FUnitVisualAnimator::FSettings FastSettings;
+	FastSettings.StepDuration = 0.01f;
+	FastSettings.DieFadeTime = 0.01f;
+
+	// Even slots keep moving for a while, odd slots finish on the first Advance, some by fading out
+	constexpr int32 NumSlots = 8;
+	FUnitVisualAnimator Animator;
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		Animator.AddSlot(FVector::ZeroVector, Slot % 2 == 0 ? SlowSettings : FastSettings);
+	}
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		if (Slot % 4 == 3)
+		{
+			Animator.StartDying(Slot, 0.f);
+		}
+		else
+		{
+			Animator.StartMove(Slot, FVector::ZeroVector, FVector(100.f, 0.f, 0.f));
+		}
+	}
+
+	Animator.Advance(0.05f, false);
+
+	TestEqual(TEXT("Slots still awake"), Animator.GetNumAwake(), NumSlots / 2);
+	TestEqual(TEXT("Changes recorded"), Animator.GetChanges().Num(), NumSlots);
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		if (Slot % 4 == 3)
+		{
+			TestTrue(FString::Printf(TEXT("Slot %d faded out"), Slot), HasChange(Animator, Slot, FUnitVisualAnimator::FadedOut));
+		}
+		else
+		{
+			TestTrue(FString::Printf(TEXT("Slot %d moved"), Slot), HasChange(Animator, Slot, FUnitVisualAnimator::LocationChanged));
+		}
+	}
+
+	// Only the slow slots may still report changes, and each exactly once
+	Animator.Advance(0.05f, false);
+	TestEqual(TEXT("Changes after the fast slots slept"), Animator.GetChanges().Num(), NumSlots / 2);
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		TestEqual(FString::Printf(TEXT("Slot %d reported while awake"), Slot),
+		          HasChange(Animator, Slot, FUnitVisualAnimator::LocationChanged), Slot % 2 == 0);
+	}
+
+	// Waking a slept slot must add it back exactly once
+	Animator.StartMove(1, FVector::ZeroVector, FVector(0.f, 100.f, 0.f));
+	TestEqual(TEXT("Slots awake after waking a slept one"), Animator.GetNumAwake(), NumSlots / 2 + 1);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FUnitVisualAnimatorReleaseTest, "IlluviumTT.Visuals.UnitVisualAnimator.ReleaseAwake", UnitVisualTestFlags)
+
+bool FUnitVisualAnimatorReleaseTest::RunTest(const FString& Parameters)
+{
+	FUnitVisualAnimator::FSettings Settings;
+	Settings.StepDuration = 1.f;
+
+	constexpr int32 NumSlots = 64;
+	FUnitVisualAnimator Animator;
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		Animator.AddSlot(FVector::ZeroVector, Settings);
+		Animator.StartMove(Slot, FVector::ZeroVector, FVector(100.f, 0.f, 0.f));
+	}
+
+	// Release from both ends and the middle of the awake list, as a mass death does
+	for (int32 Slot = 0; Slot < NumSlots; Slot += 3)
+	{
+		Animator.ReleaseSlot(Slot);
+	}
+	const int32 NumReleased = (NumSlots + 2) / 3;
+	TestEqual(TEXT("Slots awake after releasing"), Animator.GetNumAwake(), NumSlots - NumReleased);
+
+	Animator.Advance(0.05f, false);
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		TestEqual(FString::Printf(TEXT("Slot %d moved"), Slot),
+		          HasChange(Animator, Slot, FUnitVisualAnimator::LocationChanged), Slot % 3 != 0);
+	}
+
+	// A reused slot starts asleep and wakes once, and releasing awake slots after an Advance still finds them
+	const int32 ReusedSlot = Animator.AddSlot(FVector::ZeroVector, Settings);
+	TestEqual(TEXT("Slots awake after reusing a released slot"), Animator.GetNumAwake(), NumSlots - NumReleased);
+	Animator.StartMove(ReusedSlot, FVector::ZeroVector, FVector(0.f, 100.f, 0.f));
+	Animator.StartMove(ReusedSlot, FVector::ZeroVector, FVector(0.f, 100.f, 0.f));
+	TestEqual(TEXT("Slots awake after waking the reused slot"), Animator.GetNumAwake(), NumSlots - NumReleased + 1);
+
+	for (int32 Slot = 1; Slot < NumSlots; Slot += 3)
+	{
+		Animator.ReleaseSlot(Slot);
+	}
+	Animator.Advance(0.05f, false);
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		TestEqual(FString::Printf(TEXT("Slot %d moved after the second release"), Slot),
+		          HasChange(Animator, Slot, FUnitVisualAnimator::LocationChanged), Slot % 3 == 2 || Slot == ReusedSlot);
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,26 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GridBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs the FGridPerfSuite sweep headless and writes the results as JSON.
+ *
+ * UnrealEditor-Cmd IlluviumTT.uproject -run=GridBenchmark -nullrhi [-Quick] [-Output=<file>]
+ *     [-GridSizes=100,256] [-Densities=0,0.1] [-UnitCounts=2,1000] [-PathQueries=64] [-Steps=20]
+ *     [-Seed=1337] [-ExpansionBudget=1024] [-PathBudgetPerStep=4096]
+ *     [-NoWall] [-NoJPS] [-NoRegions] [-ParallelPlanning] [-NoAllocationCounting]
+ */
+UCLASS()
+class ILLUVIUMTT_API UGridBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGridBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -8,6 +8,7 @@
 #include "BattleSimGameMode.generated.h"
 
 class ASimulatedSphere;
+class AInstancedUnitVisualizer;
 class AGridGameState;
 class AGridMap;
 
@@ -26,19 +27,41 @@ protected:
 	virtual void BeginPlay() override;
 
 private:
-	UFUNCTION()
 	void HandleSimulationStepProduced(const FStepDelta& StepDelta);
+	/** Rebuilds every visual from the current units after a reset, replay start or seek. */
+	void HandleSimulationStateReplaced();
 
 	void SyncMissingVisuals();
 	void ApplyStepDeltaToVisuals(const FStepDelta& StepDelta);
+	void ApplyStepDeltaToInstances(const FStepDelta& StepDelta);
 	void CleanupDeadVisuals();
 
+	/** Takes a hidden sphere from the pool, spawning one only when the pool is empty. */
+	ASimulatedSphere* AcquireSphere(const FVector& Location);
+	void ReleaseSphere(ASimulatedSphere* Sphere);
+	void WarmSpherePool(int32 NumSpheres);
+	ASimulatedSphere* SpawnPooledSphere(const FVector& Location);
+
 	FVector CellToWorld(const FGridCoordinate& Cell) const;
 
 public:
 	UPROPERTY(EditAnywhere, Category="Visual")
 	TSubclassOf<ASimulatedSphere> SimulatedSphereClass;
 
+	/**
+	 * Spheres spawned hidden in BeginPlay. Dead units and resets return their spheres to the pool, so a pool at
+	 * least as large as the largest battle spawns no actors after startup.
+	 */
+	UPROPERTY(EditAnywhere, Category="Visual", meta=(ClampMin="0", EditCondition="!bUseInstancedVisuals"))
+	int32 SpherePoolWarmupSize = 0;
+
+	/** Draws all units through one AInstancedUnitVisualizer instead of spawning an ASimulatedSphere per unit. */
+	UPROPERTY(EditAnywhere, Category="Visual")
+	bool bUseInstancedVisuals = false;
+
+	UPROPERTY(EditAnywhere, Category="Visual", meta=(EditCondition="bUseInstancedVisuals"))
+	TSubclassOf<AInstancedUnitVisualizer> InstancedVisualizerClass;
+
 	UPROPERTY(EditAnywhere, Category="Visual")
 	float CellZOffset = 140.f;
 
@@ -47,6 +70,12 @@ private:
 	AGridGameState* GridGameState = nullptr;
 	UPROPERTY()
 	AGridMap* ActiveGridMap = nullptr;
+	UPROPERTY()
+	AInstancedUnitVisualizer* InstancedVisualizer = nullptr;
 
 	TMap<int32, ASimulatedSphere*> VisualByUnitId;
+
+	/** Hidden spheres ready for reuse. */
+	UPROPERTY()
+	TArray<ASimulatedSphere*> SpherePool;
 };
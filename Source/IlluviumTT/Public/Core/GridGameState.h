@@ -6,12 +6,22 @@
 #include "BattleTypes.h"
 #include "GameFramework/GameStateBase.h"
 #include "IlluviumTT/Public/Interfaces/GetGridMapInterface.h"
+#include "Replay/BattleReplay.h"
+#include "Simulation/AsyncBattleRunner.h"
+#include "Simulation/BattleSimulation.h"
+#include "Simulation/StepDeltaRing.h"
 #include "GridGameState.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSimulationStepProduced, const FStepDelta&, StepDelta);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnSimulationStepProducedNative, const FStepDelta&);
 
 class AGridMap;
 
+/**
+ * Drives an FBattleSimulation and broadcasts the produced step deltas, either stepping it from actor ticks or, with
+ * bAsyncSimulation, presenting the steps an FAsyncBattleRunner produces on its own thread. While a replay plays,
+ * its decoded steps are broadcast instead and no simulation runs.
+ */
 UCLASS()
 class ILLUVIUMTT_API AGridGameState : public AGameStateBase, public IGetGridMapInterface
 {
@@ -23,7 +33,25 @@ public:
 	virtual AGridMap* GetGridMap() const { return ActiveGridMap; }
 	void SetGridMap(AGridMap* NewGridMap) { ActiveGridMap = NewGridMap; }
 
-	const TMap<int32, FSimUnit>& GetUnitsById() const { return UnitsById; }
+	bool IsSimulatingAsync() const { return AsyncRunner.IsRunning(); }
+	bool IsPlayingReplay() const { return ReplayPlayer.IsOpen(); }
+
+	/** The live simulation. Owned by the worker while IsSimulatingAsync() and idle while IsPlayingReplay(). */
+	const FBattleSimulation& GetSimulation() const { return Simulation; }
+
+	/** Read-only view of the living units as of the latest broadcast step, ordered by Id. */
+	const FSimUnitStore& GetUnits() const
+	{
+		if (IsPlayingReplay()) return ReplayPlayer.GetUnits();
+		return IsSimulatingAsync() ? PresentedUnits : Simulation.GetUnits();
+	}
+
+	/** Live simulation state, not to be read while IsSimulatingAsync() and stale while IsPlayingReplay(). */
+	const FGridOccupancy& GetOccupancy() const { return Simulation.GetOccupancy(); }
+	const FGridSpatialIndex& GetSpatialIndex() const { return Simulation.GetSpatialIndex(); }
+
+	/** The delta of the latest step, or of one StepsAgo steps before it while the history still holds it. */
+	const FStepDelta* GetRecentStepDelta(int32 StepsAgo = 0) const { return StepDeltaHistory.GetRecent(StepsAgo); }
 
 	UFUNCTION(BlueprintCallable, Category="Simulation")
 	void ResetSimulation(int32 Seed);
@@ -31,20 +59,73 @@ public:
 	UFUNCTION(BlueprintCallable, Category="Simulation")
 	void StartSimulation();
 
+	/**
+	 * Writes the battle recorded since the last reset. Relative names and an empty name, which picks one from the
+	 * seed and time, land in Saved/Replays. Recording stops with the save.
+	 */
+	UFUNCTION(BlueprintCallable, Category="Replay")
+	bool SaveReplay(const FString& Filename = TEXT(""));
+
+	/** Stops the simulation and plays the replay file at ReplayPlaybackSpeed from its first step. */
+	UFUNCTION(BlueprintCallable, Category="Replay")
+	bool PlayReplay(const FString& Filename);
+
+	/** Jumps the playing replay to the state right after Step steps. */
+	UFUNCTION(BlueprintCallable, Category="Replay")
+	void SeekReplay(int32 Step);
+
+	/** Closes the replay and restarts the simulation from SimulationConfig.Seed. */
+	UFUNCTION(BlueprintCallable, Category="Replay")
+	void StopReplay();
+
+	/**
+	 * Plays the configured battle from SimulationConfig.Seed once per movement planner on separate simulations
+	 * and logs step timings and where the outcomes diverge. The running battle is left untouched.
+	 */
+	UFUNCTION(BlueprintCallable, Category="Simulation")
+	void BenchmarkMovementPlanners(int32 MaxSteps = 1000);
+
+	/**
+	 * Plays SimulationConfig headless on all cores for NumBattles seeds starting at FirstSeed and logs win rates,
+	 * step counts and survivor HP. The running battle is left untouched.
+	 */
+	UFUNCTION(BlueprintCallable, Category="Simulation")
+	void RunBattleBatch(int32 FirstSeed, int32 NumBattles = 1000, int32 MaxStepsPerBattle = 1000);
+
+	/**
+	 * Logs the heap allocations the next NumSteps steps make on the game thread, split into the simulation step
+	 * itself (copying the published step when async) and the step listeners. Needs the allocation counter, which is
+	 * only installed at startup with -CountAllocations.
+	 */
+	void CountStepAllocations(int32 NumSteps);
+
+	/** Remembers the current battle state for RestoreSimulationSnapshot. Only while stepping synchronously. */
+	bool SaveSimulationSnapshot();
+
+	/** Rewinds, or fast forwards, the battle to the state kept by SaveSimulationSnapshot. */
+	bool RestoreSimulationSnapshot();
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Tick(float DeltaSeconds) override;
 
 private:
+	/** Runs the steps due this frame on the game thread. @return the number of steps run. */
+	int32 StepSynchronously(float DeltaSeconds);
+	/** Broadcasts every step the async runner published since the last frame. @return the number of steps. */
+	int32 PresentAsyncSteps();
+	/** Decodes and broadcasts the replay steps due this frame. @return the number of steps. */
+	int32 PlayReplaySteps(float DeltaSeconds);
+	void BroadcastStep(const FStepDelta& StepDelta, uint64 SimulationAllocations);
+
 	void DiscoverGridMap();
 	void InitializeFromConfig();
-	void SpawnInitialTeams();
-	FGridCoordinate MakeRandomFreeCell() const;
-	bool IsCellOccupied(const FGridCoordinate& Cell, int32 IgnoredUnitId = -1) const;
-	int32 FindClosestEnemyUnitId(const FSimUnit& SourceUnit) const;
-	bool IsBattleOver() const;
+	void RecordStepAllocations(uint64 SimulationAllocations, uint64 ListenerAllocations);
 
-	void RunOneSimulationStep(FStepDelta& OutStepDelta);
+	/** Ends the recording, saving it under a generated name if it holds any steps. */
+	void StopRecordingReplay();
+	void ResetStepDeltaHistory(int32 NumUnits);
 
 public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Grid")
@@ -56,15 +137,70 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Simulation", meta=(ClampMin="1.0"))
 	float SimulationStepsPerSecond = 10.f;
 
+	/**
+	 * Steps the battle on a worker thread at SimulationStepsPerSecond instead of inside Tick, so slow steps never
+	 * stall a frame. The steps are identical to the synchronous mode. Takes effect on the next reset.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Simulation")
+	bool bAsyncSimulation = false;
+
+	/** Steps the worker may run ahead of the game thread before it waits. */
+	UPROPERTY(EditAnywhere, Category="Simulation", meta=(ClampMin="1", EditCondition="bAsyncSimulation"))
+	int32 AsyncMaxQueuedSteps = 4;
+
+	/** Records every battle from its reset. A battle is saved when the next reset starts or play ends. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Replay")
+	bool bRecordReplay = false;
+
+	/** Steps between the full unit states stored in recorded replays, bounding how far a seek decodes forward. */
+	UPROPERTY(EditAnywhere, Category="Replay", meta=(ClampMin="1", EditCondition="bRecordReplay"))
+	int32 ReplayKeyframeInterval = 100;
+
+	/** Replay steps played per simulation step of real time. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Replay", meta=(ClampMin="0.0"))
+	float ReplayPlaybackSpeed = 1.f;
+
+	/** Number of recent step deltas kept readable through GetRecentStepDelta. */
+	UPROPERTY(EditAnywhere, Category="Simulation", meta=(ClampMin="1"))
+	int32 StepDeltaHistorySize = 4;
+
+	/** Broadcasts every step through OnSimulationStepProduced as well. Off by default, it dispatches through reflection. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Simulation")
+	bool bBroadcastStepsToBlueprints = false;
+
+	/** Blueprint step listeners, only broadcast while bBroadcastStepsToBlueprints is set. */
 	UPROPERTY(BlueprintAssignable, Category="Simulation")
 	FOnSimulationStepProduced OnSimulationStepProduced;
 
+	/** Step listeners for C++. The delta stays valid until the history recycles it, StepDeltaHistorySize steps later. */
+	FOnSimulationStepProducedNative OnSimulationStepProducedNative;
+
+	/** Broadcast when GetUnits() jumps to a state not reached through steps: a reset, a replay start or a seek. */
+	FSimpleMulticastDelegate OnSimulationStateReplaced;
+
 private:
-	FRandomStream RandomStream;
+	FBattleSimulation Simulation;
+
+	FAsyncBattleRunner AsyncRunner;
+
+	/** Units after the latest presented async step, GetUnits() while IsSimulatingAsync(). */
+	FSimUnitStore PresentedUnits;
+
+	/** Recycled deltas the steps are written into, so producing a step allocates nothing in steady state. */
+	FStepDeltaRing StepDeltaHistory;
+
+	/** Debug rewind point, see SaveSimulationSnapshot. */
+	FBattleSimSnapshot DebugSnapshot;
 
-	TMap<int32, FSimUnit> UnitsById;
+	FBattleReplayWriter ReplayWriter;
+	FBattleReplayPlayer ReplayPlayer;
 
-	int32 NextUnitId = 1;
+	// CountStepAllocations progress
+	int32 AllocationCountStepsLeft = 0;
+	int32 AllocationCountSteps = 0;
+	int32 AllocationCountStepsThatAllocated = 0;
+	uint64 AllocationCountSimulationTotal = 0;
+	uint64 AllocationCountListenerTotal = 0;
 
 	float StepAccumulatorSeconds = 0.f;
 
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Navigation/GridRegionLabels.h"
 #include "GridMap.generated.h"
 
 class UHierarchicalInstancedStaticMeshComponent;
@@ -22,14 +23,47 @@ public:
 	void Rebuild();
 
 	void ClearGrid();
+
+	/** Blocks every cell in the box between ObstacleBrushMin and ObstacleBrushMax. */
+	UFUNCTION(CallInEditor, Category="Obstacles")
+	void BlockBrushCells();
+
+	/** Opens every cell in the box between ObstacleBrushMin and ObstacleBrushMax. */
+	UFUNCTION(CallInEditor, Category="Obstacles")
+	void ClearBrushCells();
+
+	/** Blocks random cells at ScatterDensity on top of the obstacles already placed. */
+	UFUNCTION(CallInEditor, Category="Obstacles")
+	void ScatterObstacles();
+
+	UFUNCTION(CallInEditor, Category="Obstacles")
+	void ClearAllObstacles();
+
+	/** Edits one static cell, relabelling only the regions it touches. Rebuild() updates the tiles. */
+	void SetObstacle(const FGridCoordinate& Cell, bool bBlocked);
+
+	bool IsObstacle(const FGridCoordinate& Cell) const;
+
+	/** Obstacles and regions of the XSize by YSize grid. */
+	const FGridRegionLabels& GetObstacleRegions() const { return ObstacleRegions; }
+
+	/** Shared copy of GetObstacleRegions() for simulations, made once per edit. Null while the grid has no obstacles. */
+	TSharedPtr<const FGridRegionLabels> GetSharedObstacleRegions() const;
 	
 protected:
 	virtual void OnConstruction(const FTransform& Transform) override;
 	virtual void BeginPlay() override;
+	virtual void PostLoad() override;
 
 private:
 	void BuildGrid();
 
+	/** Brings ObstacleRegions in line with ObstacleWords, keeping the cells the old and new grid size share. */
+	void SyncObstacleRegions();
+
+	void SetBrushCells(bool bBlocked);
+	void FinishObstacleEdit();
+
 public:
 	/** Grid Params **/
 	UPROPERTY(EditAnywhere, Category="Grid", meta=(ClampMin="1"))
@@ -55,7 +89,31 @@ public:
 	UPROPERTY(EditAnywhere, Category="Visual", meta=(ClampMin="0.0", ClampMax="1.0"))
 	float CheckerDelta = 0.15f;
 
+	/** Obstacles **/
+	UPROPERTY(EditAnywhere, Category="Obstacles")
+	FGridCoordinate ObstacleBrushMin;
+
+	UPROPERTY(EditAnywhere, Category="Obstacles")
+	FGridCoordinate ObstacleBrushMax;
+
+	UPROPERTY(EditAnywhere, Category="Obstacles", meta=(ClampMin="0.0", ClampMax="1.0"))
+	float ScatterDensity = 0.2f;
+
+	UPROPERTY(EditAnywhere, Category="Obstacles")
+	int32 ScatterSeed = 1;
+
 private:
 	UPROPERTY(VisibleAnywhere, Category="Components")
 	UHierarchicalInstancedStaticMeshComponent* InstancedMeshComponent = nullptr;
+
+	/** Static obstacles in FGridOccupancy words, one bit per cell of an ObstacleGridSize grid. */
+	UPROPERTY()
+	TArray<uint64> ObstacleWords;
+
+	UPROPERTY()
+	FIntPoint ObstacleGridSize = FIntPoint::ZeroValue;
+
+	/** ObstacleWords with their region labels, rebuilt on load and updated by every edit. */
+	FGridRegionLabels ObstacleRegions;
+	mutable TSharedPtr<const FGridRegionLabels> SharedObstacleRegions;
 };
@@ -0,0 +1,96 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BattleTypes.h"
+#include "GameFramework/Actor.h"
+#include "Spheres/UnitVisualAnimator.h"
+#include "InstancedUnitVisualizer.generated.h"
+
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+class UMaterialInterface;
+
+/**
+ * Draws every unit as one instance of a single instanced static mesh component, with the same move lerp, flashes
+ * and death fade as ASimulatedSphere. Instance indices double as FUnitVisualAnimator slots, so only instances the
+ * animator reports as changed are written, and the render state is marked dirty at most once per frame.
+ *
+ * Per-instance custom data, read by the material through PerInstanceCustomData:
+ * 0-2 team colour (RGB), 3 emissive, 4 opacity.
+ */
+UCLASS()
+class ILLUVIUMTT_API AInstancedUnitVisualizer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	static constexpr int32 NumCustomDataFloats = 5;
+
+	AInstancedUnitVisualizer();
+
+	virtual void Tick(float DeltaTime) override;
+
+	void SetStepDuration(float InStepDuration) { StepDuration = InStepDuration; }
+
+	bool HasUnit(int32 UnitId) const { return InstanceByUnitId.Contains(UnitId); }
+	void AddUnit(int32 UnitId, EBattleTeam Team, const FVector& WorldLocation);
+	void OnUnitNewCell(int32 UnitId, const FVector& FromWorld, const FVector& ToWorld);
+	void OnUnitAttack(int32 UnitId);
+	void OnUnitHit(int32 UnitId);
+	void OnUnitDie(int32 UnitId);
+
+	/** Removes every unit, e.g. when the battle restarts. */
+	void ClearUnits();
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	void Flash(int32 UnitId, float Emissive);
+	void WriteInstance(int32 InstanceIndex, uint8 ChangeFlags);
+	void ReleaseInstance(int32 InstanceIndex);
+
+public:
+	UPROPERTY(VisibleAnywhere, Category="Components")
+	UInstancedStaticMeshComponent* InstancedMeshComponent = nullptr;
+
+	UPROPERTY(EditAnywhere, Category="Visual")
+	UStaticMesh* UnitMesh = nullptr;
+
+	/** Must read the custom data layout documented above. */
+	UPROPERTY(EditAnywhere, Category="Visual")
+	UMaterialInterface* UnitMaterial = nullptr;
+
+	UPROPERTY(EditAnywhere, Category="Visual")
+	FVector UnitScale = FVector(1.f);
+
+	UPROPERTY(EditAnywhere, Category="Visual")
+	FLinearColor RedTeamColor = FLinearColor(1, 0, 0);
+	UPROPERTY(EditAnywhere, Category="Visual")
+	FLinearColor BlueTeamColor = FLinearColor(0, 0.2f, 1);
+
+	UPROPERTY(EditAnywhere, Category="Visual")
+	float AttackEmissive = 25.f;
+	UPROPERTY(EditAnywhere, Category="Visual")
+	float HitEmissive = 40.f;
+	UPROPERTY(EditAnywhere, Category="Visual")
+	float DieEmissive = 80.f;
+	UPROPERTY(EditAnywhere, Category="Visual")
+	float EmissiveDecay = 12.f;
+	UPROPERTY(EditAnywhere, Category="Visual")
+	float DieFadeTime = 0.55f;
+
+private:
+	float StepDuration = 0.1f;
+
+	TMap<int32, int32> InstanceByUnitId;
+
+	/** Animation state, one slot per instance. Released slots are hidden instances waiting to be reused. */
+	FUnitVisualAnimator Animator;
+
+	// Per-instance data the animator does not track, indexed by instance
+	TArray<int32> UnitIds;
+	TArray<FLinearColor> TeamColors;
+};
@@ -5,8 +5,18 @@
 #include "CoreMinimal.h"
 #include "BattleTypes.h"
 #include "GameFramework/Actor.h"
+#include "Spheres/UnitVisualAnimator.h"
 #include "SimulatedSphere.generated.h"
 
+class USphereAnimationSubsystem;
+class ASimulatedSphere;
+
+DECLARE_DELEGATE_OneParam(FOnSimulatedSphereFadedOut, ASimulatedSphere*);
+
+/**
+ * One unit drawn as its own actor. Does not tick, its animation is advanced by USphereAnimationSubsystem.
+ * Spheres can be reused: Deactivate() hides one and Init() brings it back for another unit.
+ */
 UCLASS()
 class ILLUVIUMTT_API ASimulatedSphere : public AActor
 {
@@ -15,21 +25,31 @@ class ILLUVIUMTT_API ASimulatedSphere : public AActor
 public:
 	ASimulatedSphere();
 
-	virtual void Tick(float DeltaTime) override;
-
 	void Init(int32 InId, EBattleTeam InTeam, const FVector& StartWorld, float InStepDuration);
 	void OnNewCell(const FVector& FromWorld, const FVector& ToWorld);
 	void OnAttack();
 	void OnHit();
 	void OnDie();
 
+	/** Hides the sphere and stops animating it until the next Init. */
+	void Deactivate();
+	bool IsActive() const { return AnimationSlot != INDEX_NONE; }
+
+	/** Pushes the animator state of Slot that ChangeFlags marks as changed, and hands the sphere off once faded out. */
+	void ApplyAnimation(const FUnitVisualAnimator& Animator, int32 Slot, uint8 ChangeFlags);
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 	void ApplyTeamColor();
+	void ReleaseAnimationSlot();
 
 public:
+	/** Fired when the death fade ends. Bound by a pool to take the sphere back; unbound spheres destroy themselves. */
+	FOnSimulatedSphereFadedOut OnFadedOut;
+
 	UPROPERTY(VisibleAnywhere)
 	UStaticMeshComponent* SphereMesh = nullptr;
 
@@ -37,23 +57,21 @@ public:
 	float StepDurationSec = 0.1f;
 	UPROPERTY(EditAnywhere, Category="Visual")
 	float EmissiveDecay = 12.f;
+	UPROPERTY(EditAnywhere, Category="Visual")
+	float DieFadeTime = 0.55f;
 
 private:
 	int32 UnitId = -1;
 	EBattleTeam Team = EBattleTeam::Red;
 
-	FVector FromPos, ToPos;
-	float LerpAlpha = 1.f;
-	float StepDuration = 0.1f;
+	UPROPERTY()
+	USphereAnimationSubsystem* AnimationSubsystem = nullptr;
+	int32 AnimationSlot = INDEX_NONE;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"))
 	UMaterialInstanceDynamic* MaterialInstance = nullptr;
 
 	FName BaseColorParam = TEXT("BaseColor");
 	FName EmissiveParam = TEXT("Emissive");
-	float EmissiveCurrent = 0.f;
-	float EmissiveTarget = 0.f;
-	bool bDying = false;
-	float DieTimer = 0.f;
-	float DieFadeTime = 0.55f;
+	FName OpacityParam = TEXT("Opacity");
 };
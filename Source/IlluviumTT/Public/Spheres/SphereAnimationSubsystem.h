@@ -0,0 +1,37 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Spheres/UnitVisualAnimator.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SphereAnimationSubsystem.generated.h"
+
+class ASimulatedSphere;
+
+/**
+ * Animates every ASimulatedSphere of a world in one pass per frame. Spheres do not tick; they register a slot
+ * here and only the transforms and material parameters that actually changed are pushed back to them.
+ */
+UCLASS()
+class ILLUVIUMTT_API USphereAnimationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	int32 RegisterSphere(ASimulatedSphere* Sphere, const FVector& Location, const FUnitVisualAnimator::FSettings& Settings);
+	void UnregisterSphere(int32 Slot);
+
+	FUnitVisualAnimator& GetAnimator() { return Animator; }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	FUnitVisualAnimator Animator;
+
+	/** Sphere per animator slot, null for released slots. */
+	UPROPERTY(Transient)
+	TArray<ASimulatedSphere*> SpheresBySlot;
+};
@@ -4,7 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
-#include "IlluviumTT/Public/Navigation/GridAStar.h"
+#include "Navigation/GridAStar.h"
 #include "IlluviumTT/Public/Core/GridGameState.h"
 #include "TestActor.generated.h"
 
@@ -27,6 +27,8 @@ public:
 	UPROPERTY(EditAnywhere, Category="Test")
 	int32 WallX = 10; // vertical wall at X = WallX
 	UPROPERTY(EditAnywhere, Category="Test")
+	EGridSearchMode SearchMode = EGridSearchMode::AStar;
+	UPROPERTY(EditAnywhere, Category="Test")
 	float DebugZ = 140.f;
 	UPROPERTY(EditAnywhere, Category="Test")
 	FColor PathColor = FColor::Green;
@@ -0,0 +1,88 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Move lerp, emissive flash and death fade state for unit visuals, kept in flat arrays and advanced in a single
+ * pass. Slots with nothing left to animate fall asleep and cost nothing until a move, flash or death wakes them,
+ * so the cost of Advance() follows the number of animating units rather than the number of units.
+ */
+struct ILLUVIUMTT_API FUnitVisualAnimator
+{
+	struct FSettings
+	{
+		float StepDuration = 0.1f;
+		float EmissiveDecay = 12.f;
+		float DieFadeTime = 0.55f;
+	};
+
+	enum EChangeFlags : uint8
+	{
+		None = 0,
+		LocationChanged = 1 << 0,
+		EmissiveChanged = 1 << 1,
+		OpacityChanged = 1 << 2,
+		/** The death fade finished. The slot is asleep and should be released by its owner. */
+		FadedOut = 1 << 3
+	};
+
+	struct FChange
+	{
+		int32 Slot;
+		uint8 Flags;
+	};
+
+	/** Returns a sleeping slot at Location, reusing released slots first. */
+	int32 AddSlot(const FVector& Location, const FSettings& Settings);
+	void ReleaseSlot(int32 Slot);
+	void Reset();
+
+	void StartMove(int32 Slot, const FVector& From, const FVector& To);
+	void Flash(int32 Slot, float Emissive);
+	void StartDying(int32 Slot, float Emissive);
+
+	/**
+	 * Advances every awake slot by DeltaTime and records what changed in GetChanges(). With bAllowParallel large
+	 * awake sets are advanced on worker threads; only slot state is touched, so this is safe off the game thread.
+	 */
+	void Advance(float DeltaTime, bool bAllowParallel = true);
+
+	/** Changes recorded by the last Advance(), for the owner to push to actors or instances. */
+	const TArray<FChange>& GetChanges() const { return Changes; }
+
+	FVector GetLocation(int32 Slot) const { return FMath::Lerp(FromPositions[Slot], ToPositions[Slot], LerpAlphas[Slot]); }
+	float GetEmissive(int32 Slot) const { return EmissiveCurrents[Slot]; }
+	float GetOpacity(int32 Slot) const
+	{
+		return Dying[Slot] ? 1.f - FMath::Clamp(DieTimers[Slot] / FMath::Max(DieFadeTimes[Slot], KINDA_SMALL_NUMBER), 0.f, 1.f) : 1.f;
+	}
+
+	int32 GetNumSlots() const { return FromPositions.Num(); }
+	int32 GetNumAwake() const { return AwakeSlots.Num(); }
+
+private:
+	void Wake(int32 Slot);
+	uint8 AdvanceSlot(int32 Slot, float DeltaTime);
+
+	// Per-slot state
+	TArray<FVector> FromPositions;
+	TArray<FVector> ToPositions;
+	TArray<float> LerpAlphas;
+	TArray<float> EmissiveCurrents;
+	TArray<float> EmissiveTargets;
+	TArray<float> DieTimers;
+	TArray<bool> Dying;
+	/** Position of the slot in AwakeSlots, INDEX_NONE while it sleeps. */
+	TArray<int32> AwakeIndices;
+	TArray<float> StepDurations;
+	TArray<float> EmissiveDecays;
+	TArray<float> DieFadeTimes;
+
+	TArray<int32> AwakeSlots;
+	TArray<int32> FreeSlots;
+
+	/** Parallel to AwakeSlots while advancing, compacted to the changed slots afterwards. */
+	TArray<FChange> Changes;
+};